@@ -0,0 +1,133 @@
+/*
+ * ps1-benchmark batched primitive emitters
+ */
+
+#include <stdint.h>
+#include <stddef.h>
+#include <psxgpu.h>
+
+#include "batch.h"
+#include "hottext.h"
+
+// GP0 command bytes and packet lengths in words (excluding the OT link).
+// https://problemkaputt.de/psx-spx.htm#gpurenderpolygoncommands
+#define CODE_TILE     0x60
+#define CODE_SPRT     0x64
+#define CODE_POLY_F4  0x28
+#define CODE_POLY_FT4 0x2c
+
+#define WORDS_TILE     3
+#define WORDS_SPRT     4
+#define WORDS_POLY_F4  5
+#define WORDS_POLY_FT4 9
+
+#define ADDR_MASK 0x00ffffff
+
+#define XY(x, y) ((((uint32_t) (y)) << 16) | (((uint32_t) (x)) & 0xffff))
+
+/* Emitters */
+
+// Each emitter links a packet of the given length into the OT, writes the
+// command word and then runs the kind-specific body, which fills in the rest
+// of the packet at p from the object's x, y, w, h and i. The loop is expanded
+// once per kind, so the compiler sees constant lengths and codes and no
+// branches on the kind.
+#define BATCH_EMITTER(name, words, code, body) \
+	static HOT_TEXT uint8_t *name(const Batch_Objects *obj, uint32_t *ot, uint8_t *packet) { \
+		uint32_t *p = (uint32_t *) packet; \
+		\
+		for (int i = 0; i < obj->count; i++) { \
+			uint32_t *link = &ot[obj->z[i]]; \
+			int      x     = obj->x[i]; \
+			int      y     = obj->y[i]; \
+			int      w     = obj->w[i]; \
+			int      h     = obj->h[i]; \
+			\
+			p[0]  = ((words) << 24) | (*link & ADDR_MASK); \
+			*link = ((uint32_t) p) & ADDR_MASK; \
+			p[1]  = ((code) << 24) | obj->color[i]; \
+			body \
+			\
+			p += (words) + 1; \
+		} \
+		\
+		return (uint8_t *) p; \
+	}
+
+BATCH_EMITTER(_emit_tile, WORDS_TILE, CODE_TILE,
+	p[2] = XY(x, y);
+	p[3] = XY(w, h);
+)
+
+BATCH_EMITTER(_emit_sprt, WORDS_SPRT, CODE_SPRT,
+	p[2] = XY(x, y);
+	p[3] = (((uint32_t) obj->clut) << 16) | obj->uv[i];
+	p[4] = XY(w, h);
+)
+
+BATCH_EMITTER(_emit_poly_f4, WORDS_POLY_F4, CODE_POLY_F4,
+	p[2] = XY(x,     y);
+	p[3] = XY(x + w, y);
+	p[4] = XY(x,     y + h);
+	p[5] = XY(x + w, y + h);
+)
+
+// Texture coordinates are offset by adding to the packed (v << 8) | u value,
+// so the rectangle must not wrap around the texture page.
+BATCH_EMITTER(_emit_poly_ft4, WORDS_POLY_FT4, CODE_POLY_FT4,
+	uint32_t uv = obj->uv[i];
+
+	p[2] = XY(x,     y);
+	p[3] = (((uint32_t) obj->clut) << 16) | uv;
+	p[4] = XY(x + w, y);
+	p[5] = (((uint32_t) obj->tpage) << 16) | (uv + w);
+	p[6] = XY(x,     y + h);
+	p[7] = uv + (h << 8);
+	p[8] = XY(x + w, y + h);
+	p[9] = uv + w + (h << 8);
+)
+
+/* Public API */
+
+size_t Batch_GetSize(Batch_Kind kind, int count) {
+	switch (kind) {
+		case BATCH_TILE:
+			return count * (WORDS_TILE + 1) * 4;
+		case BATCH_SPRT:
+			return count * (WORDS_SPRT + 1) * 4 + sizeof(DR_TPAGE);
+		case BATCH_POLY_F4:
+			return count * (WORDS_POLY_F4 + 1) * 4;
+		case BATCH_POLY_FT4:
+			return count * (WORDS_POLY_FT4 + 1) * 4;
+		default:
+			return 0;
+	}
+}
+
+uint8_t *Batch_Emit(
+	Batch_Kind kind, const Batch_Objects *objects, uint32_t *ot, uint8_t *packet
+) {
+	switch (kind) {
+		case BATCH_TILE:
+			return _emit_tile(objects, ot, packet);
+
+		case BATCH_SPRT:
+			// Linked last, so that it ends up first in its OT entry.
+			packet = _emit_sprt(objects, ot, packet);
+
+			DR_TPAGE *tpage = (DR_TPAGE *) packet;
+
+			setDrawTPage(tpage, 1, 0, objects->tpage);
+			addPrim(&ot[objects->tpage_z], tpage);
+			return packet + sizeof(DR_TPAGE);
+
+		case BATCH_POLY_F4:
+			return _emit_poly_f4(objects, ot, packet);
+
+		case BATCH_POLY_FT4:
+			return _emit_poly_ft4(objects, ot, packet);
+
+		default:
+			return packet;
+	}
+}
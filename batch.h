@@ -0,0 +1,90 @@
+/*
+ * ps1-benchmark batched primitive emitters
+ */
+
+/**
+ * @file batch.h
+ * @brief Type-specialized emitters for batches of rectangular primitives
+ *
+ * @details Drawing objects one by one through draw_rectangle() costs a branch
+ * on the primitive type, a dozen arguments passed through two levels of calls
+ * and a call to new_primitive() per object, most of which is the same for
+ * every object in a frame. Batch_Emit() instead takes the objects to draw as
+ * a structure of arrays and picks a loop specialized for the primitive kind
+ * once per batch; each loop writes the GPU packets and links them into the
+ * ordering table directly, as whole 32-bit words.
+ *
+ * All objects in a batch share the same texture page and CLUT (which are
+ * ignored by the untextured kinds). Sprites carry no texture page of their
+ * own, so a DR_TPAGE primitive is emitted before them and linked into OT
+ * entry tpage_z, which must be drawn before any other entry the sprites are
+ * sorted into (i.e. be the highest such entry in a reverse-cleared OT).
+ */
+
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+
+/* Type definitions */
+
+typedef enum {
+	BATCH_TILE     = 0,
+	BATCH_SPRT     = 1,
+	BATCH_POLY_F4  = 2,
+	BATCH_POLY_FT4 = 3,
+	BATCH_NUM_KINDS
+} Batch_Kind;
+
+/**
+ * @brief Objects to draw, as a structure of arrays.
+ *
+ * @details Each array holds count entries. Colors are packed as 0x00BBGGRR
+ * and texture coordinates as (v << 8) | u, the same layout the GPU expects.
+ * The uv array may be NULL for untextured kinds.
+ */
+typedef struct {
+	int            count;
+	const int16_t  *x, *y, *w, *h;
+	const uint16_t *z;
+	const uint32_t *color;
+	const uint16_t *uv;
+
+	uint16_t tpage, clut;
+	int      tpage_z;
+} Batch_Objects;
+
+/* Public API */
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @brief Returns the size of the packets emitted for a batch.
+ *
+ * @param kind
+ * @param count Number of objects
+ * @return Size in bytes
+ */
+size_t Batch_GetSize(Batch_Kind kind, int count);
+
+/**
+ * @brief Emits a primitive for each object and links it into the OT.
+ *
+ * @details The caller must make sure there are at least
+ * Batch_GetSize(kind, objects->count) bytes available at packet.
+ *
+ * @param kind
+ * @param objects
+ * @param ot Ordering table the z entries index into
+ * @param packet Address to write the first packet to
+ * @return Address past the last packet written
+ */
+uint8_t *Batch_Emit(
+	Batch_Kind kind, const Batch_Objects *objects, uint32_t *ot, uint8_t *packet
+);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,238 @@
+/*
+ * ps1-benchmark shared definitions
+ */
+
+/**
+ * @file bench.h
+ * @brief Definitions shared between BENCH.EXE and the benchmark overlays
+ *
+ * @details Every benchmark mode that is not resident is built as a separate
+ * overlay (see modes/) and loaded from the CD on demand by the overlay loader.
+ * Overlays are dynamically linked against the main executable, so any function
+ * or variable declared here is resolved at load time through the executable's
+ * symbol map and must thus not be declared static in main.c.
+ */
+
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+#include <psxgpu.h>
+#include <psxpad.h>
+#include <psxcd.h>
+
+#include "stream.h"
+#include "timer.h"
+#include "sectorcache.h"
+
+// numero massimo figure
+#define NUM_RECTANGLES 100
+
+// Length of the ordering table, i.e. the range Z coordinates can have, 0-15 in
+// this case. Larger values will allow for more granularity with depth (useful
+// when drawing a complex 3D scene) at the expense of RAM usage and performance.
+#define OT_LENGTH NUM_RECTANGLES + 1
+
+// Minimum size of the buffers GPU commands and primitives are written to. The
+// actual size depends on the amount of RAM (see Ram_Config in ram.h).
+#define BUFFER_LENGTH 8192
+
+#define SCREEN_XRES 320
+#define SCREEN_YRES 240
+
+#define BASE_W	32
+#define BASE_H	32
+
+// Layout of the result screens drawn by the benchmark overlays
+#define RESULT_START_Y	8
+#define RESULT_DY		10
+
+/* Framebuffer/display list class */
+
+typedef struct {
+	DISPENV disp_env;
+	DRAWENV draw_env;
+
+	uint32_t ot[OT_LENGTH];
+	uint8_t  *buffer;
+} RenderBuffer;
+
+// Primitives are allocated from the active buffer's packet area (buffer_length
+// bytes long), up to packet_end. Modes that need more room can point both to
+// an arena of their own until the next flip_buffers() call.
+typedef struct {
+	RenderBuffer buffers[2];
+	size_t       buffer_length;
+	uint8_t      *next_packet, *packet_end;
+	int          active_buffer;
+} RenderContext;
+
+/* .VAG header structure */
+
+typedef struct {
+	uint32_t magic;			// 0x69474156 ("VAGi") for interleaved files
+	uint32_t version;
+	uint32_t interleave;	// Little-endian, size of each channel buffer
+	uint32_t size;			// Big-endian, in bytes
+	uint32_t sample_rate;	// Big-endian, in Hertz
+	uint32_t loop_start;	// Little-endian, in chunks (0 if not looping)
+	uint32_t loop_end;		// Little-endian, in chunks (0 for end of file)
+	uint16_t _reserved;
+	uint16_t channels;		// Little-endian, channel count (stereo if 0)
+	char     name[16];
+} VAG_Header;
+
+/**
+ * @brief CD reading state of an audio stream.
+ *
+ * @details Set up by setup_stream() and updated by feed_stream(). The byte
+ * count and read time (in timer ticks) are accumulated as each read completes
+ * and can be reset by the caller at any time.
+ *
+ * A new read is only started once at least refill_threshold sectors are free
+ * in the buffer, which thus sets the typical size of each read.
+ *
+ * Sectors are read through the global sector cache: cached sectors are
+ * copied from it rather than read, and completed reads are added to it.
+ *
+ * Failed reads are retried by feed_stream() with an increasing delay between
+ * attempts. The number of retries, of reads that were given up on and the extra
+ * latency (in timer ticks) caused by retrying are accumulated. A reserve of
+ * reserve bytes is always kept in the buffer to ride out a worst-case retry.
+ *
+ * Loop points are in sectors relative to the start of the stream data. The
+ * first sectors after the loop start are kept in RAM (the loop head) and used
+ * instead of reading from the CD if use_loop_head is set. The lowest buffer
+ * fill seen right after the last wrap around is recorded in loop_min_fill,
+ * indexed by whether the loop head was in use.
+ *
+ * If the stream has been made resident by make_stream_resident(), the loop
+ * head can grow to span the whole looped part of the stream: it is extended
+ * with each read that follows on from its end, so once playback has gone
+ * through the loop once (resident is then set) the CD is no longer read from
+ * when playback gets there.
+ */
+typedef struct {
+	int start_lba, stream_length, sample_rate;
+
+	volatile int    next_sector;
+	volatile size_t refill_length;
+	int             refill_threshold; // In sectors
+
+	volatile uint32_t    bytes_read;
+	volatile Timer_Ticks read_time, read_started;
+
+	uint8_t              *read_ptr;
+	volatile bool        fill_cache;
+	volatile Timer_Ticks last_read_time;
+
+	volatile bool        read_failed;
+	volatile int         read_sector, retries;
+	volatile uint32_t    total_retries, lost_reads;
+	volatile Timer_Ticks failed_at, retry_at, retry_time, max_retry_time;
+	size_t               reserve;
+
+	int     loop_start, loop_end, loop_head_length, loop_head_capacity;
+	uint8_t *loop_head;
+	bool    use_loop_head, resident;
+	int     loop_frames;
+	size_t  loop_fill, loop_min_fill[2];
+} StreamReadContext;
+
+/**
+ * @brief Benchmark mode interface.
+ *
+ * @details Each overlay exports a single instance of this structure named
+ * "bench_mode", which the menu uses to drive the mode once the overlay has
+ * been loaded. All callbacks are optional. The overlay stays in memory (and
+ * keeps its state) until another overlay is loaded in its place.
+ */
+typedef struct {
+	void (*init)(void);
+	void (*end)(void);
+	void (*pause)(void);
+	void (*resume)(void);
+	void (*handle_commands)(PADTYPE *pad);
+	void (*draw)(RenderContext *ctx);
+} BenchMode;
+
+/**
+ * @brief State of a benchmark that blocks the main loop while it runs.
+ *
+ * @details Bench_RequestRun() moves from IDLE or DONE to PENDING when a button
+ * is released. Bench_DrawPending() then shows a notice for two frames, as the
+ * frame being drawn is only displayed after the next flip, before moving on to
+ * RUNNING; Bench_ShouldRun() tells the caller to run the benchmark and moves on
+ * to DONE. Modes with states of their own number them from BENCH_NUM_STATES.
+ */
+enum benchState {
+	BENCH_IDLE = 0,
+	BENCH_PENDING,
+	BENCH_RUNNING,
+	BENCH_DONE,
+	BENCH_NUM_STATES
+};
+
+typedef struct {
+	int state;
+	int pending_frames;
+} BenchRun;
+
+/**
+ * @brief The stress test's rectangles, for overlays measuring something
+ * against a typical frame's workload.
+ */
+typedef struct {
+	void *tiles[NUM_RECTANGLES];
+	int  x[NUM_RECTANGLES], y[NUM_RECTANGLES];
+	int  dx[NUM_RECTANGLES], dy[NUM_RECTANGLES];
+} BenchWorkload;
+
+/* Resident helpers exported to overlays */
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+extern uint16_t  lastButtons;
+extern int       useTexture;
+extern uint32_t  frameCounter;
+extern TIM_IMAGE timImage;
+extern TIM_IMAGE tiles4Image;
+
+extern SectorCache sectorCache, streamCache;
+
+void flip_buffers(RenderContext *ctx);
+void *new_primitive(RenderContext *ctx, int z, size_t size);
+void draw_text(RenderContext *ctx, int x, int y, int z, const char *text);
+void drawTextList(RenderContext *ctx, int x, int *y, int z, int dy, const char *text);
+
+void update_position(int *x, int *y, int *dx, int *dy, int w, int h);
+
+void Bench_ResetRun(BenchRun *run);
+bool Bench_RequestRun(BenchRun *run, PADTYPE *pad, uint16_t button);
+bool Bench_DrawPending(BenchRun *run, RenderContext *ctx, int x, int *y);
+bool Bench_ShouldRun(BenchRun *run);
+int Bench_SectorCount(size_t size);
+bool Bench_Matches(int value, int reference, int tolerance);
+
+void Bench_InitWorkload(BenchWorkload *workload);
+void Bench_DrawWorkload(RenderContext *ctx, BenchWorkload *workload);
+
+void init_stream(Stream_Context* cur_stream_ctx, int interleave, int num_channels, int sample_rate);
+void setup_stream(const CdlLOC *pos, StreamReadContext* cur_read_ctx, Stream_Context* cur_stream_ctx);
+bool feed_stream(StreamReadContext* cur_read_ctx, Stream_Context* cur_stream_ctx);
+bool make_stream_resident(StreamReadContext* cur_read_ctx);
+void destroy_stream(StreamReadContext* cur_read_ctx, Stream_Context* cur_stream_ctx);
+
+void DrawRotatedTexturedRectangle(RenderContext* ctx, void** prim, int rt, int ux, int uy, int x0, int y0, int x1, int y1, int z, int r, int g, int b);
+void DrawTexturedRectangle(RenderContext* ctx, void** prim, int ux, int uy, int x, int y, int z, int w, int h, int r, int g, int b);
+void DrawSimpleRectangle(RenderContext* ctx, void** prim, int x, int y, int z, int w, int h, int r, int g, int b);
+void draw_rectangle(RenderContext* ctx, void** prim, int texture, int ux, int uy, int x, int y, int z, int w, int h, int r, int g, int b);
+
+void HandleTextureCommand(PADTYPE* pad);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,238 @@
+/*
+ * ps1-benchmark clock calibration
+ */
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <psxgpu.h>
+#include <psxapi.h>
+#include <psxcd.h>
+
+#include "calib.h"
+#include "timer.h"
+
+// Nominal frame lengths in timer ticks, for the 240-line progressive modes:
+// 263 lines of 3413 video clocks at 53.693175 MHz (NTSC) and 314 lines of 3406
+// video clocks at 53.203425 MHz (PAL), converted to timer ticks at 4.2336 MHz.
+// https://problemkaputt.de/psx-spx.htm#gpuvideomemoryvram
+#define NTSC_VBLANK_TICKS 70775
+#define PAL_VBLANK_TICKS  85101
+#define VBLANK_FRAMES     30
+
+// Calib_Spin() runs 2 instructions per iteration, which take a cycle each
+// when fetched from the I-cache. The count is kept low enough for the timer
+// not to overflow more than once while interrupts are disabled.
+#define CPU_LOOP_COUNT  100000
+#define CPU_LOOP_CYCLES 2
+#define CPU_RUNS        3
+
+// GPU fill cost in GPU clocks as modeled by Mednafen and DuckStation. The GPU
+// clock is 11/7 times the CPU clock.
+#define GPU_FILL_W     320
+#define GPU_FILL_H     240
+#define GPU_FILLS      8
+#define GPU_FILL_COST  (46 + ((GPU_FILL_W / 8) + 9) * GPU_FILL_H)
+
+#define CD_FILE        "\\TRACK-1.VAG;1"
+#define CD_SECTORS     32
+#define CD_SECTOR_SIZE 2048
+#define CD_SECTOR_RATE 150 // Sectors per second at double speed
+
+static const int _tolerance[CALIB_NUM_CLOCKS] = {
+	2,  // TIMER
+	5,  // CPU
+	25, // GPU (the fill model is only an approximation)
+	10  // CD
+};
+
+static Calib_Info _info;
+
+/* Private utilities */
+
+static int _scale(Timer_Ticks fast, Timer_Ticks slow) {
+	if (!fast || !slow)
+		return CALIB_SCALE_ONE;
+
+	// Keep the intermediate product within 32 bits.
+	while (fast > (0xffffffff / CALIB_SCALE_ONE)) {
+		fast >>= 1;
+		slow >>= 1;
+	}
+
+	return (int) ((fast * CALIB_SCALE_ONE) / slow);
+}
+
+static void _measure_timer(void) {
+	VSync(0);
+	Timer_Ticks start = Timer_GetTicks();
+
+	for (int i = 0; i < VBLANK_FRAMES; i++)
+		VSync(0);
+
+	_info.measured[CALIB_TIMER] = (Timer_GetTicks() - start) / VBLANK_FRAMES;
+	_info.expected[CALIB_TIMER] = _info.pal ? PAL_VBLANK_TICKS : NTSC_VBLANK_TICKS;
+	_info.scale[CALIB_TIMER]    =
+		_scale(_info.measured[CALIB_TIMER], _info.expected[CALIB_TIMER]);
+}
+
+static void _measure_cpu(void) {
+	Timer_Ticks best = 0xffffffff;
+
+	// Interrupts are disabled so that handlers do not steal cycles from the
+	// loop; the first run also loads it into the I-cache.
+	for (int i = 0; i < CPU_RUNS; i++) {
+		int _exit = EnterCriticalSection();
+
+		Timer_Ticks start = Timer_GetTicks();
+		Calib_Spin(CPU_LOOP_COUNT);
+		Timer_Ticks time  = Timer_GetTicks() - start;
+
+		if (_exit)
+			ExitCriticalSection();
+
+		if (time < best)
+			best = time;
+	}
+
+	_info.measured[CALIB_CPU] = best;
+	_info.expected[CALIB_CPU] =
+		(CPU_LOOP_COUNT * CPU_LOOP_CYCLES) / TIMER_CYCLES_TICK;
+	_info.scale[CALIB_CPU]    =
+		_scale(_info.expected[CALIB_CPU], _info.measured[CALIB_CPU]);
+}
+
+static void _measure_gpu(void) {
+	RECT rect = { 0, 0, GPU_FILL_W, GPU_FILL_H };
+
+	DrawSync(0);
+	Timer_Ticks start = Timer_GetTicks();
+
+	for (int i = 0; i < GPU_FILLS; i++) {
+		rect.y = (i & 1) * GPU_FILL_H;
+		ClearImage(&rect, 0, 0, 0);
+	}
+
+	DrawSync(0);
+
+	_info.measured[CALIB_GPU] = Timer_GetTicks() - start;
+	_info.expected[CALIB_GPU] =
+		(GPU_FILLS * GPU_FILL_COST * 7) / (11 * TIMER_CYCLES_TICK);
+	_info.scale[CALIB_GPU]    =
+		_scale(_info.expected[CALIB_GPU], _info.measured[CALIB_GPU]);
+}
+
+static Timer_Ticks _timed_read(int lba, int count, uint32_t *buffer) {
+	CdlLOC pos;
+
+	CdIntToPos(lba, &pos);
+
+	Timer_Ticks start = Timer_GetTicks();
+
+	CdControl(CdlSetloc, &pos, 0);
+	CdRead(count, buffer, CdlModeSpeed);
+
+	if (CdReadSync(0, 0) < 0)
+		return 0;
+
+	return Timer_GetTicks() - start;
+}
+
+static void _measure_cd(void) {
+	CdlFILE  file;
+	uint32_t *buffer = malloc((CD_SECTORS + 1) * CD_SECTOR_SIZE);
+
+	_info.measured[CALIB_CD] = 0;
+	_info.expected[CALIB_CD] = (CD_SECTORS * TIMER_CLOCK) / CD_SECTOR_RATE;
+	_info.scale[CALIB_CD]    = CALIB_SCALE_ONE;
+
+	if (!buffer || !CdSearchFile(&file, CD_FILE)) {
+		free(buffer);
+		return;
+	}
+
+	// Reading the same sector twice makes the second read seek back by the
+	// same short distance as the longer read that follows, so that the
+	// difference between the two is the time taken by the extra sectors
+	// alone. The first read also spins the drive up to double speed.
+	int lba = CdPosToInt(&file.pos);
+
+	CdReadCallback(0);
+	_timed_read(lba, 1, buffer);
+
+	Timer_Ticks single = _timed_read(lba, 1, buffer);
+	Timer_Ticks multi  = _timed_read(lba, CD_SECTORS + 1, buffer);
+
+	free(buffer);
+
+	if (!single || (multi <= single))
+		return;
+
+	_info.measured[CALIB_CD] = multi - single;
+	_info.scale[CALIB_CD]    =
+		_scale(_info.expected[CALIB_CD], _info.measured[CALIB_CD]);
+}
+
+/* Public API */
+
+void __attribute__((noinline)) Calib_Spin(uint32_t count) {
+	__asm__ volatile(
+		".set push\n"
+		".set noreorder\n"
+		"1:\n"
+		"bnez  %0, 1b\n"
+		"addiu %0, %0, -1\n"
+		".set pop\n"
+		: "+r"(count)
+	);
+}
+
+void Calib_Run(void) {
+	_info.pal = (GetVideoMode() == MODE_PAL);
+
+	_measure_timer();
+	_measure_cpu();
+	_measure_gpu();
+	_measure_cd();
+}
+
+const Calib_Info *Calib_GetInfo(void) {
+	return &_info;
+}
+
+uint32_t Calib_GetFrameUs(void) {
+	return Timer_TicksToUs(_info.pal ? PAL_VBLANK_TICKS : NTSC_VBLANK_TICKS);
+}
+
+bool Calib_IsStock(void) {
+	for (int i = 0; i < CALIB_NUM_CLOCKS; i++) {
+		int delta = _info.scale[i] - CALIB_SCALE_ONE;
+
+		if (delta < 0)
+			delta = -delta;
+		if ((delta * 100) > (_tolerance[i] * CALIB_SCALE_ONE))
+			return false;
+	}
+
+	return true;
+}
+
+int Calib_GetPercent(Calib_Clock clock) {
+	return (_info.scale[clock] * 100 + CALIB_SCALE_ONE / 2) / CALIB_SCALE_ONE;
+}
+
+Timer_Ticks Calib_ToStock(Timer_Ticks ticks, Calib_Clock clock) {
+	uint32_t scale = _info.scale[clock];
+
+	return (ticks / CALIB_SCALE_ONE) * scale +
+		((ticks % CALIB_SCALE_ONE) * scale) / CALIB_SCALE_ONE;
+}
+
+uint32_t Calib_TicksToStockUs(Timer_Ticks ticks, Calib_Clock clock) {
+	return Timer_TicksToUs(Calib_ToStock(ticks, clock));
+}
+
+uint32_t Calib_TicksToStockCycles(Timer_Ticks ticks, Calib_Clock clock) {
+	return Timer_TicksToCycles(Calib_ToStock(ticks, clock));
+}
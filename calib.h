@@ -0,0 +1,152 @@
+/*
+ * ps1-benchmark clock calibration
+ */
+
+/**
+ * @file calib.h
+ * @brief Detection of the video standard and of non-stock clock speeds
+ *
+ * @details All measurements are taken with the timer (see timer.h), which
+ * assumes the console runs at stock clocks. Emulators can be set up to run the
+ * CPU faster or to speed up GPU drawing and CD reads, which makes the results
+ * meaningless when compared against a real console, so Calib_Run() measures
+ * how fast each part of the system actually runs at startup:
+ *
+ * - TIMER: timer ticks elapsed per vblank, against the nominal frame length
+ *          for the current video standard (the one clock an emulator cannot
+ *          change without the game noticing);
+ * - CPU:   time taken by a loop of known length running from the I-cache;
+ * - GPU:   time taken by the GPU to fill the framebuffer, against the fill
+ *          timing model used by cycle-accurate emulators;
+ * - CD:    time taken to read sectors sequentially at double speed, against
+ *          the nominal 150 sectors per second.
+ *
+ * Each speed is expressed as a scale factor relative to stock, in 1/1024
+ * units, and can be used to convert durations measured with the timer into
+ * the duration the same work would take on a stock console.
+ */
+
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+
+#include "timer.h"
+
+/* Constants */
+
+#define CALIB_SCALE_ONE 1024
+
+/* Type definitions */
+
+typedef enum {
+	CALIB_TIMER = 0,
+	CALIB_CPU   = 1,
+	CALIB_GPU   = 2,
+	CALIB_CD    = 3,
+	CALIB_NUM_CLOCKS
+} Calib_Clock;
+
+/**
+ * @brief Calibration results.
+ *
+ * @details The scale of each clock is the ratio between its measured and
+ * stock speed (CALIB_SCALE_ONE = stock, 2 * CALIB_SCALE_ONE = twice as fast).
+ * Clocks that could not be measured are assumed to be stock. The raw figure
+ * each scale was derived from is kept in timer ticks.
+ */
+typedef struct {
+	bool        pal;
+	int         scale[CALIB_NUM_CLOCKS];
+	Timer_Ticks measured[CALIB_NUM_CLOCKS], expected[CALIB_NUM_CLOCKS];
+} Calib_Info;
+
+/* Public API */
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @brief Measures the speed of all clocks.
+ *
+ * @details Takes about a second. Must be called after Timer_Init() and
+ * CdInit(), with no CD reads in progress. Overwrites the framebuffer area of
+ * VRAM (the top left 320x480 pixels).
+ */
+void Calib_Run(void);
+
+/**
+ * @brief Runs the busy loop used to measure the CPU speed.
+ *
+ * @details The loop runs 2 instructions per iteration, which take a cycle each
+ * when fetched from the I-cache, and touches no memory, so it can also be used
+ * to measure how many cycles interrupt handlers steal from the CPU.
+ *
+ * @param count Number of iterations
+ */
+void Calib_Spin(uint32_t count);
+
+/**
+ * @brief Returns the results of the last calibration.
+ *
+ * @return Pointer to the calibration results
+ */
+const Calib_Info *Calib_GetInfo(void);
+
+/**
+ * @brief Returns the nominal frame period for the detected video standard.
+ *
+ * @return Frame period in microseconds (about 16717 for NTSC, 20101 for PAL)
+ */
+uint32_t Calib_GetFrameUs(void);
+
+/**
+ * @brief Returns whether all clocks are within tolerance of stock speed.
+ *
+ * @return False if the system appears to be overclocked or sped up
+ */
+bool Calib_IsStock(void);
+
+/**
+ * @brief Returns a clock's speed relative to stock.
+ *
+ * @param clock
+ * @return Speed in percent (100 = stock)
+ */
+int Calib_GetPercent(Calib_Clock clock);
+
+/**
+ * @brief Converts a measured duration to the one expected at stock speed.
+ *
+ * @details Only meaningful for work that is bound by a single clock (e.g. CPU
+ * time for decompression, CD time for loading).
+ *
+ * @param ticks Measured duration
+ * @param clock Clock the work was bound by
+ * @return Duration at stock speed, in timer ticks
+ */
+Timer_Ticks Calib_ToStock(Timer_Ticks ticks, Calib_Clock clock);
+
+/**
+ * @brief Converts a measured duration to microseconds at stock speed.
+ *
+ * @param ticks Measured duration
+ * @param clock Clock the work was bound by
+ * @return Duration at stock speed, in microseconds
+ */
+uint32_t Calib_TicksToStockUs(Timer_Ticks ticks, Calib_Clock clock);
+
+/**
+ * @brief Converts a measured duration to CPU cycles at stock speed.
+ *
+ * @param ticks Measured duration
+ * @param clock Clock the work was bound by
+ * @return Duration at stock speed, in CPU cycles
+ */
+uint32_t Calib_TicksToStockCycles(Timer_Ticks ticks, Calib_Clock clock);
+
+#ifdef __cplusplus
+}
+#endif
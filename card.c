@@ -0,0 +1,160 @@
+/*
+ * ps1-benchmark direct memory card driver
+ */
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+#include <psxapi.h>
+
+#include "card.h"
+#include "sio.h"
+#include "timer.h"
+
+#define CARD_ADDRESS    0x81
+#define CARD_CMD_READ   'R'
+#define CARD_CMD_WRITE  'W'
+#define CARD_END_GOOD   'G'
+#define CARD_END_BAD_CS 'N'
+
+// Cards usually acknowledge each byte within a few dozen microseconds, but some
+// take much longer right after a write.
+#define ACK_TIMEOUT (TIMER_CLOCK / 1000) // 1 ms
+
+/* Private utilities */
+
+static int _exchange(uint8_t value, bool ack) {
+	return Sio_Exchange(value, ack, ACK_TIMEOUT);
+}
+
+static Card_Result _start_command(uint8_t command) {
+	if (_exchange(CARD_ADDRESS, true) < 0)
+		return CARD_NO_RESPONSE;
+	if (_exchange(command, true) < 0) // Returns the card's flag byte
+		return CARD_NO_RESPONSE;
+
+	int id1 = _exchange(0, true);
+	int id2 = _exchange(0, true);
+
+	if ((id1 < 0) || (id2 < 0))
+		return CARD_NO_RESPONSE;
+	if ((id1 != 0x5a) || (id2 != 0x5d))
+		return CARD_BAD_REPLY;
+
+	return CARD_OK;
+}
+
+static Card_Result _read(int sector, uint8_t *ptr) {
+	uint8_t msb = (uint8_t) (sector >> 8);
+	uint8_t lsb = (uint8_t) sector;
+
+	Card_Result result = _start_command(CARD_CMD_READ);
+
+	if (result)
+		return result;
+
+	_exchange(msb, true);
+	_exchange(lsb, true);
+
+	int ack1 = _exchange(0, true);
+	int ack2 = _exchange(0, true);
+
+	if ((ack1 < 0) || (ack2 < 0))
+		return CARD_NO_RESPONSE;
+	if ((ack1 != 0x5c) || (ack2 != 0x5d))
+		return CARD_BAD_REPLY;
+
+	// The card echoes the sector number back, or replies with FFFFh if it is
+	// out of range (in which case it aborts the command).
+	if ((_exchange(0, true) != msb) || (_exchange(0, true) != lsb))
+		return CARD_BAD_SECTOR;
+
+	uint8_t checksum = msb ^ lsb;
+
+	for (int i = 0; i < CARD_SECTOR_SIZE; i++) {
+		int value = _exchange(0, true);
+
+		if (value < 0)
+			return CARD_NO_RESPONSE;
+
+		ptr[i]    = (uint8_t) value;
+		checksum ^= (uint8_t) value;
+	}
+
+	int card_checksum = _exchange(0, true);
+	int end           = _exchange(0, false);
+
+	if (card_checksum != checksum)
+		return CARD_BAD_CHECKSUM;
+	if (end != CARD_END_GOOD)
+		return CARD_BAD_SECTOR;
+
+	return CARD_OK;
+}
+
+static Card_Result _write(int sector, const uint8_t *ptr) {
+	uint8_t msb = (uint8_t) (sector >> 8);
+	uint8_t lsb = (uint8_t) sector;
+
+	Card_Result result = _start_command(CARD_CMD_WRITE);
+
+	if (result)
+		return result;
+
+	_exchange(msb, true);
+	_exchange(lsb, true);
+
+	uint8_t checksum = msb ^ lsb;
+
+	for (int i = 0; i < CARD_SECTOR_SIZE; i++) {
+		if (_exchange(ptr[i], true) < 0)
+			return CARD_NO_RESPONSE;
+
+		checksum ^= ptr[i];
+	}
+
+	_exchange(checksum, true);
+
+	int ack1 = _exchange(0, true);
+	int ack2 = _exchange(0, true);
+	int end  = _exchange(0, false);
+
+	if ((ack1 < 0) || (ack2 < 0))
+		return CARD_NO_RESPONSE;
+	if ((ack1 != 0x5c) || (ack2 != 0x5d))
+		return CARD_BAD_REPLY;
+	if (end == CARD_END_BAD_CS)
+		return CARD_BAD_CHECKSUM;
+	if (end != CARD_END_GOOD)
+		return CARD_BAD_SECTOR;
+
+	return CARD_OK;
+}
+
+/* Public API */
+
+Card_Result Card_ReadSector(int port, int sector, void *buffer) {
+	int _exit = EnterCriticalSection();
+
+	Sio_Select(port);
+	Card_Result result = _read(sector, buffer);
+	Sio_Deselect();
+
+	if (_exit)
+		ExitCriticalSection();
+
+	return result;
+}
+
+Card_Result Card_WriteSector(int port, int sector, const void *data) {
+	int _exit = EnterCriticalSection();
+
+	Sio_Select(port);
+	Card_Result result = _write(sector, data);
+	Sio_Deselect();
+
+	if (_exit)
+		ExitCriticalSection();
+
+	return result;
+}
@@ -0,0 +1,79 @@
+/*
+ * ps1-benchmark direct memory card driver
+ */
+
+/**
+ * @file card.h
+ * @brief Polled memory card sector access through the SIO0 registers
+ *
+ * @details Reads and writes single 128-byte memory card sectors by driving the
+ * controller/memory card serial port directly, bypassing the BIOS card driver
+ * (which transfers one byte per SIO interrupt). Each transfer busy-waits on
+ * the port until it completes, which takes a few milliseconds per sector at
+ * the port's 250 kHz clock.
+ *
+ * The BIOS pad driver polls the same port during vblank, so transfers are
+ * performed in a critical section to keep it from interleaving its own
+ * traffic; interrupts raised in the meantime are serviced once the transfer
+ * is over. Transfers shall not be started while a BIOS card operation is in
+ * progress.
+ *
+ * See https://problemkaputt.de/psx-spx.htm#memorycardreadwritecommands for the
+ * protocol.
+ */
+
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+
+/* Constants */
+
+#define CARD_SECTOR_SIZE   128
+#define CARD_NUM_SECTORS   1024
+#define CARD_BLOCK_SECTORS 64
+
+/* Type definitions */
+
+typedef enum {
+	CARD_OK           = 0,
+	CARD_NO_RESPONSE  = 1, // No card inserted, or a byte was not acknowledged
+	CARD_BAD_REPLY    = 2, // Unexpected command acknowledge bytes
+	CARD_BAD_SECTOR   = 3, // Sector number rejected by the card
+	CARD_BAD_CHECKSUM = 4  // Checksum mismatch on either side
+} Card_Result;
+
+/* Public API */
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @brief Reads a sector from a memory card.
+ *
+ * @param port Memory card slot (0 or 1)
+ * @param sector Sector number (0-1023)
+ * @param buffer Destination buffer (CARD_SECTOR_SIZE bytes)
+ * @return CARD_OK, or the reason the transfer failed
+ */
+Card_Result Card_ReadSector(int port, int sector, void *buffer);
+
+/**
+ * @brief Writes a sector to a memory card.
+ *
+ * @details Cards may not respond for a short while after a write while they
+ * are still committing it to flash, in which case the next transfer fails
+ * with CARD_NO_RESPONSE and can simply be retried.
+ *
+ * @param port Memory card slot (0 or 1)
+ * @param sector Sector number (0-1023)
+ * @param data Sector data (CARD_SECTOR_SIZE bytes)
+ * @return CARD_OK, or the reason the transfer failed
+ */
+Card_Result Card_WriteSector(int port, int sector, const void *data);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,142 @@
+/*
+ * ps1-benchmark precompiled display lists
+ */
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+#include <psxgpu.h>
+
+#include "dlist.h"
+
+#define END_TAG   0x00ffffff
+#define KSEG0     0x80000000
+
+// Largest packet FntSort() emits per character (a textured 8x8 sprite).
+#define TEXT_CHAR_SIZE 16
+
+/* Private utilities */
+
+static uint32_t *_next(const uint32_t *packet) {
+	return (uint32_t *) (KSEG0 | getaddr(packet));
+}
+
+static void _append(DList *list, uint32_t *first, uint32_t *last) {
+	if (list->last[0])
+		catPrim(list->last[0], first);
+	else
+		list->first[0] = first;
+
+	list->last[0] = last;
+}
+
+/* Public API */
+
+bool DList_Init(DList *list, size_t capacity) {
+	list->buffers[0] = malloc(capacity);
+	list->buffers[1] = malloc(capacity);
+	list->capacity   = capacity;
+
+	if (!list->buffers[0] || !list->buffers[1]) {
+		DList_Destroy(list);
+		return false;
+	}
+
+	DList_Begin(list);
+	DList_End(list);
+	return true;
+}
+
+void DList_Destroy(DList *list) {
+	free(list->buffers[0]);
+	free(list->buffers[1]);
+
+	list->buffers[0] = (void *) 0;
+	list->buffers[1] = (void *) 0;
+	list->capacity   = 0;
+	list->length     = 0;
+	list->first[0]   = (void *) 0;
+	list->first[1]   = (void *) 0;
+}
+
+void DList_Begin(DList *list) {
+	list->next_packet = list->buffers[0];
+	list->length      = 0;
+
+	for (int i = 0; i < 2; i++) {
+		list->first[i] = (void *) 0;
+		list->last[i]  = (void *) 0;
+	}
+}
+
+void *DList_AddPrim(DList *list, size_t size) {
+	uint32_t *prim = (uint32_t *) list->next_packet;
+
+	if ((list->next_packet + size) > (list->buffers[0] + list->capacity))
+		return (void *) 0;
+
+	list->next_packet += size;
+
+	termPrim(prim);
+	_append(list, prim, prim);
+	return prim;
+}
+
+bool DList_AddText(DList *list, int x, int y, const char *text) {
+	size_t size = strlen(text) * TEXT_CHAR_SIZE + sizeof(DR_TPAGE);
+
+	if ((list->next_packet + size) > (list->buffers[0] + list->capacity))
+		return false;
+
+	// FntSort() links its packets into an OT entry in reverse order; sort
+	// them into a temporary entry, then append the resulting chain.
+	uint32_t entry = END_TAG;
+
+	list->next_packet = (uint8_t *)
+		FntSort(&entry, (char *) list->next_packet, x, y, text);
+
+	if (getaddr(&entry) == END_TAG)
+		return true;
+
+	uint32_t *first = _next(&entry);
+	uint32_t *last  = first;
+
+	while (getaddr(last) != END_TAG)
+		last = _next(last);
+
+	_append(list, first, last);
+	return true;
+}
+
+size_t DList_End(DList *list) {
+	list->length = list->next_packet - list->buffers[0];
+
+	if (!list->first[0])
+		return 0;
+
+	// Make a copy for the other render buffer, with its links moved along.
+	uint32_t delta = list->buffers[1] - list->buffers[0];
+
+	__builtin_memcpy(list->buffers[1], list->buffers[0], list->length);
+
+	list->first[1] = (uint32_t *) (((uint8_t *) list->first[0]) + delta);
+	list->last[1]  = (uint32_t *) (((uint8_t *) list->last[0]) + delta);
+
+	for (uint32_t *packet = list->first[1]; packet != list->last[1];) {
+		uint32_t *next = (uint32_t *) (((uint8_t *) _next(packet)) + delta);
+
+		setaddr(packet, next);
+		packet = next;
+	}
+
+	return list->length;
+}
+
+void DList_Splice(DList *list, uint32_t *ot, int buffer) {
+	if (!list->first[buffer])
+		return;
+
+	addPrims(ot, list->first[buffer], list->last[buffer]);
+}
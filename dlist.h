@@ -0,0 +1,127 @@
+/*
+ * ps1-benchmark precompiled display lists
+ */
+
+/**
+ * @file dlist.h
+ * @brief Static display lists built once and linked into the OT every frame
+ *
+ * @details Layers that do not change from one frame to the next (menus, HUD
+ * frames, backgrounds) do not need to have their primitives emitted again
+ * every frame. A display list is a chain of GPU packets built once, between
+ * DList_Begin() and DList_End(), into a buffer owned by the list; afterwards
+ * DList_Splice() inserts the whole chain into an OT entry in constant time,
+ * by pointing the entry at the first packet and the last packet at whatever
+ * the entry pointed to before.
+ *
+ * As splicing rewrites the link of the last packet, a chain cannot be linked
+ * into the OT being built while the GPU may still be walking it as part of the
+ * OT being drawn. DList_End() therefore makes a relocated copy of the chain
+ * for each of the two render buffers, and DList_Splice() picks the one for
+ * the active buffer.
+ *
+ * Packets are drawn in the order they were added. Primitives added through
+ * DList_AddPrim() must be fully set up by the caller (including their length,
+ * e.g. with setTile()), but not linked; the list takes care of that.
+ */
+
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+
+/* Type definitions */
+
+/**
+ * @brief Display list object.
+ *
+ * @details All fields are only used internally and shall not be accessed
+ * directly. The list must not be spliced while being built.
+ */
+typedef struct {
+	uint8_t  *buffers[2];
+	size_t   capacity, length;
+	uint8_t  *next_packet;
+	uint32_t *first[2], *last[2];
+} DList;
+
+/* Public API */
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @brief Allocates a display list's buffers.
+ *
+ * @param list
+ * @param capacity Maximum size of the packets in the list, in bytes
+ * @return True if the buffers were allocated successfully
+ */
+bool DList_Init(DList *list, size_t capacity);
+
+/**
+ * @brief Frees a display list's buffers.
+ *
+ * @details The GPU must not be drawing any OT the list is spliced into.
+ *
+ * @param list
+ */
+void DList_Destroy(DList *list);
+
+/**
+ * @brief Empties a display list and starts building it again.
+ *
+ * @details The GPU must not be drawing any OT the list is spliced into.
+ *
+ * @param list
+ */
+void DList_Begin(DList *list);
+
+/**
+ * @brief Allocates space for a primitive at the end of a display list.
+ *
+ * @param list
+ * @param size Size of the primitive, including its OT link
+ * @return Pointer to the primitive, or NULL if the list is full
+ */
+void *DList_AddPrim(DList *list, size_t size);
+
+/**
+ * @brief Appends text drawn with the debug font to a display list.
+ *
+ * @details The font texture must have been uploaded by FntLoad(). Up to 16
+ * bytes per character plus a texture page primitive are used.
+ *
+ * @param list
+ * @param x
+ * @param y
+ * @param text
+ * @return False if the list is full (in which case the text is not added)
+ */
+bool DList_AddText(DList *list, int x, int y, const char *text);
+
+/**
+ * @brief Finishes building a display list.
+ *
+ * @param list
+ * @return Size of the list's packets in bytes
+ */
+size_t DList_End(DList *list);
+
+/**
+ * @brief Links a whole display list into an OT entry.
+ *
+ * @details The list ends up ahead of any packets already linked into the
+ * entry. Takes the same time regardless of the list's length.
+ *
+ * @param list
+ * @param ot OT entry to link the list into
+ * @param buffer Index of the render buffer the OT belongs to (0 or 1)
+ */
+void DList_Splice(DList *list, uint32_t *ot, int buffer);
+
+#ifdef __cplusplus
+}
+#endif
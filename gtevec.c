@@ -0,0 +1,115 @@
+/*
+ * ps1-benchmark GTE vector math helpers
+ */
+
+#include <stdint.h>
+#include <stddef.h>
+#include <psxgte.h>
+#include <inline_c.h>
+
+#include "gtevec.h"
+#include "hottext.h"
+
+// inline_c.h has no macro to load MAC1-3 (GTE data registers 25-27), which
+// GPL adds its product to.
+#define _gte_ldmac(x, y, z) __asm__ volatile( \
+	"mtc2 %0, $25\n" \
+	"mtc2 %1, $26\n" \
+	"mtc2 %2, $27\n" \
+	: : "r"(x), "r"(y), "r"(z))
+
+// Loads the first row of the rotation matrix (control registers 0-1, which
+// hold R11-R12 and R13-R21) from a vector, clearing R21.
+#define _gte_ldrow0(v) __asm__ volatile( \
+	"ctc2 %0, $0\n" \
+	"ctc2 %1, $1\n" \
+	: : "r"((uint16_t) (v)->vx | ((uint32_t) (v)->vy << 16)), "r"((uint16_t) (v)->vz))
+
+// Stores MAC1 (GTE data register 25).
+#define _gte_stmac1(r0) __asm__ volatile( \
+	"swc2 $25, 0(%0)\n" \
+	: : "r"(r0) : "memory")
+
+/* Public API */
+
+HOT_TEXT void GteVec_Integrate(VECTOR *pos, const SVECTOR *vel, int dt, int count) {
+	gte_lddp(dt);
+
+	// GPL (without shifting): MAC1-3 += IR1-3 * IR0
+	for (int i = 0; i < count; i++) {
+		_gte_ldmac(pos[i].vx, pos[i].vy, pos[i].vz);
+		gte_ldsv(&vel[i]);
+		gte_gpl0();
+		gte_stlvnl(&pos[i]);
+	}
+}
+
+HOT_TEXT void GteVec_DistanceSq(const SVECTOR *points, const SVECTOR *center, int32_t *out, int count) {
+	MATRIX offset = { 0 };
+	VECTOR sums;
+
+	// MVMVA with an identity matrix and the negated center as translation
+	// leaves the differences in IR1-3, which SQR then squares.
+	offset.m[0][0] = ONE;
+	offset.m[1][1] = ONE;
+	offset.m[2][2] = ONE;
+	offset.t[0]    = -center->vx;
+	offset.t[1]    = -center->vy;
+	offset.t[2]    = -center->vz;
+
+	gte_SetRotMatrix(&offset);
+	gte_SetTransMatrix(&offset);
+
+	for (int i = 0; i < count; i++) {
+		gte_ldv0(&points[i]);
+		gte_mvmva(1, 0, 0, 0, 0);
+		gte_sqr0();
+		gte_stlvnl(&sums);
+
+		out[i] = sums.vx + sums.vy + sums.vz;
+	}
+}
+
+HOT_TEXT void GteVec_Normalize(SVECTOR *v, int count) {
+	VECTOR squares;
+
+	for (int i = 0; i < count; i++) {
+		gte_ldsv(&v[i]);
+		gte_sqr0();
+		gte_stlvnl(&squares);
+
+		int length = SquareRoot0(squares.vx + squares.vy + squares.vz);
+
+		if (!length)
+			continue;
+
+		// SQR overwrote IR1-3 with the squares, so load the vector again and
+		// scale it by ONE / length with GPF: IR1-3 = (IR1-3 * IR0) >> 12.
+		gte_lddp((ONE << 12) / length);
+		gte_ldsv(&v[i]);
+		gte_gpf12();
+		gte_stsv(&v[i]);
+	}
+}
+
+HOT_TEXT void GteVec_Cross(const VECTOR *a, const VECTOR *b, VECTOR *out, int count) {
+	// OP computes the cross product of the rotation matrix's diagonal with
+	// IR1-3.
+	for (int i = 0; i < count; i++) {
+		gte_ldopv1(&a[i]);
+		gte_ldopv2(&b[i]);
+		gte_op12();
+		gte_stlvnl(&out[i]);
+	}
+}
+
+HOT_TEXT void GteVec_Dot(const SVECTOR *a, const SVECTOR *b, int32_t *out, int count) {
+	// MVMVA multiplies the rotation matrix by V0; with the first vector in
+	// its first row, MAC1 = (a . b) >> 12 and the other rows are ignored.
+	for (int i = 0; i < count; i++) {
+		_gte_ldrow0(&a[i]);
+		gte_ldv0(&b[i]);
+		gte_mvmva(1, 0, 0, 3, 0);
+		_gte_stmac1(&out[i]);
+	}
+}
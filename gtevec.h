@@ -0,0 +1,99 @@
+/*
+ * ps1-benchmark GTE vector math helpers
+ */
+
+/**
+ * @file gtevec.h
+ * @brief Batched fixed-point vector math on the GTE
+ *
+ * @details Besides perspective transformation the GTE has a few general
+ * purpose vector commands: MVMVA (matrix times vector plus vector), SQR
+ * (component-wise square), OP (cross product with the rotation matrix's
+ * diagonal) and GPF/GPL (vector times scalar, optionally added to the
+ * previous result). Most frames only use it for a few dozen RTPS/RTPT
+ * commands, so it is otherwise idle; these helpers run simple physics math
+ * over arrays of vectors through those commands, with the CPU only moving
+ * data in and out of its registers.
+ *
+ * All values are fixed-point (typically with 12 fractional bits, ONE = 1.0).
+ * Vectors passed through the GTE's 16-bit registers are limited to -32768 to
+ * 32767 per component and are saturated otherwise.
+ *
+ * The helpers overwrite the GTE's rotation and translation matrices, which
+ * must be set again before transforming anything afterwards.
+ */
+
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+#include <psxgte.h>
+
+/* Public API */
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @brief Integrates positions over a time step (pos += vel * dt).
+ *
+ * @param pos Positions, updated in place
+ * @param vel Velocities
+ * @param dt Time step, as a plain multiplier (up to 32767)
+ * @param count Number of vectors
+ */
+void GteVec_Integrate(VECTOR *pos, const SVECTOR *vel, int dt, int count);
+
+/**
+ * @brief Computes the squared distance of each point from a center.
+ *
+ * @details The differences are saturated to 16 bits and their squares summed
+ * in 32 bits, so the result is only correct for distances up to 32767.
+ *
+ * @param points
+ * @param center
+ * @param out Squared distances
+ * @param count Number of points
+ */
+void GteVec_DistanceSq(const SVECTOR *points, const SVECTOR *center, int32_t *out, int count);
+
+/**
+ * @brief Scales vectors to unit length (ONE).
+ *
+ * @details The GTE only squares and scales the components; the square root
+ * and reciprocal of the length are still computed by the CPU. Vectors must
+ * be longer than ONE / 8, or the reciprocal overflows the GTE's 16-bit scale
+ * register (a length of exactly ONE / 8 gives a scale of 32768).
+ *
+ * @param v Vectors (12 fractional bits), normalized in place
+ * @param count Number of vectors
+ */
+void GteVec_Normalize(SVECTOR *v, int count);
+
+/**
+ * @brief Computes cross products of pairs of vectors (out = a x b).
+ *
+ * @param a Vectors (12 fractional bits)
+ * @param b Vectors (12 fractional bits)
+ * @param out Cross products (12 fractional bits), may be the same as a or b
+ * @param count Number of pairs
+ */
+void GteVec_Cross(const VECTOR *a, const VECTOR *b, VECTOR *out, int count);
+
+/**
+ * @brief Computes dot products of pairs of vectors (out = a . b).
+ *
+ * @details The sum of the products is computed in the GTE's 44-bit
+ * accumulator before being shifted, so only the result has to fit in 32 bits.
+ *
+ * @param a Vectors (12 fractional bits)
+ * @param b Vectors (12 fractional bits)
+ * @param out Dot products (12 fractional bits)
+ * @param count Number of pairs
+ */
+void GteVec_Dot(const SVECTOR *a, const SVECTOR *b, int32_t *out, int count);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,33 @@
+/*
+ * ps1-benchmark hot code placement
+ */
+
+/**
+ * @file hottext.h
+ * @brief I-cache aware placement of hot functions
+ *
+ * @details The R3000's I-cache is only 4 KB, direct mapped, with 16-byte lines,
+ * so two functions whose addresses are 4 KB apart (modulo) evict each other
+ * when called in turn, and the linker otherwise lays out functions in source
+ * order. Functions marked with HOT_TEXT are placed in the .text.hot section
+ * and aligned to a cache line; when the executable is built with the
+ * BENCH_HOT_CODE option, hotcode.ld gathers that section from all objects in
+ * a single contiguous range at the start of the executable, so the hot path
+ * spans as few lines as possible and none of it aliases with itself as long
+ * as it fits in the cache. Without the option HOT_TEXT does nothing, so both
+ * layouts can be compared.
+ *
+ * The functions marked HOT_TEXT are hand-picked: the stress test's drawing and
+ * buffer flipping code, the GTE vector kernels, the batch emitters and the
+ * stream IRQ handler.
+ * The hot code mode checks that choice against a profile of the stress
+ * workload (see profile.h).
+ */
+
+#pragma once
+
+#ifdef BENCH_HOT_CODE
+#define HOT_TEXT __attribute__((section(".text.hot"), aligned(16)))
+#else
+#define HOT_TEXT
+#endif
@@ -0,0 +1,176 @@
+/*
+ * ps1-benchmark LZ4 asset decompressor
+ */
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+
+#include "lz4.h"
+
+#define MIN_MATCH 4
+
+/* Private utilities */
+
+// The R3000 has no unaligned loads and stores, but it does have the lwl/lwr
+// and swl/swr pairs, which GCC emits for accesses to packed structures. This
+// allows copying 4 bytes at a time regardless of alignment, which is much
+// faster than a byte loop (each load also has a delay slot to fill).
+typedef struct {
+	uint32_t value;
+} __attribute__((packed)) _Unaligned32;
+
+static inline uint32_t _load32(const uint8_t *ptr) {
+	return ((const _Unaligned32 *) ptr)->value;
+}
+
+static inline void _store32(uint8_t *ptr, uint32_t value) {
+	((_Unaligned32 *) ptr)->value = value;
+}
+
+// Copies 8 bytes at a time and may write up to 7 bytes past the end, which the
+// callers must guarantee to be within the block.
+static inline void _wild_copy(uint8_t *dst, const uint8_t *src, uint8_t *end) {
+	do {
+		_store32(dst,     _load32(src));
+		_store32(dst + 4, _load32(src + 4));
+
+		dst += 8;
+		src += 8;
+	} while (dst < end);
+}
+
+static inline size_t _read_length(const uint8_t **ptr, size_t length) {
+	if (length != 15)
+		return length;
+
+	const uint8_t *ip = *ptr;
+	uint32_t      value;
+
+	do {
+		value   = *(ip++);
+		length += value;
+	} while (value == 255);
+
+	*ptr = ip;
+	return length;
+}
+
+static void _decode_block(
+	const uint8_t *ip, const uint8_t *iend, uint8_t *op, uint8_t *oend
+) {
+	for (;;) {
+		uint32_t token = *(ip++);
+
+		// Copy the literals. The fast path can only be used if the wild copy
+		// doesn't run past the end of the block, which is always the case
+		// except for the last sequence (the encoder guarantees at least 5
+		// trailing literals).
+		size_t  length = _read_length(&ip, token >> 4);
+		uint8_t *cpy   = op + length;
+
+		if (cpy <= (oend - 8)) {
+			_wild_copy(op, ip, cpy);
+		} else {
+			for (size_t i = 0; i < length; i++)
+				op[i] = ip[i];
+		}
+
+		ip += length;
+		op  = cpy;
+
+		// The last sequence of a block only contains literals.
+		if (ip >= iend)
+			return;
+
+		const uint8_t *match = op - (ip[0] | (ip[1] << 8));
+		size_t        offset = op - match;
+		ip += 2;
+
+		length = _read_length(&ip, token & 15) + MIN_MATCH;
+		cpy    = op + length;
+
+		// Matches may overlap the data being written (e.g. an offset of 1 is
+		// used for runs of the same byte), so words can only be copied if the
+		// source is far enough behind the destination.
+		if ((offset >= 8) && (cpy <= (oend - 8))) {
+			_wild_copy(op, match, cpy);
+		} else if ((offset >= 4) && (cpy <= (oend - 4))) {
+			uint8_t *dst = op;
+
+			do {
+				_store32(dst, _load32(match));
+
+				dst   += 4;
+				match += 4;
+			} while (dst < cpy);
+		} else {
+			for (size_t i = 0; i < length; i++)
+				op[i] = match[i];
+		}
+
+		op = cpy;
+	}
+}
+
+/* Public API */
+
+bool LZ4_IsValid(const void *src) {
+	const LZ4_Header *header = (const LZ4_Header *) src;
+
+	return (header->magic == LZ4_MAGIC) && header->block_size;
+}
+
+size_t LZ4_GetSize(const void *src) {
+	return ((const LZ4_Header *) src)->size;
+}
+
+void LZ4_Init(LZ4_Context *ctx, const void *src, void *dst) {
+	const LZ4_Header *header = (const LZ4_Header *) src;
+
+	ctx->src        = (const uint8_t *) src;
+	ctx->block_ends = (const uint32_t *) &header[1];
+	ctx->dst        = (uint8_t *) dst;
+	ctx->size       = header->size;
+	ctx->block_size = header->block_size;
+	ctx->decoded    = 0;
+	ctx->num_blocks = header->num_blocks;
+	ctx->next_block = 0;
+}
+
+bool LZ4_DecompressAvailable(LZ4_Context *ctx, size_t available) {
+	while (ctx->next_block < ctx->num_blocks) {
+		int    block = ctx->next_block;
+		size_t end   = ctx->block_ends[block];
+
+		if (end > available)
+			return false;
+
+		size_t start = block ?
+			ctx->block_ends[block - 1] :
+			(sizeof(LZ4_Header) + ctx->num_blocks * sizeof(uint32_t));
+
+		size_t length = ctx->size - ctx->decoded;
+
+		if (length > ctx->block_size)
+			length = ctx->block_size;
+
+		uint8_t *op = &(ctx->dst[ctx->decoded]);
+
+		_decode_block(&(ctx->src[start]), &(ctx->src[end]), op, op + length);
+
+		ctx->decoded += length;
+		ctx->next_block++;
+	}
+
+	return true;
+}
+
+size_t LZ4_Decompress(const void *src, void *dst) {
+	LZ4_Context ctx;
+
+	LZ4_Init(&ctx, src, dst);
+	LZ4_DecompressAvailable(&ctx, 0xffffffff);
+
+	return ctx.decoded;
+}
@@ -0,0 +1,112 @@
+/*
+ * ps1-benchmark LZ4 asset decompressor
+ */
+
+/**
+ * @file lz4.h
+ * @brief Decompressor for block-indexed LZ4 asset files
+ *
+ * @details Compressed assets are produced at build time by tools/lz4pack. The
+ * file starts with an LZ4_Header followed by a table holding the offset at
+ * which each block's compressed data ends, then by the blocks themselves. Each
+ * block decompresses to exactly block_size bytes (except the last one) and is
+ * encoded using the standard LZ4 block format; matches may however reference
+ * data from previous blocks, up to 64 KB back.
+ *
+ * The index allows a file to be decompressed progressively while it is still
+ * being read from the CD: any block whose compressed data ends before the
+ * number of bytes read so far can be decoded right away, overlapping CPU work
+ * with the time the drive spends fetching the following sectors.
+ *
+ * All fields are little-endian. The decompressor trusts its input (assets are
+ * generated by the build) and performs no bounds checking on the compressed
+ * stream.
+ */
+
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+
+#define LZ4_MAGIC 0x42345a4c // "LZ4B"
+
+/* Type definitions */
+
+typedef struct {
+	uint32_t magic, size;
+	uint16_t block_size, num_blocks;
+} LZ4_Header;
+
+/**
+ * @brief Progressive decompression state.
+ *
+ * @details Initialized by LZ4_Init(). All fields are only used internally and
+ * shall not be accessed directly.
+ */
+typedef struct {
+	const uint8_t  *src;
+	const uint32_t *block_ends;
+	uint8_t        *dst;
+
+	size_t size, block_size, decoded;
+	int    num_blocks, next_block;
+} LZ4_Context;
+
+/* Public API */
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @brief Checks whether a buffer starts with a valid LZ4 asset header.
+ *
+ * @param src
+ * @return True if the header is valid
+ */
+bool LZ4_IsValid(const void *src);
+
+/**
+ * @brief Returns the decompressed size of an LZ4 asset.
+ *
+ * @param src Pointer to the header (only the first sector needs to be loaded)
+ * @return Size in bytes
+ */
+size_t LZ4_GetSize(const void *src);
+
+/**
+ * @brief Prepares a context for progressive decompression.
+ *
+ * @details The source buffer may still be in the process of being filled, but
+ * its first sector (containing the header and block index) must have been
+ * loaded already.
+ *
+ * @param ctx
+ * @param src Pointer to the compressed file
+ * @param dst Destination buffer, at least LZ4_GetSize() bytes long
+ */
+void LZ4_Init(LZ4_Context *ctx, const void *src, void *dst);
+
+/**
+ * @brief Decompresses all blocks that are fully contained in the data loaded
+ * so far.
+ *
+ * @param ctx
+ * @param available Number of bytes of the compressed file loaded so far
+ * @return True once the whole file has been decompressed
+ */
+bool LZ4_DecompressAvailable(LZ4_Context *ctx, size_t available);
+
+/**
+ * @brief Decompresses a fully loaded LZ4 asset in one shot.
+ *
+ * @param src
+ * @param dst Destination buffer, at least LZ4_GetSize() bytes long
+ * @return Number of bytes written
+ */
+size_t LZ4_Decompress(const void *src, void *dst);
+
+#ifdef __cplusplus
+}
+#endif
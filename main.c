@@ -40,90 +40,68 @@
 #include <inline_c.h>
 
 #include "stream.h"
-
-// Size of the ring buffer in main RAM in bytes.
-// per audio
-#define RAM_BUFFER_SIZE 0x18000
+#include "bench.h"
+#include "timer.h"
+#include "overlay.h"
+#include "sectorcache.h"
+#include "calib.h"
+#include "hottext.h"
+#include "ram.h"
+#include "vram.h"
+#include "tilesc.h"
 
 // Minimum number of sectors that will be read from the CD-ROM at once. Higher
 // values will improve efficiency at the cost of requiring a larger buffer in
 // order to prevent underruns and glitches in the audio output.
 #define REFILL_THRESHOLD 24
 
-// numero massimo figure
-#define NUM_RECTANGLES 100
-
-// numero massimo canzoni
-#define MAX_SONGS 4
-
-// Length of the ordering table, i.e. the range Z coordinates can have, 0-15 in
-// this case. Larger values will allow for more granularity with depth (useful
-// when drawing a complex 3D scene) at the expense of RAM usage and performance.
-#define OT_LENGTH NUM_RECTANGLES + 1
+// Number of sectors after each stream's loop start that are kept in RAM. This
+// should cover the time it takes for the drive to seek back to the loop start,
+// which the stream would otherwise spend draining the buffer.
+#define LOOP_HEAD_SECTORS 16
 
-// Size of the buffer GPU commands and primitives are written to. If the program
-// crashes due to too many primitives being drawn, increase this value.
-#define BUFFER_LENGTH 8192
+// Number of frames after wrapping around the loop point during which the
+// lowest buffer fill is recorded.
+#define LOOP_WATCH_FRAMES 60
 
-/* Framebuffer/display list class */
+// Failed reads are retried up to READ_MAX_RETRIES times, waiting
+// READ_RETRY_DELAY milliseconds before the first retry and twice as long
+// before each of the following ones. READ_RETRY_SEEK is a rough worst case for
+// the time each attempt takes to seek back and read; together they set how
+// much data is kept in the buffer as a reserve (see setup_stream()).
+#define READ_MAX_RETRIES 4
+#define READ_RETRY_DELAY 20
+#define READ_RETRY_SEEK  100
 
-typedef struct {
-	DISPENV disp_env;
-	DRAWENV draw_env;
+#define READ_RETRY_WORST_MS \
+	(READ_RETRY_DELAY * ((1 << READ_MAX_RETRIES) - 1) + READ_MAX_RETRIES * READ_RETRY_SEEK)
 
-	uint32_t ot[OT_LENGTH];
-	uint8_t  buffer[BUFFER_LENGTH];
-} RenderBuffer;
-
-typedef struct {
-	RenderBuffer buffers[2];
-	uint8_t      *next_packet;
-	int          active_buffer;
-} RenderContext;
+// numero massimo canzoni
+#define MAX_SONGS 4
 
 //strutture benchmark vari
 
-/* .VAG header structure */
-
-typedef struct {
-	uint32_t magic;			// 0x69474156 ("VAGi") for interleaved files
-	uint32_t version;
-	uint32_t interleave;	// Little-endian, size of each channel buffer
-	uint32_t size;			// Big-endian, in bytes
-	uint32_t sample_rate;	// Big-endian, in Hertz
-	uint16_t _reserved[5];
-	uint16_t channels;		// Little-endian, channel count (stereo if 0)
-	char     name[16];
-} VAG_Header;
-
-typedef struct {
-	int start_lba, stream_length, sample_rate;
-
-	volatile int    next_sector;
-	volatile size_t refill_length;
-} StreamReadContext;
-
 /* Helper functions */
 
 #define DUMMY_BLOCK_ADDR   0x1000
 #define STREAM_BUFFER_ADDR 0x1010
 
-#define SCREEN_XRES 320
-#define SCREEN_YRES 240
-
-#define BASE_W	32
-#define BASE_H	32
-
 #define MENU_START_Y	SCREEN_YRES / 3
 #define MENU_CHOICE_DY	16 //distanza tra una voce e l'altra in Y
 #define MENU_X			SCREEN_XRES / 3
+#define MENU_VISIBLE	7 //voci visibili, il menu scorre se sono di piu'
 
 #define TRACK_LIST_START_Y	8
-#define TRACK_LIST_DY	16 //distanza tra una voce e l'altra in Y
+// Distanza tra una voce e l'altra in Y. Era 16, ma con le statistiche di loop,
+// cache e riletture la schermata audio ha 19 righe, che a 16 pixel l'una non
+// entrano nei 240 dello schermo.
+#define TRACK_LIST_DY	12
 
-#define START_VEL		1
 #define START_TRACK		0
 
+#define OVERLAY_STATS_Y	SCREEN_YRES - 52
+#define OVERLAY_STATS_DY	10 //piu' fitto della lista tracce, per stare sotto al menu
+
 const int CENTERX = SCREEN_XRES >> 1;
 const int CENTERY = SCREEN_YRES >> 1;
 
@@ -132,15 +110,37 @@ enum menuChoices
 	STRESS_TEST = 0,
 	MOV_TEST,
 	AUDIO_TEST,
+	LZ_TEST,
+	VAG_TEST,
+	STEMS_TEST,
+	BITRATE_TEST,
+	MUX_TEST,
+	CARD_TEST,
+	ICACHE_TEST,
+	RAM_TEST,
+	BATCH_TEST,
+	DLIST_TEST,
+	PAD_TEST,
+	MORPH_TEST,
+	SCENE_TEST,
+	VECMATH_TEST,
+	GTELAT_TEST,
+	YSORT_TEST,
+	VRAMLRU_TEST,
+	CLUTANIM_TEST,
+	PROCTEX_TEST,
 	BACK_CHOICE,
 	NUM_CHOICES
 };
 
+SectorCache sectorCache, streamCache;
+
 static Stream_Context    stream_ctx[MAX_SONGS];
 static StreamReadContext read_ctx[MAX_SONGS];
 
-static Stream_Context    masterStreamCtx;
-static StreamReadContext masterReadCtx;
+// Stream being fed by the CD read currently in progress, if any.
+static Stream_Context    *volatile pendingStreamCtx = 0;
+static StreamReadContext *volatile pendingReadCtx   = 0;
 
 static int currentTrackIndex = START_TRACK;
 static bool loadedTracks[MAX_SONGS];
@@ -156,51 +156,84 @@ static char names[MAX_SONGS][64] =
 };
 
 extern const uint32_t tilesc[]; //riferimento tile con tutte le texture
+extern const uint32_t tiles4[];
 TIM_IMAGE timImage;
-
-//può essere TILE o può essere POLY_FT4
-//POLY_FT4 può avere la texture invece TILE no essendo una figura semplice
-//POLY_FT4 è un quadrilatero generico
-void *tiles[NUM_RECTANGLES]; 
+TIM_IMAGE tiles4Image;
 
 TILE *menuTile;
-
-static int x[NUM_RECTANGLES];
-static int y[NUM_RECTANGLES];
-
-static int r[NUM_RECTANGLES];
-static int g[NUM_RECTANGLES];
-static int b[NUM_RECTANGLES];
-
-static int dx[NUM_RECTANGLES];
-static int dy[NUM_RECTANGLES];
-
-static int w[NUM_RECTANGLES];
-static int h[NUM_RECTANGLES];
+void *discTile;
 
 static int curMode = STRESS_TEST;
 static int curMenuChoice = 0;
 static int isInMenu = 1;
-static int useTexture = 0;
-
-static uint16_t lastButtons = 0xffff;
+int useTexture = 0;
 
-static int curVel = START_VEL;
-static int vel[4] = {1, 3, 5, 7};
+uint16_t lastButtons = 0xffff;
 
 static int anglesTable[360]; //da gradi a fixed point
 
 static int discAngle = 0;
-static uint32_t frameCounter = 0;
+uint32_t frameCounter = 0;
 
 static char menuChoicesText[NUM_CHOICES][64] =
 {
 	{"STRESS TEST"},
 	{"MOVEMENT TEST"},
 	{"AUDIO TEST"},
+	{"COMPRESSION TEST"},
+	{"INTERLEAVE TEST"},
+	{"STEMS TEST"},
+	{"MAX BITRATE TEST"},
+	{"CONTAINER TEST"},
+	{"MEMORY CARD TEST"},
+	{"I-CACHE TEST"},
+	{"RAM SCALING TEST"},
+	{"BATCH EMITTER TEST"},
+	{"DISPLAY LIST TEST"},
+	{"PAD POLLING TEST"},
+	{"MORPH AND SKINNING TEST"},
+	{"SCENE GRAPH TEST"},
+	{"GTE VECTOR MATH TEST"},
+	{"GTE LATENCY TEST"},
+	{"Y SORT TEST"},
+	{"VRAM TEXTURE CACHE TEST"},
+	{"CLUT ANIMATION TEST"},
+	{"PROCEDURAL TEXTURE TEST"},
 	{"BACK"}
 };
 
+// Overlay each menu choice is loaded from, NULL for modes that are resident.
+// The audio test stays in BENCH.EXE as the stream driver's IRQ handlers and CD
+// callbacks must never be unloaded.
+static const char *menuOverlays[NUM_CHOICES] =
+{
+	"\\MODES\\STRESS.DLL;1",
+	"\\MODES\\MOVABLE.DLL;1",
+	0,
+	"\\MODES\\LZBENCH.DLL;1",
+	"\\MODES\\VAGBENCH.DLL;1",
+	"\\MODES\\STEMS.DLL;1",
+	"\\MODES\\BITRATE.DLL;1",
+	"\\MODES\\MUXBENCH.DLL;1",
+	"\\MODES\\MEMCARD.DLL;1",
+	"\\MODES\\HOTCODE.DLL;1",
+	"\\MODES\\RAMSCALE.DLL;1",
+	"\\MODES\\BATCH.DLL;1",
+	"\\MODES\\DLIST.DLL;1",
+	"\\MODES\\PADBENCH.DLL;1",
+	"\\MODES\\MORPH.DLL;1",
+	"\\MODES\\SCENE.DLL;1",
+	"\\MODES\\VECMATH.DLL;1",
+	"\\MODES\\GTELAT.DLL;1",
+	"\\MODES\\YSORT.DLL;1",
+	"\\MODES\\VRAMLRU.DLL;1",
+	"\\MODES\\CLUTANIM.DLL;1",
+	"\\MODES\\PROCTEX.DLL;1",
+	0
+};
+
+static const BenchMode *overlayMode = 0;
+
 void ComputeAngles()
 {
 	//0-360 -> 0-4095
@@ -229,9 +262,46 @@ void reset_spu_channels(void) {
 
 void cd_read_handler(CdlIntrResult event, uint8_t *payload) 
 {
+	StreamReadContext *cur_read_ctx = pendingReadCtx;
+	Timer_Ticks now = Timer_GetTicks();
+
 	// Mark the data that has just been read as valid.
 	if (event != CdlDiskError)
-		Stream_Feed(&stream_ctx[currentTrackIndex], read_ctx[currentTrackIndex].refill_length * 2048);
+	{
+		Stream_Feed(pendingStreamCtx, cur_read_ctx->refill_length * 2048);
+		cur_read_ctx->bytes_read += cur_read_ctx->refill_length * 2048;
+
+		// The data is copied into the sector cache by feed_stream(), as it
+		// takes too long to do it here.
+		cur_read_ctx->last_read_time = now - cur_read_ctx->read_started;
+		cur_read_ctx->fill_cache     = true;
+
+		// Account for the time lost to retrying, if this was a retry.
+		if (cur_read_ctx->retries)
+		{
+			Timer_Ticks latency = now - cur_read_ctx->failed_at;
+
+			cur_read_ctx->retry_time += latency;
+
+			if (latency > cur_read_ctx->max_retry_time)
+				cur_read_ctx->max_retry_time = latency;
+
+			cur_read_ctx->retries = 0;
+		}
+	}
+	else
+	{
+		// Leave it to feed_stream() to re-issue the read once the backoff
+		// delay has elapsed.
+		if (!cur_read_ctx->retries)
+			cur_read_ctx->failed_at = now;
+
+		cur_read_ctx->retry_at    = now +
+			(TIMER_CLOCK / 1000) * (READ_RETRY_DELAY << cur_read_ctx->retries);
+		cur_read_ctx->read_failed = true;
+	}
+
+	cur_read_ctx->read_time += now - cur_read_ctx->read_started;
 }
 
 //utilizza double buffer
@@ -250,15 +320,20 @@ void setup_context(RenderContext *ctx, int w, int h, int r, int g, int b) {
 
 	// Initialize the first buffer and clear its OT so that it can be used for
 	// drawing.
+	ctx->buffer_length     = Ram_GetConfig()->render_buffer;
+	ctx->buffers[0].buffer = Ram_Alloc(ctx->buffer_length);
+	ctx->buffers[1].buffer = Ram_Alloc(ctx->buffer_length);
+
 	ctx->active_buffer = 0;
 	ctx->next_packet   = ctx->buffers[0].buffer;
+	ctx->packet_end    = &(ctx->buffers[0].buffer[ctx->buffer_length]);
 	ClearOTagR(ctx->buffers[0].ot, OT_LENGTH);
 
 	// Turn on the video output.
 	SetDispMask(1);
 }
 
-void flip_buffers(RenderContext *ctx) {
+HOT_TEXT void flip_buffers(RenderContext *ctx) {
 	// Wait for the GPU to finish drawing, then wait for vblank in order to
 	// prevent screen tearing.
 	DrawSync(0);
@@ -276,10 +351,11 @@ void flip_buffers(RenderContext *ctx) {
 	// pointer.
 	ctx->active_buffer ^= 1;
 	ctx->next_packet    = disp_buffer->buffer;
+	ctx->packet_end     = &(disp_buffer->buffer[ctx->buffer_length]);
 	ClearOTagR(disp_buffer->ot, OT_LENGTH);
 }
 
-void *new_primitive(RenderContext *ctx, int z, size_t size) 
+HOT_TEXT void *new_primitive(RenderContext *ctx, int z, size_t size) 
 {
 	// Place the primitive after all previously allocated primitives, then
 	// insert it into the OT and bump the allocation pointer.
@@ -290,7 +366,7 @@ void *new_primitive(RenderContext *ctx, int z, size_t size)
 	ctx->next_packet += size;
 
 	// Make sure we haven't yet run out of space for future primitives.
-	assert(ctx->next_packet <= &(buffer->buffer[BUFFER_LENGTH]));
+	assert(ctx->next_packet <= ctx->packet_end);
 
 	return (void *) prim;
 }
@@ -305,7 +381,7 @@ void draw_text(RenderContext *ctx, int x, int y, int z, const char *text)
 	ctx->next_packet = (uint8_t *)
 		FntSort(&(buffer->ot[z]), ctx->next_packet, x, y, text);
 
-	assert(ctx->next_packet <= &(buffer->buffer[BUFFER_LENGTH]));
+	assert(ctx->next_packet <= ctx->packet_end);
 }
 
 //incremento in verticale
@@ -323,34 +399,89 @@ void drawImmediateText(RenderContext *ctx, int x, int y, int z, const char *text
 	flip_buffers(ctx);
 }
 
-/* Main */
+/* Benchmark runs */
 
-void setup_stream(const CdlLOC *pos, StreamReadContext* cur_read_ctx, Stream_Context* cur_stream_ctx);
-bool feed_stream(StreamReadContext* cur_read_ctx, Stream_Context* cur_stream_ctx);
+void Bench_ResetRun(BenchRun *run)
+{
+	run->state          = BENCH_IDLE;
+	run->pending_frames = 0;
+}
 
-void setup_stream(const CdlLOC *pos, StreamReadContext* cur_read_ctx, Stream_Context* cur_stream_ctx) 
+// Requests a run when the button is released, unless one is already under way.
+bool Bench_RequestRun(BenchRun *run, PADTYPE *pad, uint16_t button)
 {
-	// Read the .VAG header from the first sector of the file.
-	uint32_t header[512];
-	CdControl(CdlSetloc, pos, 0);
+	if((run->state == BENCH_PENDING) || (run->state == BENCH_RUNNING))
+		return false;
+	if(!(lastButtons & button) || (pad->btn & button))
+		return false;
 
-	CdReadCallback(0);
-	CdRead(1, header, CdlModeSpeed);
-	CdReadSync(0, 0);
+	run->state          = BENCH_PENDING;
+	run->pending_frames = 2;
+	return true;
+}
 
-	VAG_Header    *vag = (VAG_Header *) header;
-	Stream_Config config;
+// Returns true while the notice is shown, in which case the caller should not
+// draw anything else.
+bool Bench_DrawPending(BenchRun *run, RenderContext *ctx, int x, int *y)
+{
+	if(run->state != BENCH_PENDING)
+		return false;
 
-	int num_channels = vag->channels ? vag->channels : 2;
-	int num_chunks   =
-		(__builtin_bswap32(vag->size) + vag->interleave - 1) / vag->interleave;
+	// The frame drawn now is only displayed after the next flip, so wait two
+	// frames for the notice to show up before blocking.
+	drawTextList(ctx, x, y, 0, RESULT_DY, "RUNNING...");
+
+	if(!--run->pending_frames)
+		run->state = BENCH_RUNNING;
+
+	return true;
+}
+
+bool Bench_ShouldRun(BenchRun *run)
+{
+	if(run->state != BENCH_RUNNING)
+		return false;
+
+	run->state = BENCH_DONE;
+	return true;
+}
+
+int Bench_SectorCount(size_t size)
+{
+	return (size + 2047) / 2048;
+}
+
+// Compares a result computed on the GTE against the same computation done on
+// the CPU. Modes check their GTE output this way before timing it, so that a
+// wrongly set up GTE cannot produce a faster result. The two may round
+// intermediate results differently, hence the tolerance.
+bool Bench_Matches(int value, int reference, int tolerance)
+{
+	int delta = value - reference;
+
+	return (delta >= -tolerance) && (delta <= tolerance);
+}
+
+/* Main */
+
+void init_stream(Stream_Context* cur_stream_ctx, int interleave, int num_channels, int sample_rate)
+{
+	Stream_Config config;
 
 	__builtin_memset(&config, 0, sizeof(Stream_Config));
 
 	config.spu_address = STREAM_BUFFER_ADDR;
-	config.interleave  = vag->interleave;
-	config.buffer_size = RAM_BUFFER_SIZE;
-	config.sample_rate = __builtin_bswap32(vag->sample_rate);
+	config.interleave  = interleave;
+	config.buffer_size = Ram_GetConfig()->stream_buffer;
+	config.sample_rate = sample_rate;
+
+	// The ring buffer is larger and lives past the first 2 MB if there is
+	// extra RAM.
+	config.alloc_function = &Ram_Alloc;
+	config.free_function  = &Ram_Free;
+
+	// Profile the SPU IRQ handler and chunk uploads (see Stream_GetStats()).
+	config.profile_function = &Timer_GetTicks;
 
 	// Use the first N channels of the SPU and pan them left/right in pairs
 	// (this assumes the stream contains one or more stereo tracks).
@@ -362,62 +493,336 @@ void setup_stream(const CdlLOC *pos, StreamReadContext* cur_read_ctx, Stream_Con
 	}
 
 	Stream_Init(cur_stream_ctx, &config);
+}
+
+void setup_stream(const CdlLOC *pos, StreamReadContext* cur_read_ctx, Stream_Context* cur_stream_ctx) 
+{
+	// Read the .VAG header from the first sector of the file.
+	uint32_t header[512];
+
+	SectorCache_Read(&sectorCache, CdPosToInt(pos), 1, header);
+
+	VAG_Header *vag = (VAG_Header *) header;
+
+	int num_channels = vag->channels ? vag->channels : 2;
+	int num_chunks   =
+		(__builtin_bswap32(vag->size) + vag->interleave - 1) / vag->interleave;
+	int sample_rate  = __builtin_bswap32(vag->sample_rate);
+
+	init_stream(cur_stream_ctx, vag->interleave, num_channels, sample_rate);
+
+	int stream_length = (num_channels * num_chunks * vag->interleave + 2047) / 2048;
+	int chunk_sectors = (num_channels * vag->interleave + 2047) / 2048;
+
+	cur_read_ctx->start_lba        = CdPosToInt(pos) + 1;
+	cur_read_ctx->stream_length    = stream_length;
+	cur_read_ctx->sample_rate      = sample_rate;
+	cur_read_ctx->next_sector      = 0;
+	cur_read_ctx->refill_length    = 0;
+	cur_read_ctx->refill_threshold = REFILL_THRESHOLD;
+	cur_read_ctx->bytes_read       = 0;
+	cur_read_ctx->read_time        = 0;
+
+	cur_read_ctx->fill_cache     = false;
+	cur_read_ctx->read_failed    = false;
+	cur_read_ctx->retries        = 0;
+	cur_read_ctx->total_retries  = 0;
+	cur_read_ctx->lost_reads     = 0;
+	cur_read_ctx->retry_time     = 0;
+	cur_read_ctx->max_retry_time = 0;
 
-	cur_read_ctx->start_lba     = CdPosToInt(pos) + 1;
-	cur_read_ctx->stream_length =
-		(num_channels * num_chunks * vag->interleave + 2047) / 2048;
-	cur_read_ctx->sample_rate   = config.sample_rate;
-	cur_read_ctx->next_sector   = 0;
-	cur_read_ctx->refill_length = 0;
+	// Always keep enough data in the buffer to keep playing throughout the
+	// worst case retry sequence, or half of the buffer if that's not possible.
+	size_t reserve = (num_channels * (sample_rate / 28) * 16 / 1000) * READ_RETRY_WORST_MS;
+
+	if (reserve > (cur_stream_ctx->config.buffer_size / 2))
+		reserve = cur_stream_ctx->config.buffer_size / 2;
+
+	cur_read_ctx->reserve = reserve;
+
+	// Loop points are stored in the header as chunk indices (see
+	// tools/vagenc); by default the whole stream is looped.
+	int loop_start = vag->loop_start * chunk_sectors;
+	int loop_end   = vag->loop_end ? (vag->loop_end * chunk_sectors) : stream_length;
+
+	if ((loop_end > stream_length) || (loop_end <= loop_start))
+	{
+		loop_start = 0;
+		loop_end   = stream_length;
+	}
+
+	cur_read_ctx->loop_start       = loop_start;
+	cur_read_ctx->loop_end         = loop_end;
+	cur_read_ctx->use_loop_head    = true;
+	cur_read_ctx->resident         = false;
+	cur_read_ctx->loop_frames      = 0;
+	cur_read_ctx->loop_min_fill[0] = 0;
+	cur_read_ctx->loop_min_fill[1] = 0;
+
+	// Keep the first sectors after the loop start in RAM, so that wrapping
+	// around does not have to wait for the drive to seek back.
+	int head_length = loop_end - loop_start;
+
+	if (head_length > LOOP_HEAD_SECTORS)
+		head_length = LOOP_HEAD_SECTORS;
+
+	cur_read_ctx->loop_head          = malloc(head_length * 2048);
+	cur_read_ctx->loop_head_length   = 0;
+	cur_read_ctx->loop_head_capacity = head_length;
+
+	if (cur_read_ctx->loop_head)
+	{
+		if (SectorCache_Read(
+			&sectorCache, cur_read_ctx->start_lba + loop_start, head_length,
+			cur_read_ctx->loop_head
+		))
+			cur_read_ctx->loop_head_length = head_length;
+	}
 
 	// Ensure the buffer is full before starting playback.
-	while (feed_stream(&masterReadCtx, &masterStreamCtx))
+	while (feed_stream(cur_read_ctx, cur_stream_ctx))
 		__asm__ volatile("");
 }
 
+// Replaces the loop head with a buffer, allocated with Ram_Alloc(), large
+// enough to hold the whole looped part of the stream. Nothing is read here:
+// the buffer is filled by extend_loop_head() as the stream plays through the
+// loop for the first time, after which the stream is fed from RAM alone. The
+// part before the loop start is still read from the CD.
+bool make_stream_resident(StreamReadContext* cur_read_ctx)
+{
+	int     length = cur_read_ctx->loop_end - cur_read_ctx->loop_start;
+	uint8_t *data  = Ram_Alloc(length * 2048);
+
+	if (!data)
+		return false;
+
+	if (cur_read_ctx->loop_head)
+	{
+		__builtin_memcpy(
+			data, cur_read_ctx->loop_head, cur_read_ctx->loop_head_length * 2048
+		);
+		Ram_Free(cur_read_ctx->loop_head);
+	}
+
+	cur_read_ctx->loop_head          = data;
+	cur_read_ctx->loop_head_capacity = length;
+	cur_read_ctx->resident           = (cur_read_ctx->loop_head_length == length);
+	return true;
+}
+
+// Appends the given sectors to the loop head if they follow on from its end
+// and there is room for them, i.e. if the stream has been made resident.
+static void extend_loop_head(StreamReadContext* cur_read_ctx, int sector, int count, const uint8_t *data)
+{
+	int end  = cur_read_ctx->loop_start + cur_read_ctx->loop_head_length;
+	int skip = end - sector;
+
+	if ((skip < 0) || (skip >= count))
+		return;
+
+	count -= skip;
+
+	if (count > (cur_read_ctx->loop_head_capacity - cur_read_ctx->loop_head_length))
+		count = cur_read_ctx->loop_head_capacity - cur_read_ctx->loop_head_length;
+	if (count <= 0)
+		return;
+
+	__builtin_memcpy(
+		&(cur_read_ctx->loop_head[cur_read_ctx->loop_head_length * 2048]),
+		&data[skip * 2048], count * 2048
+	);
+
+	cur_read_ctx->loop_head_length += count;
+	cur_read_ctx->resident          =
+		(cur_read_ctx->loop_head_length == cur_read_ctx->loop_head_capacity);
+}
+
+void destroy_stream(StreamReadContext* cur_read_ctx, Stream_Context* cur_stream_ctx)
+{
+	Ram_Free(cur_read_ctx->loop_head);
+
+	cur_read_ctx->loop_head          = 0;
+	cur_read_ctx->loop_head_length   = 0;
+	cur_read_ctx->loop_head_capacity = 0;
+	cur_read_ctx->resident           = false;
+
+	Stream_Destroy(cur_stream_ctx);
+}
+
+// Records the lowest ring fill seen in the frames following a wrap around the
+// loop point, separately for when the loop head cache is used or not.
+static void track_loop_fill(StreamReadContext* cur_read_ctx, Stream_Context* cur_stream_ctx)
+{
+	if (!cur_read_ctx->loop_frames)
+		return;
+
+	size_t fill = cur_stream_ctx->buffer.length;
+
+	if (fill < cur_read_ctx->loop_fill)
+		cur_read_ctx->loop_fill = fill;
+
+	if (!--cur_read_ctx->loop_frames)
+		cur_read_ctx->loop_min_fill[cur_read_ctx->use_loop_head] = cur_read_ctx->loop_fill;
+}
+
+static void start_read(StreamReadContext* cur_read_ctx, Stream_Context* cur_stream_ctx, int sector, size_t length, uint8_t *ptr)
+{
+	CdlLOC pos;
+
+	cur_read_ctx->read_sector   = sector;
+	cur_read_ctx->read_ptr      = ptr;
+	cur_read_ctx->refill_length = length;
+	cur_read_ctx->read_started  = Timer_GetTicks();
+
+	pendingStreamCtx = cur_stream_ctx;
+	pendingReadCtx   = cur_read_ctx;
+
+	CdIntToPos(cur_read_ctx->start_lba + sector, &pos);
+	CdControl(CdlSetloc, &pos, 0);
+	CdReadCallback(&cd_read_handler);
+	CdRead(length, (uint32_t *) ptr, CdlModeSpeed);
+}
+
 bool feed_stream(StreamReadContext* cur_read_ctx, Stream_Context* cur_stream_ctx) 
 {
+	track_loop_fill(cur_read_ctx, cur_stream_ctx);
+
 	// Do nothing if the drive is already busy reading a chunk.
 	if (CdReadSync(1, 0) > 0)
 		return true;
 
-	// To improve efficiency, do not start refilling immediately but wait until
-	// there is enough space in the buffer (see REFILL_THRESHOLD).
-	if (Stream_GetRefillLength(cur_stream_ctx) < (REFILL_THRESHOLD * 2048))
-		return false;
-
 	uint8_t *ptr;
-	size_t  refill_length = Stream_GetFeedPtr(cur_stream_ctx, &ptr) / 2048;
+	size_t  refill_length;
+
+	// Copy the data the last read fetched into the sector cache (and into the
+	// loop head, if the stream is being made resident). This must happen
+	// before anything else is fed into the buffer, which could overwrite it.
+	if (cur_read_ctx->fill_cache) {
+		SectorCache_Fill(
+			&streamCache, cur_read_ctx->start_lba + cur_read_ctx->read_sector,
+			cur_read_ctx->refill_length, cur_read_ctx->read_ptr,
+			cur_read_ctx->last_read_time
+		);
+		extend_loop_head(
+			cur_read_ctx, cur_read_ctx->read_sector, cur_read_ctx->refill_length,
+			cur_read_ctx->read_ptr
+		);
+
+		cur_read_ctx->fill_cache = false;
+	}
+
+	// If the last read failed, read the same range again into the same place
+	// (as it was never fed, the feed pointer has not moved) once the backoff
+	// delay has elapsed. After too many failures, give up and skip the range.
+	if (cur_read_ctx->read_failed) {
+		if (cur_read_ctx->retries >= READ_MAX_RETRIES) {
+			cur_read_ctx->read_failed = false;
+			cur_read_ctx->retries     = 0;
+			cur_read_ctx->retry_time += Timer_GetTicks() - cur_read_ctx->failed_at;
+			cur_read_ctx->lost_reads++;
+		} else {
+			if ((int32_t) (Timer_GetTicks() - cur_read_ctx->retry_at) < 0)
+				return true;
+
+			Stream_GetFeedPtr(cur_stream_ctx, &ptr);
+
+			cur_read_ctx->read_failed = false;
+			cur_read_ctx->retries++;
+			cur_read_ctx->total_retries++;
+
+			start_read(
+				cur_read_ctx, cur_stream_ctx, cur_read_ctx->read_sector,
+				cur_read_ctx->refill_length, ptr
+			);
+			return true;
+		}
+	}
 
-	// Figure out how much data can be read in one shot. If the end of the file
-	// would be reached before the buffer is full, split the read into two
-	// separate reads.
+	// Wrap around to the loop start once the loop end has been reached (or
+	// passed, when seeking).
 	int next_sector = cur_read_ctx->next_sector;
-	int max_length  = cur_read_ctx->stream_length - next_sector;
+	int loop_start  = cur_read_ctx->loop_start;
+	int loop_end    = cur_read_ctx->loop_end;
+
+	if (next_sector >= loop_end) {
+		while (next_sector >= loop_end)
+			next_sector -= loop_end - loop_start;
+
+		cur_read_ctx->next_sector = next_sector;
+		cur_read_ctx->loop_frames = LOOP_WATCH_FRAMES;
+		cur_read_ctx->loop_fill   = cur_stream_ctx->config.buffer_size;
+	}
+
+	// Sectors cached from the loop head are copied straight into the buffer,
+	// with no need to wait for the refill threshold. The drive only has to
+	// seek back once the cached sectors have been used up, while the buffer
+	// is still nearly full.
+	int cached = loop_start + cur_read_ctx->loop_head_length - next_sector;
+
+	if (cur_read_ctx->use_loop_head && (next_sector >= loop_start) && (cached > 0)) {
+		refill_length = Stream_GetFeedPtr(cur_stream_ctx, &ptr) / 2048;
 
-	while (max_length <= 0) {
-		next_sector -= cur_read_ctx->stream_length;
-		max_length  += cur_read_ctx->stream_length;
+		if (!refill_length)
+			return false;
+		if (refill_length > cached)
+			refill_length = cached;
+
+		__builtin_memcpy(
+			ptr, &(cur_read_ctx->loop_head[(next_sector - loop_start) * 2048]),
+			refill_length * 2048
+		);
+		Stream_Feed(cur_stream_ctx, refill_length * 2048);
+
+		cur_read_ctx->next_sector = next_sector + refill_length;
+		return true;
 	}
 
+	// To improve efficiency, do not start refilling immediately but wait until
+	// there is enough space in the buffer (see REFILL_THRESHOLD), unless the
+	// buffer is about to drop below the reserve kept for retries.
+	if (
+		(Stream_GetRefillLength(cur_stream_ctx) < (cur_read_ctx->refill_threshold * 2048)) &&
+		(cur_stream_ctx->buffer.length > cur_read_ctx->reserve)
+	)
+		return false;
+
+	refill_length = Stream_GetFeedPtr(cur_stream_ctx, &ptr) / 2048;
+
+	// Figure out how much data can be read in one shot. If the loop end would
+	// be reached before the buffer is full, split the read into two separate
+	// reads.
+	int max_length = loop_end - next_sector;
+
 	if (refill_length > max_length)
 		refill_length = max_length;
 
-	// Start reading the next chunk from the CD-ROM into the buffer.
-	CdlLOC pos;
+	if (!refill_length)
+		return false;
 
-	CdIntToPos(cur_read_ctx->start_lba + next_sector, &pos);
-	CdControl(CdlSetloc, &pos, 0);
-	CdReadCallback(&cd_read_handler);
-	CdRead(refill_length, (uint32_t *) ptr, CdlModeSpeed);
+	// Sectors still in the sector cache (e.g. after seeking backwards) are
+	// copied from there. Only the cached ones at the start of the range are
+	// used, the rest will be read on the next call.
+	int hits = SectorCache_Fetch(
+		&streamCache, cur_read_ctx->start_lba + next_sector, refill_length, ptr
+	);
+
+	if (hits) {
+		extend_loop_head(cur_read_ctx, next_sector, hits, ptr);
+		Stream_Feed(cur_stream_ctx, hits * 2048);
+
+		cur_read_ctx->next_sector = next_sector + hits;
+		return true;
+	}
 
-	cur_read_ctx->next_sector   = next_sector + refill_length;
-	cur_read_ctx->refill_length = refill_length;
+	// Start reading the next chunk from the CD-ROM into the buffer.
+	cur_read_ctx->next_sector = next_sector + refill_length;
+	start_read(cur_read_ctx, cur_stream_ctx, next_sector, refill_length, ptr);
 
 	return true;
 }
 
-void update_position(int *x, int *y, int *dx, int *dy, int w, int h)
+HOT_TEXT void update_position(int *x, int *y, int *dx, int *dy, int w, int h)
 {
 	if (*x < 0 || *x > (SCREEN_XRES - w))
 		*dx = -*dx;
@@ -428,7 +833,7 @@ void update_position(int *x, int *y, int *dx, int *dy, int w, int h)
 	*y += *dy;
 }
 
-void DrawRotatedTexturedRectangle(RenderContext* ctx, void** prim, int rt, int ux, int uy, int x0, int y0, int x1, int y1, int z, int r, int g, int b)
+HOT_TEXT void DrawRotatedTexturedRectangle(RenderContext* ctx, void** prim, int rt, int ux, int uy, int x0, int y0, int x1, int y1, int z, int r, int g, int b)
 {
 	MATRIX	mtx;	
 	SVECTOR rot = { 0 };
@@ -491,10 +896,9 @@ void DrawRotatedTexturedRectangle(RenderContext* ctx, void** prim, int rt, int u
 	
 	setRGB0(poly, r, g, b);
 
-	poly->tpage = getTPage(timImage.mode, 0, timImage.prect->x, timImage.prect->y);
-
-	// Set CLUT
-	setClut(poly, timImage.crect->x, timImage.crect->y);
+	// Texture page and CLUT are precomputed by the atlas packer (tilesc.h).
+	poly->tpage = TILESC_TPAGE;
+	poly->clut  = TILESC_CLUT;
 	
 	// Set texture coordinates
 	setUVWH(poly, ux, uy, 31, 31);
@@ -502,7 +906,7 @@ void DrawRotatedTexturedRectangle(RenderContext* ctx, void** prim, int rt, int u
 	*prim = poly;
 }
 
-void DrawTexturedRectangle(RenderContext* ctx, void** prim, int ux, int uy, int x, int y, int z, int w, int h, int r, int g, int b)
+HOT_TEXT void DrawTexturedRectangle(RenderContext* ctx, void** prim, int ux, int uy, int x, int y, int z, int w, int h, int r, int g, int b)
 {
 	POLY_FT4* poly = (POLY_FT4*)new_primitive(ctx, z, sizeof(POLY_FT4));
 
@@ -519,10 +923,9 @@ void DrawTexturedRectangle(RenderContext* ctx, void** prim, int ux, int uy, int
 				x, y + h,
 				x + w, y + h);
 	setRGB0(poly, r, g, b);
-	poly->tpage = getTPage(timImage.mode, 0, timImage.prect->x, timImage.prect->y);
-
-	// Set CLUT
-	setClut(poly, timImage.crect->x, timImage.crect->y);
+	// Texture page and CLUT are precomputed by the atlas packer (tilesc.h).
+	poly->tpage = TILESC_TPAGE;
+	poly->clut  = TILESC_CLUT;
 	
 	// Set texture coordinates
 	setUVWH(poly, ux, uy, 32, 32);
@@ -530,7 +933,7 @@ void DrawTexturedRectangle(RenderContext* ctx, void** prim, int ux, int uy, int
 	*prim = poly;
 }
 
-void DrawSimpleRectangle(RenderContext* ctx, void** prim, int x, int y, int z, int w, int h, int r, int g, int b)
+HOT_TEXT void DrawSimpleRectangle(RenderContext* ctx, void** prim, int x, int y, int z, int w, int h, int r, int g, int b)
 {
 	TILE* tile = new_primitive(ctx, z, sizeof(TILE));
 
@@ -542,7 +945,7 @@ void DrawSimpleRectangle(RenderContext* ctx, void** prim, int x, int y, int z, i
 	*prim = tile;
 }
 
-void draw_rectangle(RenderContext* ctx, void** prim, int texture, int ux, int uy, int x, int y, int z, int w, int h, int r, int g, int b)
+HOT_TEXT void draw_rectangle(RenderContext* ctx, void** prim, int texture, int ux, int uy, int x, int y, int z, int w, int h, int r, int g, int b)
 {
 	if(!texture)
 	{
@@ -554,37 +957,36 @@ void draw_rectangle(RenderContext* ctx, void** prim, int texture, int ux, int uy
 	}
 }
 
-void InitRandomRectangle(int i)
+void Bench_InitWorkload(BenchWorkload *workload)
 {
-	x[i] = rand() % (SCREEN_XRES - BASE_W); //tra 0 e 320 - la grandezza del quadrato
-	y[i] = rand() % (SCREEN_YRES - BASE_H);
-
-	r[i] = rand() % 256;
-	g[i] = rand() % 256;
-	b[i] = rand() % 256;
-
-	dx[i] = rand() % 6 + 1;
-	dy[i] = rand() % 6 + 1;
-
-	w[i] = BASE_W;
-	h[i] = BASE_H;
+	for(int i = 0; i < NUM_RECTANGLES; i++)
+	{
+		workload->x[i]  = rand() % (SCREEN_XRES - BASE_W);
+		workload->y[i]  = rand() % (SCREEN_YRES - BASE_H);
+		workload->dx[i] = rand() % 6 + 1;
+		workload->dy[i] = rand() % 6 + 1;
+	}
 }
 
-void InitStressTest()
+HOT_TEXT void Bench_DrawWorkload(RenderContext *ctx, BenchWorkload *workload)
 {
-	int i;
-
-	for(i = 0; i < NUM_RECTANGLES; i++)
+	for(int i = 0; i < NUM_RECTANGLES; i++)
 	{
-		InitRandomRectangle(i);
+		update_position(&workload->x[i], &workload->y[i], &workload->dx[i], &workload->dy[i], BASE_W, BASE_H);
+		draw_rectangle(ctx, &workload->tiles[i], useTexture, TILESC_SPHERE_U, TILESC_SPHERE_V,
+			workload->x[i], workload->y[i], i + 1, BASE_W, BASE_H, 128, 128, 128);
 	}
 }
 
-void InitMovableTest()
+void InitOverlayMode(int choice)
 {
-	curVel = START_VEL;
+	// The drive is shared with the audio streams, make sure it is idle.
+	CdReadSync(0, 0);
+
+	overlayMode = Overlay_Load(menuOverlays[choice]);
 
-	InitRandomRectangle(0);
+	if(overlayMode && overlayMode->init)
+		overlayMode->init();
 }
 
 void InitAudioTest()
@@ -621,23 +1023,6 @@ void ResumeAudioTest()
 		Stream_Start(&stream_ctx[currentTrackIndex], true);
 }
 
-void DrawStressTest(RenderContext* ctx)
-{
-	int i;
-
-	for(i = 0; i < NUM_RECTANGLES; i++)
-	{
-		update_position(&x[i], &y[i], &dx[i], &dy[i], w[i], h[i]); //aggiornare posizione di un quadrato alla volta
-		draw_rectangle(ctx, &tiles[i], useTexture, 32, 0, x[i], y[i], i + 1, w[i], h[i], r[i], g[i], b[i]);
-	}
-}
-
-void DrawMovableTest(RenderContext* ctx)
-{
-	//utilizzo solo il primo
-	draw_rectangle(ctx, &tiles[0], useTexture, 32, 0, x[0], y[0], 1, w[0], h[0], r[0], g[0], b[0]);
-}
-
 void DrawAudioTest(RenderContext* ctx)
 {
 	char buffer[128];
@@ -664,10 +1049,30 @@ void DrawAudioTest(RenderContext* ctx)
 	sprintf(buffer,  "BUFFER USAGE: %d/%d", stream_ctx[currentTrackIndex].buffer.length, stream_ctx[currentTrackIndex].config.buffer_size);
 	drawTextList(ctx, xPos, &yPos, 0, TRACK_LIST_DY, buffer);
 
-	sprintf(buffer,  "POSITION SECTOR: %d/%d", read_ctx[currentTrackIndex].next_sector, read_ctx[currentTrackIndex].stream_length);
+	StreamReadContext *read = &read_ctx[currentTrackIndex];
+
+	const SectorCache_Stats *cache = SectorCache_GetStats(&streamCache);
+	uint32_t lookups = cache->hits + cache->misses;
+
+	//settori dello stream letti dalla cache invece che dal CD
+	sprintf(buffer,  "POS %d/%d, CACHE %d%% -%d MS", read->next_sector, read->stream_length,
+		lookups ? (cache->hits * 100 / lookups) : 0, Calib_TicksToStockUs(SectorCache_GetTimeSaved(&streamCache), CALIB_CD) / 1000);
+	drawTextList(ctx, xPos, &yPos, 0, TRACK_LIST_DY, buffer);
+
+	sprintf(buffer,  "LOOP: %d-%d, %s: %s (%d SECTORS)", read->loop_start, read->loop_end,
+		read->resident ? "RAM" : "CACHE", read->use_loop_head ? "ON" : "OFF", read->loop_head_length);
+	drawTextList(ctx, xPos, &yPos, 0, TRACK_LIST_DY, buffer);
+
+	//riempimento minimo del buffer subito dopo il punto di loop, senza e con cache
+	sprintf(buffer,  "MIN FILL AFTER LOOP: OFF %d ON %d", read->loop_min_fill[0], read->loop_min_fill[1]);
 	drawTextList(ctx, xPos, &yPos, 0, TRACK_LIST_DY, buffer);
 
 	sprintf(buffer,  "SAMPLE RATE: %5d HZ", sample_rate);
+	drawTextList(ctx, xPos, &yPos, 0, TRACK_LIST_DY, buffer);
+
+	//tentativi di rilettura dopo errori e latenza aggiunta
+	sprintf(buffer,  "RETRIES: %d LOST: %d, +%d MS (MAX %d)", read->total_retries, read->lost_reads,
+		Calib_TicksToStockUs(read->retry_time, CALIB_CD) / 1000, Calib_TicksToStockUs(read->max_retry_time, CALIB_CD) / 1000);
 	drawTextList(ctx, xPos, &yPos, 0, TRACK_LIST_DY * 2, buffer);
 
 	drawTextList(ctx, xPos, &yPos, 0, TRACK_LIST_DY, "COMMANDS:");
@@ -678,6 +1083,7 @@ void DrawAudioTest(RenderContext* ctx)
 	drawTextList(ctx, xPos, &yPos, 0, TRACK_LIST_DY, "[O]          RESET POSITION");
 	drawTextList(ctx, xPos, &yPos, 0, TRACK_LIST_DY, "[UP/DOWN]    CHANGE SAMPLE RATE");
 	drawTextList(ctx, xPos, &yPos, 0, TRACK_LIST_DY, "[X]          RESET SAMPLE RATE");
+	drawTextList(ctx, xPos, &yPos, 0, TRACK_LIST_DY, "[SQUARE]     TOGGLE LOOP CACHE");
 	drawTextList(ctx, xPos, &yPos, 0, TRACK_LIST_DY * 2, "[TRIANGLE]   CHANGE TRACK");
 
 	drawTextList(ctx, xPos, &yPos, 0, TRACK_LIST_DY, "PAUSE AND RESUME IF IT DOESN'T START!");
@@ -698,124 +1104,75 @@ void DrawAudioTest(RenderContext* ctx)
 		discAngle = angle;
 	}
 
-	DrawRotatedTexturedRectangle(ctx, &tiles[0], discAngle, 64, 0, x0, y0, x1, y1, 0, 128, 128, 128);	
+	DrawRotatedTexturedRectangle(ctx, &discTile, discAngle, TILESC_DISC_U, TILESC_DISC_V, x0, y0, x1, y1, 0, 128, 128, 128);	
 }
 
-void DrawMenu(RenderContext* ctx)
+void DrawOverlayStats(RenderContext* ctx)
 {
-	int i;
-	int y = MENU_START_Y;
+	char buffer[128];
+	int xPos = 8;
+	int yPos = OVERLAY_STATS_Y;
 
-	for(i = 0; i < NUM_CHOICES; i++)
-	{
-		if(curMenuChoice == i)
-			draw_rectangle(ctx, &menuTile, 1, 0, 0, MENU_X - 14, y, 0, 8, 8, 255, 0, 0);
+	const Overlay_Stats *stats = Overlay_GetStats();
 
-		draw_text(ctx, MENU_X, y, 0, menuChoicesText[i]);
+	sprintf(buffer, "OVERLAYS: %d KB, ARENA: %d KB",
+		stats->total_size / 1024, stats->arena_size / 1024);
+	drawTextList(ctx, xPos, &yPos, 0, OVERLAY_STATS_DY, buffer);
 
-		y += MENU_CHOICE_DY;
-	}
-}
+	//RAM risparmiata rispetto ad un eseguibile unico con tutti i test, tenendo
+	//conto della mappa dei simboli che deve restare in memoria
+	sprintf(buffer, "SYMBOL MAP: %d KB, SAVED: %d KB", stats->map_size / 1024,
+		((int) stats->total_size - (int) stats->arena_size - (int) stats->map_size) / 1024);
+	drawTextList(ctx, xPos, &yPos, 0, OVERLAY_STATS_DY, buffer);
 
-void HandleMovableTestCommands(PADTYPE* pad)
-{
-	if (!(pad->btn & PAD_RIGHT))
+	//tempi riportati alla velocita' di una console originale: la lettura dipende
+	//dal CD, il collegamento dalla CPU
+	if(stats->size)
 	{
-		int pos = x[0] + vel[curVel];
-
-		if(pos > SCREEN_XRES - w[0])
-			pos = SCREEN_XRES - w[0];
-
-		x[0] = pos;
-	} 
-	else if(!(pad->btn & PAD_LEFT))
-	{
-		int pos = x[0] - vel[curVel];
-
-		if(pos < 0)
-			pos = 0;
-
-		x[0] = pos;
+		sprintf(buffer, "LAST LOAD: %d B, READ %d US, LINK %d US",
+			stats->size, Calib_TicksToStockUs(stats->read_time, CALIB_CD), Calib_TicksToStockUs(stats->link_time, CALIB_CPU));
+		drawTextList(ctx, xPos, &yPos, 0, OVERLAY_STATS_DY, buffer);
 	}
 
-	if (!(pad->btn & PAD_UP))
-	{
-		int pos = y[0] - vel[curVel];
+	const SectorCache_Stats *cache = SectorCache_GetStats(&sectorCache);
 
-		if(pos < 0)
-			pos = 0;
-		
-		y[0] = pos;
-	} 
-	else if(!(pad->btn & PAD_DOWN))
-	{
-		int pos = y[0] + vel[curVel];
+	uint32_t lookups = cache->hits + cache->misses;
 
-		if(pos > SCREEN_YRES - h[0])
-			pos = SCREEN_YRES - h[0];
-		
-		y[0] = pos;
-	}
-
-	//per evitare di switchare a manetta
-	if((lastButtons & PAD_CROSS) && !(pad->btn & PAD_CROSS))			
-	{
-		r[0] = rand() % 256;
-		g[0] = rand() % 256;
-		b[0] = rand() % 256;
-	}
-	if((lastButtons & PAD_SQUARE) && !(pad->btn & PAD_SQUARE))			
-	{
-		int v = curVel + 1;
-
-		if(v == 4)
-			v = 0;
+	sprintf(buffer, "FILE CACHE: %d%% HIT (%d/%d), -%d MS", lookups ? (cache->hits * 100 / lookups) : 0,
+		cache->hits, lookups, Calib_TicksToStockUs(SectorCache_GetTimeSaved(&sectorCache), CALIB_CD) / 1000);
+	drawTextList(ctx, xPos, &yPos, 0, OVERLAY_STATS_DY, buffer);
 
-		curVel = v;
-	}
+	//velocita' misurate all'avvio rispetto ad una console originale
+	sprintf(buffer, "%s CPU %d%% GPU %d%% CD %d%% %s", Calib_GetInfo()->pal ? "PAL" : "NTSC",
+		Calib_GetPercent(CALIB_CPU), Calib_GetPercent(CALIB_GPU), Calib_GetPercent(CALIB_CD),
+		Calib_IsStock() ? "STOCK" : "FAST");
+	drawTextList(ctx, xPos, &yPos, 0, OVERLAY_STATS_DY, buffer);
+}
 
-	//rimpicciolimento
-	if((lastButtons & PAD_L1) && !(pad->btn & PAD_L1))			
-	{
-		int curW = w[0] - BASE_W;
-		int curH = h[0] - BASE_H;
+void DrawMenu(RenderContext* ctx)
+{
+	int i;
+	int y = MENU_START_Y;
 
-		if(curW < BASE_W)
-			curW = BASE_W;
+	// Keep the selected choice in the middle of the visible part of the menu.
+	int first = curMenuChoice - MENU_VISIBLE / 2;
 
-		if(curH < BASE_H)
-			curH = BASE_H;
+	if(first > (NUM_CHOICES - MENU_VISIBLE))
+		first = NUM_CHOICES - MENU_VISIBLE;
+	if(first < 0)
+		first = 0;
 
-		w[0] = curW;
-		h[0] = curH;
-	}
-	//ingrandimento
-	if((lastButtons & PAD_R1) && !(pad->btn & PAD_R1))			
+	for(i = first; (i < NUM_CHOICES) && (i < (first + MENU_VISIBLE)); i++)
 	{
-		int curW = w[0] + BASE_W;
-		int curH = h[0] + BASE_H;
-
-		if(curW > SCREEN_XRES - BASE_W)
-			curW = SCREEN_XRES - BASE_W;
-
-		if(curH > SCREEN_YRES - BASE_H)
-			curH = SCREEN_YRES - BASE_H;
-
-		w[0] = curW;
-		h[0] = curH;
-	}
+		if(curMenuChoice == i)
+			draw_rectangle(ctx, &menuTile, 1, TILESC_ARROW_U, TILESC_ARROW_V, MENU_X - 14, y, 0, 8, 8, 255, 0, 0);
 
-	HandleTextureCommand(pad);
-}
+		draw_text(ctx, MENU_X, y, 0, menuChoicesText[i]);
 
-void HandleStressTestCommands(PADTYPE* pad)
-{
-	if((lastButtons & PAD_SELECT) && !(pad->btn & PAD_SELECT))
-	{
-		InitStressTest();
+		y += MENU_CHOICE_DY;
 	}
 
-	HandleTextureCommand(pad);
+	DrawOverlayStats(ctx);
 }
 
 void HandleAudioTestCommands(PADTYPE* pad)
@@ -832,7 +1189,8 @@ void HandleAudioTestCommands(PADTYPE* pad)
 	}
 
 	// Note that seeking will only work correctly with .VAG files whose
-	// interleave (chunk size) is a multiple of 2048.
+	// interleave (chunk size) is a multiple of 2048, which tools/vagenc always
+	// produces.
 	if (!(pad->btn & PAD_LEFT) && (read_ctx[currentTrackIndex].next_sector > 0))
 		read_ctx[currentTrackIndex].next_sector -= sectors_per_chunk;
 	if (!(pad->btn & PAD_RIGHT))
@@ -855,6 +1213,8 @@ void HandleAudioTestCommands(PADTYPE* pad)
 		sampleRate[currentTrackIndex] = read_ctx[currentTrackIndex].sample_rate;
 		Stream_SetSampleRate(&stream_ctx[currentTrackIndex], sampleRate[currentTrackIndex]);
 	}
+	if ((lastButtons & PAD_SQUARE) && !(pad->btn & PAD_SQUARE)) 
+		read_ctx[currentTrackIndex].use_loop_head ^= 1;
 	if ((lastButtons & PAD_TRIANGLE) && !(pad->btn & PAD_TRIANGLE)) 
 	{
 		Stream_Stop();
@@ -888,6 +1248,11 @@ void EndCurrentMode()
 		case AUDIO_TEST:
 			EndAudioTest();
 		break;
+
+		default:
+			if(overlayMode && overlayMode->end)
+				overlayMode->end();
+		break;
 	}
 }
 
@@ -898,6 +1263,11 @@ void ResumeCurrentMode()
 		case AUDIO_TEST:
 			ResumeAudioTest();
 		break;
+
+		default:
+			if(overlayMode && overlayMode->resume)
+				overlayMode->resume();
+		break;
 	}
 }
 
@@ -908,6 +1278,11 @@ void PauseCurrentMode()
 		case AUDIO_TEST:
 			PauseAudioTest();
 		break;
+
+		default:
+			if(overlayMode && overlayMode->pause)
+				overlayMode->pause();
+		break;
 	}
 }
 
@@ -937,14 +1312,6 @@ void HandleMenuCommands(PADTYPE* pad)
 
 		switch(curMenuChoice)
 		{
-			case STRESS_TEST:
-				EndCurrentMode();
-				InitStressTest();
-			break;
-			case MOV_TEST:
-				EndCurrentMode();
-				InitMovableTest();
-			break;
 			case AUDIO_TEST:
 				EndCurrentMode();
 				InitAudioTest();
@@ -952,6 +1319,10 @@ void HandleMenuCommands(PADTYPE* pad)
 			case BACK_CHOICE:
 				ResumeCurrentMode();
 			return;
+			default:
+				EndCurrentMode();
+				InitOverlayMode(curMenuChoice);
+			break;
 		}
 
 		curMode = curMenuChoice;
@@ -966,17 +1337,14 @@ void HandleCommands(PADTYPE* pad)
 		{
 			switch(curMode)
 			{
-				case STRESS_TEST:
-				HandleStressTestCommands(pad);
-				break;
-
-				case MOV_TEST:
-				HandleMovableTestCommands(pad);
-				break;
-
 				case AUDIO_TEST:
 				HandleAudioTestCommands(pad);
 				break;
+
+				default:
+				if(overlayMode && overlayMode->handle_commands)
+					overlayMode->handle_commands(pad);
+				break;
 			}
 
 			if(!(pad->btn & PAD_START))
@@ -1007,16 +1375,22 @@ void DrawCurrentMode(RenderContext *ctx)
 
 	switch(curMode)
 	{
-		case STRESS_TEST:
-		DrawStressTest(ctx);
+		case AUDIO_TEST:
+		DrawAudioTest(ctx);
 		break;
 
-		case MOV_TEST:
-		DrawMovableTest(ctx);
-		break;
+		default:
+		if(!overlayMode)
+		{
+			const char *error = Overlay_GetError();
 
-		case AUDIO_TEST:
-		DrawAudioTest(ctx);
+			draw_text(ctx, 8, MENU_START_Y, 0, "OVERLAY NOT LOADED");
+			draw_text(ctx, 8, MENU_START_Y + MENU_CHOICE_DY, 0, error ? error : "");
+		}
+		else if(overlayMode->draw)
+		{
+			overlayMode->draw(ctx);
+		}
 		break;
 	}
 }
@@ -1029,17 +1403,50 @@ void HandleTextureCommand(PADTYPE* pad)
 	}
 }
 
-void LoadTextures()
+static void LoadAtlas(const uint32_t *tim, TIM_IMAGE *image)
 {
-	GetTimInfo( tilesc, &timImage ); /* Get TIM parameters */
+	GetTimInfo( tim, image ); /* Get TIM parameters */
 
-	LoadImage( timImage.prect, timImage.paddr );		/* Upload texture to VRAM */
-	if( timImage.mode & 0x8 ) 
+	LoadImage( image->prect, image->paddr );		/* Upload texture to VRAM */
+	Vram_Reserve( image->prect );
+	if( image->mode & 0x8 ) 
 	{
-		LoadImage( timImage.crect, timImage.caddr );	/* Upload CLUT if present */
+		LoadImage( image->crect, image->caddr );	/* Upload CLUT if present */
+		Vram_Reserve( image->crect );
 	}
 }
 
+void LoadTextures()
+{
+	LoadAtlas( tilesc, &timImage );
+
+	// 4bpp copy of the atlas, with a CLUT per sprite (for the CLUT animation
+	// test)
+	LoadAtlas( tiles4, &tiles4Image );
+}
+
+void Calibrate(RenderContext *ctx)
+{
+	char debug[128];
+
+	drawImmediateText(ctx, 8, MENU_START_Y, 0, "Calibrating clocks...");
+	Calib_Run();
+
+	sprintf(debug, "Clocks: TMR %d%% CPU %d%% GPU %d%% CD %d%%", Calib_GetPercent(CALIB_TIMER),
+		Calib_GetPercent(CALIB_CPU), Calib_GetPercent(CALIB_GPU), Calib_GetPercent(CALIB_CD));
+	drawImmediateText(ctx, 8, MENU_START_Y, 0, debug);
+}
+
+void LoadOverlays(RenderContext *ctx)
+{
+	char debug[128];
+
+	bool loaded = Overlay_Init("\\BENCH.MAP;1", menuOverlays, NUM_CHOICES);
+
+	sprintf(debug, "Loading BENCH.MAP: %s", loaded ? "SUCCESS" : Overlay_GetError());
+	drawImmediateText(ctx, 8, MENU_START_Y, 0, debug);
+}
+
 void LoadAudioTracks(RenderContext *ctx)
 {
 	int i;
@@ -1068,6 +1475,11 @@ void LoadAudioTracks(RenderContext *ctx)
 		{
 			setup_stream(&file.pos, &read_ctx[i], &stream_ctx[i]);
 			sampleRate[i] = read_ctx[i].sample_rate;
+
+			// Con 8 MB di RAM le tracce che ci stanno restano in memoria
+			// man mano che vengono riprodotte, senza letture all'avvio
+			if(Ram_GetConfig()->resident_audio)
+				make_stream_resident(&read_ctx[i]);
 		}
 	}
 }
@@ -1077,13 +1489,28 @@ int main(int argc, const char **argv) {
 	// PSn00bSDK at (960, 0) in VRAM.
 	ResetGraph(0);
 	FntLoad(960, 0);
+
+	// Detect how much RAM there is before anything is allocated from it.
+	Ram_Init();
 	
 	// Set up our rendering context.
 	RenderContext ctx;
 	setup_context(&ctx, SCREEN_XRES, SCREEN_YRES, 63, 0, 127);
 
+	// Keep textures loaded at runtime away from the framebuffers and the
+	// font (whose CLUT PSn00bSDK places below it, in the same texture page).
+	RECT framebuffers = { 0, 0, SCREEN_XRES, SCREEN_YRES * 2 };
+	RECT font         = { 960, 0, 64, 256 };
+
+	Vram_Init();
+	Vram_Reserve(&framebuffers);
+	Vram_Reserve(&font);
+
 	ComputeAngles();
 
+	//timer per le misurazioni
+	Timer_Init();
+
 	//inizializzo CD stream
 	CdInit();
 
@@ -1092,7 +1519,19 @@ int main(int argc, const char **argv) {
 	gte_SetGeomOffset( CENTERX, CENTERY );
 	gte_SetGeomScreen( CENTERX );
 
+	//misura le velocita' effettive (emulatori con overclock o speed hack)
+	Calibrate(&ctx);
+
 	LoadTextures();
+
+	// Streamed audio gets a cache of its own, so that it does not evict the
+	// other files and its hit rate is reported separately.
+	int cacheSectors = Ram_GetConfig()->cache_sectors;
+
+	SectorCache_Init(&sectorCache, cacheSectors / 2);
+	SectorCache_Init(&streamCache, cacheSectors - cacheSectors / 2);
+
+	LoadOverlays(&ctx);
 	LoadAudioTracks(&ctx);
 
 	// Set up controller polling.
@@ -0,0 +1,251 @@
+/*
+ * ps1-benchmark batched primitive emitter test (overlay)
+ *
+ * Compares the cost of emitting primitives one object at a time through
+ * draw_rectangle() (as the stress test does) with the type-specialized batch
+ * emitters in batch.h, in CPU cycles per primitive. Both write into a scratch
+ * buffer which is never drawn, with the I-cache warmed up by a first run; the
+ * fastest of several runs is kept. draw_rectangle() can only emit tiles and
+ * textured quads, so sprites and flat quads are only measured batched.
+ *
+ * The objects are also drawn on screen with the selected emitter, to check
+ * that all kinds produce the same picture.
+ */
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <psxgpu.h>
+#include <psxpad.h>
+#include <psxapi.h>
+
+#include "bench.h"
+#include "timer.h"
+#include "calib.h"
+#include "batch.h"
+#include "tilesc.h"
+
+#define NUM_OBJECTS 256
+#define NUM_RUNS    8
+
+static const char *const kindNames[BATCH_NUM_KINDS] =
+{
+	"TILE", "SPRT", "POLY_F4", "POLY_FT4"
+};
+
+static int16_t  objX[NUM_OBJECTS], objY[NUM_OBJECTS];
+static int16_t  objW[NUM_OBJECTS], objH[NUM_OBJECTS];
+static uint16_t objZ[NUM_OBJECTS], objUV[NUM_OBJECTS];
+static uint32_t objColor[NUM_OBJECTS];
+static Batch_Objects objects;
+
+// Cycles per primitive, 0 if not measured
+static uint32_t chainCycles[BATCH_NUM_KINDS], batchCycles[BATCH_NUM_KINDS];
+
+static BenchRun run;
+static int liveKind = BATCH_POLY_FT4;
+static const char *error = 0;
+
+static void *tiles[NUM_OBJECTS];
+
+/* Workload */
+
+static void InitObjects(void)
+{
+	for(int i = 0; i < NUM_OBJECTS; i++)
+	{
+		objX[i]     = rand() % (SCREEN_XRES - BASE_W);
+		objY[i]     = rand() % (SCREEN_YRES - BASE_H);
+		objW[i]     = BASE_W;
+		objH[i]     = BASE_H;
+		objZ[i]     = 1 + i % NUM_RECTANGLES;
+		objUV[i]    = (TILESC_SPHERE_V << 8) | TILESC_SPHERE_U;
+		objColor[i] = 0x808080;
+	}
+
+	objects.count   = NUM_OBJECTS;
+	objects.x       = objX;
+	objects.y       = objY;
+	objects.w       = objW;
+	objects.h       = objH;
+	objects.z       = objZ;
+	objects.uv      = objUV;
+	objects.color   = objColor;
+	objects.tpage   = TILESC_TPAGE;
+	objects.clut    = TILESC_CLUT;
+	objects.tpage_z = NUM_RECTANGLES;
+}
+
+/* Measurement */
+
+static Timer_Ticks TimeChain(RenderContext* ctx, int kind, uint8_t *arena, size_t size)
+{
+	int texture = (kind == BATCH_POLY_FT4);
+
+	ctx->next_packet = arena;
+	ctx->packet_end  = arena + size;
+
+	Timer_Ticks start = Timer_GetTicks();
+
+	for(int i = 0; i < NUM_OBJECTS; i++)
+	{
+		draw_rectangle(ctx, &tiles[i], texture, TILESC_SPHERE_U, TILESC_SPHERE_V,
+			objX[i], objY[i], objZ[i], objW[i], objH[i], 128, 128, 128);
+	}
+
+	return Timer_GetTicks() - start;
+}
+
+static Timer_Ticks TimeBatch(RenderContext* ctx, int kind, uint8_t *arena)
+{
+	Timer_Ticks start = Timer_GetTicks();
+
+	Batch_Emit(kind, &objects, ctx->buffers[0].ot, arena);
+
+	return Timer_GetTicks() - start;
+}
+
+static uint32_t PerPrimitive(Timer_Ticks ticks)
+{
+	return Calib_TicksToStockCycles(ticks, CALIB_CPU) / NUM_OBJECTS;
+}
+
+static void RunBenchmark(void)
+{
+	size_t size = Batch_GetSize(BATCH_POLY_FT4, NUM_OBJECTS);
+	RenderContext *scratch = malloc(sizeof(RenderContext));
+	uint8_t *arena = malloc(size);
+
+	if(!scratch || !arena)
+	{
+		free(arena);
+		free(scratch);
+		error = "OUT OF MEMORY";
+		return;
+	}
+
+	scratch->active_buffer = 0;
+
+	for(int kind = 0; kind < BATCH_NUM_KINDS; kind++)
+	{
+		bool hasChain = (kind == BATCH_TILE) || (kind == BATCH_POLY_FT4);
+		Timer_Ticks bestChain = 0xffffffff, bestBatch = 0xffffffff;
+
+		// The first run of each also loads the code into the I-cache.
+		for(int i = 0; i <= NUM_RUNS; i++)
+		{
+			Timer_Ticks chain = hasChain ? TimeChain(scratch, kind, arena, size) : 0;
+			Timer_Ticks batch = TimeBatch(scratch, kind, arena);
+
+			if(!i)
+				continue;
+			if(chain < bestChain)
+				bestChain = chain;
+			if(batch < bestBatch)
+				bestBatch = batch;
+		}
+
+		chainCycles[kind] = hasChain ? PerPrimitive(bestChain) : 0;
+		batchCycles[kind] = PerPrimitive(bestBatch);
+	}
+
+	free(arena);
+	free(scratch);
+}
+
+/* Mode callbacks */
+
+static void InitBatch(void)
+{
+	Bench_ResetRun(&run);
+	error = 0;
+
+	InitObjects();
+}
+
+static void DrawLive(RenderContext* ctx)
+{
+	// Only as many objects as the stress test draws fit in the render buffer.
+	objects.count = NUM_RECTANGLES;
+
+	size_t size = Batch_GetSize(liveKind, objects.count);
+
+	if((ctx->next_packet + size) <= ctx->packet_end)
+	{
+		ctx->next_packet = Batch_Emit(liveKind, &objects,
+			ctx->buffers[ctx->active_buffer].ot, ctx->next_packet);
+	}
+
+	objects.count = NUM_OBJECTS;
+}
+
+static void DrawResults(RenderContext* ctx, int xPos, int *yPos)
+{
+	char buffer[128];
+
+	drawTextList(ctx, xPos, yPos, 0, RESULT_DY, "CYCLES/PRIM  CALLS  BATCH  GAIN");
+
+	for(int kind = 0; kind < BATCH_NUM_KINDS; kind++)
+	{
+		if(chainCycles[kind])
+		{
+			uint32_t gain = batchCycles[kind] ? (chainCycles[kind] * 10 / batchCycles[kind]) : 0;
+
+			sprintf(buffer, "%-11s %6d %6d %3d.%dX", kindNames[kind], chainCycles[kind],
+				batchCycles[kind], gain / 10, gain % 10);
+		}
+		else
+		{
+			sprintf(buffer, "%-11s %6s %6d", kindNames[kind], "-", batchCycles[kind]);
+		}
+
+		drawTextList(ctx, xPos, yPos, 0, RESULT_DY, buffer);
+	}
+
+	*yPos += RESULT_DY;
+}
+
+static void DrawBatch(RenderContext* ctx)
+{
+	char buffer[128];
+	int xPos = 8;
+	int yPos = RESULT_START_Y;
+
+	if(Bench_DrawPending(&run, ctx, xPos, &yPos))
+		return;
+	if(Bench_ShouldRun(&run))
+		RunBenchmark();
+
+	if(error)
+	{
+		drawTextList(ctx, xPos, &yPos, 0, RESULT_DY, error);
+		return;
+	}
+
+	sprintf(buffer, "BATCH EMITTERS, %d OBJECTS", NUM_OBJECTS);
+	drawTextList(ctx, xPos, &yPos, 0, RESULT_DY * 2, buffer);
+
+	if(run.state == BENCH_DONE)
+		DrawResults(ctx, xPos, &yPos);
+
+	sprintf(buffer, "[SQUARE] DRAWING: %s", kindNames[liveKind]);
+	drawTextList(ctx, xPos, &yPos, 0, RESULT_DY, buffer);
+	drawTextList(ctx, xPos, &yPos, 0, RESULT_DY, "[X]      MEASURE");
+
+	DrawLive(ctx);
+}
+
+static void HandleBatchCommands(PADTYPE* pad)
+{
+	Bench_RequestRun(&run, pad, PAD_CROSS);
+
+	if((lastButtons & PAD_SQUARE) && !(pad->btn & PAD_SQUARE))
+		liveKind = (liveKind + 1) % BATCH_NUM_KINDS;
+}
+
+const BenchMode bench_mode =
+{
+	.init            = &InitBatch,
+	.handle_commands = &HandleBatchCommands,
+	.draw            = &DrawBatch
+};
@@ -0,0 +1,348 @@
+/*
+ * ps1-benchmark maximum sustainable stream bitrate test (overlay)
+ *
+ * Automatically ramps up the playback rate of the 2, 4 and 8-channel stem
+ * streams, for a few different refill sizes (i.e. the number of free sectors
+ * the ring buffer must have before a new CD read is issued), until the
+ * CD-to-SPU pipeline can no longer keep up. Each rate is held for a couple of
+ * seconds; a step fails if the SPU IRQ handler reports an underrun or if the
+ * ring buffer drains below a quarter of its size, which would turn into an
+ * underrun if the rate was held any longer.
+ *
+ * For each configuration the highest sustained rate and the resulting bytes
+ * per second are reported, along with the stage that was the most loaded when
+ * the next step failed:
+ *
+ * - CD:  time spent reading (and seeking) sectors, from feed_stream();
+ * - ISR: time spent in the SPU IRQ handler;
+ * - DMA: time spent uploading chunks to SPU RAM.
+ *
+ * The ramp stops at 4x the original rate, which is the highest pitch the SPU
+ * supports.
+ */
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <psxgpu.h>
+#include <psxpad.h>
+#include <psxcd.h>
+#include <psxspu.h>
+
+#include "bench.h"
+#include "stream.h"
+#include "timer.h"
+
+#define NUM_STREAMS 3
+#define NUM_REFILLS 3
+#define NUM_CONFIGS (NUM_STREAMS * NUM_REFILLS)
+
+#define MIN_RATE    44100
+#define MAX_RATE    176400
+#define RATE_STEP   22050
+#define STEP_FRAMES 120
+
+enum rampStage
+{
+	STAGE_NONE = 0,
+	STAGE_CD,
+	STAGE_ISR,
+	STAGE_DMA
+};
+
+typedef struct
+{
+	int      channels, refill, max_rate;
+	uint32_t bytes_per_second;
+	int      limit, load[4]; // Load of each stage (%) when the next step failed
+} RampResult;
+
+static const char *const streamPaths[NUM_STREAMS] =
+{
+	"\\STREAMS\\STEMS2.VAG;1",
+	"\\STREAMS\\STEMS4.VAG;1",
+	"\\STREAMS\\STEMS8.VAG;1"
+};
+
+// Must be smaller than the ring buffer (48 sectors).
+static const int refillSizes[NUM_REFILLS] = { 8, 16, 32 };
+
+static const char *const stageNames[4] = { "SPU PITCH", "CD READ", "ISR", "SPU DMA" };
+static const char *const stageShort[4] = { "MAX", "CD", "ISR", "DMA" };
+
+static Stream_Context    streamCtx;
+static StreamReadContext readCtx;
+
+static RampResult results[NUM_CONFIGS];
+static int state = BENCH_IDLE; // Never PENDING, the test runs over several frames
+static int currentConfig = 0;
+static int currentRate = 0;
+static int stepFrames = 0;
+static size_t minFill = 0;
+static bool loaded = false;
+static Timer_Ticks stepStart;
+static const char *error = 0;
+
+/* Stream management */
+
+static uint32_t BytesPerSecond(int channels, int rate)
+{
+	// 16 bytes per 28 samples.
+	return channels * (rate / 28) * 16;
+}
+
+static void UnloadStream(void)
+{
+	if(!loaded)
+		return;
+
+	Stream_Stop();
+	CdReadSync(0, 0);
+	destroy_stream(&readCtx, &streamCtx);
+
+	loaded = false;
+}
+
+static void StartStep(int rate)
+{
+	currentRate = rate;
+	stepFrames  = 0;
+	minFill     = streamCtx.config.buffer_size;
+
+	Stream_SetSampleRate(&streamCtx, rate);
+	Stream_ResetStats(&streamCtx);
+
+	readCtx.bytes_read = 0;
+	readCtx.read_time  = 0;
+	stepStart          = Timer_GetTicks();
+}
+
+static void StartConfig(int index)
+{
+	RampResult *result = &results[index];
+	CdlFILE    file;
+
+	UnloadStream();
+
+	currentConfig = index;
+
+	if(!CdSearchFile(&file, streamPaths[index / NUM_REFILLS]))
+	{
+		error = "STREAM NOT FOUND";
+		state = BENCH_DONE;
+		return;
+	}
+
+	CdReadSync(0, 0);
+	setup_stream(&file.pos, &readCtx, &streamCtx);
+
+	readCtx.refill_threshold = refillSizes[index % NUM_REFILLS];
+	loaded = true;
+
+	result->channels         = streamCtx.num_channels;
+	result->refill           = readCtx.refill_threshold;
+	result->max_rate         = 0;
+	result->bytes_per_second = 0;
+	result->limit            = STAGE_NONE;
+
+	for(int i = 0; i < 4; i++)
+		result->load[i] = 0;
+
+	Stream_Start(&streamCtx, false);
+	StartStep(MIN_RATE);
+}
+
+static void NextConfig(void)
+{
+	if((currentConfig + 1) < NUM_CONFIGS)
+	{
+		StartConfig(currentConfig + 1);
+		return;
+	}
+
+	UnloadStream();
+	state = BENCH_DONE;
+}
+
+static void EndStep(void)
+{
+	RampResult *result = &results[currentConfig];
+	Stream_Stats stats;
+
+	Stream_GetStats(&streamCtx, &stats);
+
+	bool failed = stats.underruns || (minFill < (streamCtx.config.buffer_size / 4));
+
+	if(!failed)
+	{
+		result->max_rate         = currentRate;
+		result->bytes_per_second = BytesPerSecond(result->channels, currentRate);
+
+		if((currentRate + RATE_STEP) > MAX_RATE)
+			NextConfig();
+		else
+			StartStep(currentRate + RATE_STEP);
+
+		return;
+	}
+
+	// Figure out which stage was the busiest during the failed step.
+	uint32_t elapsed = Timer_TicksToUs(Timer_GetTicks() - stepStart) / 100;
+
+	if(elapsed)
+	{
+		result->load[STAGE_CD]  = Timer_TicksToUs(readCtx.read_time) / elapsed;
+		result->load[STAGE_ISR] = Timer_TicksToUs(stats.irq_time) / elapsed;
+		result->load[STAGE_DMA] = Timer_TicksToUs(stats.dma_time) / elapsed;
+	}
+
+	result->limit = STAGE_CD;
+
+	if(result->load[STAGE_ISR] > result->load[result->limit])
+		result->limit = STAGE_ISR;
+	if(result->load[STAGE_DMA] > result->load[result->limit])
+		result->limit = STAGE_DMA;
+
+	NextConfig();
+}
+
+static void UpdateRamp(void)
+{
+	feed_stream(&readCtx, &streamCtx);
+
+	size_t fill = streamCtx.buffer.length;
+
+	if(fill < minFill)
+		minFill = fill;
+
+	if(++stepFrames >= STEP_FRAMES)
+		EndStep();
+}
+
+/* Mode callbacks */
+
+static void InitBitrate(void)
+{
+	state = BENCH_IDLE;
+	error = 0;
+}
+
+static void EndBitrate(void)
+{
+	UnloadStream();
+
+	if(state == BENCH_RUNNING)
+		state = BENCH_IDLE;
+}
+
+static void DrawBitrate(RenderContext* ctx)
+{
+	char buffer[128];
+	int xPos = 8;
+	int yPos = RESULT_START_Y;
+	int i;
+
+	if(state == BENCH_IDLE)
+	{
+		drawTextList(ctx, xPos, &yPos, 0, RESULT_DY * 2, "MAXIMUM SUSTAINED STREAM BITRATE");
+		drawTextList(ctx, xPos, &yPos, 0, RESULT_DY, "[X] RUN (TAKES UP TO 2 MINUTES)");
+		return;
+	}
+
+	if(state == BENCH_RUNNING)
+	{
+		UpdateRamp();
+
+		if(state == BENCH_RUNNING)
+		{
+			Stream_Stats stats;
+			Stream_GetStats(&streamCtx, &stats);
+
+			sprintf(buffer, "CONFIG %d/%d: %d CH, REFILL %d SECTORS", currentConfig + 1,
+				NUM_CONFIGS, streamCtx.num_channels, readCtx.refill_threshold);
+			drawTextList(ctx, xPos, &yPos, 0, RESULT_DY, buffer);
+
+			sprintf(buffer, "RATE %6d HZ, %3d KB/S", currentRate,
+				BytesPerSecond(streamCtx.num_channels, currentRate) / 1024);
+			drawTextList(ctx, xPos, &yPos, 0, RESULT_DY, buffer);
+
+			sprintf(buffer, "BUFFER %5d/%d (MIN %5d)", streamCtx.buffer.length,
+				streamCtx.config.buffer_size, minFill);
+			drawTextList(ctx, xPos, &yPos, 0, RESULT_DY, buffer);
+
+			sprintf(buffer, "UNDERRUNS %d, STEP %3d%%", stats.underruns, stepFrames * 100 / STEP_FRAMES);
+			drawTextList(ctx, xPos, &yPos, 0, RESULT_DY * 2, buffer);
+
+			drawTextList(ctx, xPos, &yPos, 0, RESULT_DY, "[X] ABORT");
+			return;
+		}
+	}
+
+	if(error)
+	{
+		drawTextList(ctx, xPos, &yPos, 0, RESULT_DY, error);
+		return;
+	}
+
+	drawTextList(ctx, xPos, &yPos, 0, RESULT_DY * 2, "MAXIMUM SUSTAINED STREAM BITRATE");
+
+	int best = 0;
+
+	for(i = 0; i < NUM_CONFIGS; i++)
+	{
+		const RampResult *result = &results[i];
+
+		if(!(i % NUM_REFILLS))
+		{
+			sprintf(buffer, "%d CHANNELS", result->channels);
+			drawTextList(ctx, xPos, &yPos, 0, RESULT_DY, buffer);
+		}
+
+		sprintf(buffer, " %2d SECT: %6d HZ %3d KB/S %s %d%%", result->refill, result->max_rate,
+			result->bytes_per_second / 1024, stageShort[result->limit], result->load[result->limit]);
+		drawTextList(ctx, xPos, &yPos, 0, RESULT_DY, buffer);
+
+		if(result->bytes_per_second > results[best].bytes_per_second)
+			best = i;
+	}
+
+	yPos += RESULT_DY;
+
+	const RampResult *result = &results[best];
+
+	sprintf(buffer, "MAX SUSTAINED %d KB/S (%d CH, %d SECT)",
+		result->bytes_per_second / 1024, result->channels, result->refill);
+	drawTextList(ctx, xPos, &yPos, 0, RESULT_DY, buffer);
+
+	sprintf(buffer, "LIMITED BY %s (CD %d%% ISR %d%% DMA %d%%)", stageNames[result->limit],
+		result->load[STAGE_CD], result->load[STAGE_ISR], result->load[STAGE_DMA]);
+	drawTextList(ctx, xPos, &yPos, 0, RESULT_DY * 2, buffer);
+
+	drawTextList(ctx, xPos, &yPos, 0, RESULT_DY, "[X] RUN AGAIN");
+}
+
+static void HandleBitrateCommands(PADTYPE* pad)
+{
+	if(!((lastButtons & PAD_CROSS) && !(pad->btn & PAD_CROSS)))
+		return;
+
+	if(state == BENCH_RUNNING)
+	{
+		UnloadStream();
+		state = BENCH_IDLE;
+		return;
+	}
+
+	error = 0;
+	state = BENCH_RUNNING;
+	StartConfig(0);
+}
+
+const BenchMode bench_mode =
+{
+	.init            = &InitBitrate,
+	.end             = &EndBitrate,
+	.pause           = &EndBitrate,
+	.handle_commands = &HandleBitrateCommands,
+	.draw            = &DrawBitrate
+};
@@ -0,0 +1,412 @@
+/*
+ * ps1-benchmark CLUT animation test (overlay)
+ *
+ * Palette cycling animates indexed textures (water, fire, highlights) by
+ * rotating the colors of their CLUT every frame and uploading it again with
+ * LoadImage(), which moves a few dozen bytes per CLUT instead of changing the
+ * primitives' UVs or uploading new texture data. This test measures, for 1 to
+ * 256 animated CLUTs of 16 colors (4bpp) and 1 to 64 of up to 256 colors
+ * (8bpp, limited by the size of the scratch area in VRAM):
+ *
+ * - the CPU time taken to compute the rotated palettes,
+ * - the CPU time taken to submit the uploads, and the time until the DMA
+ *   transfers are complete, when each CLUT is uploaded separately,
+ * - the same when the CLUTs are laid out next to each other in VRAM and
+ *   uploaded with a single LoadImage() call.
+ *
+ * Meanwhile, the sprites of both texture atlases are drawn with their CLUTs
+ * cycled every frame: each sprite has its own 16-color CLUT in the 4bpp atlas,
+ * while the 8bpp atlas shares a single one (which is restored when leaving).
+ */
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <psxgpu.h>
+#include <psxpad.h>
+
+#include "bench.h"
+#include "timer.h"
+#include "calib.h"
+#include "vram.h"
+#include "tilesc.h"
+#include "tiles4.h"
+
+#define NUM_COUNTS   5
+#define MAX_CLUTS    256
+#define MAX_CLUTS_8  64
+#define NUM_RUNS     8
+
+#define CLUTS_PER_ROW 16
+
+#define SPRITES_X    16
+#define SPRITES_Y    168
+#define SPRITE_STEP  40
+
+enum clutDepth
+{
+	DEPTH_4BPP = 0,
+	DEPTH_8BPP,
+	NUM_DEPTHS
+};
+
+typedef struct
+{
+	Timer_Ticks generate;
+	Timer_Ticks eachSubmit, eachDMA;
+	Timer_Ticks batchSubmit, batchDMA;
+} Result;
+
+typedef struct
+{
+	uint8_t  u4, v4, u8, v8, w, h;
+	uint16_t clut4;
+} Sprite;
+
+#define SPRITE(name) \
+	{ TILES4_##name##_U, TILES4_##name##_V, TILESC_##name##_U, TILESC_##name##_V, \
+	  TILES4_##name##_W, TILES4_##name##_H, TILES4_##name##_CLUT }
+
+static const Sprite sprites[TILES4_NUM_SPRITES] =
+{
+	SPRITE(ARROW), SPRITE(SPHERE), SPRITE(DISC), SPRITE(SQUARE),
+	SPRITE(CROSS), SPRITE(CIRCLE), SPRITE(TRIANGLE)
+};
+
+static const int clutCounts[NUM_COUNTS] = { 1, 4, 16, 64, 256 };
+
+static Result results[NUM_COUNTS][NUM_DEPTHS];
+
+// Rotated palettes, laid out as in the scratch area of VRAM
+static uint16_t *staging = 0;
+static RECT scratch;
+
+// Rotated palettes for the atlases, uploaded each frame
+static uint16_t live4[TILES4_NUM_SPRITES][16];
+static uint16_t live8[256];
+static int phase = 0;
+static Timer_Ticks liveTime = 0;
+
+static BenchRun run;
+static const char *error = 0;
+
+/* Palettes */
+
+// Rotates all colors but the first (transparent) one by phase entries.
+static void CyclePalette(const uint16_t *src, uint16_t *dst, int colors, int phase)
+{
+	int split = (colors - 1) - phase;
+
+	dst[0] = src[0];
+
+	for(int i = 0; i < split; i++)
+		dst[1 + i] = src[1 + phase + i];
+	for(int i = 0; i < phase; i++)
+		dst[1 + split + i] = src[1 + i];
+}
+
+static int GetColors(int depth)
+{
+	return (depth == DEPTH_4BPP) ? tiles4Image.crect->w : timImage.crect->w;
+}
+
+// The source palettes are the atlases' CLUTs, the 4bpp one's taken in turn.
+static const uint16_t *GetPalette(int depth, int index)
+{
+	if(depth == DEPTH_8BPP)
+		return (const uint16_t *) timImage.caddr;
+
+	return &((const uint16_t *) tiles4Image.caddr)[(index % tiles4Image.crect->h) * 16];
+}
+
+// 16-color CLUTs are packed 16 to a row of the scratch area, larger ones take
+// a row each.
+static void GetClutRect(int depth, int index, RECT *rect)
+{
+	int colors = GetColors(depth);
+
+	if(depth == DEPTH_4BPP)
+		setRECT(rect, scratch.x + (index % CLUTS_PER_ROW) * 16, scratch.y + index / CLUTS_PER_ROW, colors, 1);
+	else
+		setRECT(rect, scratch.x, scratch.y + index, colors, 1);
+}
+
+static void GetBatchRect(int depth, int count, RECT *rect)
+{
+	int colors = GetColors(depth);
+
+	if(depth == DEPTH_8BPP)
+		setRECT(rect, scratch.x, scratch.y, colors, count);
+	else if(count < CLUTS_PER_ROW)
+		setRECT(rect, scratch.x, scratch.y, colors * count, 1);
+	else
+		setRECT(rect, scratch.x, scratch.y, colors * CLUTS_PER_ROW, count / CLUTS_PER_ROW);
+}
+
+/* Measurement */
+
+static void GeneratePalettes(int depth, int count)
+{
+	int colors = GetColors(depth);
+
+	for(int i = 0; i < count; i++)
+		CyclePalette(GetPalette(depth, i), &staging[i * colors], colors, i % (colors - 1));
+}
+
+static void Measure(int depth, int count, bool batched, Result *result)
+{
+	int colors = GetColors(depth);
+	RECT rect;
+
+	// Start with the GPU idle, so the transfers are not queued behind drawing.
+	DrawSync(0);
+
+	Timer_Ticks start = Timer_GetTicks();
+	GeneratePalettes(depth, count);
+	Timer_Ticks generated = Timer_GetTicks();
+
+	if(batched)
+	{
+		GetBatchRect(depth, count, &rect);
+		LoadImage(&rect, (const uint32_t *) staging);
+	}
+	else
+	{
+		for(int i = 0; i < count; i++)
+		{
+			GetClutRect(depth, i, &rect);
+			LoadImage(&rect, (const uint32_t *) &staging[i * colors]);
+		}
+	}
+
+	Timer_Ticks submitted = Timer_GetTicks();
+	DrawSync(0);
+	Timer_Ticks done = Timer_GetTicks();
+
+	Timer_Ticks generate = generated - start;
+	Timer_Ticks submit   = submitted - generated;
+	Timer_Ticks dma      = done - generated;
+
+	if(generate < result->generate)
+		result->generate = generate;
+
+	if(batched)
+	{
+		if(submit < result->batchSubmit)
+			result->batchSubmit = submit;
+		if(dma < result->batchDMA)
+			result->batchDMA = dma;
+	}
+	else
+	{
+		if(submit < result->eachSubmit)
+			result->eachSubmit = submit;
+		if(dma < result->eachDMA)
+			result->eachDMA = dma;
+	}
+}
+
+static void RunBenchmark(void)
+{
+	for(int c = 0; c < NUM_COUNTS; c++)
+	{
+		for(int depth = 0; depth < NUM_DEPTHS; depth++)
+		{
+			Result *result = &results[c][depth];
+
+			result->generate    = 0xffffffff;
+			result->eachSubmit  = result->eachDMA  = 0xffffffff;
+			result->batchSubmit = result->batchDMA = 0xffffffff;
+
+			if((depth == DEPTH_8BPP) && (clutCounts[c] > MAX_CLUTS_8))
+				continue;
+
+			// The first run also loads the code into the I-cache.
+			Result warmup = *result;
+
+			Measure(depth, clutCounts[c], false, &warmup);
+			Measure(depth, clutCounts[c], true, &warmup);
+
+			for(int i = 0; i < NUM_RUNS; i++)
+			{
+				Measure(depth, clutCounts[c], false, result);
+				Measure(depth, clutCounts[c], true, result);
+			}
+		}
+	}
+}
+
+/* Live animation */
+
+static void AnimateAtlases(void)
+{
+	RECT rect;
+
+	phase++;
+
+	for(int i = 0; i < TILES4_NUM_SPRITES; i++)
+	{
+		CyclePalette(GetPalette(DEPTH_4BPP, i), live4[i], 16, phase % 15);
+
+		setRECT(&rect, TILES4_CLUT_X, TILES4_CLUT_Y + i, 16, 1);
+		LoadImage(&rect, (const uint32_t *) live4[i]);
+	}
+
+	int colors = GetColors(DEPTH_8BPP);
+
+	CyclePalette(GetPalette(DEPTH_8BPP, 0), live8, colors, phase % (colors - 1));
+	LoadImage(timImage.crect, (const uint32_t *) live8);
+}
+
+static void RestoreAtlases(void)
+{
+	LoadImage(tiles4Image.crect, tiles4Image.caddr);
+	LoadImage(timImage.crect, timImage.caddr);
+	DrawSync(0);
+}
+
+static void DrawSprite(RenderContext* ctx, int x, int y, int u, int v, const Sprite *sprite,
+	uint16_t tpage, uint16_t clut)
+{
+	POLY_FT4 *poly = new_primitive(ctx, 1, sizeof(POLY_FT4));
+
+	setPolyFT4(poly);
+	setXY4(poly, x, y, x + sprite->w, y, x, y + sprite->h, x + sprite->w, y + sprite->h);
+	setRGB0(poly, 128, 128, 128);
+	setUVWH(poly, u, v, sprite->w - 1, sprite->h - 1);
+	poly->tpage = tpage;
+	poly->clut  = clut;
+}
+
+static void DrawAtlases(RenderContext* ctx)
+{
+	for(int i = 0; i < TILES4_NUM_SPRITES; i++)
+	{
+		const Sprite *sprite = &sprites[i];
+		int x = SPRITES_X + i * SPRITE_STEP;
+
+		DrawSprite(ctx, x, SPRITES_Y, sprite->u4, sprite->v4, sprite, TILES4_TPAGE, sprite->clut4);
+		DrawSprite(ctx, x, SPRITES_Y + SPRITE_STEP - 4, sprite->u8, sprite->v8, sprite,
+			TILESC_TPAGE, TILESC_CLUT);
+	}
+}
+
+/* Display */
+
+static void DrawResults(RenderContext* ctx, int xPos, int *yPos)
+{
+	char buffer[128];
+
+	drawTextList(ctx, xPos, yPos, 0, RESULT_DY, "US             ----EACH---- ----BATCH---");
+	drawTextList(ctx, xPos, yPos, 0, RESULT_DY, "CLUTS BPP   GEN   CPU   DMA   CPU   DMA");
+
+	for(int c = 0; c < NUM_COUNTS; c++)
+	{
+		for(int depth = 0; depth < NUM_DEPTHS; depth++)
+		{
+			const Result *result = &results[c][depth];
+
+			if(result->generate == 0xffffffff)
+				continue;
+
+			// DMA transfers are paced by the bus and the GPU's FIFO rather
+			// than by the CPU, so their times are left as measured.
+			sprintf(buffer, "%5d %3d %5d %5d %5d %5d %5d", clutCounts[c], depth ? 8 : 4,
+				Calib_TicksToStockUs(result->generate, CALIB_CPU),
+				Calib_TicksToStockUs(result->eachSubmit, CALIB_CPU),
+				Timer_TicksToUs(result->eachDMA),
+				Calib_TicksToStockUs(result->batchSubmit, CALIB_CPU),
+				Timer_TicksToUs(result->batchDMA));
+			drawTextList(ctx, xPos, yPos, 0, RESULT_DY, buffer);
+		}
+	}
+
+	*yPos += RESULT_DY;
+}
+
+/* Mode callbacks */
+
+static void InitClutAnim(void)
+{
+	Bench_ResetRun(&run);
+	error = 0;
+	phase = 0;
+
+	int words = MAX_CLUTS * 16;
+
+	if((MAX_CLUTS_8 * 256) > words)
+		words = MAX_CLUTS_8 * 256;
+
+	staging = malloc(words * sizeof(uint16_t));
+
+	if(!staging)
+		error = "OUT OF MEMORY";
+	else if(!Vram_Alloc(2, 256, MAX_CLUTS_8, &scratch))
+		error = "NO FREE VRAM";
+}
+
+static void PauseClutAnim(void)
+{
+	RestoreAtlases();
+}
+
+static void EndClutAnim(void)
+{
+	RestoreAtlases();
+
+	if(staging && !error)
+		Vram_Free(&scratch);
+
+	free(staging);
+	staging = 0;
+}
+
+static void DrawClutAnim(RenderContext* ctx)
+{
+	char buffer[128];
+	int xPos = 8;
+	int yPos = RESULT_START_Y;
+
+	if(error)
+	{
+		drawTextList(ctx, xPos, &yPos, 0, RESULT_DY, error);
+		return;
+	}
+
+	if(Bench_DrawPending(&run, ctx, xPos, &yPos))
+		return;
+	if(Bench_ShouldRun(&run))
+		RunBenchmark();
+
+	// The previous frame's uploads were completed when the buffers were
+	// flipped, so the palette buffers can be reused.
+	Timer_Ticks start = Timer_GetTicks();
+	AnimateAtlases();
+	liveTime = Timer_GetTicks() - start;
+
+	drawTextList(ctx, xPos, &yPos, 0, RESULT_DY * 2, "CLUT ANIMATION");
+
+	if(run.state == BENCH_DONE)
+		DrawResults(ctx, xPos, &yPos);
+
+	sprintf(buffer, "LIVE: %d CLUTS, %d US", TILES4_NUM_SPRITES + 1,
+		Calib_TicksToStockUs(liveTime, CALIB_CPU));
+	drawTextList(ctx, xPos, &yPos, 0, RESULT_DY, buffer);
+	drawTextList(ctx, xPos, &yPos, 0, RESULT_DY, "[X] MEASURE");
+
+	DrawAtlases(ctx);
+}
+
+static void HandleClutAnimCommands(PADTYPE* pad)
+{
+	Bench_RequestRun(&run, pad, PAD_CROSS);
+}
+
+const BenchMode bench_mode =
+{
+	.init            = &InitClutAnim,
+	.end             = &EndClutAnim,
+	.pause           = &PauseClutAnim,
+	.handle_commands = &HandleClutAnimCommands,
+	.draw            = &DrawClutAnim
+};
@@ -0,0 +1,255 @@
+/*
+ * ps1-benchmark static display list test (overlay)
+ *
+ * Draws a static HUD layer (a grid of tiles, framed panels and a few dozen
+ * lines of text) either by emitting all of its primitives again every frame,
+ * as the menu and the other modes do, or by building it once into a display
+ * list (see dlist.h) and splicing that into the OT every frame. The CPU time
+ * taken to put the layer in the OT is averaged over a number of frames for
+ * each method; press [SQUARE] to switch between them. The one-off cost of
+ * building the display list is shown as well.
+ */
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <psxgpu.h>
+#include <psxpad.h>
+
+#include "bench.h"
+#include "timer.h"
+#include "calib.h"
+#include "dlist.h"
+
+#define AVERAGE_FRAMES 60
+
+// Primitives of the layer are sorted behind the result text (drawn at z = 0),
+// tiles behind text.
+#define LAYER_Z        2
+#define LAYER_Y        96
+#define GRID_COLUMNS   8
+#define GRID_ROWS      4
+#define GRID_SIZE      40
+#define PANEL_COLUMNS  3
+#define PANEL_ROWS     2
+#define PANEL_W        96
+#define PANEL_H        60
+#define PANEL_BORDER   2
+#define PANEL_LINES    4
+#define NUM_PANELS     (PANEL_COLUMNS * PANEL_ROWS)
+
+// The text of the layer alone does not fit in the resident render buffers
+// along with the results, so the layer is emitted into an arena of its own.
+#define LIST_CAPACITY  16384
+#define ARENA_SIZE     24576
+
+enum layerMethod
+{
+	METHOD_REBUILD = 0,
+	METHOD_SPLICE,
+	NUM_METHODS
+};
+
+static const char *const methodNames[NUM_METHODS] = { "REBUILT", "SPLICED" };
+
+// The panel text is formatted once by FormatText(), so that only emitting the
+// layer is timed.
+static char panelText[NUM_PANELS][PANEL_LINES][16];
+
+static DList list;
+static uint8_t *arena = 0;
+static size_t listSize = 0;
+static Timer_Ticks buildTime = 0;
+
+static int method = METHOD_REBUILD;
+static int frames = 0;
+static Timer_Ticks total = 0;
+static Timer_Ticks sums[NUM_METHODS]; // Over AVERAGE_FRAMES, 0 if not measured yet
+static const char *error = 0;
+
+/* Layer */
+
+// The same code builds the layer either into the OT (dlist is NULL) or into
+// the display list.
+static void AddTile(RenderContext* ctx, DList *dlist, int x, int y, int w, int h, int r, int g, int b)
+{
+	TILE *tile = dlist ?
+		DList_AddPrim(dlist, sizeof(TILE)) : new_primitive(ctx, LAYER_Z + 1, sizeof(TILE));
+
+	if(!tile)
+		return;
+
+	setTile(tile);
+	setXY0 (tile, x, y);
+	setWH  (tile, w, h);
+	setRGB0(tile, r, g, b);
+}
+
+static void AddText(RenderContext* ctx, DList *dlist, int x, int y, const char *text)
+{
+	if(dlist)
+		DList_AddText(dlist, x, y, text);
+	else
+		draw_text(ctx, x, y, LAYER_Z, text);
+}
+
+static void FormatText(void)
+{
+	for(int i = 0; i < NUM_PANELS; i++)
+	{
+		for(int line = 0; line < PANEL_LINES; line++)
+			sprintf(panelText[i][line], "S%d.%d %03d", i + 1, line + 1, (i * 37 + line * 11) % 1000);
+	}
+}
+
+static void BuildLayer(RenderContext* ctx, DList *dlist)
+{
+	for(int row = 0; row < GRID_ROWS; row++)
+	{
+		for(int col = 0; col < GRID_COLUMNS; col++)
+		{
+			int shade = ((row + col) & 1) ? 24 : 40;
+
+			AddTile(ctx, dlist, col * GRID_SIZE, LAYER_Y + row * GRID_SIZE,
+				GRID_SIZE, GRID_SIZE, shade, shade, shade + 16);
+		}
+	}
+
+	for(int i = 0; i < NUM_PANELS; i++)
+	{
+		int x = 8 + (i % PANEL_COLUMNS) * (PANEL_W + 8);
+		int y = LAYER_Y + 8 + (i / PANEL_COLUMNS) * (PANEL_H + 8);
+
+		AddTile(ctx, dlist, x, y, PANEL_W, PANEL_BORDER, 160, 160, 32);
+		AddTile(ctx, dlist, x, y + PANEL_H - PANEL_BORDER, PANEL_W, PANEL_BORDER, 160, 160, 32);
+		AddTile(ctx, dlist, x, y, PANEL_BORDER, PANEL_H, 160, 160, 32);
+		AddTile(ctx, dlist, x + PANEL_W - PANEL_BORDER, y, PANEL_BORDER, PANEL_H, 160, 160, 32);
+
+		for(int line = 0; line < PANEL_LINES; line++)
+			AddText(ctx, dlist, x + 6, y + 8 + line * 12, panelText[i][line]);
+	}
+}
+
+/* Mode callbacks */
+
+static void InitDList(void)
+{
+	method = METHOD_REBUILD;
+	frames = 0;
+	total  = 0;
+	error  = 0;
+
+	for(int i = 0; i < NUM_METHODS; i++)
+		sums[i] = 0;
+
+	arena = malloc(ARENA_SIZE * 2);
+
+	if(!arena || !DList_Init(&list, LIST_CAPACITY))
+	{
+		free(arena);
+		arena = 0;
+		error = "OUT OF MEMORY";
+		return;
+	}
+
+	FormatText();
+
+	Timer_Ticks start = Timer_GetTicks();
+
+	DList_Begin(&list);
+	BuildLayer(0, &list);
+	listSize = DList_End(&list);
+
+	buildTime = Timer_GetTicks() - start;
+}
+
+static void EndDList(void)
+{
+	// The list may still be linked into the OT being drawn.
+	DrawSync(0);
+
+	if(arena)
+		DList_Destroy(&list);
+
+	free(arena);
+	arena = 0;
+}
+
+static void DrawLayer(RenderContext* ctx)
+{
+	ctx->next_packet = &arena[ctx->active_buffer * ARENA_SIZE];
+	ctx->packet_end  = ctx->next_packet + ARENA_SIZE;
+
+	Timer_Ticks start = Timer_GetTicks();
+
+	if(method == METHOD_SPLICE)
+		DList_Splice(&list, &(ctx->buffers[ctx->active_buffer].ot[LAYER_Z]), ctx->active_buffer);
+	else
+		BuildLayer(ctx, 0);
+
+	total += Timer_GetTicks() - start;
+
+	if(++frames >= AVERAGE_FRAMES)
+	{
+		sums[method] = total ? total : 1;
+		frames = 0;
+		total  = 0;
+	}
+}
+
+static void DrawDListMode(RenderContext* ctx)
+{
+	char buffer[128];
+	int xPos = 8;
+	int yPos = RESULT_START_Y;
+
+	if(error)
+	{
+		drawTextList(ctx, xPos, &yPos, 0, RESULT_DY, error);
+		return;
+	}
+
+	DrawLayer(ctx);
+
+	drawTextList(ctx, xPos, &yPos, 0, RESULT_DY * 2, "STATIC DISPLAY LIST");
+
+	sprintf(buffer, "LIST: %d BYTES, BUILT IN %d US", listSize,
+		Calib_TicksToStockUs(buildTime, CALIB_CPU));
+	drawTextList(ctx, xPos, &yPos, 0, RESULT_DY, buffer);
+
+	for(int i = 0; i < NUM_METHODS; i++)
+	{
+		// Splicing takes less than a timer tick, so work from the total.
+		if(sums[i])
+			sprintf(buffer, "%s: %5d US/FRAME (%d CYCLES)", methodNames[i],
+				Calib_TicksToStockUs(sums[i], CALIB_CPU) / AVERAGE_FRAMES,
+				Calib_TicksToStockCycles(sums[i], CALIB_CPU) / AVERAGE_FRAMES);
+		else
+			sprintf(buffer, "%s: -", methodNames[i]);
+
+		drawTextList(ctx, xPos, &yPos, 0, RESULT_DY, buffer);
+	}
+
+	yPos += RESULT_DY;
+
+	sprintf(buffer, "[SQUARE] LAYER: %s", methodNames[method]);
+	drawTextList(ctx, xPos, &yPos, 0, RESULT_DY, buffer);
+}
+
+static void HandleDListCommands(PADTYPE* pad)
+{
+	if((lastButtons & PAD_SQUARE) && !(pad->btn & PAD_SQUARE))
+	{
+		method = (method + 1) % NUM_METHODS;
+		frames = 0;
+		total  = 0;
+	}
+}
+
+const BenchMode bench_mode =
+{
+	.init            = &InitDList,
+	.end             = &EndDList,
+	.handle_commands = &HandleDListCommands,
+	.draw            = &DrawDListMode
+};
@@ -0,0 +1,310 @@
+/*
+ * ps1-benchmark GTE latency test (overlay)
+ *
+ * Measures how many CPU cycles each GTE command takes from being issued to
+ * its result being readable, by timing a loop issuing the command and
+ * immediately storing its result (which stalls the CPU until the command is
+ * done) against the same loop with only the store. The figures include the
+ * two NOPs the inline_c.h command macros insert before each command, and are
+ * shown next to the documented command timings.
+ *
+ * It then measures how much independent CPU work fits between issuing RTPS or
+ * RTPT and reading its result, as in the transform loops of
+ * DrawRotatedTexturedRectangle(): the loop is timed with an increasing number
+ * of NOPs between the command and the store, against the same NOPs and store
+ * with no command. The extra cycles are the part of the command's latency
+ * that was not hidden by the NOPs; once they stop decreasing, any further CPU
+ * work between the command and the read is no longer free.
+ */
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <psxgpu.h>
+#include <psxgte.h>
+#include <psxpad.h>
+#include <inline_c.h>
+
+#include "bench.h"
+#include "timer.h"
+#include "calib.h"
+
+#define LOOPS        64
+#define UNROLL       8
+#define NUM_RUNS     16
+
+#define REPEAT8(x) x x x x x x x x
+
+// Commands with arguments, as the test macros cannot take commas.
+#define MVMVA()  gte_mvmva(1, 0, 0, 0, 0)
+#define NOPS(n)  __asm__ volatile(".rept %0\nnop\n.endr\n" : : "i"(n))
+
+typedef struct
+{
+	const char *name;
+	void (*run)(void);
+	void (*base)(void);
+	int documented;
+} LatencyTest;
+
+// Destinations for the results
+static uint32_t sinkXY, sinkZ, sinkRGB;
+static VECTOR sinkVector;
+static SVECTOR sinkShort;
+
+/* Tests */
+
+// Defines a function issuing the command and storing a result UNROLL times
+// per loop, and one only storing the result.
+#define LATENCY_TEST(name, cmd, read) \
+	static void name(void) \
+	{ \
+		for(int i = 0; i < LOOPS; i++) \
+		{ \
+			REPEAT8(cmd; read;) \
+		} \
+	} \
+	static void name##Base(void) \
+	{ \
+		for(int i = 0; i < LOOPS; i++) \
+		{ \
+			REPEAT8(read;) \
+		} \
+	}
+
+LATENCY_TEST(Rtps,  gte_rtps(),  gte_stsxy(&sinkXY))
+LATENCY_TEST(Rtpt,  gte_rtpt(),  gte_stsxy2(&sinkXY))
+LATENCY_TEST(Nclip, gte_nclip(), gte_stopz(&sinkZ))
+LATENCY_TEST(Avsz3, gte_avsz3(), gte_stotz(&sinkZ))
+LATENCY_TEST(Avsz4, gte_avsz4(), gte_stotz(&sinkZ))
+LATENCY_TEST(Ncs,   gte_ncs(),   gte_strgb(&sinkRGB))
+LATENCY_TEST(Nct,   gte_nct(),   gte_strgb(&sinkRGB))
+LATENCY_TEST(Mvmva, MVMVA(),     gte_stlvnl(&sinkVector))
+LATENCY_TEST(Sqr,   gte_sqr12(), gte_stlvnl(&sinkVector))
+LATENCY_TEST(Dpcs,  gte_dpcs(),  gte_strgb(&sinkRGB))
+LATENCY_TEST(Intpl, gte_intpl(), gte_stsv(&sinkShort))
+
+// Documented timings in cycles, see
+// https://problemkaputt.de/psx-spx.htm#gteoverview
+static const LatencyTest latencyTests[] =
+{
+	{ "RTPS",  &Rtps,  &RtpsBase,  15 },
+	{ "RTPT",  &Rtpt,  &RtptBase,  23 },
+	{ "NCLIP", &Nclip, &NclipBase, 8 },
+	{ "AVSZ3", &Avsz3, &Avsz3Base, 5 },
+	{ "AVSZ4", &Avsz4, &Avsz4Base, 6 },
+	{ "NCS",   &Ncs,   &NcsBase,   14 },
+	{ "NCT",   &Nct,   &NctBase,   30 },
+	{ "MVMVA", &Mvmva, &MvmvaBase, 8 },
+	{ "SQR",   &Sqr,   &SqrBase,   5 },
+	{ "DPCS",  &Dpcs,  &DpcsBase,  8 },
+	{ "INTPL", &Intpl, &IntplBase, 8 }
+};
+
+#define NUM_TESTS (sizeof(latencyTests) / sizeof(LatencyTest))
+
+// Defines functions issuing RTPS or RTPT, then running n NOPs before storing
+// the result, and one running only the NOPs and the store.
+#define OVERLAP_TEST(n) \
+	static void RtpsOverlap##n(void) \
+	{ \
+		for(int i = 0; i < LOOPS; i++) \
+		{ \
+			REPEAT8(gte_rtps(); NOPS(n); gte_stsxy(&sinkXY);) \
+		} \
+	} \
+	static void RtptOverlap##n(void) \
+	{ \
+		for(int i = 0; i < LOOPS; i++) \
+		{ \
+			REPEAT8(gte_rtpt(); NOPS(n); gte_stsxy2(&sinkXY);) \
+		} \
+	} \
+	static void BaseOverlap##n(void) \
+	{ \
+		for(int i = 0; i < LOOPS; i++) \
+		{ \
+			REPEAT8(NOPS(n); gte_stsxy(&sinkXY);) \
+		} \
+	}
+
+OVERLAP_TEST(0)
+OVERLAP_TEST(4)
+OVERLAP_TEST(8)
+OVERLAP_TEST(12)
+OVERLAP_TEST(16)
+OVERLAP_TEST(20)
+OVERLAP_TEST(24)
+OVERLAP_TEST(28)
+
+#define NUM_OVERLAPS 8
+#define OVERLAP_STEP 4
+
+static void (*const overlapTests[NUM_OVERLAPS][3])(void) =
+{
+	{ &RtpsOverlap0,  &RtptOverlap0,  &BaseOverlap0 },
+	{ &RtpsOverlap4,  &RtptOverlap4,  &BaseOverlap4 },
+	{ &RtpsOverlap8,  &RtptOverlap8,  &BaseOverlap8 },
+	{ &RtpsOverlap12, &RtptOverlap12, &BaseOverlap12 },
+	{ &RtpsOverlap16, &RtptOverlap16, &BaseOverlap16 },
+	{ &RtpsOverlap20, &RtptOverlap20, &BaseOverlap20 },
+	{ &RtpsOverlap24, &RtptOverlap24, &BaseOverlap24 },
+	{ &RtpsOverlap28, &RtptOverlap28, &BaseOverlap28 }
+};
+
+// Latencies in tenths of a cycle
+static int latencies[NUM_TESTS];
+static int overlaps[NUM_OVERLAPS][2];
+
+static BenchRun run;
+
+/* Measurement */
+
+static Timer_Ticks TimeRun(void (*func)(void))
+{
+	Timer_Ticks best = 0xffffffff;
+
+	// The first run also loads the code into the I-cache.
+	for(int i = 0; i <= NUM_RUNS; i++)
+	{
+		Timer_Ticks start = Timer_GetTicks();
+		func();
+		Timer_Ticks time = Timer_GetTicks() - start;
+
+		if(i && (time < best))
+			best = time;
+	}
+
+	return best;
+}
+
+// Returns the difference in tenths of a cycle per command.
+static int CompareRuns(void (*func)(void), void (*base)(void))
+{
+	int cycles = (int) Calib_TicksToStockCycles(TimeRun(func), CALIB_CPU) -
+		(int) Calib_TicksToStockCycles(TimeRun(base), CALIB_CPU);
+
+	if(cycles < 0)
+		cycles = 0;
+
+	return (cycles * 10) / (LOOPS * UNROLL);
+}
+
+static void SetupGTE(void)
+{
+	MATRIX identity = { 0 };
+	SVECTOR v[3] = { { 16, 0, 0 }, { 0, 16, 0 }, { 0, 0, 16 } };
+	CVECTOR color = { 128, 128, 128, 0 };
+
+	identity.m[0][0] = ONE;
+	identity.m[1][1] = ONE;
+	identity.m[2][2] = ONE;
+	identity.t[2]    = 256;
+
+	// Command timings do not depend on the values, but keep them sensible so
+	// no flags are raised.
+	gte_SetRotMatrix(&identity);
+	gte_SetTransMatrix(&identity);
+	gte_SetLightMatrix(&identity);
+	gte_SetColorMatrix(&identity);
+	gte_SetBackColor(0, 0, 0);
+
+	gte_ldv3(&v[0], &v[1], &v[2]);
+	gte_rtpt();
+	gte_ldrgb(&color);
+	gte_lddp(ONE / 2);
+}
+
+static void RunBenchmark(void)
+{
+	SetupGTE();
+
+	for(int test = 0; test < NUM_TESTS; test++)
+		latencies[test] = CompareRuns(latencyTests[test].run, latencyTests[test].base);
+
+	for(int i = 0; i < NUM_OVERLAPS; i++)
+	{
+		overlaps[i][0] = CompareRuns(overlapTests[i][0], overlapTests[i][2]);
+		overlaps[i][1] = CompareRuns(overlapTests[i][1], overlapTests[i][2]);
+	}
+}
+
+/* Display */
+
+static void DrawResults(RenderContext* ctx, int xPos, int *yPos)
+{
+	char buffer[128];
+	int half = (NUM_TESTS + 1) / 2;
+
+	drawTextList(ctx, xPos, yPos, 0, RESULT_DY, "CMD   CYCLES DOC  CMD   CYCLES DOC");
+
+	// Two columns of commands
+	for(int row = 0; row < half; row++)
+	{
+		const LatencyTest *left = &latencyTests[row];
+		int length = sprintf(buffer, "%-5s %4d.%d %3d", left->name,
+			latencies[row] / 10, latencies[row] % 10, left->documented);
+
+		if((row + half) < NUM_TESTS)
+		{
+			const LatencyTest *right = &latencyTests[row + half];
+
+			sprintf(&buffer[length], "  %-5s %4d.%d %3d", right->name,
+				latencies[row + half] / 10, latencies[row + half] % 10, right->documented);
+		}
+
+		drawTextList(ctx, xPos, yPos, 0, RESULT_DY, buffer);
+	}
+
+	*yPos += RESULT_DY;
+
+	drawTextList(ctx, xPos, yPos, 0, RESULT_DY, "STALL CYCLES AFTER N NOPS");
+	drawTextList(ctx, xPos, yPos, 0, RESULT_DY, "NOPS   RTPS   RTPT");
+
+	for(int i = 0; i < NUM_OVERLAPS; i++)
+	{
+		sprintf(buffer, "%4d %4d.%d %4d.%d", i * OVERLAP_STEP,
+			overlaps[i][0] / 10, overlaps[i][0] % 10,
+			overlaps[i][1] / 10, overlaps[i][1] % 10);
+		drawTextList(ctx, xPos, yPos, 0, RESULT_DY, buffer);
+	}
+
+	*yPos += RESULT_DY;
+}
+
+/* Mode callbacks */
+
+static void InitGteLatency(void)
+{
+	Bench_ResetRun(&run);
+}
+
+static void DrawGteLatency(RenderContext* ctx)
+{
+	int xPos = 8;
+	int yPos = RESULT_START_Y;
+
+	if(Bench_DrawPending(&run, ctx, xPos, &yPos))
+		return;
+	if(Bench_ShouldRun(&run))
+		RunBenchmark();
+
+	drawTextList(ctx, xPos, &yPos, 0, RESULT_DY * 2, "GTE COMMAND LATENCY");
+
+	if(run.state == BENCH_DONE)
+		DrawResults(ctx, xPos, &yPos);
+
+	drawTextList(ctx, xPos, &yPos, 0, RESULT_DY, "[X] MEASURE");
+}
+
+static void HandleGteLatencyCommands(PADTYPE* pad)
+{
+	Bench_RequestRun(&run, pad, PAD_CROSS);
+}
+
+const BenchMode bench_mode =
+{
+	.init            = &InitGteLatency,
+	.handle_commands = &HandleGteLatencyCommands,
+	.draw            = &DrawGteLatency
+};
@@ -0,0 +1,473 @@
+/*
+ * ps1-benchmark I-cache hot code placement test (overlay)
+ *
+ * Shows where the hot functions (the ones marked HOT_TEXT, see hottext.h)
+ * ended up in the executable and how much the stress test's inner loop slows
+ * down when its code has to be fetched from RAM rather than the I-cache. The
+ * loop (update_position() and the primitive emitters for each rectangle) is
+ * timed right after flushing the I-cache and again with the cache warm; the
+ * difference is the one-time cost of filling the cache.
+ *
+ * The cost of aliasing is measured separately, by calling two copies of a
+ * block of generated code in turn: once placed 4 KB apart, so they map to the
+ * same cache lines and evict each other on every call, and once 2 KB apart,
+ * so both stay cached.
+ *
+ * The profiler can also be run on the stress workload. The hot set is then
+ * taken from the profile, as the smallest set of sampled code blocks that
+ * accounts for HOT_SET_PERCENT of the samples outside the kernel; it is
+ * checked against the HOT_TEXT range and for blocks aliasing each other in the
+ * cache, which tells which functions should be marked HOT_TEXT. Build with
+ * and without BENCH_HOT_CODE to compare the two layouts. Each sample is
+ * attributed to the closest known resident function starting before it.
+ */
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <psxgpu.h>
+#include <psxpad.h>
+#include <psxapi.h>
+
+#include "bench.h"
+#include "timer.h"
+#include "calib.h"
+#include "hottext.h"
+#include "profile.h"
+
+#define NUM_RUNS        16
+#define PROFILE_FRAMES  300
+#define PROFILE_RATE    1000
+#define NUM_SYMBOLS     12
+#define TOP_BUCKETS     8
+
+// Samples further than this from the closest known function are shown as
+// unknown code.
+#define MAX_SYMBOL_SIZE 2048
+
+#define HOT_SET_PERCENT 90
+
+// The I-cache is 4 KB, direct mapped, with 16-byte lines.
+#define ICACHE_SIZE     4096
+#define ICACHE_LINE     16
+#define ICACHE_LINES    (ICACHE_SIZE / ICACHE_LINE)
+
+// Each generated block is 1 KB of code; the two copies are called in turn
+// ALIAS_CALLS times each.
+#define ALIAS_BLOCK_WORDS 256
+#define ALIAS_CALLS       64
+
+#define MIPS_ADDU_V0_A0   0x00801021 // addu  $v0, $a0, $zero
+#define MIPS_ADDIU_V0     0x24420001 // addiu $v0, $v0, 1
+#define MIPS_JR_RA        0x03e00008 // jr    $ra
+#define MIPS_NOP          0x00000000
+
+// Sampling the stress workload over several frames, see bench.h for the others
+enum hotCodeState
+{
+	BENCH_PROFILING = BENCH_NUM_STATES
+};
+
+typedef struct
+{
+	const char *name;
+	uint32_t   address;
+} Symbol;
+
+static Symbol symbols[NUM_SYMBOLS];
+
+typedef int (*BlockFunc)(int value);
+
+static Timer_Ticks coldTime, warmTime;
+static Timer_Ticks aliasedTime, separateTime;
+static Profile_Data *profile = 0;
+static bool profiled = false;
+static bool measured = false;
+static int profileFrames = 0;
+
+// Hot set taken from the last profile
+static int hotBlocks = 0, groupedBlocks = 0, aliasedLines = 0;
+
+static BenchRun run;
+static const char *error = 0;
+
+// Stress test workload
+static BenchWorkload workload;
+
+/* Symbol lookup */
+
+static void AddSymbol(int index, const char *name, void *address)
+{
+	symbols[index].name    = name;
+	symbols[index].address = (uint32_t) address;
+}
+
+// The addresses are only known once the overlay has been linked, so the table
+// is filled in at runtime.
+static void InitSymbols(void)
+{
+	AddSymbol(0,  "update_position", &update_position);
+	AddSymbol(1,  "draw_rectangle", &draw_rectangle);
+	AddSymbol(2,  "DrawSimpleRect", &DrawSimpleRectangle);
+	AddSymbol(3,  "DrawTexturedRect", &DrawTexturedRectangle);
+	AddSymbol(4,  "DrawRotatedRect", &DrawRotatedTexturedRectangle);
+	AddSymbol(5,  "new_primitive", &new_primitive);
+	AddSymbol(6,  "flip_buffers", &flip_buffers);
+	AddSymbol(7,  "draw_text", &draw_text);
+	AddSymbol(8,  "drawTextList", &drawTextList);
+	AddSymbol(9,  "feed_stream", &feed_stream);
+	AddSymbol(10, "Timer_GetTicks", &Timer_GetTicks);
+	AddSymbol(11, "HandleTexture", &HandleTextureCommand);
+}
+
+static const Symbol *FindSymbol(uint32_t address)
+{
+	const Symbol *closest = 0;
+
+	for(int i = 0; i < NUM_SYMBOLS; i++)
+	{
+		if((symbols[i].address > address) || ((address - symbols[i].address) >= MAX_SYMBOL_SIZE))
+			continue;
+		if(!closest || (symbols[i].address > closest->address))
+			closest = &symbols[i];
+	}
+
+	return closest;
+}
+
+/* Miss penalty measurement */
+
+static Timer_Ticks TimeWorkload(RenderContext* ctx)
+{
+	// Primitives are written to a scratch context which is never drawn.
+	ctx->next_packet = ctx->buffers[0].buffer;
+	ctx->packet_end  = &(ctx->buffers[0].buffer[ctx->buffer_length]);
+
+	Timer_Ticks start = Timer_GetTicks();
+	Bench_DrawWorkload(ctx, &workload);
+	return Timer_GetTicks() - start;
+}
+
+/* Aliasing measurement */
+
+static void GenerateBlock(uint32_t *code)
+{
+	code[0] = MIPS_ADDU_V0_A0;
+
+	for(int i = 1; i < (ALIAS_BLOCK_WORDS - 2); i++)
+		code[i] = MIPS_ADDIU_V0;
+
+	code[ALIAS_BLOCK_WORDS - 2] = MIPS_JR_RA;
+	code[ALIAS_BLOCK_WORDS - 1] = MIPS_NOP;
+}
+
+// Calls two copies of the block in turn, the second one the given number of
+// bytes after the first.
+static Timer_Ticks TimeBlocks(uint32_t *code, int distance)
+{
+	BlockFunc first  = (BlockFunc) code;
+	BlockFunc second = (BlockFunc) &code[distance / 4];
+	int value = 0;
+
+	GenerateBlock(code);
+	GenerateBlock(&code[distance / 4]);
+	FlushCache();
+
+	// Warm up, so only conflicts are measured rather than the first fill.
+	value = second(first(value));
+
+	Timer_Ticks start = Timer_GetTicks();
+
+	for(int i = 0; i < ALIAS_CALLS; i++)
+		value = second(first(value));
+
+	Timer_Ticks time = Timer_GetTicks() - start;
+
+	// Keep the calls from being optimized out.
+	if(value < 0)
+		error = "BAD BLOCK RESULT";
+
+	return time;
+}
+
+static bool MeasureAliasing(void)
+{
+	uint32_t *code = malloc(ICACHE_SIZE + ALIAS_BLOCK_WORDS * 4);
+
+	if(!code)
+		return false;
+
+	aliasedTime  = TimeBlocks(code, ICACHE_SIZE);
+	separateTime = TimeBlocks(code, ICACHE_SIZE / 2);
+
+	free(code);
+	FlushCache();
+	return true;
+}
+
+/* Hot set */
+
+// Takes the most sampled blocks until they add up to HOT_SET_PERCENT of the
+// samples outside the kernel (the buckets are sorted by count), then counts
+// how many of them are in the hot section and how many of their cache lines
+// are shared with another block of the set.
+static void FindHotSet(void)
+{
+	static uint8_t lineUse[ICACHE_LINES];
+
+	uint32_t start, end;
+	bool grouped = Profile_GetHotRange(&start, &end);
+	uint32_t target = (profile->total - profile->kernel) * HOT_SET_PERCENT / 100;
+	uint32_t covered = 0;
+
+	hotBlocks = 0;
+	groupedBlocks = 0;
+	aliasedLines = 0;
+	__builtin_memset(lineUse, 0, sizeof(lineUse));
+
+	for(int i = 0; (i < profile->num_buckets) && (covered < target); i++)
+	{
+		const Profile_Bucket *bucket = &profile->buckets[i];
+
+		covered += bucket->count;
+		hotBlocks++;
+
+		if(grouped && (bucket->address >= start) && (bucket->address < end))
+			groupedBlocks++;
+
+		for(int j = 0; j < (1 << PROFILE_BUCKET_SHIFT); j += ICACHE_LINE)
+			lineUse[((bucket->address + j) / ICACHE_LINE) % ICACHE_LINES]++;
+	}
+
+	for(int i = 0; i < ICACHE_LINES; i++)
+	{
+		if(lineUse[i] > 1)
+			aliasedLines += lineUse[i];
+	}
+}
+
+/* Benchmark */
+
+static void RunBenchmark(void)
+{
+	// The scratch context's packet buffer is allocated along with it.
+	RenderContext *scratch = malloc(sizeof(RenderContext) + BUFFER_LENGTH);
+
+	if(!scratch || !MeasureAliasing())
+	{
+		free(scratch);
+		error = "OUT OF MEMORY";
+		return;
+	}
+
+	scratch->buffers[0].buffer = (uint8_t *) &scratch[1];
+	scratch->buffer_length     = BUFFER_LENGTH;
+	scratch->active_buffer     = 0;
+	coldTime = 0;
+	warmTime = 0;
+
+	for(int i = 0; i < NUM_RUNS; i++)
+	{
+		FlushCache();
+
+		coldTime += TimeWorkload(scratch);
+		warmTime += TimeWorkload(scratch);
+	}
+
+	free(scratch);
+	measured = true;
+}
+
+/* Mode callbacks */
+
+static void InitHotCode(void)
+{
+	Bench_ResetRun(&run);
+	error = 0;
+
+	InitSymbols();
+	Bench_InitWorkload(&workload);
+}
+
+static void StopProfiling(void)
+{
+	if(run.state != BENCH_PROFILING)
+		return;
+
+	Profile_Stop(false);
+	Bench_ResetRun(&run);
+}
+
+static void EndHotCode(void)
+{
+	StopProfiling();
+
+	free(profile);
+	profile  = 0;
+	profiled = false;
+}
+
+static void DrawLayout(RenderContext* ctx, int xPos, int *yPos)
+{
+	char buffer[128];
+	uint32_t start, end;
+
+	if(Profile_GetHotRange(&start, &end))
+		sprintf(buffer, "HOT CODE: %d BYTES AT %08X", end - start, start);
+	else
+		sprintf(buffer, "HOT CODE: NOT GROUPED (OPTION OFF)");
+
+	drawTextList(ctx, xPos, yPos, 0, RESULT_DY * 2, buffer);
+}
+
+static void DrawResults(RenderContext* ctx, int xPos, int *yPos)
+{
+	char buffer[128];
+
+	if(measured)
+	{
+		uint32_t coldUs = Calib_TicksToStockUs(coldTime / NUM_RUNS, CALIB_CPU);
+		uint32_t warmUs = Calib_TicksToStockUs(warmTime / NUM_RUNS, CALIB_CPU);
+
+		sprintf(buffer, "%d RECTANGLES, I-CACHE COLD %d US", NUM_RECTANGLES, coldUs);
+		drawTextList(ctx, xPos, yPos, 0, RESULT_DY, buffer);
+
+		sprintf(buffer, "I-CACHE WARM %d US, %d CYCLES/RECT", warmUs,
+			Calib_TicksToStockCycles(warmTime / NUM_RUNS, CALIB_CPU) / NUM_RECTANGLES);
+		drawTextList(ctx, xPos, yPos, 0, RESULT_DY, buffer);
+
+		sprintf(buffer, "FILL PENALTY %d US (+%d%%)", coldUs - warmUs,
+			warmUs ? ((coldUs - warmUs) * 100 / warmUs) : 0);
+		drawTextList(ctx, xPos, yPos, 0, RESULT_DY, buffer);
+
+		// Each call runs through the whole block, one cache line at a time.
+		int lines = (ALIAS_BLOCK_WORDS * 4 / ICACHE_LINE) * ALIAS_CALLS * 2;
+		int aliased  = Calib_TicksToStockCycles(aliasedTime, CALIB_CPU);
+		int separate = Calib_TicksToStockCycles(separateTime, CALIB_CPU);
+
+		sprintf(buffer, "ALIASED %d US, APART %d US, %d CYC/LINE",
+			Calib_TicksToStockUs(aliasedTime, CALIB_CPU),
+			Calib_TicksToStockUs(separateTime, CALIB_CPU), (aliased - separate) / lines);
+		drawTextList(ctx, xPos, yPos, 0, RESULT_DY * 2, buffer);
+	}
+
+	if(profiled)
+	{
+		uint32_t start, end, hot = 0;
+		bool grouped = Profile_GetHotRange(&start, &end);
+		uint32_t total = profile->total ? profile->total : 1;
+
+		for(int i = 0; i < profile->num_buckets; i++)
+		{
+			if(grouped && (profile->buckets[i].address >= start) && (profile->buckets[i].address < end))
+				hot += profile->buckets[i].count;
+		}
+
+		sprintf(buffer, "%d SAMPLES, KERNEL %d%%, HOT CODE %d%%", profile->total,
+			profile->kernel * 100 / total, hot * 100 / total);
+		drawTextList(ctx, xPos, yPos, 0, RESULT_DY, buffer);
+
+		sprintf(buffer, "HOT SET (%d%%): %d BYTES, %d/%d IN HOT CODE", HOT_SET_PERCENT,
+			hotBlocks << PROFILE_BUCKET_SHIFT, groupedBlocks, hotBlocks);
+		drawTextList(ctx, xPos, yPos, 0, RESULT_DY, buffer);
+
+		sprintf(buffer, "HOT SET ALIASED CACHE LINES: %d", aliasedLines);
+		drawTextList(ctx, xPos, yPos, 0, RESULT_DY, buffer);
+
+		for(int i = 0; (i < TOP_BUCKETS) && (i < profile->num_buckets); i++)
+		{
+			const Profile_Bucket *bucket = &profile->buckets[i];
+			const Symbol *symbol = FindSymbol(bucket->address);
+
+			if(symbol)
+				sprintf(buffer, "%08X %-.16s+%03X %2d%%", bucket->address, symbol->name,
+					bucket->address - symbol->address, bucket->count * 100 / total);
+			else
+				sprintf(buffer, "%08X ? %2d%%", bucket->address, bucket->count * 100 / total);
+
+			drawTextList(ctx, xPos, yPos, 0, RESULT_DY, buffer);
+		}
+
+		*yPos += RESULT_DY;
+	}
+}
+
+static void DrawHotCode(RenderContext* ctx)
+{
+	char buffer[128];
+	int xPos = 8;
+	int yPos = RESULT_START_Y;
+
+	if(run.state == BENCH_PROFILING)
+	{
+		sprintf(buffer, "PROFILING %d/%d", profileFrames, PROFILE_FRAMES);
+		drawTextList(ctx, xPos, &yPos, 0, RESULT_DY, buffer);
+
+		Bench_DrawWorkload(ctx, &workload);
+
+		if(++profileFrames >= PROFILE_FRAMES)
+		{
+			Profile_Stop(false);
+			FindHotSet();
+			profiled = true;
+			run.state = BENCH_DONE;
+		}
+		return;
+	}
+
+	if(Bench_DrawPending(&run, ctx, xPos, &yPos))
+		return;
+	if(Bench_ShouldRun(&run))
+		RunBenchmark();
+
+	if(error)
+	{
+		drawTextList(ctx, xPos, &yPos, 0, RESULT_DY, error);
+		return;
+	}
+
+	drawTextList(ctx, xPos, &yPos, 0, RESULT_DY * 2, "I-CACHE HOT CODE PLACEMENT");
+	DrawLayout(ctx, xPos, &yPos);
+	DrawResults(ctx, xPos, &yPos);
+
+	drawTextList(ctx, xPos, &yPos, 0, RESULT_DY, "[X]      MEASURE MISS PENALTIES");
+	drawTextList(ctx, xPos, &yPos, 0, RESULT_DY, "[SQUARE] PROFILE STRESS WORKLOAD");
+}
+
+static void HandleHotCodeCommands(PADTYPE* pad)
+{
+	if((run.state == BENCH_PENDING) || (run.state == BENCH_RUNNING) || (run.state == BENCH_PROFILING))
+	{
+		HandleTextureCommand(pad);
+		return;
+	}
+
+	Bench_RequestRun(&run, pad, PAD_CROSS);
+
+	if((lastButtons & PAD_SQUARE) && !(pad->btn & PAD_SQUARE))
+	{
+		if(!profile)
+			profile = malloc(sizeof(Profile_Data));
+
+		if(!profile)
+		{
+			error = "OUT OF MEMORY";
+			return;
+		}
+
+		profiled = false;
+		profileFrames = 0;
+		run.state = BENCH_PROFILING;
+
+		Profile_Start(profile, PROFILE_RATE);
+	}
+}
+
+const BenchMode bench_mode =
+{
+	.init            = &InitHotCode,
+	.end             = &EndHotCode,
+	.pause           = &StopProfiling,
+	.handle_commands = &HandleHotCodeCommands,
+	.draw            = &DrawHotCode
+};
@@ -0,0 +1,315 @@
+/*
+ * ps1-benchmark compressed asset loading benchmark (overlay)
+ *
+ * Compares the effective throughput (uncompressed bytes delivered per second)
+ * of loading assets from the CD in three ways, at both 1x and 2x speed:
+ *
+ * - RAW:    reading the uncompressed file;
+ * - SEQ:    reading the LZ4 compressed file, then decompressing it;
+ * - STREAM: decompressing each block of the LZ4 file as soon as it has been
+ *           read, while the drive keeps reading the following sectors.
+ *
+ * The decompressor's throughput from RAM is reported as well. Each decompressed
+ * file is checked against the raw one.
+ */
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <psxgpu.h>
+#include <psxpad.h>
+#include <psxcd.h>
+
+#include "bench.h"
+#include "timer.h"
+#include "lz4.h"
+#include "calib.h"
+
+#define SECTOR_SIZE 2048
+#define NUM_SPEEDS  2
+#define NUM_ASSETS  4
+
+typedef struct
+{
+	const char *name;
+	const char *raw_path, *packed_path;
+} Asset;
+
+typedef struct
+{
+	size_t      raw_size, packed_size;
+	Timer_Ticks raw_time[NUM_SPEEDS], seq_time[NUM_SPEEDS], stream_time[NUM_SPEEDS];
+	Timer_Ticks decode_time;
+	bool        valid;
+} AssetResult;
+
+static const Asset assets[NUM_ASSETS] =
+{
+	{ "TIM",     "\\PACKED\\TILESC.TIM;1", "\\PACKED\\TILESC.LZ4;1"   },
+	{ "VAG",     "\\PACKED\\BANK.VAG;1",   "\\PACKED\\BANK.LZ4;1"     },
+	{ "OVERLAY", "\\MODES\\STRESS.DLL;1",  "\\PACKED\\STRESS.LZ4;1"   },
+	{ "MAP",     "\\BENCH.MAP;1",          "\\PACKED\\BENCHMAP.LZ4;1" }
+};
+
+static const int speedModes[NUM_SPEEDS] = { 0, CdlModeSpeed };
+
+static AssetResult results[NUM_ASSETS];
+static BenchRun run;
+static const char *error = 0;
+
+/* Measurement helpers */
+
+static uint32_t Checksum(const uint8_t *data, size_t size)
+{
+	uint32_t sum = 0;
+
+	for(size_t i = 0; i < size; i++)
+		sum = (sum << 1 | sum >> 31) + data[i];
+
+	return sum;
+}
+
+// Reads the first sector of the file at the given speed without timing it, so
+// that spinning the drive up or down is not counted towards the measurement.
+static void WarmUp(const CdlFILE *file, uint8_t *buffer, int mode)
+{
+	CdControl(CdlSetloc, &file->pos, 0);
+	CdRead(1, (uint32_t *) buffer, mode);
+	CdReadSync(0, 0);
+}
+
+static Timer_Ticks TimedRead(const CdlFILE *file, uint8_t *buffer, int mode)
+{
+	WarmUp(file, buffer, mode);
+
+	Timer_Ticks start = Timer_GetTicks();
+
+	CdControl(CdlSetloc, &file->pos, 0);
+	CdRead(Bench_SectorCount(file->size), (uint32_t *) buffer, mode);
+
+	if(CdReadSync(0, 0) < 0)
+		error = "CD READ ERROR";
+
+	return Timer_GetTicks() - start;
+}
+
+static Timer_Ticks TimedStreamedRead(const CdlFILE *file, uint8_t *buffer, uint8_t *output, int mode)
+{
+	WarmUp(file, buffer, mode);
+
+	Timer_Ticks start   = Timer_GetTicks();
+	int         sectors = Bench_SectorCount(file->size);
+
+	CdControl(CdlSetloc, &file->pos, 0);
+	CdRead(sectors, (uint32_t *) buffer, mode);
+
+	// Decompress every block as soon as it is complete. The header and block
+	// index must be in memory before the context can be set up.
+	LZ4_Context lz;
+	bool        started = false;
+
+	for(;;)
+	{
+		int remaining = CdReadSync(1, 0);
+
+		if(remaining < 0)
+		{
+			error = "CD READ ERROR";
+			break;
+		}
+
+		size_t available = remaining ? ((sectors - remaining) * SECTOR_SIZE) : file->size;
+
+		if(!started)
+		{
+			const LZ4_Header *header = (const LZ4_Header *) buffer;
+
+			if(available < sizeof(LZ4_Header))
+				continue;
+			if(available < (sizeof(LZ4_Header) + header->num_blocks * sizeof(uint32_t)))
+				continue;
+
+			LZ4_Init(&lz, buffer, output);
+			started = true;
+		}
+
+		if(LZ4_DecompressAvailable(&lz, available))
+			break;
+	}
+
+	CdReadSync(0, 0);
+
+	return Timer_GetTicks() - start;
+}
+
+static void RunAsset(int index, uint8_t *raw_buffer, uint8_t *packed_buffer)
+{
+	const Asset *asset  = &assets[index];
+	AssetResult *result = &results[index];
+	CdlFILE     raw_file, packed_file;
+
+	if(!CdSearchFile(&raw_file, asset->raw_path) || !CdSearchFile(&packed_file, asset->packed_path))
+	{
+		error = "ASSET NOT FOUND";
+		return;
+	}
+
+	result->raw_size    = raw_file.size;
+	result->packed_size = packed_file.size;
+
+	uint32_t checksum = 0;
+	result->valid = true;
+
+	for(int speed = 0; speed < NUM_SPEEDS; speed++)
+	{
+		int mode = speedModes[speed];
+
+		result->raw_time[speed] = TimedRead(&raw_file, raw_buffer, mode);
+		checksum = Checksum(raw_buffer, raw_file.size);
+
+		// Sequential: read the whole compressed file, then decompress it.
+		Timer_Ticks read_time = TimedRead(&packed_file, packed_buffer, mode);
+		Timer_Ticks start     = Timer_GetTicks();
+
+		LZ4_Decompress(packed_buffer, raw_buffer);
+
+		result->decode_time     = Timer_GetTicks() - start;
+		result->seq_time[speed] = read_time + result->decode_time;
+
+		if(Checksum(raw_buffer, raw_file.size) != checksum)
+			result->valid = false;
+
+		result->stream_time[speed] = TimedStreamedRead(&packed_file, packed_buffer, raw_buffer, mode);
+
+		if(Checksum(raw_buffer, raw_file.size) != checksum)
+			result->valid = false;
+	}
+}
+
+static void RunBenchmark(void)
+{
+	size_t raw_max = 0, packed_max = 0;
+	int i;
+
+	error = 0;
+
+	// Other modes (and the audio streams) install their own read callbacks.
+	CdReadCallback(0);
+
+	for(i = 0; i < NUM_ASSETS; i++)
+	{
+		CdlFILE file;
+
+		if(CdSearchFile(&file, assets[i].raw_path) && (file.size > raw_max))
+			raw_max = file.size;
+		if(CdSearchFile(&file, assets[i].packed_path) && (file.size > packed_max))
+			packed_max = file.size;
+	}
+
+	uint8_t *raw_buffer    = malloc(Bench_SectorCount(raw_max) * SECTOR_SIZE);
+	uint8_t *packed_buffer = malloc(Bench_SectorCount(packed_max) * SECTOR_SIZE);
+
+	if(!raw_buffer || !packed_buffer)
+	{
+		error = "OUT OF MEMORY";
+	}
+	else
+	{
+		for(i = 0; (i < NUM_ASSETS) && !error; i++)
+			RunAsset(i, raw_buffer, packed_buffer);
+	}
+
+	free(raw_buffer);
+	free(packed_buffer);
+
+	// Leave the drive at double speed, which everything else uses.
+	uint8_t mode = CdlModeSpeed;
+	CdControlB(CdlSetmode, &mode, 0);
+}
+
+/* Mode callbacks */
+
+static int KBPerSecond(size_t size, Timer_Ticks ticks)
+{
+	uint32_t us = Timer_TicksToUs(ticks);
+
+	if(!us)
+		return 0;
+
+	// 1000000 / 1024 ~= 977, which avoids pulling in 64-bit division (not
+	// available to overlays unless the executable happens to use it).
+	return (int) ((size * 977) / us);
+}
+
+static void InitLZBench(void)
+{
+	Bench_ResetRun(&run);
+	error = 0;
+}
+
+static void DrawLZBench(RenderContext* ctx)
+{
+	char buffer[128];
+	int xPos = 8;
+	int yPos = RESULT_START_Y;
+	int i;
+
+	if(run.state == BENCH_IDLE)
+	{
+		drawTextList(ctx, xPos, &yPos, 0, RESULT_DY * 2, "COMPRESSED ASSET LOADING");
+		drawTextList(ctx, xPos, &yPos, 0, RESULT_DY, "[X] RUN (TAKES A FEW SECONDS)");
+		return;
+	}
+
+	if(Bench_DrawPending(&run, ctx, xPos, &yPos))
+		return;
+	if(Bench_ShouldRun(&run))
+		RunBenchmark();
+
+	if(error)
+	{
+		drawTextList(ctx, xPos, &yPos, 0, RESULT_DY, error);
+		return;
+	}
+
+	drawTextList(ctx, xPos, &yPos, 0, RESULT_DY * 2, "EFFECTIVE THROUGHPUT (KB/S)");
+
+	for(i = 0; i < NUM_ASSETS; i++)
+	{
+		const AssetResult *result = &results[i];
+
+		sprintf(buffer, "%s %d->%d KB %d%% %s", assets[i].name,
+			result->raw_size / 1024, result->packed_size / 1024,
+			result->raw_size ? (result->packed_size * 100 / result->raw_size) : 0,
+			result->valid ? "OK" : "BAD");
+		drawTextList(ctx, xPos, &yPos, 0, RESULT_DY, buffer);
+
+		for(int speed = 0; speed < NUM_SPEEDS; speed++)
+		{
+			sprintf(buffer, " %dX RAW %4d SEQ %4d STREAM %4d", speed + 1,
+				KBPerSecond(result->raw_size, result->raw_time[speed]),
+				KBPerSecond(result->raw_size, result->seq_time[speed]),
+				KBPerSecond(result->raw_size, result->stream_time[speed]));
+			drawTextList(ctx, xPos, &yPos, 0, RESULT_DY, buffer);
+		}
+
+		sprintf(buffer, " DECOMPRESS FROM RAM %d KB/S (STOCK %d)",
+			KBPerSecond(result->raw_size, result->decode_time),
+			KBPerSecond(result->raw_size, Calib_ToStock(result->decode_time, CALIB_CPU)));
+		drawTextList(ctx, xPos, &yPos, 0, RESULT_DY + 4, buffer);
+	}
+
+	drawTextList(ctx, xPos, &yPos, 0, RESULT_DY, "[X] RUN AGAIN");
+}
+
+static void HandleLZBenchCommands(PADTYPE* pad)
+{
+	Bench_RequestRun(&run, pad, PAD_CROSS);
+}
+
+const BenchMode bench_mode =
+{
+	.init            = &InitLZBench,
+	.handle_commands = &HandleLZBenchCommands,
+	.draw            = &DrawLZBench
+};
@@ -0,0 +1,760 @@
+/*
+ * ps1-benchmark memory card benchmark (overlay)
+ *
+ * Measures how long it takes to read and write memory card sectors through:
+ *
+ * - BIOS: the BIOS card functions (_card_read() and _card_write()), which
+ *         transfer one byte per SIO interrupt in the background and signal
+ *         completion through SwCARD events;
+ * - SIO:  the polled driver in card.c, which talks to the port directly and
+ *         blocks until each sector has been transferred.
+ *
+ * Each method reads the sectors of the last block on the card one at a time;
+ * the throughput and the average and worst latency per sector are reported.
+ *
+ * Writing is a separate test which has to be confirmed, as it writes to
+ * whatever card is inserted. Each method then also writes the block, and the
+ * frame time impact is measured by running the stress test's workload for a
+ * few seconds with no card access, then while writing one sector in the
+ * background through the BIOS and finally while writing one sector per frame
+ * through the SIO driver. Frames are counted as dropped if they take more
+ * than 1.5 times as long as the average frame with no card access.
+ *
+ * The BIOS card driver is only running while this mode is loaded, so it does
+ * not add its IRQ overhead to other modes. During the frame time test it is
+ * further only enabled while writing through the BIOS, so that the other two
+ * runs are not slowed down by it.
+ *
+ * The block is read first and only written back with the very same data, so
+ * any save it belongs to is left intact. Nothing is written if reading it
+ * fails. Once writing is over (or has failed) the block is read back and, if
+ * it differs from the backup, written again until it matches or
+ * RESTORE_ATTEMPTS is reached; the block's state is reported either way.
+ */
+
+#include <stdint.h>
+#include <stdio.h>
+#include <psxgpu.h>
+#include <psxpad.h>
+#include <psxapi.h>
+
+#include "bench.h"
+#include "card.h"
+#include "timer.h"
+
+#define NUM_METHODS 2
+#define NUM_OPS     2
+#define NUM_LOADS   3
+
+#define TEST_SECTOR  (CARD_NUM_SECTORS - CARD_BLOCK_SECTORS)
+#define TEST_SECTORS CARD_BLOCK_SECTORS
+#define TEST_SIZE    (TEST_SECTORS * CARD_SECTOR_SIZE)
+
+// The SIO driver retries sectors the card did not respond to (which may happen
+// right after a write) this many times.
+#define MAX_ATTEMPTS 4
+
+// Rewrite the block this many times at most if it does not read back intact.
+#define RESTORE_ATTEMPTS 4
+
+// Give up waiting for a BIOS transfer after this long (in microseconds).
+#define BIOS_TIMEOUT_US 1000000
+
+#define LOAD_FRAMES 180
+
+// Waiting for the write test to be confirmed, and measuring frame times under
+// load over several frames, see bench.h for the others
+enum memCardState
+{
+	BENCH_CONFIRM = BENCH_NUM_STATES,
+	BENCH_LOAD
+};
+
+enum blockState
+{
+	BLOCK_NOT_WRITTEN = 0,
+	BLOCK_INTACT,
+	BLOCK_RESTORED,
+	BLOCK_DAMAGED
+};
+
+enum cardMethod
+{
+	METHOD_BIOS = 0,
+	METHOD_SIO
+};
+
+enum cardLoad
+{
+	LOAD_NONE = 0,
+	LOAD_BIOS,
+	LOAD_SIO
+};
+
+enum cardEvent
+{
+	EVENT_DONE = 0,
+	EVENT_ERROR,
+	EVENT_TIMEOUT,
+	EVENT_NEW,
+	NUM_EVENTS
+};
+
+typedef struct
+{
+	Timer_Ticks total_time, max_time;
+	uint32_t    sectors, errors;
+} TransferResult;
+
+typedef struct
+{
+	Timer_Ticks total_time, max_time, card_time;
+	uint32_t    frames, dropped, sectors, errors;
+} LoadResult;
+
+static const char *const opNames[NUM_METHODS][NUM_OPS] =
+{
+	{ "BIOS RD", "BIOS WR" },
+	{ "SIO RD",  "SIO WR"  }
+};
+static const char *const loadNames[NUM_LOADS] = { "IDLE", "BIOS WR", "SIO WR" };
+static const char *const blockNames[] =
+{
+	"NOT WRITTEN",
+	"INTACT",
+	"RESTORED",
+	"DAMAGED, CHECK YOUR SAVES"
+};
+
+static const uint32_t eventSpecs[NUM_EVENTS] = { EvSpIOE, EvSpERROR, EvSpTIMOUT, EvSpNEW };
+
+static int cardEvents[NUM_EVENTS];
+static bool cardDriver = false;
+
+static uint8_t backup[TEST_SIZE];
+static uint8_t scratch[TEST_SIZE];
+
+static TransferResult results[NUM_METHODS][NUM_OPS];
+static LoadResult loadResults[NUM_LOADS];
+static bool dataMatches = false;
+static bool writeTest = false;
+static int blockState = BLOCK_NOT_WRITTEN;
+static int restoreAttempts = 0;
+
+static BenchRun run;
+static int slot = 0;
+static const char *error = 0;
+
+// Load test state
+static int currentLoad = 0;
+static int loadFrame = 0;
+static int loadSector = 0;
+static bool biosBusy = false;
+static Timer_Ticks lastFrame;
+static Timer_Ticks frameTimes[LOAD_FRAMES];
+static Timer_Ticks baselineTime = 0;
+
+// Stress test workload
+static BenchWorkload workload;
+
+/* BIOS card access */
+
+// Controller polling is kept enabled by InitCARD(1), which shares the SIO IRQ
+// handler between the two drivers.
+static void InitCardDriver(void)
+{
+	InitCARD(1);
+	StartPAD();
+	StartCARD();
+	_bu_init();
+	ChangeClearPAD(0);
+
+	cardDriver = true;
+}
+
+static void SetCardDriver(bool enable)
+{
+	if(enable == cardDriver)
+		return;
+
+	if(enable)
+		StartCARD();
+	else
+		StopCARD();
+
+	ChangeClearPAD(0);
+	cardDriver = enable;
+}
+
+static void OpenCardEvents(void)
+{
+	EnterCriticalSection();
+
+	for(int i = 0; i < NUM_EVENTS; i++)
+	{
+		cardEvents[i] = OpenEvent(SwCARD, eventSpecs[i], EvMdNOINTR, 0);
+		EnableEvent(cardEvents[i]);
+	}
+
+	ExitCriticalSection();
+}
+
+static void CloseCardEvents(void)
+{
+	EnterCriticalSection();
+
+	for(int i = 0; i < NUM_EVENTS; i++)
+		CloseEvent(cardEvents[i]);
+
+	ExitCriticalSection();
+}
+
+static void ClearCardEvents(void)
+{
+	for(int i = 0; i < NUM_EVENTS; i++)
+		TestEvent(cardEvents[i]);
+}
+
+// Returns the event the last BIOS operation ended with, or -1 if it is still
+// in progress.
+static int PollBiosCard(void)
+{
+	for(int i = 0; i < NUM_EVENTS; i++)
+	{
+		if(TestEvent(cardEvents[i]))
+			return i;
+	}
+
+	return -1;
+}
+
+static int WaitBiosCard(void)
+{
+	Timer_Ticks start = Timer_GetTicks();
+	int event;
+
+	while((event = PollBiosCard()) < 0)
+	{
+		if(Timer_TicksToUs(Timer_GetTicks() - start) > BIOS_TIMEOUT_US)
+			return EVENT_TIMEOUT;
+	}
+
+	return event;
+}
+
+static bool StartBiosTransfer(bool write, int sector, uint8_t *ptr)
+{
+	ClearCardEvents();
+
+	if(write)
+		return _card_write(slot << 4, sector, ptr);
+	else
+		return _card_read(slot << 4, sector, ptr);
+}
+
+static bool BiosTransfer(bool write, int sector, uint8_t *ptr, uint32_t *errors)
+{
+	for(int attempt = 0; attempt < 2; attempt++)
+	{
+		if(!StartBiosTransfer(write, sector, ptr))
+			break;
+
+		int event = WaitBiosCard();
+
+		if(event == EVENT_DONE)
+			return true;
+
+		(*errors)++;
+
+		// The first access after a card has been inserted fails with a "new
+		// card" event, which has to be acknowledged before retrying.
+		if(event != EVENT_NEW)
+			break;
+
+		_new_card();
+	}
+
+	return false;
+}
+
+/* Direct card access */
+
+static bool DirectTransfer(bool write, int sector, uint8_t *ptr, uint32_t *errors)
+{
+	for(int attempt = 0; attempt < MAX_ATTEMPTS; attempt++)
+	{
+		Card_Result result = write ?
+			Card_WriteSector(slot, sector, ptr) : Card_ReadSector(slot, sector, ptr);
+
+		if(result == CARD_OK)
+			return true;
+
+		(*errors)++;
+
+		if(result != CARD_NO_RESPONSE)
+			break;
+	}
+
+	return false;
+}
+
+/* Throughput test */
+
+static bool RunTransfer(int method, bool write, uint8_t *buffer)
+{
+	TransferResult *result = &results[method][write];
+
+	__builtin_memset(result, 0, sizeof(TransferResult));
+
+	for(int i = 0; i < TEST_SECTORS; i++)
+	{
+		uint8_t *ptr = &buffer[i * CARD_SECTOR_SIZE];
+
+		Timer_Ticks start = Timer_GetTicks();
+		bool ok;
+
+		if(method == METHOD_BIOS)
+			ok = BiosTransfer(write, TEST_SECTOR + i, ptr, &result->errors);
+		else
+			ok = DirectTransfer(write, TEST_SECTOR + i, ptr, &result->errors);
+
+		Timer_Ticks time = Timer_GetTicks() - start;
+
+		if(!ok)
+			return false;
+
+		result->total_time += time;
+		result->sectors++;
+
+		if(time > result->max_time)
+			result->max_time = time;
+	}
+
+	return true;
+}
+
+// Returns true if the block reads back the same as the backup.
+static bool VerifyBlock(void)
+{
+	uint32_t errors = 0;
+
+	for(int i = 0; i < TEST_SECTORS; i++)
+	{
+		uint8_t *ptr = &scratch[i * CARD_SECTOR_SIZE];
+
+		if(!DirectTransfer(false, TEST_SECTOR + i, ptr, &errors))
+			return false;
+		if(__builtin_memcmp(ptr, &backup[i * CARD_SECTOR_SIZE], CARD_SECTOR_SIZE))
+			return false;
+	}
+
+	return true;
+}
+
+// Writes the backup over the block until it reads back intact.
+static int RestoreBlock(void)
+{
+	for(restoreAttempts = 0; restoreAttempts < RESTORE_ATTEMPTS; restoreAttempts++)
+	{
+		if(VerifyBlock())
+			return restoreAttempts ? BLOCK_RESTORED : BLOCK_INTACT;
+
+		// Keep going past failed sectors, so as much of the block as possible
+		// is restored.
+		uint32_t errors = 0;
+
+		for(int i = 0; i < TEST_SECTORS; i++)
+			DirectTransfer(true, TEST_SECTOR + i, &backup[i * CARD_SECTOR_SIZE], &errors);
+	}
+
+	return VerifyBlock() ? BLOCK_RESTORED : BLOCK_DAMAGED;
+}
+
+static void RunBenchmark(void)
+{
+	SetCardDriver(true);
+
+	__builtin_memset(results, 0, sizeof(results));
+	dataMatches = false;
+	blockState  = BLOCK_NOT_WRITTEN;
+	restoreAttempts = 0;
+
+	// Back up the block first; nothing gets written if this fails.
+	if(!RunTransfer(METHOD_BIOS, false, backup))
+	{
+		error = results[METHOD_BIOS][0].sectors ? "CARD READ FAILED" : "NO CARD IN SLOT";
+		return;
+	}
+	if(!RunTransfer(METHOD_SIO, false, scratch))
+	{
+		error = "DIRECT READ FAILED";
+		return;
+	}
+
+	dataMatches = !__builtin_memcmp(backup, scratch, TEST_SIZE);
+
+	if(!dataMatches)
+	{
+		error = "BIOS AND DIRECT READS DIFFER";
+		return;
+	}
+	if(!writeTest)
+		return;
+
+	// The SIO write goes ahead even if the BIOS one failed, as it rewrites
+	// the whole block.
+	bool written = RunTransfer(METHOD_BIOS, true, backup);
+	written      = RunTransfer(METHOD_SIO, true, backup) && written;
+
+	blockState = RestoreBlock();
+
+	if(!written)
+		error = "CARD WRITE FAILED";
+	else if(blockState == BLOCK_DAMAGED)
+		error = "CARD RESTORE FAILED";
+}
+
+/* Frame time test */
+
+static void StartLoad(int load)
+{
+	currentLoad = load;
+	loadFrame   = -1; // The first frame's start time is only a reference
+	loadSector  = 0;
+	biosBusy    = false;
+
+	SetCardDriver(load == LOAD_BIOS);
+
+	__builtin_memset(&loadResults[load], 0, sizeof(LoadResult));
+}
+
+static void EndLoad(void)
+{
+	LoadResult *result = &loadResults[currentLoad];
+
+	if(biosBusy)
+	{
+		WaitBiosCard();
+		biosBusy = false;
+	}
+
+	if(currentLoad == LOAD_NONE)
+		baselineTime = result->total_time / result->frames;
+
+	for(int i = 0; i < LOAD_FRAMES; i++)
+	{
+		if(frameTimes[i] > (baselineTime * 3 / 2))
+			result->dropped++;
+	}
+
+	if(currentLoad + 1 < NUM_LOADS)
+	{
+		StartLoad(currentLoad + 1);
+		return;
+	}
+
+	blockState = RestoreBlock();
+	run.state  = BENCH_DONE;
+}
+
+// Stops the frame time test early, making sure the block is left intact.
+static void AbortLoad(void)
+{
+	if(biosBusy)
+	{
+		WaitBiosCard();
+		biosBusy = false;
+	}
+
+	if(run.state != BENCH_LOAD)
+		return;
+
+	blockState = RestoreBlock();
+	Bench_ResetRun(&run);
+}
+
+static void UpdateLoad(void)
+{
+	LoadResult *result = &loadResults[currentLoad];
+	Timer_Ticks now    = Timer_GetTicks();
+
+	if(loadFrame >= 0)
+	{
+		Timer_Ticks time = now - lastFrame;
+
+		frameTimes[loadFrame] = time;
+		result->total_time   += time;
+		result->frames++;
+
+		if(time > result->max_time)
+			result->max_time = time;
+	}
+
+	lastFrame = now;
+
+	if(++loadFrame >= LOAD_FRAMES)
+	{
+		EndLoad();
+		return;
+	}
+
+	// Keep writing the backed up block, one sector at a time.
+	uint8_t *ptr = &backup[loadSector * CARD_SECTOR_SIZE];
+	int sector   = TEST_SECTOR + loadSector;
+
+	switch(currentLoad)
+	{
+		case LOAD_BIOS:
+			if(biosBusy)
+			{
+				int event = PollBiosCard();
+
+				if(event < 0)
+					break;
+
+				if(event == EVENT_DONE)
+					result->sectors++;
+				else
+					result->errors++;
+
+				loadSector = (loadSector + 1) % TEST_SECTORS;
+				ptr        = &backup[loadSector * CARD_SECTOR_SIZE];
+				sector     = TEST_SECTOR + loadSector;
+			}
+
+			biosBusy = StartBiosTransfer(true, sector, ptr);
+		break;
+
+		case LOAD_SIO:
+			if(DirectTransfer(true, sector, ptr, &result->errors))
+				result->sectors++;
+
+			loadSector = (loadSector + 1) % TEST_SECTORS;
+		break;
+	}
+
+	result->card_time += Timer_GetTicks() - now;
+}
+
+/* Mode callbacks */
+
+static void DrawBlockState(RenderContext* ctx, int xPos, int *yPos, int dy)
+{
+	char buffer[64];
+
+	if(blockState == BLOCK_NOT_WRITTEN)
+		sprintf(buffer, "BLOCK: %s", blockNames[blockState]);
+	else
+		sprintf(buffer, "BLOCK: %s (%d REWRITES)", blockNames[blockState], restoreAttempts);
+
+	drawTextList(ctx, xPos, yPos, 0, dy, buffer);
+}
+
+static uint32_t AverageUs(Timer_Ticks total, uint32_t count)
+{
+	return count ? (Timer_TicksToUs(total) / count) : 0;
+}
+
+static uint32_t BytesPerSecond(size_t size, Timer_Ticks ticks)
+{
+	uint32_t ms = Timer_TicksToUs(ticks) / 1000;
+
+	return ms ? ((size * 1000) / ms) : 0;
+}
+
+static void InitMemCard(void)
+{
+	Bench_ResetRun(&run);
+	error = 0;
+
+	InitCardDriver();
+	OpenCardEvents();
+	Bench_InitWorkload(&workload);
+}
+
+static void EndMemCard(void)
+{
+	AbortLoad();
+	CloseCardEvents();
+	SetCardDriver(false);
+}
+
+static void PauseMemCard(void)
+{
+	AbortLoad();
+
+	if(run.state == BENCH_CONFIRM)
+		Bench_ResetRun(&run);
+}
+
+static void DrawMemCard(RenderContext* ctx)
+{
+	char buffer[128];
+	int xPos = 8;
+	int yPos = RESULT_START_Y;
+	int i, j;
+
+	if(run.state == BENCH_IDLE)
+	{
+		drawTextList(ctx, xPos, &yPos, 0, RESULT_DY * 2, "MEMORY CARD: BIOS VS DIRECT SIO");
+		sprintf(buffer, "[SQUARE] SLOT %d", slot + 1);
+		drawTextList(ctx, xPos, &yPos, 0, RESULT_DY, buffer);
+		drawTextList(ctx, xPos, &yPos, 0, RESULT_DY, "[X]      READ TEST");
+		drawTextList(ctx, xPos, &yPos, 0, RESULT_DY, "[CIRCLE] WRITE TEST (ABOUT 15 SECONDS)");
+		return;
+	}
+
+	if(run.state == BENCH_CONFIRM)
+	{
+		drawTextList(ctx, xPos, &yPos, 0, RESULT_DY * 2, "MEMORY CARD WRITE TEST");
+		sprintf(buffer, "THE LAST BLOCK OF THE CARD IN SLOT %d", slot + 1);
+		drawTextList(ctx, xPos, &yPos, 0, RESULT_DY, buffer);
+		drawTextList(ctx, xPos, &yPos, 0, RESULT_DY, "WILL BE REWRITTEN WITH ITS OWN DATA.");
+		drawTextList(ctx, xPos, &yPos, 0, RESULT_DY * 2, "DO NOT REMOVE THE CARD DURING THE TEST.");
+		drawTextList(ctx, xPos, &yPos, 0, RESULT_DY, "[SELECT] WRITE");
+		drawTextList(ctx, xPos, &yPos, 0, RESULT_DY, "[CIRCLE] CANCEL");
+		return;
+	}
+
+	if(Bench_DrawPending(&run, ctx, xPos, &yPos))
+		return;
+
+	if(Bench_ShouldRun(&run))
+	{
+		RunBenchmark();
+
+		// Follow up with the frame time measurements, unless this is only a
+		// read test or the transfers failed.
+		if(writeTest && !error)
+		{
+			run.state = BENCH_LOAD;
+			StartLoad(LOAD_NONE);
+			return;
+		}
+	}
+
+	if(run.state == BENCH_LOAD)
+	{
+		UpdateLoad();
+
+		if(run.state == BENCH_LOAD)
+		{
+			sprintf(buffer, "FRAME TIME: %s %d/%d", loadNames[currentLoad],
+				loadFrame, LOAD_FRAMES);
+			drawTextList(ctx, xPos, &yPos, 0, RESULT_DY, buffer);
+
+			Bench_DrawWorkload(ctx, &workload);
+			return;
+		}
+	}
+
+	if(error)
+	{
+		drawTextList(ctx, xPos, &yPos, 0, RESULT_DY, error);
+
+		if(blockState != BLOCK_NOT_WRITTEN)
+			DrawBlockState(ctx, xPos, &yPos, RESULT_DY);
+
+		drawTextList(ctx, xPos, &yPos, 0, RESULT_DY, "[X] READ TEST  [CIRCLE] WRITE TEST");
+		return;
+	}
+
+	sprintf(buffer, "MEMORY CARD SLOT %d, %d SECTORS", slot + 1, TEST_SECTORS);
+	drawTextList(ctx, xPos, &yPos, 0, RESULT_DY * 2, buffer);
+
+	drawTextList(ctx, xPos, &yPos, 0, RESULT_DY, "          B/S  AVG US  MAX US ERR");
+
+	for(i = 0; i < NUM_METHODS; i++)
+	{
+		for(j = 0; j < (writeTest ? NUM_OPS : 1); j++)
+		{
+			const TransferResult *result = &results[i][j];
+
+			sprintf(buffer, "%-7s %5d %7d %7d %3d", opNames[i][j],
+				BytesPerSecond(result->sectors * CARD_SECTOR_SIZE, result->total_time),
+				AverageUs(result->total_time, result->sectors),
+				Timer_TicksToUs(result->max_time), result->errors);
+			drawTextList(ctx, xPos, &yPos, 0, RESULT_DY, buffer);
+		}
+	}
+
+	sprintf(buffer, "DATA CHECK: %s", dataMatches ? "OK" : "MISMATCH");
+	drawTextList(ctx, xPos, &yPos, 0, RESULT_DY, buffer);
+	DrawBlockState(ctx, xPos, &yPos, RESULT_DY * 2);
+
+	if(!writeTest)
+	{
+		drawTextList(ctx, xPos, &yPos, 0, RESULT_DY, "[X] READ TEST  [CIRCLE] WRITE TEST");
+		return;
+	}
+
+	sprintf(buffer, "STRESS TEST, %d FRAMES EACH", LOAD_FRAMES);
+	drawTextList(ctx, xPos, &yPos, 0, RESULT_DY, buffer);
+
+	drawTextList(ctx, xPos, &yPos, 0, RESULT_DY, "        AVG US  MAX US DROP CARD% SECT");
+
+	for(i = 0; i < NUM_LOADS; i++)
+	{
+		const LoadResult *result = &loadResults[i];
+		uint32_t load = 0;
+
+		if(result->total_time)
+			load = Timer_TicksToUs(result->card_time) / (Timer_TicksToUs(result->total_time) / 100 + 1);
+
+		sprintf(buffer, "%-7s %6d %7d %4d %4d%% %4d", loadNames[i],
+			AverageUs(result->total_time, result->frames), Timer_TicksToUs(result->max_time),
+			result->dropped, load, result->sectors);
+		drawTextList(ctx, xPos, &yPos, 0, RESULT_DY, buffer);
+	}
+
+	yPos += RESULT_DY;
+	drawTextList(ctx, xPos, &yPos, 0, RESULT_DY, "[X] READ TEST  [CIRCLE] WRITE TEST");
+}
+
+static void HandleMemCardCommands(PADTYPE* pad)
+{
+	if((run.state == BENCH_PENDING) || (run.state == BENCH_RUNNING) || (run.state == BENCH_LOAD))
+	{
+		HandleTextureCommand(pad);
+		return;
+	}
+
+	if(run.state == BENCH_CONFIRM)
+	{
+		if(Bench_RequestRun(&run, pad, PAD_SELECT))
+		{
+			writeTest = true;
+			error = 0;
+		}
+		else if((lastButtons & PAD_CIRCLE) && !(pad->btn & PAD_CIRCLE))
+		{
+			Bench_ResetRun(&run);
+		}
+
+		return;
+	}
+
+	if((lastButtons & PAD_SQUARE) && !(pad->btn & PAD_SQUARE))
+		slot ^= 1;
+
+	if((lastButtons & PAD_CIRCLE) && !(pad->btn & PAD_CIRCLE))
+	{
+		run.state = BENCH_CONFIRM;
+		return;
+	}
+
+	if(Bench_RequestRun(&run, pad, PAD_CROSS))
+	{
+		writeTest = false;
+		error = 0;
+	}
+}
+
+const BenchMode bench_mode =
+{
+	.init            = &InitMemCard,
+	.end             = &EndMemCard,
+	.pause           = &PauseMemCard,
+	.handle_commands = &HandleMemCardCommands,
+	.draw            = &DrawMemCard
+};
@@ -0,0 +1,402 @@
+/*
+ * ps1-benchmark vertex morph and skinning test (overlay)
+ *
+ * Animates a grid mesh in two ways and compares doing the vertex math on the
+ * CPU with handing it to the GTE:
+ *
+ * - Morphing blends each vertex between two keyframes. On the GTE this is the
+ *   INTPL command, which interpolates from IR1-3 (the first keyframe) towards
+ *   the far color registers (the second) by IR0; on the CPU it is a
+ *   fixed-point lerp.
+ * - Two-bone skinning transforms each vertex by both bones' world matrices
+ *   and blends the results by a per-vertex weight. The second bone's matrix is
+ *   composed with the first's, as in a matrix stack. On the GTE each bone is a
+ *   pass of RTV0TR over all vertices with the bone's matrix loaded, followed by
+ *   an INTPL pass blending the two; on the CPU the matrices are applied with
+ *   plain multiplies.
+ *
+ * Results are given in vertices per second and per frame at the console's
+ * refresh rate (i.e. how many vertices could be animated if that was all the
+ * CPU did). The output of each GTE test is checked against the CPU version of
+ * the same test (see Bench_Matches()). The animated mesh is also projected
+ * and drawn as points with the GTE.
+ */
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <psxgpu.h>
+#include <psxgte.h>
+#include <psxpad.h>
+#include <inline_c.h>
+
+#include "bench.h"
+#include "timer.h"
+#include "calib.h"
+
+#define GRID_SIZE    16
+#define NUM_VERTICES (GRID_SIZE * GRID_SIZE)
+#define GRID_STEP    12
+#define BULGE        64
+#define NUM_RUNS     16
+
+// Only every other vertex is drawn, to leave room for text in the render
+// buffer.
+#define DRAW_STEP    2
+#define CAMERA_Z     256
+
+#define CHECK_TOLERANCE 2
+
+enum benchTest
+{
+	TEST_MORPH_CPU = 0,
+	TEST_MORPH_GTE,
+	TEST_SKIN_CPU,
+	TEST_SKIN_GTE,
+	NUM_TESTS
+};
+
+static const char *const testNames[NUM_TESTS] =
+{
+	"MORPH CPU", "MORPH GTE", "SKIN CPU", "SKIN GTE"
+};
+
+// Keyframes (the second one also as 32-bit vectors, for loading into the far
+// color registers), skinning weights and output
+static SVECTOR key0[NUM_VERTICES], key1[NUM_VERTICES];
+static VECTOR  key1Long[NUM_VERTICES];
+static int16_t weights[NUM_VERTICES];
+static SVECTOR output[NUM_VERTICES];
+
+// Output of the CPU version of each test, to check the GTE version against
+static SVECTOR reference[NUM_VERTICES];
+
+// Intermediate results of the GTE skinning passes
+static SVECTOR bone0Pos[NUM_VERTICES];
+static VECTOR  bone1Pos[NUM_VERTICES];
+
+static MATRIX bones[2];
+
+static Timer_Ticks times[NUM_TESTS];
+static bool valid[NUM_TESTS];
+
+static BenchRun run;
+static int liveTest = TEST_MORPH_GTE;
+static int phase = 0;
+
+/* Mesh */
+
+static void InitMesh(void)
+{
+	for(int row = 0; row < GRID_SIZE; row++)
+	{
+		for(int col = 0; col < GRID_SIZE; col++)
+		{
+			int i = row * GRID_SIZE + col;
+			int x = (col - GRID_SIZE / 2) * GRID_STEP;
+			int y = (row - GRID_SIZE / 2) * GRID_STEP;
+
+			// The second keyframe bulges towards the viewer in the middle.
+			int dx = (col - GRID_SIZE / 2);
+			int dy = (row - GRID_SIZE / 2);
+			int r2 = dx * dx + dy * dy;
+			int z  = (r2 < (GRID_SIZE * GRID_SIZE / 4)) ?
+				-(BULGE - (BULGE * 4 * r2) / (GRID_SIZE * GRID_SIZE)) : 0;
+
+			setVector(&key0[i], x, y, 0);
+			setVector(&key1[i], x, y, z);
+			setVector(&key1Long[i], x, y, z);
+
+			// Vertices blend from the first bone to the second along X.
+			weights[i] = (col * ONE) / (GRID_SIZE - 1);
+		}
+	}
+}
+
+// The first bone rotates about Y around the origin, the second is attached to
+// it and bends about Z.
+static void SetupBones(int angle)
+{
+	SVECTOR rot   = { 0, angle, 0 };
+	VECTOR  trans = { 0, 0, 0 };
+
+	RotMatrix(&rot, &bones[0]);
+	TransMatrix(&bones[0], &trans);
+
+	MATRIX local;
+	SVECTOR bend  = { 0, 0, angle * 2 };
+	VECTOR  joint = { GRID_STEP * 2, 0, 0 };
+
+	RotMatrix(&bend, &local);
+	TransMatrix(&local, &joint);
+
+	CompMatrixLV(&bones[0], &local, &bones[1]);
+}
+
+/* CPU implementations */
+
+static void MorphCPU(int t)
+{
+	for(int i = 0; i < NUM_VERTICES; i++)
+	{
+		output[i].vx = key0[i].vx + (((key1[i].vx - key0[i].vx) * t) >> 12);
+		output[i].vy = key0[i].vy + (((key1[i].vy - key0[i].vy) * t) >> 12);
+		output[i].vz = key0[i].vz + (((key1[i].vz - key0[i].vz) * t) >> 12);
+	}
+}
+
+static void Transform(const MATRIX *m, const SVECTOR *v, VECTOR *out)
+{
+	out->vx = ((m->m[0][0] * v->vx + m->m[0][1] * v->vy + m->m[0][2] * v->vz) >> 12) + m->t[0];
+	out->vy = ((m->m[1][0] * v->vx + m->m[1][1] * v->vy + m->m[1][2] * v->vz) >> 12) + m->t[1];
+	out->vz = ((m->m[2][0] * v->vx + m->m[2][1] * v->vy + m->m[2][2] * v->vz) >> 12) + m->t[2];
+}
+
+static void SkinCPU(void)
+{
+	for(int i = 0; i < NUM_VERTICES; i++)
+	{
+		VECTOR p0, p1;
+		int w = weights[i];
+
+		Transform(&bones[0], &key0[i], &p0);
+		Transform(&bones[1], &key0[i], &p1);
+
+		output[i].vx = p0.vx + (((p1.vx - p0.vx) * w) >> 12);
+		output[i].vy = p0.vy + (((p1.vy - p0.vy) * w) >> 12);
+		output[i].vz = p0.vz + (((p1.vz - p0.vz) * w) >> 12);
+	}
+}
+
+/* GTE implementations */
+
+static void MorphGTE(int t)
+{
+	gte_lddp(t);
+
+	for(int i = 0; i < NUM_VERTICES; i++)
+	{
+		gte_ldfc(&key1Long[i]);
+		gte_ldsv(&key0[i]);
+		gte_intpl();
+		gte_stsv(&output[i]);
+	}
+}
+
+static void SkinGTE(void)
+{
+	gte_SetRotMatrix(&bones[0]);
+	gte_SetTransMatrix(&bones[0]);
+
+	for(int i = 0; i < NUM_VERTICES; i++)
+	{
+		gte_ldv0(&key0[i]);
+		gte_rtv0tr();
+		gte_stsv(&bone0Pos[i]);
+	}
+
+	gte_SetRotMatrix(&bones[1]);
+	gte_SetTransMatrix(&bones[1]);
+
+	for(int i = 0; i < NUM_VERTICES; i++)
+	{
+		gte_ldv0(&key0[i]);
+		gte_rtv0tr();
+		gte_stlvnl(&bone1Pos[i]);
+	}
+
+	// INTPL blends from IR1-3 (the first bone) towards the far color (the
+	// second) by IR0 (the weight).
+	for(int i = 0; i < NUM_VERTICES; i++)
+	{
+		gte_ldfc(&bone1Pos[i]);
+		gte_ldsv(&bone0Pos[i]);
+		gte_lddp(weights[i]);
+		gte_intpl();
+		gte_stsv(&output[i]);
+	}
+}
+
+static void RunTest(int test, int t)
+{
+	switch(test)
+	{
+		case TEST_MORPH_CPU:
+			MorphCPU(t);
+		break;
+
+		case TEST_MORPH_GTE:
+			MorphGTE(t);
+		break;
+
+		case TEST_SKIN_CPU:
+			SkinCPU();
+		break;
+
+		case TEST_SKIN_GTE:
+			SkinGTE();
+		break;
+	}
+}
+
+static bool MatchesVector(const SVECTOR *a, const SVECTOR *b)
+{
+	return
+		Bench_Matches(a->vx, b->vx, CHECK_TOLERANCE) &&
+		Bench_Matches(a->vy, b->vy, CHECK_TOLERANCE) &&
+		Bench_Matches(a->vz, b->vz, CHECK_TOLERANCE);
+}
+
+// Returns true if a GTE test gives the same output as the CPU test before it.
+static bool CheckTest(int test, int t)
+{
+	RunTest(test - 1, t);
+	__builtin_memcpy(reference, output, sizeof(output));
+	RunTest(test, t);
+
+	for(int i = 0; i < NUM_VERTICES; i++)
+	{
+		if(!MatchesVector(&output[i], &reference[i]))
+			return false;
+	}
+
+	return true;
+}
+
+static void RunBenchmark(void)
+{
+	SetupBones(256);
+
+	for(int test = 0; test < NUM_TESTS; test++)
+	{
+		valid[test] = (test & 1) ? CheckTest(test, 2048) : true;
+
+		Timer_Ticks best = 0xffffffff;
+
+		// The first run also loads the code into the I-cache.
+		for(int i = 0; i <= NUM_RUNS; i++)
+		{
+			Timer_Ticks start = Timer_GetTicks();
+			RunTest(test, 2048);
+			Timer_Ticks time = Timer_GetTicks() - start;
+
+			if(i && (time < best))
+				best = time;
+		}
+
+		times[test] = best;
+	}
+}
+
+/* Display */
+
+static void DrawMesh(RenderContext* ctx)
+{
+	MATRIX camera = { 0 };
+	VECTOR trans  = { 0, 0, CAMERA_Z };
+
+	camera.m[0][0] = ONE;
+	camera.m[1][1] = ONE;
+	camera.m[2][2] = ONE;
+	TransMatrix(&camera, &trans);
+
+	gte_SetRotMatrix(&camera);
+	gte_SetTransMatrix(&camera);
+
+	for(int i = 0; i < NUM_VERTICES; i += DRAW_STEP)
+	{
+		TILE *tile = new_primitive(ctx, 1, sizeof(TILE));
+		uint32_t xy;
+
+		gte_ldv0(&output[i]);
+		gte_rtps();
+		gte_stsxy(&xy);
+
+		setTile(tile);
+		setXY0 (tile, (int16_t) xy - 1, (int16_t) (xy >> 16) - 1);
+		setWH  (tile, 2, 2);
+		setRGB0(tile, 255, 255, (i % GRID_SIZE) * 16);
+	}
+}
+
+static void DrawResults(RenderContext* ctx, int xPos, int *yPos)
+{
+	char buffer[128];
+
+	uint32_t frameUs = Calib_GetFrameUs();
+
+	drawTextList(ctx, xPos, yPos, 0, RESULT_DY, "              US  VERTS/S VERTS/FRAME");
+
+	for(int test = 0; test < NUM_TESTS; test++)
+	{
+		uint32_t us = Calib_TicksToStockUs(times[test], CALIB_CPU);
+
+		if(!valid[test])
+			sprintf(buffer, "%-10s WRONG RESULTS", testNames[test]);
+		else if(us)
+			sprintf(buffer, "%-10s %5d %8d %11d", testNames[test], us,
+				(NUM_VERTICES * 1000000) / us, (NUM_VERTICES * frameUs) / us);
+		else
+			sprintf(buffer, "%-10s %5d", testNames[test], us);
+
+		drawTextList(ctx, xPos, yPos, 0, RESULT_DY, buffer);
+	}
+
+	*yPos += RESULT_DY;
+}
+
+/* Mode callbacks */
+
+static void InitMorph(void)
+{
+	Bench_ResetRun(&run);
+	phase = 0;
+
+	InitMesh();
+}
+
+static void DrawMorph(RenderContext* ctx)
+{
+	char buffer[128];
+	int xPos = 8;
+	int yPos = RESULT_START_Y;
+
+	if(Bench_DrawPending(&run, ctx, xPos, &yPos))
+		return;
+	if(Bench_ShouldRun(&run))
+		RunBenchmark();
+
+	sprintf(buffer, "MORPH AND SKINNING, %d VERTICES", NUM_VERTICES);
+	drawTextList(ctx, xPos, &yPos, 0, RESULT_DY * 2, buffer);
+
+	if(run.state == BENCH_DONE)
+		DrawResults(ctx, xPos, &yPos);
+
+	sprintf(buffer, "[SQUARE] SHOWING: %s", testNames[liveTest]);
+	drawTextList(ctx, xPos, &yPos, 0, RESULT_DY, buffer);
+	drawTextList(ctx, xPos, &yPos, 0, RESULT_DY, "[X]      MEASURE");
+
+	// Animate back and forth between the keyframes, or swing the bones.
+	phase = (phase + 32) & 4095;
+
+	int t = (isin(phase) + ONE) / 2;
+
+	SetupBones(isin(phase) / 8);
+	RunTest(liveTest, t);
+	DrawMesh(ctx);
+}
+
+static void HandleMorphCommands(PADTYPE* pad)
+{
+	Bench_RequestRun(&run, pad, PAD_CROSS);
+
+	if((lastButtons & PAD_SQUARE) && !(pad->btn & PAD_SQUARE))
+		liveTest = (liveTest + 1) % NUM_TESTS;
+}
+
+const BenchMode bench_mode =
+{
+	.init            = &InitMorph,
+	.handle_commands = &HandleMorphCommands,
+	.draw            = &DrawMorph
+};
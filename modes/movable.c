@@ -0,0 +1,143 @@
+/*
+ * ps1-benchmark movement test (overlay)
+ *
+ * A single rectangle moved around with the D-pad, to check input latency and
+ * drawing of large primitives.
+ */
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <psxgpu.h>
+#include <psxpad.h>
+
+#include "bench.h"
+#include "tilesc.h"
+
+#define START_VEL		1
+
+static void *tile;
+
+static int x, y;
+static int r, g, b;
+static int w, h;
+
+static int curVel = START_VEL;
+static int vel[4] = {1, 3, 5, 7};
+
+static void InitMovableTest(void)
+{
+	curVel = START_VEL;
+
+	x = rand() % (SCREEN_XRES - BASE_W);
+	y = rand() % (SCREEN_YRES - BASE_H);
+
+	r = rand() % 256;
+	g = rand() % 256;
+	b = rand() % 256;
+
+	w = BASE_W;
+	h = BASE_H;
+}
+
+static void DrawMovableTest(RenderContext* ctx)
+{
+	draw_rectangle(ctx, &tile, useTexture, TILESC_SPHERE_U, TILESC_SPHERE_V, x, y, 1, w, h, r, g, b);
+}
+
+static void HandleMovableTestCommands(PADTYPE* pad)
+{
+	if (!(pad->btn & PAD_RIGHT))
+	{
+		int pos = x + vel[curVel];
+
+		if(pos > SCREEN_XRES - w)
+			pos = SCREEN_XRES - w;
+
+		x = pos;
+	}
+	else if(!(pad->btn & PAD_LEFT))
+	{
+		int pos = x - vel[curVel];
+
+		if(pos < 0)
+			pos = 0;
+
+		x = pos;
+	}
+
+	if (!(pad->btn & PAD_UP))
+	{
+		int pos = y - vel[curVel];
+
+		if(pos < 0)
+			pos = 0;
+
+		y = pos;
+	}
+	else if(!(pad->btn & PAD_DOWN))
+	{
+		int pos = y + vel[curVel];
+
+		if(pos > SCREEN_YRES - h)
+			pos = SCREEN_YRES - h;
+
+		y = pos;
+	}
+
+	//per evitare di switchare a manetta
+	if((lastButtons & PAD_CROSS) && !(pad->btn & PAD_CROSS))
+	{
+		r = rand() % 256;
+		g = rand() % 256;
+		b = rand() % 256;
+	}
+	if((lastButtons & PAD_SQUARE) && !(pad->btn & PAD_SQUARE))
+	{
+		int v = curVel + 1;
+
+		if(v == 4)
+			v = 0;
+
+		curVel = v;
+	}
+
+	//rimpicciolimento
+	if((lastButtons & PAD_L1) && !(pad->btn & PAD_L1))
+	{
+		int curW = w - BASE_W;
+		int curH = h - BASE_H;
+
+		if(curW < BASE_W)
+			curW = BASE_W;
+
+		if(curH < BASE_H)
+			curH = BASE_H;
+
+		w = curW;
+		h = curH;
+	}
+	//ingrandimento
+	if((lastButtons & PAD_R1) && !(pad->btn & PAD_R1))
+	{
+		int curW = w + BASE_W;
+		int curH = h + BASE_H;
+
+		if(curW > SCREEN_XRES - BASE_W)
+			curW = SCREEN_XRES - BASE_W;
+
+		if(curH > SCREEN_YRES - BASE_H)
+			curH = SCREEN_YRES - BASE_H;
+
+		w = curW;
+		h = curH;
+	}
+
+	HandleTextureCommand(pad);
+}
+
+const BenchMode bench_mode =
+{
+	.init            = &InitMovableTest,
+	.handle_commands = &HandleMovableTestCommands,
+	.draw            = &DrawMovableTest
+};
@@ -0,0 +1,525 @@
+/*
+ * ps1-benchmark audio+data container benchmark (overlay)
+ *
+ * Simulates loading a level's data while its music starts playing, in two
+ * ways:
+ *
+ * - MUXED:    reading a container built by tools/avmux, which interleaves the
+ *             music's sectors with the data's, with a single continuous read
+ *             from start to end and routing each sector to the stream's ring
+ *             buffer or the data buffer (see mux.h) as it arrives;
+ * - SEPARATE: streaming the same music from its own .VAG file with
+ *             feed_stream(), and reading the data files in small pieces
+ *             whenever the drive is not busy refilling the stream, which
+ *             makes it seek back and forth between the files.
+ *
+ * In both cases playback starts once the ring buffer is full. The time it
+ * takes for playback to start and for all data to be loaded are measured, as
+ * well as the lowest ring buffer fill (i.e. how close the stream got to an
+ * underrun) while the data was being loaded. The data loaded both ways is
+ * checked against each other.
+ *
+ * The container is read with CdlReadN into a staging ring, from which the
+ * main loop demuxes sectors whenever the stream has room for them. The drive
+ * is only paused (and has to seek to resume) if the staging ring fills up
+ * because the stream fell behind; the number of times this happens is
+ * reported. The sector caches are put aside while loading separately, so that
+ * the files are actually read from the CD and the caches other modes use are
+ * left as they were.
+ */
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <psxgpu.h>
+#include <psxpad.h>
+#include <psxcd.h>
+#include <psxspu.h>
+
+#include "bench.h"
+#include "stream.h"
+#include "timer.h"
+#include "mux.h"
+#include "calib.h"
+
+#define SECTOR_SIZE 2048
+#define NUM_METHODS 2
+
+// Sectors read at once from each data file when loading them separately.
+#define BATCH_SECTORS 16
+
+// Size of the staging ring the container is read into. The drive is paused
+// once fewer than PAUSE_MARGIN sectors are free, as a few more may still
+// arrive before it stops, and restarted once the ring is half empty.
+#define STAGING_SECTORS 64
+#define PAUSE_MARGIN    8
+
+// Give up if loading takes longer than this (in microseconds).
+#define TIMEOUT_US 20000000
+
+enum loadMethod
+{
+	METHOD_MUXED = 0,
+	METHOD_SEPARATE
+};
+
+typedef struct
+{
+	Timer_Ticks start_time, load_time;
+	size_t      min_fill;
+	uint32_t    underruns, restarts, checksum;
+} MuxResult;
+
+static const char *const methodNames[NUM_METHODS] = { "MUXED", "SEPARATE" };
+
+// The container is built from the same stream and data files (see
+// CMakeLists.txt), in the same order.
+static const char *const muxPath    = "\\STREAMS\\MUX.AVM;1";
+static const char *const streamPath = "\\STREAMS\\IL2K.VAG;1";
+static const char *const dataPaths[] =
+{
+	"\\PACKED\\TILESC.TIM;1",
+	"\\PACKED\\BANK.VAG;1"
+};
+
+static Stream_Context    streamCtx;
+static StreamReadContext readCtx;
+
+static uint32_t   headerBuffer[SECTOR_SIZE / 4];
+static Mux_Header *header = (Mux_Header *) headerBuffer;
+static size_t     dataSize = 0;
+
+// Staging ring state, shared with the CD ready callback. Sectors arriving
+// while the ring is full are dropped and read again once the drive restarts.
+static uint8_t      *staging = 0;
+static int          stagingLba = 0;
+static volatile int received = 0, consumed = 0;
+static volatile bool readFailed = false;
+
+static MuxResult results[NUM_METHODS];
+static BenchRun run;
+static const char *error = 0;
+
+/* Measurement helpers */
+
+static bool ReadSectors(int lba, int count, void *buffer)
+{
+	CdlLOC pos;
+
+	CdReadCallback(0);
+	CdIntToPos(lba, &pos);
+	CdControl(CdlSetloc, &pos, 0);
+	CdRead(count, (uint32_t *) buffer, CdlModeSpeed);
+
+	return (CdReadSync(0, 0) >= 0);
+}
+
+// Only covers the files themselves, as the padding after the end of each file
+// is not guaranteed to be the same on the CD and in the container.
+static uint32_t Checksum(const uint8_t *data)
+{
+	uint32_t sum = 0;
+
+	for(int i = 0; i < header->num_files; i++)
+	{
+		const uint8_t *ptr = &data[header->files[i].offset * SECTOR_SIZE];
+
+		for(size_t j = 0; j < header->files[i].size; j++)
+			sum = (sum << 1 | sum >> 31) + ptr[j];
+	}
+
+	return sum;
+}
+
+static bool TimedOut(Timer_Ticks start)
+{
+	if(Timer_TicksToUs(Timer_GetTicks() - start) < TIMEOUT_US)
+		return false;
+
+	error = "TIMED OUT";
+	return true;
+}
+
+static void TrackFill(MuxResult *result)
+{
+	if(streamCtx.buffer.length < result->min_fill)
+		result->min_fill = streamCtx.buffer.length;
+}
+
+static void StopStream(MuxResult *result)
+{
+	Stream_Stats stats;
+
+	Stream_GetStats(&streamCtx, &stats);
+	result->underruns = stats.underruns;
+
+	Stream_Stop();
+	CdReadSync(0, 0);
+}
+
+/* Muxed loading */
+
+static void StagingCallback(CdlIntrResult event, uint8_t *payload)
+{
+	if(event != CdlDataReady)
+	{
+		readFailed = true;
+		return;
+	}
+	if((received - consumed) >= STAGING_SECTORS)
+		return;
+
+	CdGetSector(&staging[(received % STAGING_SECTORS) * SECTOR_SIZE], SECTOR_SIZE / 4);
+	received++;
+}
+
+// Starts reading from the first sector that has not been received yet.
+static void StartStaging(void)
+{
+	CdlLOC pos;
+
+	CdIntToPos(stagingLba + received, &pos);
+	CdControl(CdlSetloc, &pos, 0);
+	CdControl(CdlReadN, 0, 0);
+}
+
+static void RunMuxed(MuxResult *result, uint8_t *data)
+{
+	CdlFILE     file;
+	Mux_Context mux;
+	bool        started = false, reading = true;
+
+	if(!CdSearchFile(&file, muxPath))
+	{
+		error = "CONTAINER NOT FOUND";
+		return;
+	}
+
+	uint8_t mode = CdlModeSpeed;
+	CdControlB(CdlSetmode, &mode, 0);
+
+	Timer_Ticks start  = Timer_GetTicks();
+	int         length = Mux_GetLength(header);
+
+	init_stream(&streamCtx, header->interleave, header->channels, header->sample_rate);
+	Stream_ResetStats(&streamCtx);
+	Mux_Init(&mux, header, &streamCtx, data);
+
+	stagingLba = CdPosToInt(&file.pos) + 1;
+	received   = 0;
+	consumed   = 0;
+	readFailed = false;
+
+	CdlCB oldCallback = CdReadyCallback(&StagingCallback);
+	StartStaging();
+
+	// Route sectors as they arrive, waiting for room in the ring buffer
+	// whenever the next ones hold audio. Playback starts once the buffer is
+	// first full.
+	while(!started || !Mux_IsDataComplete(&mux))
+	{
+		if(TimedOut(start))
+			break;
+		if(readFailed)
+		{
+			error = "CD READ ERROR";
+			break;
+		}
+
+		int staged = received - consumed;
+
+		if(reading && ((staged >= (STAGING_SECTORS - PAUSE_MARGIN)) || (received >= length)))
+		{
+			CdControlF(CdlPause, 0);
+			reading = false;
+		}
+		else if(!reading && (staged <= (STAGING_SECTORS / 2)) && (received < length))
+		{
+			StartStaging();
+			reading = true;
+			result->restarts++;
+		}
+
+		// Demux up to the end of the staging ring, then wrap around on the
+		// next iteration.
+		int first = consumed % STAGING_SECTORS;
+
+		if(staged > (STAGING_SECTORS - first))
+			staged = STAGING_SECTORS - first;
+
+		int batch = Mux_GetBatchLength(&mux, staged);
+
+		if(batch)
+		{
+			Mux_Demux(&mux, &staging[first * SECTOR_SIZE], batch);
+			consumed += batch;
+		}
+
+		if(!started && ((Stream_GetRefillLength(&streamCtx) < SECTOR_SIZE) || (consumed >= length)))
+		{
+			Stream_Start(&streamCtx, false);
+
+			result->start_time = Timer_GetTicks() - start;
+			started = true;
+		}
+
+		if(started)
+			TrackFill(result);
+	}
+
+	result->load_time = Timer_GetTicks() - start;
+
+	CdControlB(CdlPause, 0, 0);
+	CdReadyCallback(oldCallback);
+
+	StopStream(result);
+	Stream_Destroy(&streamCtx);
+}
+
+/* Separate loading */
+
+static void RunSeparate(MuxResult *result, uint8_t *data)
+{
+	CdlFILE stream, files[2];
+	int     i;
+
+	if(!CdSearchFile(&stream, streamPath))
+	{
+		error = "STREAM NOT FOUND";
+		return;
+	}
+
+	for(i = 0; i < header->num_files; i++)
+	{
+		if(!CdSearchFile(&files[i], dataPaths[i]))
+		{
+			error = "DATA FILE NOT FOUND";
+			return;
+		}
+	}
+
+	// Make sure the stream is actually read from the CD, rather than from
+	// the sector caches after the first run. Swapping in empty caches (which
+	// never hit) and putting the real ones back afterwards leaves their
+	// contents and statistics untouched.
+	SectorCache savedCaches[2];
+
+	__builtin_memcpy(&savedCaches[0], &sectorCache, sizeof(SectorCache));
+	__builtin_memcpy(&savedCaches[1], &streamCache, sizeof(SectorCache));
+	__builtin_memset(&sectorCache, 0, sizeof(SectorCache));
+	__builtin_memset(&streamCache, 0, sizeof(SectorCache));
+
+	Timer_Ticks start = Timer_GetTicks();
+
+	CdReadSync(0, 0);
+	setup_stream(&stream.pos, &readCtx, &streamCtx);
+	Stream_Start(&streamCtx, false);
+
+	result->start_time = Timer_GetTicks() - start;
+
+	// Load each file into the same place the demuxer would have put it.
+	int file   = 0;
+	int offset = 0;
+
+	while(file < header->num_files)
+	{
+		if(TimedOut(start))
+			break;
+
+		TrackFill(result);
+
+		// Only read data while the stream does not need refilling.
+		if(feed_stream(&readCtx, &streamCtx))
+			continue;
+
+		int sectors = Bench_SectorCount(header->files[file].size);
+		int length  = sectors - offset;
+
+		if(length > BATCH_SECTORS)
+			length = BATCH_SECTORS;
+
+		uint8_t *ptr = &data[(header->files[file].offset + offset) * SECTOR_SIZE];
+
+		if(!ReadSectors(CdPosToInt(&files[file].pos) + offset, length, ptr))
+		{
+			error = "CD READ ERROR";
+			break;
+		}
+
+		offset += length;
+
+		if(offset >= sectors)
+		{
+			file++;
+			offset = 0;
+		}
+	}
+
+	result->load_time = Timer_GetTicks() - start;
+
+	StopStream(result);
+	destroy_stream(&readCtx, &streamCtx);
+
+	__builtin_memcpy(&sectorCache, &savedCaches[0], sizeof(SectorCache));
+	__builtin_memcpy(&streamCache, &savedCaches[1], sizeof(SectorCache));
+}
+
+static void RunBenchmark(void)
+{
+	CdlFILE file;
+
+	error = 0;
+
+	// Other modes (and the audio streams) install their own read callbacks.
+	CdReadCallback(0);
+
+	if(!CdSearchFile(&file, muxPath))
+	{
+		error = "CONTAINER NOT FOUND";
+		return;
+	}
+	if(!ReadSectors(CdPosToInt(&file.pos), 1, headerBuffer) || !Mux_IsValid(header))
+	{
+		error = "INVALID CONTAINER";
+		return;
+	}
+	if(header->num_files > 2)
+	{
+		error = "TOO MANY DATA FILES";
+		return;
+	}
+
+	dataSize = 0;
+
+	for(int i = 0; i < header->num_files; i++)
+		dataSize += header->files[i].size;
+
+	uint8_t *data = malloc(header->num_data_sectors * SECTOR_SIZE);
+	staging       = malloc(STAGING_SECTORS * SECTOR_SIZE);
+
+	if(!data || !staging)
+	{
+		error = "OUT OF MEMORY";
+	}
+	else
+	{
+		for(int method = 0; (method < NUM_METHODS) && !error; method++)
+		{
+			MuxResult *result = &results[method];
+
+			result->min_fill = 0xffffffff;
+			result->restarts = 0;
+
+			__builtin_memset(data, 0, header->num_data_sectors * SECTOR_SIZE);
+
+			if(method == METHOD_MUXED)
+				RunMuxed(result, data);
+			else
+				RunSeparate(result, data);
+
+			result->checksum = Checksum(data);
+		}
+	}
+
+	free(data);
+	free(staging);
+	staging = 0;
+}
+
+/* Mode callbacks */
+
+static int KBPerSecond(size_t size, Timer_Ticks ticks)
+{
+	uint32_t us = Timer_TicksToUs(ticks);
+
+	if(!us)
+		return 0;
+
+	// 1000000 / 1024 ~= 977, which avoids pulling in 64-bit division.
+	return (int) ((size * 977) / us);
+}
+
+static void InitMuxBench(void)
+{
+	Bench_ResetRun(&run);
+	error = 0;
+}
+
+static void DrawMuxBench(RenderContext* ctx)
+{
+	char buffer[128];
+	int xPos = 8;
+	int yPos = RESULT_START_Y;
+	int i;
+
+	if(run.state == BENCH_IDLE)
+	{
+		drawTextList(ctx, xPos, &yPos, 0, RESULT_DY * 2, "AUDIO+DATA CONTAINER VS SEPARATE FILES");
+		drawTextList(ctx, xPos, &yPos, 0, RESULT_DY, "[X] RUN (TAKES A FEW SECONDS)");
+		return;
+	}
+
+	if(Bench_DrawPending(&run, ctx, xPos, &yPos))
+		return;
+	if(Bench_ShouldRun(&run))
+		RunBenchmark();
+
+	if(error)
+	{
+		drawTextList(ctx, xPos, &yPos, 0, RESULT_DY, error);
+		drawTextList(ctx, xPos, &yPos, 0, RESULT_DY, "[X] RUN AGAIN");
+		return;
+	}
+
+	drawTextList(ctx, xPos, &yPos, 0, RESULT_DY * 2, "AUDIO+DATA CONTAINER VS SEPARATE FILES");
+
+	sprintf(buffer, "DATA %d KB IN %d FILES, GROUPS OF %d+%d",
+		dataSize / 1024, header->num_files, header->audio_sectors, header->data_sectors);
+	drawTextList(ctx, xPos, &yPos, 0, RESULT_DY * 2, buffer);
+
+	for(i = 0; i < NUM_METHODS; i++)
+	{
+		const MuxResult *result = &results[i];
+
+		sprintf(buffer, "%s:", methodNames[i]);
+		drawTextList(ctx, xPos, &yPos, 0, RESULT_DY, buffer);
+
+		sprintf(buffer, " PLAYBACK STARTS AFTER %5d MS", Timer_TicksToUs(result->start_time) / 1000);
+		drawTextList(ctx, xPos, &yPos, 0, RESULT_DY, buffer);
+
+		sprintf(buffer, " DATA LOADED AFTER    %5d MS", Timer_TicksToUs(result->load_time) / 1000);
+		drawTextList(ctx, xPos, &yPos, 0, RESULT_DY, buffer);
+
+		sprintf(buffer, " LOAD THROUGHPUT %4d KB/S (STOCK %d)", KBPerSecond(dataSize, result->load_time),
+			KBPerSecond(dataSize, Calib_ToStock(result->load_time, CALIB_CD)));
+		drawTextList(ctx, xPos, &yPos, 0, RESULT_DY, buffer);
+
+		// Only the muxed read is meant to be continuous.
+		if(i == METHOD_MUXED)
+		{
+			sprintf(buffer, " DRIVE RESTARTS %d", result->restarts);
+			drawTextList(ctx, xPos, &yPos, 0, RESULT_DY, buffer);
+		}
+
+		sprintf(buffer, " MIN FILL %d KB, UNDERRUNS %d", result->min_fill / 1024, result->underruns);
+		drawTextList(ctx, xPos, &yPos, 0, RESULT_DY + 4, buffer);
+	}
+
+	sprintf(buffer, "DATA CHECK: %s",
+		(results[METHOD_MUXED].checksum == results[METHOD_SEPARATE].checksum) ? "OK" : "MISMATCH");
+	drawTextList(ctx, xPos, &yPos, 0, RESULT_DY * 2, buffer);
+
+	drawTextList(ctx, xPos, &yPos, 0, RESULT_DY, "[X] RUN AGAIN");
+}
+
+static void HandleMuxBenchCommands(PADTYPE* pad)
+{
+	Bench_RequestRun(&run, pad, PAD_CROSS);
+}
+
+const BenchMode bench_mode =
+{
+	.init            = &InitMuxBench,
+	.handle_commands = &HandleMuxBenchCommands,
+	.draw            = &DrawMuxBench
+};
@@ -0,0 +1,359 @@
+/*
+ * ps1-benchmark controller polling test (overlay)
+ *
+ * Measures how many CPU cycles per frame the BIOS pad driver takes away from
+ * the program, by timing a fixed busy loop spanning several frames with the
+ * driver running and stopped, and compares that with the cost of reading the
+ * controllers directly (see pad.h): port 1 only, both ports, and both ports
+ * through multitaps (up to eight controllers). Which controllers and
+ * multitaps are actually plugged in is detected and shown, as the BIOS
+ * driver's cost depends on it.
+ *
+ * Input can also be read live by either driver, to compare how old the input
+ * is by the time the main loop processes it: the BIOS driver polls during
+ * vblank, while the direct driver polls once per frame either early (at the
+ * start of drawing) or late (right before the frame is flipped, just ahead of
+ * the next frame's input processing). When reading directly, the result is
+ * written to the buffer the BIOS driver would have filled, so the menu keeps
+ * working.
+ */
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <psxgpu.h>
+#include <psxpad.h>
+#include <psxapi.h>
+
+#include "bench.h"
+#include "timer.h"
+#include "calib.h"
+#include "pad.h"
+
+#define NUM_PORTS    2
+#define POLL_RUNS    16
+#define AGE_FRAMES   60
+
+// The busy loop (Calib_Spin()) lasts about half a second.
+#define SPIN_LOOPS   8000000
+#define SPIN_RUNS    2
+
+enum pollMethod
+{
+	METHOD_BIOS = 0,
+	METHOD_EARLY,
+	METHOD_LATE,
+	NUM_METHODS
+};
+
+enum directConfig
+{
+	DIRECT_PORT1 = 0,
+	DIRECT_BOTH,
+	DIRECT_TAPS,
+	NUM_CONFIGS
+};
+
+static const char *const methodNames[NUM_METHODS] = { "BIOS", "EARLY", "LATE" };
+static const char *const configNames[NUM_CONFIGS] = { "PORT 1", "BOTH PORTS", "MULTITAPS" };
+
+// Detected devices
+static int portPads[NUM_PORTS];
+static bool portTap[NUM_PORTS];
+
+// Cycles per frame
+static int biosCycles;
+static uint32_t directCycles[NUM_CONFIGS];
+
+static BenchRun run;
+
+// Live polling
+static int method = METHOD_BIOS;
+static PADTYPE *padBuffer = 0;
+static void (*oldVSyncCallback)(void) = 0;
+static volatile Timer_Ticks lastVBlank = 0;
+static Timer_Ticks sampleTime = 0;
+static Timer_Ticks ageTotal = 0;
+static int ageFrames = 0;
+static Timer_Ticks ages[NUM_METHODS];
+
+static uint8_t pollBuffer[PAD_BUFFER_SIZE];
+
+/* BIOS driver */
+
+static void StopBiosPad(void)
+{
+	StopPAD();
+}
+
+static void StartBiosPad(void)
+{
+	StartPAD();
+	ChangeClearPAD(0);
+}
+
+static void VBlankHandler(void)
+{
+	lastVBlank = Timer_GetTicks();
+
+	if(oldVSyncCallback)
+		oldVSyncCallback();
+}
+
+/* Measurement */
+
+// Returns the fastest time taken by the busy loop, with interrupts enabled.
+static Timer_Ticks TimeSpin(int *vblanks)
+{
+	Timer_Ticks best = 0xffffffff;
+
+	for(int i = 0; i < SPIN_RUNS; i++)
+	{
+		int frame = VSync(-1);
+		Timer_Ticks start = Timer_GetTicks();
+
+		Calib_Spin(SPIN_LOOPS);
+
+		Timer_Ticks time = Timer_GetTicks() - start;
+
+		if(time < best)
+		{
+			best = time;
+			*vblanks = VSync(-1) - frame;
+		}
+	}
+
+	return best;
+}
+
+static void DetectDevices(void)
+{
+	for(int port = 0; port < NUM_PORTS; port++)
+	{
+		portPads[port] = 0;
+		portTap[port]  = false;
+
+		if(!Pad_Poll(port, pollBuffer, true))
+			continue;
+
+		if(pollBuffer[1] != PAD_TAP_ID)
+		{
+			portPads[port] = 1;
+			continue;
+		}
+
+		portTap[port] = true;
+
+		for(int slot = 0; slot < PAD_TAP_SLOTS; slot++)
+		{
+			if(!pollBuffer[2 + slot * 8])
+				portPads[port]++;
+		}
+	}
+}
+
+static uint32_t TimeDirect(int config)
+{
+	Timer_Ticks start = Timer_GetTicks();
+
+	for(int i = 0; i < POLL_RUNS; i++)
+	{
+		Pad_Poll(0, pollBuffer, config == DIRECT_TAPS);
+
+		if(config != DIRECT_PORT1)
+			Pad_Poll(1, pollBuffer, config == DIRECT_TAPS);
+	}
+
+	// Polling is bound by the serial port's baud rate rather than the CPU, so
+	// the time is left as measured.
+	return Timer_TicksToCycles(Timer_GetTicks() - start) / POLL_RUNS;
+}
+
+static void RunBenchmark(void)
+{
+	int onFrames = 1, offFrames = 1;
+
+	StartBiosPad();
+	Timer_Ticks onTime = TimeSpin(&onFrames);
+
+	StopBiosPad();
+	Timer_Ticks offTime = TimeSpin(&offFrames);
+
+	// Any difference not caused by the driver (e.g. the audio stream's IRQ
+	// handler) is averaged out over the frames.
+	biosCycles = (
+		(int) Calib_TicksToStockCycles(onTime, CALIB_CPU) -
+		(int) Calib_TicksToStockCycles(offTime, CALIB_CPU)
+	) /
+		(onFrames ? onFrames : 1);
+
+	DetectDevices();
+
+	for(int config = 0; config < NUM_CONFIGS; config++)
+		directCycles[config] = TimeDirect(config);
+
+	if(method == METHOD_BIOS)
+		StartBiosPad();
+}
+
+/* Live polling */
+
+static void PollDirect(void)
+{
+	if(!padBuffer)
+		return;
+
+	Pad_Poll(0, (uint8_t *) padBuffer, false);
+	sampleTime = Timer_GetTicks();
+}
+
+static void SetMethod(int newMethod)
+{
+	if((method == METHOD_BIOS) && (newMethod != METHOD_BIOS))
+		StopBiosPad();
+	if((method != METHOD_BIOS) && (newMethod == METHOD_BIOS))
+		StartBiosPad();
+
+	method    = newMethod;
+	ageTotal  = 0;
+	ageFrames = 0;
+}
+
+static void RecordAge(void)
+{
+	Timer_Ticks sampled = (method == METHOD_BIOS) ? lastVBlank : sampleTime;
+
+	ageTotal += Timer_GetTicks() - sampled;
+
+	if(++ageFrames >= AGE_FRAMES)
+	{
+		ages[method] = ageTotal / AGE_FRAMES;
+		ageTotal  = 0;
+		ageFrames = 0;
+	}
+}
+
+/* Mode callbacks */
+
+static void InitPadBench(void)
+{
+	Bench_ResetRun(&run);
+	method = METHOD_BIOS;
+	ageTotal = 0;
+	ageFrames = 0;
+
+	for(int i = 0; i < NUM_METHODS; i++)
+		ages[i] = 0;
+
+	oldVSyncCallback = (void (*)(void)) VSyncCallback(&VBlankHandler);
+}
+
+static void PausePadBench(void)
+{
+	// The menu relies on the BIOS driver.
+	SetMethod(METHOD_BIOS);
+}
+
+static void EndPadBench(void)
+{
+	PausePadBench();
+	VSyncCallback(oldVSyncCallback);
+}
+
+static void DrawResults(RenderContext* ctx, int xPos, int *yPos)
+{
+	char buffer[128];
+
+	for(int port = 0; port < NUM_PORTS; port++)
+	{
+		if(portTap[port])
+			sprintf(buffer, "PORT %d: MULTITAP, %d PADS", port + 1, portPads[port]);
+		else
+			sprintf(buffer, "PORT %d: %s", port + 1, portPads[port] ? "PAD" : "EMPTY");
+
+		drawTextList(ctx, xPos, yPos, 0, RESULT_DY, buffer);
+	}
+
+	*yPos += RESULT_DY;
+
+	sprintf(buffer, "BIOS DRIVER: %d CYCLES/FRAME", biosCycles);
+	drawTextList(ctx, xPos, yPos, 0, RESULT_DY * 2, buffer);
+
+	drawTextList(ctx, xPos, yPos, 0, RESULT_DY, "DIRECT       CYCLES  RECLAIMED");
+
+	for(int config = 0; config < NUM_CONFIGS; config++)
+	{
+		sprintf(buffer, "%-12s %6d %+10d", configNames[config], directCycles[config],
+			biosCycles - (int) directCycles[config]);
+		drawTextList(ctx, xPos, yPos, 0, RESULT_DY, buffer);
+	}
+
+	*yPos += RESULT_DY;
+}
+
+static void DrawPadBench(RenderContext* ctx)
+{
+	char buffer[128];
+	int xPos = 8;
+	int yPos = RESULT_START_Y;
+
+	if(method == METHOD_EARLY)
+		PollDirect();
+
+	if(Bench_DrawPending(&run, ctx, xPos, &yPos))
+		return;
+	if(Bench_ShouldRun(&run))
+		RunBenchmark();
+
+	drawTextList(ctx, xPos, &yPos, 0, RESULT_DY * 2, "CONTROLLER POLLING COST");
+
+	if(run.state == BENCH_DONE)
+		DrawResults(ctx, xPos, &yPos);
+
+	// Ages depend on the frame rate rather than on any clock speed.
+	drawTextList(ctx, xPos, &yPos, 0, RESULT_DY, "INPUT AGE WHEN PROCESSED:");
+
+	for(int i = 0; i < NUM_METHODS; i++)
+	{
+		if(ages[i])
+			sprintf(buffer, "  %-6s %6d US", methodNames[i], Timer_TicksToUs(ages[i]));
+		else
+			sprintf(buffer, "  %-6s      -", methodNames[i]);
+
+		drawTextList(ctx, xPos, &yPos, 0, RESULT_DY, buffer);
+	}
+
+	yPos += RESULT_DY;
+
+	sprintf(buffer, "[SQUARE] POLLING: %s", methodNames[method]);
+	drawTextList(ctx, xPos, &yPos, 0, RESULT_DY, buffer);
+	drawTextList(ctx, xPos, &yPos, 0, RESULT_DY, "[X]      MEASURE COST");
+
+	if(method == METHOD_LATE)
+		PollDirect();
+}
+
+static void HandlePadBenchCommands(PADTYPE* pad)
+{
+	padBuffer = pad;
+
+	if(sampleTime || (method == METHOD_BIOS))
+		RecordAge();
+
+	Bench_RequestRun(&run, pad, PAD_CROSS);
+
+	if((lastButtons & PAD_SQUARE) && !(pad->btn & PAD_SQUARE))
+	{
+		sampleTime = 0;
+		SetMethod((method + 1) % NUM_METHODS);
+	}
+}
+
+const BenchMode bench_mode =
+{
+	.init            = &InitPadBench,
+	.end             = &EndPadBench,
+	.pause           = &PausePadBench,
+	.handle_commands = &HandlePadBenchCommands,
+	.draw            = &DrawPadBench
+};
@@ -0,0 +1,405 @@
+/*
+ * ps1-benchmark procedural texture test (overlay)
+ *
+ * Software effects compute textures on the CPU every frame and upload them to
+ * VRAM with LoadImage(). This test generates up to four 128x128 8bpp layers
+ * each frame, with one of two effects:
+ *
+ * - Plasma: the sum of three sine waves looked up in a table, which is cheap
+ *   per texel and only writes to RAM.
+ * - Rotozoom: a small source texture rotated and scaled by stepping through it
+ *   with fixed point coordinates, standing in for a software-rendered layer.
+ *
+ * Layers are generated in bands of 16 rows, each uploaded as soon as it is
+ * done. With a single band buffer, the CPU must wait for each upload to be
+ * complete before generating the next band into it; with two, the next band
+ * is generated while the previous one is being uploaded, and the CPU only
+ * waits if the upload takes longer than generating a band.
+ *
+ * The time spent generating, the time spent waiting for uploads and the total
+ * time (until the last upload is complete) are averaged over a second, along
+ * with the resulting rates in thousands of texels per second.
+ */
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <psxgpu.h>
+#include <psxgte.h>
+#include <psxpad.h>
+
+#include "bench.h"
+#include "timer.h"
+#include "calib.h"
+#include "vram.h"
+
+#define MAX_LAYERS    4
+#define LAYER_SIZE    128 // In texels
+#define BAND_ROWS     16
+#define NUM_BANDS     (LAYER_SIZE / BAND_ROWS)
+#define STATS_FRAMES  60
+
+#define SOURCE_SIZE   64
+#define SOURCE_MASK   (SOURCE_SIZE - 1)
+
+#define QUAD_SIZE     64
+#define QUAD_STEP     72
+#define QUADS_X       16
+#define QUADS_Y       152
+
+enum effect
+{
+	EFFECT_PLASMA = 0,
+	EFFECT_ROTOZOOM,
+	NUM_EFFECTS
+};
+
+typedef void (*GenerateFunc)(uint8_t *band, int y0, int time);
+
+static const char *const effectNames[NUM_EFFECTS] = { "PLASMA", "ROTOZOOM" };
+static const int layerCounts[] = { 1, 2, 4 };
+
+#define NUM_LAYER_COUNTS (sizeof(layerCounts) / sizeof(int))
+
+// Band buffers, word aligned for LoadImage()
+static uint32_t bands[2][(LAYER_SIZE * BAND_ROWS) / 4];
+
+static uint8_t  sine[256];
+static uint8_t  source[SOURCE_SIZE * SOURCE_SIZE];
+static uint16_t palette[256];
+
+static RECT layerRects[MAX_LAYERS];
+static RECT clutRect;
+static int  allocatedLayers = 0;
+static bool clutAllocated = false;
+
+static int effect = EFFECT_PLASMA;
+static int layerChoice = 0;
+static bool doubleBuffered = true;
+static int frame = 0;
+static const char *error = 0;
+
+static Timer_Ticks waitTicks = 0;
+
+// Totals over the current second, and averages over the previous one
+static Timer_Ticks generateTotal = 0, waitTotal = 0, frameTotal = 0;
+static Timer_Ticks generateAverage = 0, waitAverage = 0, frameAverage = 0;
+static int statsFrames = 0;
+
+/* Tables */
+
+static void InitTables(void)
+{
+	// 0 to 128; sums of waves wrap around, as the palette does
+	for(int i = 0; i < 256; i++)
+		sine[i] = (isin(i << 4) + ONE) >> 6;
+
+	// The palette wraps around smoothly. All colors have the STP bit set, so
+	// black is not transparent.
+	for(int i = 0; i < 256; i++)
+	{
+		int r = sine[i] >> 2;
+		int g = sine[(i + 85) & 255] >> 2;
+		int b = sine[(i + 170) & 255] >> 2;
+
+		palette[i] = 0x8000 | (r > 31 ? 31 : r) | ((g > 31 ? 31 : g) << 5) |
+			((b > 31 ? 31 : b) << 10);
+	}
+
+	// Checkerboard with a gradient, so rotation and scaling are easy to see
+	for(int y = 0; y < SOURCE_SIZE; y++)
+	{
+		for(int x = 0; x < SOURCE_SIZE; x++)
+			source[y * SOURCE_SIZE + x] = (((x ^ y) & 16) ? 128 : 0) + x + y;
+	}
+}
+
+/* Effects */
+
+static void GeneratePlasma(uint8_t *band, int y0, int time)
+{
+	uint8_t xWave[LAYER_SIZE];
+
+	for(int x = 0; x < LAYER_SIZE; x++)
+		xWave[x] = sine[(x * 2 + time) & 255];
+
+	for(int y = y0; y < (y0 + BAND_ROWS); y++)
+	{
+		int yWave = sine[(y * 3 - time) & 255];
+		int diagonal = y + time * 2;
+
+		for(int x = 0; x < LAYER_SIZE; x++)
+			*(band++) = xWave[x] + yWave + sine[(x + diagonal) & 255];
+	}
+}
+
+static void GenerateRotozoom(uint8_t *band, int y0, int time)
+{
+	int angle = time * 16;
+	int scale = ONE + isin(time * 24) / 2;
+
+	// Step per texel in the source texture, in 20.12 fixed point
+	int du = (icos(angle) * scale) >> 12;
+	int dv = (isin(angle) * scale) >> 12;
+
+	for(int y = y0; y < (y0 + BAND_ROWS); y++)
+	{
+		int cy = y - (LAYER_SIZE / 2);
+		int u  = (time << 12) - (LAYER_SIZE / 2) * du - cy * dv;
+		int v  = (time << 11) - (LAYER_SIZE / 2) * dv + cy * du;
+
+		for(int x = 0; x < LAYER_SIZE; x++)
+		{
+			*(band++) = source[(((v >> 12) & SOURCE_MASK) * SOURCE_SIZE) + ((u >> 12) & SOURCE_MASK)];
+			u += du;
+			v += dv;
+		}
+	}
+}
+
+static const GenerateFunc generators[NUM_EFFECTS] = { &GeneratePlasma, &GenerateRotozoom };
+
+/* Streaming */
+
+static void WaitUploads(void)
+{
+	Timer_Ticks start = Timer_GetTicks();
+
+	DrawSync(0);
+	waitTicks += Timer_GetTicks() - start;
+}
+
+// Generates and uploads all layers, returning the time spent generating.
+static Timer_Ticks StreamLayers(void)
+{
+	GenerateFunc generate = generators[effect];
+	Timer_Ticks generateTicks = 0;
+	int count = 0;
+
+	for(int layer = 0; layer < layerCounts[layerChoice]; layer++)
+	{
+		int time = frame + layer * 37;
+
+		for(int b = 0; b < NUM_BANDS; b++, count++)
+		{
+			uint8_t *band = (uint8_t *) bands[doubleBuffered ? (count & 1) : 0];
+			RECT rect;
+
+			Timer_Ticks start = Timer_GetTicks();
+			generate(band, b * BAND_ROWS, time);
+			generateTicks += Timer_GetTicks() - start;
+
+			// An 8bpp pixel holds two texels.
+			setRECT(&rect, layerRects[layer].x, layerRects[layer].y + b * BAND_ROWS,
+				LAYER_SIZE / 2, BAND_ROWS);
+
+			// With two buffers, only the previous band's upload has to be
+			// complete before queuing this one, which then runs while the next
+			// band is generated into the other buffer.
+			if(doubleBuffered)
+			{
+				WaitUploads();
+				LoadImage(&rect, (const uint32_t *) band);
+			}
+			else
+			{
+				LoadImage(&rect, (const uint32_t *) band);
+				WaitUploads();
+			}
+		}
+	}
+
+	WaitUploads();
+	return generateTicks;
+}
+
+static void AccumulateStats(Timer_Ticks generateTicks, Timer_Ticks frameTicks)
+{
+	generateTotal += generateTicks;
+	waitTotal     += waitTicks;
+	frameTotal    += frameTicks;
+
+	if(++statsFrames < STATS_FRAMES)
+		return;
+
+	generateAverage = generateTotal / STATS_FRAMES;
+	waitAverage     = waitTotal / STATS_FRAMES;
+	frameAverage    = frameTotal / STATS_FRAMES;
+	generateTotal   = 0;
+	waitTotal       = 0;
+	frameTotal      = 0;
+	statsFrames     = 0;
+}
+
+static void ResetStats(void)
+{
+	generateTotal   = waitTotal   = frameTotal   = 0;
+	generateAverage = waitAverage = frameAverage = 0;
+	statsFrames     = 0;
+}
+
+/* Display */
+
+static void DrawLayers(RenderContext* ctx)
+{
+	for(int layer = 0; layer < layerCounts[layerChoice]; layer++)
+	{
+		const RECT *rect = &layerRects[layer];
+		POLY_FT4 *poly = new_primitive(ctx, 1, sizeof(POLY_FT4));
+		int x = QUADS_X + layer * QUAD_STEP;
+		int y = QUADS_Y;
+
+		setPolyFT4(poly);
+		setXY4(poly, x, y, x + QUAD_SIZE, y, x, y + QUAD_SIZE, x + QUAD_SIZE, y + QUAD_SIZE);
+		setRGB0(poly, 128, 128, 128);
+		setUVWH(poly, (rect->x % 64) * 2, rect->y % 256, LAYER_SIZE - 1, LAYER_SIZE - 1);
+		poly->tpage = getTPage(1, 0, rect->x, rect->y);
+		poly->clut  = getClut(clutRect.x, clutRect.y);
+	}
+}
+
+// Thousands of texels per second, for a number of texels per frame
+static int GetRate(int texels, int us)
+{
+	return us ? ((texels * 1000) / us) : 0;
+}
+
+static void DrawStats(RenderContext* ctx, int xPos, int *yPos)
+{
+	char buffer[128];
+	int texels = layerCounts[layerChoice] * LAYER_SIZE * LAYER_SIZE;
+
+	// Generation is normalized to stock CPU speed. Waiting and whole frames
+	// are bound by the GPU and the display rather than the CPU, so those
+	// times are left as measured.
+	int generateUs = Calib_TicksToStockUs(generateAverage, CALIB_CPU);
+	int frameUs    = Timer_TicksToUs(frameAverage);
+
+	sprintf(buffer, "TEXELS/FRAME   %7d", texels);
+	drawTextList(ctx, xPos, yPos, 0, RESULT_DY, buffer);
+	sprintf(buffer, "GENERATE TIME  %7d US", generateUs);
+	drawTextList(ctx, xPos, yPos, 0, RESULT_DY, buffer);
+	sprintf(buffer, "WAIT TIME      %7d US", Timer_TicksToUs(waitAverage));
+	drawTextList(ctx, xPos, yPos, 0, RESULT_DY, buffer);
+	sprintf(buffer, "TOTAL TIME     %7d US", frameUs);
+	drawTextList(ctx, xPos, yPos, 0, RESULT_DY, buffer);
+
+	sprintf(buffer, "GENERATED      %7d KTEXELS/S", GetRate(texels, generateUs));
+	drawTextList(ctx, xPos, yPos, 0, RESULT_DY, buffer);
+	sprintf(buffer, "STREAMED       %7d KTEXELS/S", GetRate(texels, frameUs));
+	drawTextList(ctx, xPos, yPos, 0, RESULT_DY, buffer);
+
+	*yPos += RESULT_DY;
+}
+
+/* Mode callbacks */
+
+static void EndProcTex(void)
+{
+	// Uploads may still be reading from the band buffers.
+	DrawSync(0);
+
+	for(int i = 0; i < allocatedLayers; i++)
+		Vram_Free(&layerRects[i]);
+
+	if(clutAllocated)
+		Vram_FreeClut(&clutRect);
+
+	allocatedLayers = 0;
+	clutAllocated = false;
+}
+
+static void InitProcTex(void)
+{
+	effect = EFFECT_PLASMA;
+	layerChoice = NUM_LAYER_COUNTS - 1;
+	doubleBuffered = true;
+	frame = 0;
+	error = 0;
+
+	InitTables();
+	ResetStats();
+
+	for(; allocatedLayers < MAX_LAYERS; allocatedLayers++)
+	{
+		if(!Vram_Alloc(1, LAYER_SIZE / 2, LAYER_SIZE, &layerRects[allocatedLayers]))
+			break;
+	}
+
+	clutAllocated = Vram_AllocClut(256, 1, &clutRect);
+
+	if((allocatedLayers < MAX_LAYERS) || !clutAllocated)
+	{
+		error = "NO FREE VRAM";
+		EndProcTex();
+		return;
+	}
+
+	LoadImage(&clutRect, (const uint32_t *) palette);
+	DrawSync(0);
+}
+
+static void DrawProcTex(RenderContext* ctx)
+{
+	char buffer[128];
+	int xPos = 8;
+	int yPos = RESULT_START_Y;
+
+	if(error)
+	{
+		drawTextList(ctx, xPos, &yPos, 0, RESULT_DY, error);
+		return;
+	}
+
+	// Start with the GPU idle, so only the uploads are waited for.
+	DrawSync(0);
+	waitTicks = 0;
+
+	Timer_Ticks start = Timer_GetTicks();
+	Timer_Ticks generateTicks = StreamLayers();
+
+	AccumulateStats(generateTicks, Timer_GetTicks() - start);
+	frame++;
+
+	DrawLayers(ctx);
+
+	drawTextList(ctx, xPos, &yPos, 0, RESULT_DY * 2, "PROCEDURAL TEXTURES");
+
+	DrawStats(ctx, xPos, &yPos);
+
+	sprintf(buffer, "[SQUARE] EFFECT: %s", effectNames[effect]);
+	drawTextList(ctx, xPos, &yPos, 0, RESULT_DY, buffer);
+	sprintf(buffer, "[CIRCLE] BUFFERS: %s", doubleBuffered ? "DOUBLE" : "SINGLE");
+	drawTextList(ctx, xPos, &yPos, 0, RESULT_DY, buffer);
+	sprintf(buffer, "[TRIANGLE] LAYERS: %d", layerCounts[layerChoice]);
+	drawTextList(ctx, xPos, &yPos, 0, RESULT_DY, buffer);
+}
+
+static void HandleProcTexCommands(PADTYPE* pad)
+{
+	if((lastButtons & PAD_SQUARE) && !(pad->btn & PAD_SQUARE))
+	{
+		effect = (effect + 1) % NUM_EFFECTS;
+		ResetStats();
+	}
+
+	if((lastButtons & PAD_CIRCLE) && !(pad->btn & PAD_CIRCLE))
+	{
+		doubleBuffered = !doubleBuffered;
+		ResetStats();
+	}
+
+	if((lastButtons & PAD_TRIANGLE) && !(pad->btn & PAD_TRIANGLE))
+	{
+		layerChoice = (layerChoice + 1) % NUM_LAYER_COUNTS;
+		ResetStats();
+	}
+}
+
+const BenchMode bench_mode =
+{
+	.init            = &InitProcTex,
+	.end             = &EndProcTex,
+	.handle_commands = &HandleProcTexCommands,
+	.draw            = &DrawProcTex
+};
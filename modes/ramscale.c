@@ -0,0 +1,338 @@
+/*
+ * ps1-benchmark RAM scaling test (overlay)
+ *
+ * Shows how much RAM was detected and the buffer configuration picked for it
+ * (see ram.h), then ramps up the number of objects drawn by the stress test
+ * workload, doubling it every few frames, to find out what limits it. Objects
+ * are drawn into a double-buffered packet arena of the size given by the
+ * configuration (allocated past 2 MB on consoles with 8 MB of RAM), instead of
+ * the resident render buffers.
+ *
+ * Each step is classified by what keeps it from running at full frame rate:
+ * the CPU if the time spent emitting primitives alone takes up the extra
+ * frames, the GPU otherwise. The ramp stops once the arena or the object
+ * arrays are full; with 2 MB of RAM that happens long before the frame rate
+ * drops, i.e. object count is memory-bound, while with 8 MB it is not.
+ */
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <psxgpu.h>
+#include <psxpad.h>
+
+#include "bench.h"
+#include "timer.h"
+#include "calib.h"
+#include "ram.h"
+#include "tilesc.h"
+
+#define MAX_STEPS     8
+#define STEP_FRAMES   32
+#define WARMUP_FRAMES 2
+
+// Room left in each arena for the text drawn on top of the objects, and the
+// largest primitive draw_rectangle() emits.
+#define TEXT_RESERVE  2048
+#define OBJECT_SIZE   sizeof(POLY_FT4)
+
+// The test runs over several frames rather than blocking, so it only shares
+// the idle and done states with the others (see bench.h).
+enum ramScaleState
+{
+	BENCH_RAMPING = BENCH_NUM_STATES
+};
+
+enum stepLimit
+{
+	LIMIT_NONE = 0,
+	LIMIT_CPU,
+	LIMIT_GPU
+};
+
+enum rampLimit
+{
+	RAMP_ARENA = 0,
+	RAMP_OBJECTS
+};
+
+typedef struct
+{
+	int         count;
+	Timer_Ticks cpuTime, frameTime;
+	int         limit;
+} Step;
+
+static const char *const stepLimitNames[] = { "-", "CPU", "GPU" };
+static const char *const rampLimitNames[] = { "PACKET ARENA", "OBJECT ARRAYS" };
+
+static Step steps[MAX_STEPS];
+static int numSteps = 0;
+static int maxCount = 0;
+static int rampLimit = RAMP_ARENA;
+
+static int state = BENCH_IDLE;
+static int stepFrames = 0;
+static Timer_Ticks lastFrame = 0;
+static const char *error = 0;
+
+// Object arrays and packet arena, both allocated with Ram_Alloc()
+static int *objects = 0;
+static int *x, *y, *dx, *dy;
+static void **tiles;
+static uint8_t *arena = 0;
+
+/* Setup */
+
+static bool AllocateBuffers(void)
+{
+	const Ram_Config *config = Ram_GetConfig();
+	int count = config->max_objects;
+
+	objects = Ram_Alloc(count * (sizeof(int) * 4 + sizeof(void *)));
+	arena   = Ram_Alloc(config->packet_arena * 2);
+
+	if(!objects || !arena)
+		return false;
+
+	x     = objects;
+	y     = &x[count];
+	dx    = &y[count];
+	dy    = &dx[count];
+	tiles = (void **) &dy[count];
+
+	for(int i = 0; i < count; i++)
+	{
+		x[i]  = rand() % (SCREEN_XRES - BASE_W);
+		y[i]  = rand() % (SCREEN_YRES - BASE_H);
+		dx[i] = rand() % 6 + 1;
+		dy[i] = rand() % 6 + 1;
+	}
+
+	// The ramp stops at whichever runs out first.
+	int arenaCount = (config->packet_arena - TEXT_RESERVE) / OBJECT_SIZE;
+
+	maxCount  = (arenaCount < count) ? arenaCount : count;
+	rampLimit = (arenaCount < count) ? RAMP_ARENA : RAMP_OBJECTS;
+	return true;
+}
+
+static void FreeBuffers(void)
+{
+	// Freed in reverse order, so that the RAM past 2 MB is reclaimed.
+	Ram_Free(arena);
+	Ram_Free(objects);
+
+	arena   = 0;
+	objects = 0;
+}
+
+/* Ramp */
+
+static void StartRamp(void)
+{
+	numSteps   = 0;
+	stepFrames = 0;
+
+	steps[0].count     = (NUM_RECTANGLES < maxCount) ? NUM_RECTANGLES : maxCount;
+	steps[0].cpuTime   = 0;
+	steps[0].frameTime = 0;
+
+	state = BENCH_RAMPING;
+}
+
+static void FinishStep(Step *step)
+{
+	Timer_Ticks vblank = Calib_GetInfo()->measured[CALIB_TIMER];
+	int frames = STEP_FRAMES - WARMUP_FRAMES;
+
+	step->cpuTime   /= frames;
+	step->frameTime /= frames;
+
+	// Allow some jitter before deciding that a frame was missed.
+	if(step->frameTime <= (vblank + vblank / 8))
+		step->limit = LIMIT_NONE;
+	else if(step->cpuTime > (step->frameTime - vblank))
+		step->limit = LIMIT_CPU;
+	else
+		step->limit = LIMIT_GPU;
+
+	numSteps++;
+
+	int next = step->count * 2;
+
+	if((step->count >= maxCount) || (numSteps >= MAX_STEPS))
+	{
+		state = BENCH_DONE;
+		return;
+	}
+
+	steps[numSteps].count     = (next < maxCount) ? next : maxCount;
+	steps[numSteps].cpuTime   = 0;
+	steps[numSteps].frameTime = 0;
+	stepFrames = 0;
+}
+
+static void DrawObjects(RenderContext* ctx, Step *step)
+{
+	Timer_Ticks start = Timer_GetTicks();
+
+	for(int i = 0; i < step->count; i++)
+	{
+		update_position(&x[i], &y[i], &dx[i], &dy[i], BASE_W, BASE_H);
+		draw_rectangle(ctx, &tiles[i], useTexture, TILESC_SPHERE_U, TILESC_SPHERE_V,
+			x[i], y[i], 1 + i % NUM_RECTANGLES, BASE_W, BASE_H, 128, 128, 128);
+	}
+
+	Timer_Ticks end = Timer_GetTicks();
+
+	// The time between two calls includes waiting for the GPU and vblank in
+	// flip_buffers().
+	if(stepFrames >= WARMUP_FRAMES)
+	{
+		step->cpuTime   += end - start;
+		step->frameTime += start - lastFrame;
+	}
+
+	lastFrame = start;
+
+	if(++stepFrames >= STEP_FRAMES)
+		FinishStep(step);
+}
+
+/* Mode callbacks */
+
+static void InitRamScale(void)
+{
+	state = BENCH_IDLE;
+	numSteps = 0;
+	error = 0;
+
+	if(!AllocateBuffers())
+	{
+		FreeBuffers();
+		error = "OUT OF MEMORY";
+	}
+}
+
+static void EndRamScale(void)
+{
+	// Primitives in the arena may still be queued for drawing.
+	DrawSync(0);
+	FreeBuffers();
+}
+
+static void DrawConfig(RenderContext* ctx, int xPos, int *yPos)
+{
+	const Ram_Config *config = Ram_GetConfig();
+	char buffer[128];
+	size_t used;
+	size_t extra = Ram_GetExtraUsage(&used);
+
+	sprintf(buffer, "RAM %d MB, %d/%d KB PAST 2 MB USED", config->ram_size >> 20,
+		used >> 10, extra >> 10);
+	drawTextList(ctx, xPos, yPos, 0, RESULT_DY, buffer);
+
+	sprintf(buffer, "ARENA 2X%d KB, MAX %d OBJECTS", config->packet_arena >> 10,
+		config->max_objects);
+	drawTextList(ctx, xPos, yPos, 0, RESULT_DY, buffer);
+
+	sprintf(buffer, "STREAM %d KB/TRACK, RENDER 2X%d KB", config->stream_buffer >> 10,
+		config->render_buffer >> 10);
+	drawTextList(ctx, xPos, yPos, 0, RESULT_DY, buffer);
+
+	sprintf(buffer, "SECTOR CACHE %d, RESIDENT AUDIO %s", config->cache_sectors,
+		config->resident_audio ? "ON" : "OFF");
+	drawTextList(ctx, xPos, yPos, 0, RESULT_DY * 2, buffer);
+}
+
+static void DrawResults(RenderContext* ctx, int xPos, int *yPos)
+{
+	char buffer[128];
+
+	drawTextList(ctx, xPos, yPos, 0, RESULT_DY, " OBJS  CPU US FRAME US  FPS LIMIT");
+
+	// CPU time is normalized to stock CPU speed. Frame time and frame rate are
+	// bound by the GPU and the display, so they are left as measured.
+	for(int i = 0; i < numSteps; i++)
+	{
+		const Step *step = &steps[i];
+
+		sprintf(buffer, "%5d %7d %8d %4d %s", step->count, Calib_TicksToStockUs(step->cpuTime, CALIB_CPU),
+			Timer_TicksToUs(step->frameTime),
+			step->frameTime ? (TIMER_CLOCK / step->frameTime) : 0, stepLimitNames[step->limit]);
+		drawTextList(ctx, xPos, yPos, 0, RESULT_DY, buffer);
+	}
+
+	if(state != BENCH_DONE)
+		return;
+
+	// The ramp was cut short by memory if even the last step kept up.
+	const Step *last = &steps[numSteps - 1];
+
+	*yPos += RESULT_DY;
+
+	sprintf(buffer, "STOPPED AT %d: %s", last->count, rampLimitNames[rampLimit]);
+	drawTextList(ctx, xPos, yPos, 0, RESULT_DY, buffer);
+
+	sprintf(buffer, "OBJECT COUNT IS %s-BOUND",
+		(last->limit == LIMIT_NONE) ? "MEMORY" : stepLimitNames[last->limit]);
+	drawTextList(ctx, xPos, yPos, 0, RESULT_DY * 2, buffer);
+}
+
+static void DrawRamScale(RenderContext* ctx)
+{
+	char buffer[128];
+	int xPos = 8;
+	int yPos = RESULT_START_Y;
+
+	if(error)
+	{
+		drawTextList(ctx, xPos, &yPos, 0, RESULT_DY, error);
+		return;
+	}
+
+	if(state == BENCH_RAMPING)
+	{
+		Step *step = &steps[numSteps];
+		const Ram_Config *config = Ram_GetConfig();
+
+		// Draw everything into the arena for the current buffer.
+		ctx->next_packet = &arena[ctx->active_buffer * config->packet_arena];
+		ctx->packet_end  = ctx->next_packet + config->packet_arena;
+
+		sprintf(buffer, "RAMPING: %d OBJECTS", step->count);
+		drawTextList(ctx, xPos, &yPos, 0, RESULT_DY, buffer);
+
+		DrawObjects(ctx, step);
+		return;
+	}
+
+	drawTextList(ctx, xPos, &yPos, 0, RESULT_DY * 2, "RAM SCALING");
+	DrawConfig(ctx, xPos, &yPos);
+
+	if(numSteps)
+		DrawResults(ctx, xPos, &yPos);
+
+	drawTextList(ctx, xPos, &yPos, 0, RESULT_DY, "[X] RAMP UP OBJECT COUNT");
+}
+
+static void HandleRamScaleCommands(PADTYPE* pad)
+{
+	if(state == BENCH_RAMPING)
+	{
+		HandleTextureCommand(pad);
+		return;
+	}
+
+	if(!error && (lastButtons & PAD_CROSS) && !(pad->btn & PAD_CROSS))
+		StartRamp();
+}
+
+const BenchMode bench_mode =
+{
+	.init            = &InitRamScale,
+	.end             = &EndRamScale,
+	.handle_commands = &HandleRamScaleCommands,
+	.draw            = &DrawRamScale
+};
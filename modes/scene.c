@@ -0,0 +1,404 @@
+/*
+ * ps1-benchmark hierarchical transform test (overlay)
+ *
+ * Updates the world matrices of a scene graph with a fixed-depth hierarchy
+ * (a root with 6 children per node, 4 levels deep, 259 nodes) and compares
+ * composing each node's local matrix with its parent's world matrix on the
+ * GTE (CompMatrixLV()) against plain fixed-point multiplies on the CPU.
+ *
+ * Nodes are stored breadth first, so every parent comes before its children
+ * and the whole hierarchy is updated in a single pass, with no recursion or
+ * explicit matrix stack. Each method can update either every node, or only
+ * the nodes flagged as dirty: a node is dirty if its local matrix was changed
+ * by the animation since the last update or if its parent's world matrix was
+ * recomputed. Every frame the animation turns an eighth of the nodes.
+ *
+ * Results are given as nodes updated per frame at the console's refresh
+ * rate. For the dirty-flag methods this is the equivalent total number of
+ * nodes in the scene, i.e. taking into account that only some of them need
+ * updating each frame. The world matrices computed on the GTE are checked
+ * against the CPU's before timing.
+ */
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <psxgpu.h>
+#include <psxgte.h>
+#include <psxpad.h>
+#include <inline_c.h>
+
+#include "bench.h"
+#include "timer.h"
+#include "calib.h"
+
+#define NUM_CHILDREN  6
+#define NUM_LEVELS    4
+#define NUM_NODES     (1 + 6 + 36 + 216)
+#define ANIMATE_EVERY 8
+#define BENCH_FRAMES  64
+
+#define CAMERA_Z      480
+
+#define CHECK_TOLERANCE 2
+
+enum updateMethod
+{
+	METHOD_GTE_FULL = 0,
+	METHOD_CPU_FULL,
+	METHOD_GTE_DIRTY,
+	METHOD_CPU_DIRTY,
+	NUM_METHODS
+};
+
+static const char *const methodNames[NUM_METHODS] =
+{
+	"GTE ALL", "CPU ALL", "GTE DIRTY", "CPU DIRTY"
+};
+
+typedef struct
+{
+	MATRIX  local, world;
+	SVECTOR rotation;
+	VECTOR  offset;
+	int16_t parent;
+	uint8_t level, dirty;
+} Node;
+
+static Node *nodes = 0;
+static uint32_t animFrame = 0;
+
+// Average time and number of nodes updated per frame
+static Timer_Ticks times[NUM_METHODS];
+static int updated[NUM_METHODS];
+static bool gteValid = false;
+
+static BenchRun run;
+static int liveMethod = METHOD_GTE_DIRTY;
+static Timer_Ticks liveTime = 0;
+static int liveUpdated = 0;
+static const char *error = 0;
+
+/* Scene */
+
+static void SetLocal(Node *node)
+{
+	RotMatrix(&node->rotation, &node->local);
+	TransMatrix(&node->local, &node->offset);
+
+	node->dirty = 1;
+}
+
+static void BuildScene(void)
+{
+	static const int radius[NUM_LEVELS] = { 0, 160, 64, 24 };
+
+	int first = 0, count = 1, next = 1;
+
+	nodes[0].parent = -1;
+	nodes[0].level  = 0;
+	setVector(&nodes[0].rotation, 0, 0, 0);
+	setVector(&nodes[0].offset, 0, 0, 0);
+	SetLocal(&nodes[0]);
+
+	// Add children to each node of the previous level in turn.
+	for(int level = 1; level < NUM_LEVELS; level++)
+	{
+		for(int parent = first; parent < (first + count); parent++)
+		{
+			for(int i = 0; i < NUM_CHILDREN; i++, next++)
+			{
+				Node *node = &nodes[next];
+				int angle = (i * 4096) / NUM_CHILDREN;
+
+				node->parent = parent;
+				node->level  = level;
+				setVector(&node->rotation, 0, angle, 0);
+				setVector(&node->offset, (radius[level] * icos(angle)) >> 12,
+					(level & 1) ? 16 : -16, (radius[level] * isin(angle)) >> 12);
+				SetLocal(node);
+			}
+		}
+
+		first += count;
+		count *= NUM_CHILDREN;
+	}
+}
+
+// Turns every ANIMATE_EVERY-th node (a different set each frame), the root
+// included every now and then.
+static void Animate(void)
+{
+	animFrame++;
+
+	for(int i = animFrame % ANIMATE_EVERY; i < NUM_NODES; i += ANIMATE_EVERY)
+	{
+		nodes[i].rotation.vy += 24;
+		SetLocal(&nodes[i]);
+	}
+}
+
+/* Update */
+
+static void ComposeCPU(const MATRIX *p, const MATRIX *l, MATRIX *out)
+{
+	for(int r = 0; r < 3; r++)
+	{
+		int m0 = p->m[r][0], m1 = p->m[r][1], m2 = p->m[r][2];
+
+		out->m[r][0] = (m0 * l->m[0][0] + m1 * l->m[1][0] + m2 * l->m[2][0]) >> 12;
+		out->m[r][1] = (m0 * l->m[0][1] + m1 * l->m[1][1] + m2 * l->m[2][1]) >> 12;
+		out->m[r][2] = (m0 * l->m[0][2] + m1 * l->m[1][2] + m2 * l->m[2][2]) >> 12;
+		out->t[r]    = ((m0 * l->t[0] + m1 * l->t[1] + m2 * l->t[2]) >> 12) + p->t[r];
+	}
+}
+
+// Returns the number of nodes whose world matrix was recomputed.
+static int UpdateScene(int method)
+{
+	bool gte = (method == METHOD_GTE_FULL) || (method == METHOD_GTE_DIRTY);
+	bool all = (method == METHOD_GTE_FULL) || (method == METHOD_CPU_FULL);
+	int count = 0;
+
+	if(all || nodes[0].dirty)
+	{
+		nodes[0].world = nodes[0].local;
+		count++;
+	}
+
+	for(int i = 1; i < NUM_NODES; i++)
+	{
+		Node *node = &nodes[i];
+		Node *parent = &nodes[node->parent];
+
+		// Parents are updated (and their flags cleared) before their
+		// children, so propagate the flag down first.
+		node->dirty |= parent->dirty;
+
+		if(!all && !node->dirty)
+			continue;
+
+		if(gte)
+			CompMatrixLV(&parent->world, &node->local, &node->world);
+		else
+			ComposeCPU(&parent->world, &node->local, &node->world);
+
+		count++;
+	}
+
+	// Flags can only be cleared once all children have seen them.
+	for(int i = 0; i < NUM_NODES; i++)
+		nodes[i].dirty = 0;
+
+	return count;
+}
+
+static bool MatchesMatrix(const MATRIX *a, const MATRIX *b)
+{
+	for(int r = 0; r < 3; r++)
+	{
+		for(int c = 0; c < 3; c++)
+		{
+			if(!Bench_Matches(a->m[r][c], b->m[r][c], CHECK_TOLERANCE))
+				return false;
+		}
+
+		if(!Bench_Matches(a->t[r], b->t[r], CHECK_TOLERANCE))
+			return false;
+	}
+
+	return true;
+}
+
+// Returns true if updating the whole scene on the GTE gives the same world
+// matrices as on the CPU.
+static bool CheckGTE(void)
+{
+	MATRIX *reference = malloc(NUM_NODES * sizeof(MATRIX));
+	bool matches = true;
+
+	if(!reference)
+		return false;
+
+	UpdateScene(METHOD_CPU_FULL);
+
+	for(int i = 0; i < NUM_NODES; i++)
+		reference[i] = nodes[i].world;
+
+	UpdateScene(METHOD_GTE_FULL);
+
+	for(int i = 0; (i < NUM_NODES) && matches; i++)
+		matches = MatchesMatrix(&nodes[i].world, &reference[i]);
+
+	free(reference);
+	return matches;
+}
+
+static void RunBenchmark(void)
+{
+	gteValid = CheckGTE();
+
+	for(int method = 0; method < NUM_METHODS; method++)
+	{
+		Timer_Ticks total = 0;
+		int totalUpdated = 0;
+
+		// Start from an up to date scene, so the first frame does not have
+		// every node dirty.
+		UpdateScene(METHOD_GTE_FULL);
+
+		for(int frame = 0; frame < BENCH_FRAMES; frame++)
+		{
+			Animate();
+
+			Timer_Ticks start = Timer_GetTicks();
+			totalUpdated += UpdateScene(method);
+			total += Timer_GetTicks() - start;
+		}
+
+		times[method]   = total / BENCH_FRAMES;
+		updated[method] = totalUpdated / BENCH_FRAMES;
+	}
+}
+
+/* Display */
+
+static void DrawScene(RenderContext* ctx)
+{
+	MATRIX camera = { 0 };
+	VECTOR trans  = { 0, 0, CAMERA_Z };
+	SVECTOR tilt  = { 512, 0, 0 };
+
+	RotMatrix(&tilt, &camera);
+	TransMatrix(&camera, &trans);
+
+	gte_SetRotMatrix(&camera);
+	gte_SetTransMatrix(&camera);
+
+	// Draw the node origins; every other leaf is skipped to leave room for
+	// text in the render buffer.
+	for(int i = 0; i < NUM_NODES; i++)
+	{
+		const Node *node = &nodes[i];
+
+		if((node->level == (NUM_LEVELS - 1)) && (i & 1))
+			continue;
+
+		SVECTOR pos = { node->world.t[0], node->world.t[1], node->world.t[2] };
+		TILE *tile = new_primitive(ctx, 1, sizeof(TILE));
+		int size = (NUM_LEVELS - node->level) * 2;
+		uint32_t xy;
+
+		gte_ldv0(&pos);
+		gte_rtps();
+		gte_stsxy(&xy);
+
+		setTile(tile);
+		setXY0 (tile, (int16_t) xy - size / 2, (int16_t) (xy >> 16) - size / 2);
+		setWH  (tile, size, size);
+		setRGB0(tile, 255, 64 * node->level, 255 - 64 * node->level);
+	}
+}
+
+static void DrawResults(RenderContext* ctx, int xPos, int *yPos)
+{
+	char buffer[128];
+
+	uint32_t frameUs = Calib_GetFrameUs();
+
+	drawTextList(ctx, xPos, yPos, 0, RESULT_DY, "            US UPDATED NODES/FRAME");
+
+	for(int method = 0; method < NUM_METHODS; method++)
+	{
+		bool gte = (method == METHOD_GTE_FULL) || (method == METHOD_GTE_DIRTY);
+		uint32_t us = Calib_TicksToStockUs(times[method], CALIB_CPU);
+
+		if(gte && !gteValid)
+			sprintf(buffer, "%-9s WRONG RESULTS", methodNames[method]);
+		else
+			sprintf(buffer, "%-9s %4d %7d %11d", methodNames[method], us, updated[method],
+				us ? ((NUM_NODES * frameUs) / us) : 0);
+
+		drawTextList(ctx, xPos, yPos, 0, RESULT_DY, buffer);
+	}
+
+	*yPos += RESULT_DY;
+}
+
+/* Mode callbacks */
+
+static void InitScene(void)
+{
+	Bench_ResetRun(&run);
+	error = 0;
+	animFrame = 0;
+
+	nodes = malloc(NUM_NODES * sizeof(Node));
+
+	if(!nodes)
+	{
+		error = "OUT OF MEMORY";
+		return;
+	}
+
+	BuildScene();
+}
+
+static void EndScene(void)
+{
+	free(nodes);
+	nodes = 0;
+}
+
+static void DrawSceneMode(RenderContext* ctx)
+{
+	char buffer[128];
+	int xPos = 8;
+	int yPos = RESULT_START_Y;
+
+	if(error)
+	{
+		drawTextList(ctx, xPos, &yPos, 0, RESULT_DY, error);
+		return;
+	}
+
+	if(Bench_DrawPending(&run, ctx, xPos, &yPos))
+		return;
+	if(Bench_ShouldRun(&run))
+		RunBenchmark();
+
+	Animate();
+
+	Timer_Ticks start = Timer_GetTicks();
+	liveUpdated = UpdateScene(liveMethod);
+	liveTime = Timer_GetTicks() - start;
+
+	sprintf(buffer, "SCENE GRAPH, %d NODES, %d LEVELS", NUM_NODES, NUM_LEVELS);
+	drawTextList(ctx, xPos, &yPos, 0, RESULT_DY * 2, buffer);
+
+	if(run.state == BENCH_DONE)
+		DrawResults(ctx, xPos, &yPos);
+
+	sprintf(buffer, "[SQUARE] %s: %d NODES, %d US", methodNames[liveMethod], liveUpdated,
+		Calib_TicksToStockUs(liveTime, CALIB_CPU));
+	drawTextList(ctx, xPos, &yPos, 0, RESULT_DY, buffer);
+	drawTextList(ctx, xPos, &yPos, 0, RESULT_DY, "[X]      MEASURE");
+
+	DrawScene(ctx);
+}
+
+static void HandleSceneCommands(PADTYPE* pad)
+{
+	Bench_RequestRun(&run, pad, PAD_CROSS);
+
+	if((lastButtons & PAD_SQUARE) && !(pad->btn & PAD_SQUARE))
+		liveMethod = (liveMethod + 1) % NUM_METHODS;
+}
+
+const BenchMode bench_mode =
+{
+	.init            = &InitScene,
+	.end             = &EndScene,
+	.handle_commands = &HandleSceneCommands,
+	.draw            = &DrawSceneMode
+};
@@ -0,0 +1,275 @@
+/*
+ * ps1-benchmark multi-channel stream benchmark (overlay)
+ *
+ * Plays 2, 4 and 8-channel interleaved streams (built by tools/vagenc by
+ * stacking the stereo tracks) as "stems", with a live volume control for each
+ * channel, and shows how the cost of streaming scales with the channel count:
+ *
+ * - the CD bandwidth the stream needs, versus what is actually being read and
+ *   how much of the time the drive is busy;
+ * - the chunk size (interleave * channels), which is what gets uploaded to SPU
+ *   RAM on each SPU IRQ;
+ * - the average SPU DMA time per chunk and the time spent in the SPU IRQ
+ *   handler, as measured by the stream driver (see Stream_GetStats()).
+ */
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <psxgpu.h>
+#include <psxpad.h>
+#include <psxcd.h>
+#include <psxspu.h>
+#include <hwregs_c.h>
+
+#include "bench.h"
+#include "stream.h"
+#include "timer.h"
+
+#define NUM_STREAMS  3
+#define MAX_CHANNELS 8
+
+#define MAX_VOLUME  0x3fff
+#define VOLUME_STEP 0x100
+
+static const char *const streamPaths[NUM_STREAMS] =
+{
+	"\\STREAMS\\STEMS2.VAG;1",
+	"\\STREAMS\\STEMS4.VAG;1",
+	"\\STREAMS\\STEMS8.VAG;1"
+};
+
+static Stream_Context    streamCtx;
+static StreamReadContext readCtx;
+
+static int currentStream = 0;
+static bool loaded = false;
+static bool paused = false;
+static int selectedChannel = 0;
+static int volumes[MAX_CHANNELS];
+static Timer_Ticks startTicks;
+
+/* Stream management */
+
+static void ApplyVolume(int ch)
+{
+	// Stems come in stereo pairs, so even channels go left and odd ones right.
+	SPU_CH_VOL_L(ch) = (ch % 2) ? 0 : volumes[ch];
+	SPU_CH_VOL_R(ch) = (ch % 2) ? volumes[ch] : 0;
+}
+
+static void ResetStats(void)
+{
+	Stream_ResetStats(&streamCtx);
+
+	readCtx.bytes_read = 0;
+	readCtx.read_time  = 0;
+	startTicks         = Timer_GetTicks();
+}
+
+static void UnloadStream(void)
+{
+	if(!loaded)
+		return;
+
+	// Make sure no read is still going to feed the stream being destroyed.
+	Stream_Stop();
+	CdReadSync(0, 0);
+	destroy_stream(&readCtx, &streamCtx);
+
+	loaded = false;
+}
+
+static void LoadStream(int index)
+{
+	CdlFILE file;
+	int ch;
+
+	UnloadStream();
+
+	currentStream = index;
+	selectedChannel = 0;
+
+	if(!CdSearchFile(&file, streamPaths[index]))
+		return;
+
+	CdReadSync(0, 0);
+	setup_stream(&file.pos, &readCtx, &streamCtx);
+
+	for(ch = 0; ch < MAX_CHANNELS; ch++)
+	{
+		volumes[ch] = MAX_VOLUME;
+
+		if(ch < streamCtx.num_channels)
+			ApplyVolume(ch);
+	}
+
+	loaded = true;
+	paused = false;
+
+	Stream_Start(&streamCtx, false);
+	ResetStats();
+}
+
+/* Mode callbacks */
+
+static void InitStems(void)
+{
+	LoadStream(0);
+}
+
+static void EndStems(void)
+{
+	UnloadStream();
+}
+
+static void PauseStems(void)
+{
+	if(loaded && !paused)
+		Stream_Stop();
+}
+
+static void ResumeStems(void)
+{
+	if(loaded && !paused)
+		Stream_Start(&streamCtx, true);
+}
+
+static void DrawStems(RenderContext* ctx)
+{
+	char buffer[128];
+	int xPos = 8;
+	int yPos = RESULT_START_Y;
+	int ch;
+
+	if(!loaded)
+	{
+		sprintf(buffer, "STREAM %s NOT FOUND", streamPaths[currentStream]);
+		drawTextList(ctx, xPos, &yPos, 0, RESULT_DY, buffer);
+		drawTextList(ctx, xPos, &yPos, 0, RESULT_DY, "[TRIANGLE] CHANGE STREAM");
+		return;
+	}
+
+	bool buffering = feed_stream(&readCtx, &streamCtx);
+
+	Stream_Stats stats;
+	Stream_GetStats(&streamCtx, &stats);
+
+	int channels = streamCtx.num_channels;
+	int rate     = streamCtx.config.sample_rate;
+	int samples  = streamCtx.samples_per_chunk;
+
+	// Bandwidth needed to keep up with playback: 16 bytes per 28 samples.
+	uint32_t needed  = channels * (rate / 28) * 16 / 1024;
+	uint32_t elapsed = Timer_TicksToUs(Timer_GetTicks() - startTicks) / 1000;
+	uint32_t readKB  = readCtx.bytes_read / 1024;
+
+	uint32_t irqUs = stats.chunks ? Timer_TicksToUs(stats.irq_time / stats.chunks) : 0;
+	uint32_t dmaUs = stats.chunks ? Timer_TicksToUs(stats.dma_time / stats.chunks) : 0;
+	int irqs       = rate * 10 / samples; // 0.1 IRQ/s
+
+	sprintf(buffer, "STEMS: %d CHANNELS, %d HZ%s", channels, rate, paused ? " (PAUSED)" : "");
+	drawTextList(ctx, xPos, &yPos, 0, RESULT_DY * 2, buffer);
+
+	sprintf(buffer, "CD NEEDED %3d KB/S, READ %3d KB/S",
+		needed, elapsed ? (readKB * 1000 / elapsed) : 0);
+	drawTextList(ctx, xPos, &yPos, 0, RESULT_DY, buffer);
+
+	sprintf(buffer, "CD BUSY %2d%%, STATUS %s",
+		elapsed ? (Timer_TicksToUs(readCtx.read_time) / 10 / elapsed) : 0,
+		buffering ? "READING" : "IDLE");
+	drawTextList(ctx, xPos, &yPos, 0, RESULT_DY, buffer);
+
+	sprintf(buffer, "CHUNK %d KB (%d X %d), %d.%d IRQ/S",
+		streamCtx.chunk_size / 1024, streamCtx.config.interleave, channels,
+		irqs / 10, irqs % 10);
+	drawTextList(ctx, xPos, &yPos, 0, RESULT_DY, buffer);
+
+	sprintf(buffer, "DMA/CHUNK %5d US (LAST %5d)", dmaUs, Timer_TicksToUs(stats.last_dma_time));
+	drawTextList(ctx, xPos, &yPos, 0, RESULT_DY, buffer);
+
+	sprintf(buffer, "IRQ/CHUNK %5d US (LAST %5d)", irqUs, Timer_TicksToUs(stats.last_irq_time));
+	drawTextList(ctx, xPos, &yPos, 0, RESULT_DY, buffer);
+
+	sprintf(buffer, "CHUNKS %d, UNDERRUNS %d", stats.chunks, stats.underruns);
+	drawTextList(ctx, xPos, &yPos, 0, RESULT_DY * 2, buffer);
+
+	for(ch = 0; ch < channels; ch++)
+	{
+		int percent = volumes[ch] * 100 / MAX_VOLUME;
+
+		sprintf(buffer, "%s CH%d %s %3d%%", (ch == selectedChannel) ? ">" : " ",
+			ch + 1, (ch % 2) ? "R" : "L", percent);
+		drawTextList(ctx, xPos, &yPos, 0, RESULT_DY, buffer);
+
+		// Volume bar
+		void *bar;
+		DrawSimpleRectangle(ctx, &bar, xPos + 112, yPos - RESULT_DY + 1, 0, percent, 6,
+			(ch == selectedChannel) ? 255 : 128, 128, 0);
+	}
+
+	yPos += RESULT_DY;
+
+	drawTextList(ctx, xPos, &yPos, 0, RESULT_DY, "[UP/DOWN] CHANNEL [LEFT/RIGHT] VOLUME");
+	drawTextList(ctx, xPos, &yPos, 0, RESULT_DY, "[X] MUTE [SELECT] PAUSE [O] RESET STATS");
+	drawTextList(ctx, xPos, &yPos, 0, RESULT_DY, "[TRIANGLE] CHANGE STREAM");
+}
+
+static void HandleStemsCommands(PADTYPE* pad)
+{
+	if((lastButtons & PAD_TRIANGLE) && !(pad->btn & PAD_TRIANGLE))
+	{
+		LoadStream((currentStream + 1) % NUM_STREAMS);
+		return;
+	}
+
+	if(!loaded)
+		return;
+
+	int channels = streamCtx.num_channels;
+
+	if((lastButtons & PAD_SELECT) && !(pad->btn & PAD_SELECT))
+	{
+		paused ^= 1;
+
+		if(paused)
+			Stream_Stop();
+		else
+			Stream_Start(&streamCtx, true);
+	}
+
+	if((lastButtons & PAD_DOWN) && !(pad->btn & PAD_DOWN))
+		selectedChannel = (selectedChannel + 1) % channels;
+	if((lastButtons & PAD_UP) && !(pad->btn & PAD_UP))
+		selectedChannel = (selectedChannel + channels - 1) % channels;
+
+	int volume = volumes[selectedChannel];
+
+	if(!(pad->btn & PAD_LEFT))
+		volume -= VOLUME_STEP;
+	if(!(pad->btn & PAD_RIGHT))
+		volume += VOLUME_STEP;
+	if((lastButtons & PAD_CROSS) && !(pad->btn & PAD_CROSS))
+		volume = volume ? 0 : MAX_VOLUME;
+
+	if(volume < 0)
+		volume = 0;
+	if(volume > MAX_VOLUME)
+		volume = MAX_VOLUME;
+
+	volumes[selectedChannel] = volume;
+	ApplyVolume(selectedChannel);
+
+	if((lastButtons & PAD_CIRCLE) && !(pad->btn & PAD_CIRCLE))
+		ResetStats();
+}
+
+const BenchMode bench_mode =
+{
+	.init            = &InitStems,
+	.end             = &EndStems,
+	.pause           = &PauseStems,
+	.resume          = &ResumeStems,
+	.handle_commands = &HandleStemsCommands,
+	.draw            = &DrawStems
+};
@@ -0,0 +1,86 @@
+/*
+ * ps1-benchmark stress test (overlay)
+ *
+ * Bounces NUM_RECTANGLES flat or textured rectangles around the screen, one OT
+ * entry each.
+ */
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <psxgpu.h>
+#include <psxpad.h>
+
+#include "bench.h"
+#include "tilesc.h"
+
+//può essere TILE o può essere POLY_FT4
+//POLY_FT4 può avere la texture invece TILE no essendo una figura semplice
+//POLY_FT4 è un quadrilatero generico
+static void *tiles[NUM_RECTANGLES];
+
+static int x[NUM_RECTANGLES];
+static int y[NUM_RECTANGLES];
+
+static int r[NUM_RECTANGLES];
+static int g[NUM_RECTANGLES];
+static int b[NUM_RECTANGLES];
+
+static int dx[NUM_RECTANGLES];
+static int dy[NUM_RECTANGLES];
+
+static int w[NUM_RECTANGLES];
+static int h[NUM_RECTANGLES];
+
+static void InitRandomRectangle(int i)
+{
+	x[i] = rand() % (SCREEN_XRES - BASE_W); //tra 0 e 320 - la grandezza del quadrato
+	y[i] = rand() % (SCREEN_YRES - BASE_H);
+
+	r[i] = rand() % 256;
+	g[i] = rand() % 256;
+	b[i] = rand() % 256;
+
+	dx[i] = rand() % 6 + 1;
+	dy[i] = rand() % 6 + 1;
+
+	w[i] = BASE_W;
+	h[i] = BASE_H;
+}
+
+static void InitStressTest(void)
+{
+	int i;
+
+	for(i = 0; i < NUM_RECTANGLES; i++)
+	{
+		InitRandomRectangle(i);
+	}
+}
+
+static void DrawStressTest(RenderContext* ctx)
+{
+	int i;
+
+	for(i = 0; i < NUM_RECTANGLES; i++)
+	{
+		update_position(&x[i], &y[i], &dx[i], &dy[i], w[i], h[i]); //aggiornare posizione di un quadrato alla volta
+		draw_rectangle(ctx, &tiles[i], useTexture, TILESC_SPHERE_U, TILESC_SPHERE_V, x[i], y[i], i + 1, w[i], h[i], r[i], g[i], b[i]);
+	}
+}
+
+static void HandleStressTestCommands(PADTYPE* pad)
+{
+	if((lastButtons & PAD_SELECT) && !(pad->btn & PAD_SELECT))
+	{
+		InitStressTest();
+	}
+
+	HandleTextureCommand(pad);
+}
+
+const BenchMode bench_mode =
+{
+	.init            = &InitStressTest,
+	.handle_commands = &HandleStressTestCommands,
+	.draw            = &DrawStressTest
+};
@@ -0,0 +1,274 @@
+/*
+ * ps1-benchmark stream interleave benchmark (overlay)
+ *
+ * Compares the same audio encoded with different interleave sizes (see the
+ * il*.vag files generated by tools/vagenc). For each file, one chunk (i.e. one
+ * interleave-sized slice per channel) is read from the CD and uploaded to SPU
+ * RAM the same way the stream driver's IRQ handler does it, measuring:
+ *
+ * - how long reading the chunk from the CD at 2x takes;
+ * - how long the SPU DMA transfer of the chunk takes;
+ * - how many IRQs (and thus transfers) per second the stream needs, and the
+ *   resulting share of CPU time spent waiting on or servicing DMA.
+ *
+ * Larger interleaves amortize the fixed cost of each transfer over more data,
+ * but use more SPU RAM (two chunks are allocated) and make seeking coarser.
+ */
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <psxgpu.h>
+#include <psxpad.h>
+#include <psxcd.h>
+#include <psxspu.h>
+#include <psxetc.h>
+
+#include "bench.h"
+#include "timer.h"
+
+#define SECTOR_SIZE 2048
+#define NUM_STREAMS 4
+#define DMA_REPEATS 8
+
+// Far away from the stream buffers at 0x1010, so the SPU IRQ address (which
+// also triggers on DMA writes) is never hit.
+#define SCRATCH_SPU_ADDR 0x40000
+
+// Interleaves whose DMA cost is within this many percent of the cheapest one
+// are considered equivalent, and the smallest of them is recommended.
+#define RECOMMEND_TOLERANCE 5
+
+typedef struct
+{
+	int         interleave, channels, sample_rate;
+	size_t      chunk_size;
+	Timer_Ticks cd_time, dma_time;
+	bool        valid;
+} StreamResult;
+
+static const char *const streamPaths[NUM_STREAMS] =
+{
+	"\\STREAMS\\IL2K.VAG;1",
+	"\\STREAMS\\IL4K.VAG;1",
+	"\\STREAMS\\IL8K.VAG;1",
+	"\\STREAMS\\IL16K.VAG;1"
+};
+
+static StreamResult results[NUM_STREAMS];
+static int recommended = -1;
+static BenchRun run;
+static const char *error = 0;
+
+/* Measurement helpers */
+
+static int SamplesPerChunk(const StreamResult *result)
+{
+	return result->interleave / 16 * 28;
+}
+
+// Microseconds of DMA per second of audio.
+static uint32_t DMAUsPerSecond(const StreamResult *result)
+{
+	uint32_t us = Timer_TicksToUs(result->dma_time);
+
+	return us * result->sample_rate / SamplesPerChunk(result);
+}
+
+static bool ReadSectors(int lba, int count, uint8_t *buffer)
+{
+	CdlLOC pos;
+
+	CdIntToPos(lba, &pos);
+	CdControl(CdlSetloc, &pos, 0);
+	CdRead(count, (uint32_t *) buffer, CdlModeSpeed);
+
+	return (CdReadSync(0, 0) >= 0);
+}
+
+static Timer_Ticks TimedUpload(const uint8_t *data, size_t size)
+{
+	Timer_Ticks start = Timer_GetTicks();
+
+	SpuSetTransferStartAddr(SCRATCH_SPU_ADDR);
+	SpuWrite((const uint32_t *) data, size);
+	SpuIsTransferCompleted(SPU_TRANSFER_WAIT);
+
+	return Timer_GetTicks() - start;
+}
+
+static void RunStream(int index)
+{
+	StreamResult *result = &results[index];
+	CdlFILE      file;
+	uint32_t     header[SECTOR_SIZE / 4];
+
+	result->valid = false;
+
+	if(!CdSearchFile(&file, streamPaths[index]))
+	{
+		error = "STREAM NOT FOUND";
+		return;
+	}
+
+	int lba = CdPosToInt(&file.pos);
+
+	if(!ReadSectors(lba, 1, (uint8_t *) header))
+	{
+		error = "CD READ ERROR";
+		return;
+	}
+
+	const VAG_Header *vag = (const VAG_Header *) header;
+
+	result->interleave  = vag->interleave;
+	result->channels    = vag->channels ? vag->channels : 2;
+	result->sample_rate = __builtin_bswap32(vag->sample_rate);
+	result->chunk_size  = result->interleave * result->channels;
+
+	uint8_t *chunk = malloc(Bench_SectorCount(result->chunk_size) * SECTOR_SIZE);
+
+	if(!chunk)
+	{
+		error = "OUT OF MEMORY";
+		return;
+	}
+
+	// Read the first sector of the chunk untimed to get the drive positioned
+	// and spinning, then time reading the whole chunk.
+	ReadSectors(lba + 1, 1, chunk);
+
+	Timer_Ticks start = Timer_GetTicks();
+
+	if(!ReadSectors(lba + 1, Bench_SectorCount(result->chunk_size), chunk))
+		error = "CD READ ERROR";
+
+	result->cd_time = Timer_GetTicks() - start;
+
+	// Average the DMA time over a few transfers. The stream driver's DMA
+	// callback is removed meanwhile, as it would re-enable the SPU IRQ.
+	void *old_callback = DMACallback(DMA_SPU, 0);
+	Timer_Ticks total = 0;
+
+	for(int i = 0; i < DMA_REPEATS; i++)
+		total += TimedUpload(chunk, result->chunk_size);
+
+	DMACallback(DMA_SPU, old_callback);
+
+	result->dma_time = total / DMA_REPEATS;
+	result->valid    = !error;
+
+	free(chunk);
+}
+
+static void RunBenchmark(void)
+{
+	int i;
+
+	error = 0;
+	recommended = -1;
+
+	// Other modes (and the audio streams) install their own read callbacks.
+	CdReadCallback(0);
+
+	for(i = 0; (i < NUM_STREAMS) && !error; i++)
+		RunStream(i);
+
+	if(error)
+		return;
+
+	// Pick the smallest interleave whose DMA cost is close to the cheapest.
+	uint32_t cheapest = 0xffffffff;
+
+	for(i = 0; i < NUM_STREAMS; i++)
+	{
+		uint32_t cost = DMAUsPerSecond(&results[i]);
+
+		if(cost < cheapest)
+			cheapest = cost;
+	}
+
+	for(i = 0; i < NUM_STREAMS; i++)
+	{
+		if(DMAUsPerSecond(&results[i]) * 100 <= cheapest * (100 + RECOMMEND_TOLERANCE))
+		{
+			recommended = i;
+			break;
+		}
+	}
+}
+
+/* Mode callbacks */
+
+static void InitVAGBench(void)
+{
+	Bench_ResetRun(&run);
+	error = 0;
+}
+
+static void DrawVAGBench(RenderContext* ctx)
+{
+	char buffer[128];
+	int xPos = 8;
+	int yPos = RESULT_START_Y;
+	int i;
+
+	if(run.state == BENCH_IDLE)
+	{
+		drawTextList(ctx, xPos, &yPos, 0, RESULT_DY * 2, "STREAM INTERLEAVE");
+		drawTextList(ctx, xPos, &yPos, 0, RESULT_DY, "[X] RUN");
+		return;
+	}
+
+	if(Bench_DrawPending(&run, ctx, xPos, &yPos))
+		return;
+	if(Bench_ShouldRun(&run))
+		RunBenchmark();
+
+	if(error)
+	{
+		drawTextList(ctx, xPos, &yPos, 0, RESULT_DY, error);
+		return;
+	}
+
+	drawTextList(ctx, xPos, &yPos, 0, RESULT_DY * 2, "STREAM INTERLEAVE (PER CHUNK)");
+
+	for(i = 0; i < NUM_STREAMS; i++)
+	{
+		const StreamResult *result = &results[i];
+
+		int samples  = SamplesPerChunk(result);
+		int length   = samples * 10000 / result->sample_rate; // 0.1 ms
+		int irqs     = result->sample_rate * 10 / samples;    // 0.1 IRQ/s
+		uint32_t dma = DMAUsPerSecond(result);
+
+		sprintf(buffer, "%s%5d X%d: CHUNK %2d KB, %d.%d MS",
+			(i == recommended) ? ">" : " ", result->interleave, result->channels,
+			result->chunk_size / 1024, length / 10, length % 10);
+		drawTextList(ctx, xPos, &yPos, 0, RESULT_DY, buffer);
+
+		sprintf(buffer, "  CD %5d US, DMA %5d US, SPU RAM %d KB",
+			Timer_TicksToUs(result->cd_time), Timer_TicksToUs(result->dma_time),
+			result->chunk_size * 2 / 1024);
+		drawTextList(ctx, xPos, &yPos, 0, RESULT_DY, buffer);
+
+		sprintf(buffer, "  %d.%d IRQ/S, DMA LOAD %d.%02d%%",
+			irqs / 10, irqs % 10, dma / 10000, (dma / 100) % 100);
+		drawTextList(ctx, xPos, &yPos, 0, RESULT_DY + 4, buffer);
+	}
+
+	drawTextList(ctx, xPos, &yPos, 0, RESULT_DY, "> SMALLEST WITHIN 5% OF BEST DMA LOAD");
+	drawTextList(ctx, xPos, &yPos, 0, RESULT_DY, "[X] RUN AGAIN");
+}
+
+static void HandleVAGBenchCommands(PADTYPE* pad)
+{
+	Bench_RequestRun(&run, pad, PAD_CROSS);
+}
+
+const BenchMode bench_mode =
+{
+	.init            = &InitVAGBench,
+	.handle_commands = &HandleVAGBenchCommands,
+	.draw            = &DrawVAGBench
+};
@@ -0,0 +1,408 @@
+/*
+ * ps1-benchmark GTE vector math test (overlay)
+ *
+ * Runs simple physics math over arrays of fixed-point vectors, both as plain
+ * C on the CPU and through the GTE's general purpose vector commands (see
+ * gtevec.h):
+ *
+ * - Integration adds each velocity times a time step to its position (GPL).
+ * - Distance checks compute the squared distance of each point from a center
+ *   (MVMVA to subtract, then SQR).
+ * - Normalization scales vectors to unit length (SQR, then GPF by the
+ *   reciprocal of the length computed by the CPU).
+ * - Cross products of pairs of vectors (OP).
+ * - Dot products of pairs of vectors (MVMVA with the first vector loaded as
+ *   the first row of the rotation matrix).
+ *
+ * The same number of update_position() calls, which is what the other tests
+ * use to move their objects, is timed as a baseline. Results are given in
+ * vectors per frame at the console's refresh rate (i.e. how many could be
+ * processed if that was all the CPU did), along with the GTE's speedup over
+ * the CPU. The output of each GTE test is checked against the CPU version of
+ * the same test.
+ */
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <psxgpu.h>
+#include <psxgte.h>
+#include <psxpad.h>
+
+#include "bench.h"
+#include "timer.h"
+#include "calib.h"
+#include "gtevec.h"
+
+#define NUM_VECTORS  256
+#define NUM_RUNS     16
+#define TIME_STEP    2
+
+#define CHECK_TOLERANCE 1
+
+// CPU and GTE versions of each operation alternate, so the GTE's speedup can
+// be computed from adjacent entries.
+enum benchTest
+{
+	TEST_BASELINE = 0,
+	TEST_INTEGRATE_CPU,
+	TEST_INTEGRATE_GTE,
+	TEST_DISTANCE_CPU,
+	TEST_DISTANCE_GTE,
+	TEST_NORMALIZE_CPU,
+	TEST_NORMALIZE_GTE,
+	TEST_CROSS_CPU,
+	TEST_CROSS_GTE,
+	TEST_DOT_CPU,
+	TEST_DOT_GTE,
+	NUM_TESTS
+};
+
+static const char *const testNames[NUM_TESTS] =
+{
+	"UPDATE_POSITION",
+	"INTEGRATE CPU", "INTEGRATE GTE",
+	"DISTANCE CPU",  "DISTANCE GTE",
+	"NORMALIZE CPU", "NORMALIZE GTE",
+	"CROSS CPU",     "CROSS GTE",
+	"DOT CPU",       "DOT GTE"
+};
+
+// Baseline objects
+static int x[NUM_VECTORS], y[NUM_VECTORS], dx[NUM_VECTORS], dy[NUM_VECTORS];
+
+static VECTOR  positions[NUM_VECTORS];
+static SVECTOR velocities[NUM_VECTORS];
+static SVECTOR points[NUM_VECTORS], center;
+static int32_t distances[NUM_VECTORS];
+static SVECTOR normals[NUM_VECTORS];
+static VECTOR  crossA[NUM_VECTORS], crossB[NUM_VECTORS], crossOut[NUM_VECTORS];
+static SVECTOR dotA[NUM_VECTORS], dotB[NUM_VECTORS];
+static int32_t dots[NUM_VECTORS];
+
+// Output of the CPU version of each test, to check the GTE version against
+static VECTOR  refVectors[NUM_VECTORS];
+static SVECTOR refShorts[NUM_VECTORS];
+static int32_t refScalars[NUM_VECTORS];
+
+static Timer_Ticks times[NUM_TESTS];
+static bool valid[NUM_TESTS];
+
+static BenchRun run;
+
+/* Data */
+
+static int RandomRange(int range)
+{
+	return (rand() % (range * 2 + 1)) - range;
+}
+
+// Called before each test, as some of them update the data in place.
+static void InitData(void)
+{
+	srand(1);
+
+	for(int i = 0; i < NUM_VECTORS; i++)
+	{
+		x[i]  = rand() % (SCREEN_XRES - BASE_W);
+		y[i]  = rand() % (SCREEN_YRES - BASE_H);
+		dx[i] = (rand() & 1) ? 1 : -1;
+		dy[i] = (rand() & 1) ? 1 : -1;
+
+		setVector(&positions[i], RandomRange(ONE * 64), RandomRange(ONE * 64), RandomRange(ONE * 64));
+		setVector(&velocities[i], RandomRange(ONE), RandomRange(ONE), RandomRange(ONE));
+		setVector(&points[i], RandomRange(ONE * 2), RandomRange(ONE * 2), RandomRange(ONE * 2));
+
+		// Normals must be longer than ONE / 8, see GteVec_Normalize().
+		setVector(&normals[i], RandomRange(ONE * 2), RandomRange(ONE * 2), ONE);
+
+		setVector(&crossA[i], RandomRange(ONE), RandomRange(ONE), RandomRange(ONE));
+		setVector(&crossB[i], RandomRange(ONE), RandomRange(ONE), RandomRange(ONE));
+
+		setVector(&dotA[i], RandomRange(ONE), RandomRange(ONE), RandomRange(ONE));
+		setVector(&dotB[i], RandomRange(ONE), RandomRange(ONE), RandomRange(ONE));
+	}
+
+	setVector(&center, ONE / 2, -ONE / 2, ONE);
+}
+
+/* CPU implementations */
+
+static void IntegrateCPU(void)
+{
+	for(int i = 0; i < NUM_VECTORS; i++)
+	{
+		positions[i].vx += velocities[i].vx * TIME_STEP;
+		positions[i].vy += velocities[i].vy * TIME_STEP;
+		positions[i].vz += velocities[i].vz * TIME_STEP;
+	}
+}
+
+static void DistanceCPU(void)
+{
+	for(int i = 0; i < NUM_VECTORS; i++)
+	{
+		int ddx = points[i].vx - center.vx;
+		int ddy = points[i].vy - center.vy;
+		int ddz = points[i].vz - center.vz;
+
+		distances[i] = ddx * ddx + ddy * ddy + ddz * ddz;
+	}
+}
+
+static void NormalizeCPU(void)
+{
+	for(int i = 0; i < NUM_VECTORS; i++)
+	{
+		SVECTOR *v = &normals[i];
+		int length = SquareRoot0(v->vx * v->vx + v->vy * v->vy + v->vz * v->vz);
+
+		if(!length)
+			continue;
+
+		int scale = (ONE << 12) / length;
+
+		v->vx = (v->vx * scale) >> 12;
+		v->vy = (v->vy * scale) >> 12;
+		v->vz = (v->vz * scale) >> 12;
+	}
+}
+
+static void CrossCPU(void)
+{
+	for(int i = 0; i < NUM_VECTORS; i++)
+	{
+		const VECTOR *a = &crossA[i], *b = &crossB[i];
+
+		crossOut[i].vx = (a->vy * b->vz - a->vz * b->vy) >> 12;
+		crossOut[i].vy = (a->vz * b->vx - a->vx * b->vz) >> 12;
+		crossOut[i].vz = (a->vx * b->vy - a->vy * b->vx) >> 12;
+	}
+}
+
+static void DotCPU(void)
+{
+	for(int i = 0; i < NUM_VECTORS; i++)
+	{
+		const SVECTOR *a = &dotA[i], *b = &dotB[i];
+
+		dots[i] = (a->vx * b->vx + a->vy * b->vy + a->vz * b->vz) >> 12;
+	}
+}
+
+static void RunTest(int test)
+{
+	switch(test)
+	{
+		case TEST_BASELINE:
+			for(int i = 0; i < NUM_VECTORS; i++)
+				update_position(&x[i], &y[i], &dx[i], &dy[i], BASE_W, BASE_H);
+		break;
+
+		case TEST_INTEGRATE_CPU:
+			IntegrateCPU();
+		break;
+
+		case TEST_INTEGRATE_GTE:
+			GteVec_Integrate(positions, velocities, TIME_STEP, NUM_VECTORS);
+		break;
+
+		case TEST_DISTANCE_CPU:
+			DistanceCPU();
+		break;
+
+		case TEST_DISTANCE_GTE:
+			GteVec_DistanceSq(points, &center, distances, NUM_VECTORS);
+		break;
+
+		case TEST_NORMALIZE_CPU:
+			NormalizeCPU();
+		break;
+
+		case TEST_NORMALIZE_GTE:
+			GteVec_Normalize(normals, NUM_VECTORS);
+		break;
+
+		case TEST_CROSS_CPU:
+			CrossCPU();
+		break;
+
+		case TEST_CROSS_GTE:
+			GteVec_Cross(crossA, crossB, crossOut, NUM_VECTORS);
+		break;
+
+		case TEST_DOT_CPU:
+			DotCPU();
+		break;
+
+		case TEST_DOT_GTE:
+			GteVec_Dot(dotA, dotB, dots, NUM_VECTORS);
+		break;
+	}
+}
+
+/* Result checks */
+
+static bool MatchesVector(const VECTOR *a, const VECTOR *b)
+{
+	return
+		Bench_Matches(a->vx, b->vx, CHECK_TOLERANCE) &&
+		Bench_Matches(a->vy, b->vy, CHECK_TOLERANCE) &&
+		Bench_Matches(a->vz, b->vz, CHECK_TOLERANCE);
+}
+
+static bool MatchesShort(const SVECTOR *a, const SVECTOR *b)
+{
+	return
+		Bench_Matches(a->vx, b->vx, CHECK_TOLERANCE) &&
+		Bench_Matches(a->vy, b->vy, CHECK_TOLERANCE) &&
+		Bench_Matches(a->vz, b->vz, CHECK_TOLERANCE);
+}
+
+// Returns true if a GTE test gives the same output as the CPU test before it.
+static bool CheckTest(int test)
+{
+	bool matches = true;
+
+	InitData();
+	RunTest(test - 1);
+
+	__builtin_memcpy(refVectors, (test == TEST_CROSS_GTE) ? crossOut : positions, sizeof(refVectors));
+	__builtin_memcpy(refShorts, normals, sizeof(refShorts));
+	__builtin_memcpy(refScalars, (test == TEST_DOT_GTE) ? dots : distances, sizeof(refScalars));
+
+	InitData();
+	RunTest(test);
+
+	for(int i = 0; (i < NUM_VECTORS) && matches; i++)
+	{
+		switch(test)
+		{
+			case TEST_INTEGRATE_GTE:
+				matches = MatchesVector(&positions[i], &refVectors[i]);
+			break;
+
+			case TEST_DISTANCE_GTE:
+				matches = Bench_Matches(distances[i], refScalars[i], CHECK_TOLERANCE);
+			break;
+
+			case TEST_NORMALIZE_GTE:
+				matches = MatchesShort(&normals[i], &refShorts[i]);
+			break;
+
+			case TEST_CROSS_GTE:
+				matches = MatchesVector(&crossOut[i], &refVectors[i]);
+			break;
+
+			case TEST_DOT_GTE:
+				matches = Bench_Matches(dots[i], refScalars[i], CHECK_TOLERANCE);
+			break;
+		}
+	}
+
+	return matches;
+}
+
+static void RunBenchmark(void)
+{
+	for(int test = 0; test < NUM_TESTS; test++)
+	{
+		Timer_Ticks best = 0xffffffff;
+
+		valid[test] = ((test != TEST_BASELINE) && !(test & 1)) ? CheckTest(test) : true;
+
+		// The first run also loads the code into the I-cache.
+		for(int i = 0; i <= NUM_RUNS; i++)
+		{
+			InitData();
+
+			Timer_Ticks start = Timer_GetTicks();
+			RunTest(test);
+			Timer_Ticks time = Timer_GetTicks() - start;
+
+			if(i && (time < best))
+				best = time;
+		}
+
+		times[test] = best;
+	}
+}
+
+/* Display */
+
+static void DrawResults(RenderContext* ctx, int xPos, int *yPos)
+{
+	char buffer[128];
+
+	uint32_t frameUs = Calib_GetFrameUs();
+
+	drawTextList(ctx, xPos, yPos, 0, RESULT_DY, "                  US VECS/FRAME");
+
+	for(int test = 0; test < NUM_TESTS; test++)
+	{
+		uint32_t us = Calib_TicksToStockUs(times[test], CALIB_CPU);
+		int length;
+
+		if(valid[test])
+			length = sprintf(buffer, "%-15s %4d %10d", testNames[test], us,
+				us ? ((NUM_VECTORS * frameUs) / us) : 0);
+		else
+			length = sprintf(buffer, "%-15s WRONG RESULTS", testNames[test]);
+
+		// Show the speedup (in tenths) next to each GTE result.
+		if((test != TEST_BASELINE) && !(test & 1) && times[test] && valid[test])
+		{
+			int speedup = (times[test - 1] * 10) / times[test];
+
+			sprintf(&buffer[length], " %2d.%dX", speedup / 10, speedup % 10);
+		}
+
+		drawTextList(ctx, xPos, yPos, 0, RESULT_DY, buffer);
+
+		if(test & 1)
+			continue;
+
+		*yPos += RESULT_DY / 2;
+	}
+
+	*yPos += RESULT_DY / 2;
+}
+
+/* Mode callbacks */
+
+static void InitVecMath(void)
+{
+	Bench_ResetRun(&run);
+}
+
+static void DrawVecMath(RenderContext* ctx)
+{
+	char buffer[128];
+	int xPos = 8;
+	int yPos = RESULT_START_Y;
+
+	if(Bench_DrawPending(&run, ctx, xPos, &yPos))
+		return;
+	if(Bench_ShouldRun(&run))
+		RunBenchmark();
+
+	sprintf(buffer, "GTE VECTOR MATH, %d VECTORS", NUM_VECTORS);
+	drawTextList(ctx, xPos, &yPos, 0, RESULT_DY * 2, buffer);
+
+	if(run.state == BENCH_DONE)
+		DrawResults(ctx, xPos, &yPos);
+
+	drawTextList(ctx, xPos, &yPos, 0, RESULT_DY, "[X] MEASURE");
+}
+
+static void HandleVecMathCommands(PADTYPE* pad)
+{
+	Bench_RequestRun(&run, pad, PAD_CROSS);
+}
+
+const BenchMode bench_mode =
+{
+	.init            = &InitVecMath,
+	.handle_commands = &HandleVecMathCommands,
+	.draw            = &DrawVecMath
+};
@@ -0,0 +1,356 @@
+/*
+ * ps1-benchmark VRAM texture cache test (overlay)
+ *
+ * Requests a set of textures through the LRU texture cache (see vram.h) each
+ * frame and draws them, out of a pool of textures taking up more VRAM than is
+ * free, so that textures are constantly evicted and uploaded again. Textures
+ * are 4bpp, 8bpp and 16bpp images of a few sizes; their .TIM files are
+ * generated into a staging buffer when the cache asks for them, standing in
+ * for reading them from the disc.
+ *
+ * The set of textures requested each frame either slides along the pool by
+ * one texture every few frames (so each texture stays in use for a while, as
+ * when walking through a level) or is picked at random. The hit rate, misses
+ * and evictions per frame, bytes uploaded per frame and the time spent in the
+ * cache (excluding generating the textures) are averaged over a second. The
+ * staging buffer is only reused once the previous frame's uploads are done, so
+ * it also limits how many textures can be uploaded per frame; requests beyond
+ * that fail and are counted separately.
+ */
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <psxgpu.h>
+#include <psxpad.h>
+
+#include "bench.h"
+#include "timer.h"
+#include "vram.h"
+
+#define NUM_TEXTURES  64
+#define MAX_SET_SIZE  16
+#define SLIDE_FRAMES  4
+#define STATS_FRAMES  60
+
+// Enough for four of the largest textures
+#define STAGING_SIZE  0x10000
+
+#define TIM_MAGIC     0x10
+
+#define QUAD_SIZE     32
+#define QUAD_STEP     36
+#define QUADS_X       16
+#define QUADS_Y       156
+
+typedef struct
+{
+	uint8_t  bpp;
+	uint16_t width, height; // In texels
+} TextureKind;
+
+typedef struct
+{
+	const char *name;
+	int size;
+	bool random;
+} AccessPattern;
+
+// Texture number n is of kind n % NUM_KINDS.
+static const TextureKind textureKinds[] =
+{
+	{ 0, 128, 128 },
+	{ 1, 128, 64 },
+	{ 1, 128, 128 },
+	{ 2, 64, 64 },
+	{ 2, 128, 64 }
+};
+
+#define NUM_KINDS (sizeof(textureKinds) / sizeof(TextureKind))
+
+static const AccessPattern patterns[] =
+{
+	{ "SLIDING 8",  8,  false },
+	{ "SLIDING 16", 16, false },
+	{ "RANDOM 8",   8,  true },
+	{ "RANDOM 16",  16, true }
+};
+
+#define NUM_PATTERNS (sizeof(patterns) / sizeof(AccessPattern))
+
+static uint8_t *staging = 0;
+static size_t stagingUsed = 0;
+static Timer_Ticks loadTicks = 0;
+
+static int pattern = 0;
+static int frame = 0;
+static const char *error = 0;
+
+// Totals over the current second, and averages over the previous one
+static Vram_Stats totals, averages;
+static Timer_Ticks cacheTotal = 0, cacheAverage = 0;
+static Timer_Ticks loadTotal = 0, loadAverage = 0;
+static int statsFrames = 0;
+
+/* Texture generation */
+
+// Writes a .TIM file with a generated pattern to the staging buffer.
+static const uint32_t *LoadTexture(uint32_t id, void *arg)
+{
+	Timer_Ticks start = Timer_GetTicks();
+	const TextureKind *kind = &textureKinds[id % NUM_KINDS];
+
+	int colors = (kind->bpp == 0) ? 16 : ((kind->bpp == 1) ? 256 : 0);
+	int width  = kind->width >> (2 - kind->bpp);
+	int height = kind->height;
+	size_t size = 8 + (colors ? (12 + colors * 2) : 0) + 12 + width * height * 2;
+
+	if((stagingUsed + size) > STAGING_SIZE)
+		return 0;
+
+	uint32_t *tim = (uint32_t *) &staging[stagingUsed];
+	uint32_t *ptr = tim;
+
+	stagingUsed += size;
+
+	*(ptr++) = TIM_MAGIC;
+	*(ptr++) = kind->bpp | (colors ? TIM_HAS_CLUT : 0);
+
+	// The CLUT is a gradient tinted differently for each texture, with color
+	// 0 left transparent.
+	if(colors)
+	{
+		*(ptr++) = 12 + colors * 2;
+		*(ptr++) = 0;
+		*(ptr++) = colors | (1 << 16);
+
+		uint16_t *clut = (uint16_t *) ptr;
+
+		for(int i = 0; i < colors; i++)
+		{
+			int level = (i * 31) / (colors - 1);
+
+			clut[i] = i ? (level | (((level * id) & 31) << 5) | ((31 - level) << 10)) : 0;
+		}
+
+		ptr += colors / 2;
+	}
+
+	*(ptr++) = 12 + width * height * 2;
+	*(ptr++) = 0;
+	*(ptr++) = width | (height << 16);
+
+	// Diagonal stripes, whose spacing depends on the texture number
+	for(int y = 0; y < height; y++)
+	{
+		for(int x = 0; x < (width / 2); x++)
+		{
+			uint32_t value = ((x + y) >> ((id % 3) + 1)) + id;
+
+			*(ptr++) = (kind->bpp == 2) ?
+				((value & 0x7fff) * 0x00010001) : (value * 0x01010101);
+		}
+	}
+
+	loadTicks += Timer_GetTicks() - start;
+	return tim;
+}
+
+/* Cache */
+
+static int GetSetTexture(int index)
+{
+	const AccessPattern *current = &patterns[pattern];
+
+	if(current->random)
+		return rand() % NUM_TEXTURES;
+
+	return ((frame / SLIDE_FRAMES) + index) % NUM_TEXTURES;
+}
+
+static void AccumulateStats(Timer_Ticks cacheTicks)
+{
+	Vram_Stats stats;
+
+	Vram_GetStats(&stats, true);
+
+	totals.hits         += stats.hits;
+	totals.misses       += stats.misses;
+	totals.evictions    += stats.evictions;
+	totals.failures     += stats.failures;
+	totals.upload_bytes += stats.upload_bytes;
+	cacheTotal          += cacheTicks;
+	loadTotal           += loadTicks;
+
+	if(++statsFrames < STATS_FRAMES)
+		return;
+
+	averages     = totals;
+	cacheAverage = cacheTotal / STATS_FRAMES;
+	loadAverage  = loadTotal / STATS_FRAMES;
+	statsFrames  = 0;
+	cacheTotal   = 0;
+	loadTotal    = 0;
+
+	totals.hits = totals.misses = totals.evictions = totals.failures = 0;
+	totals.upload_bytes = 0;
+}
+
+static void ResetStats(void)
+{
+	Vram_Stats stats;
+
+	Vram_GetStats(&stats, true);
+
+	totals.hits = totals.misses = totals.evictions = totals.failures = 0;
+	totals.upload_bytes = 0;
+	averages     = totals;
+	cacheTotal   = 0;
+	cacheAverage = 0;
+	loadTotal    = 0;
+	loadAverage  = 0;
+	statsFrames  = 0;
+}
+
+/* Display */
+
+static void DrawTexture(RenderContext* ctx, int index, const Vram_Texture *texture)
+{
+	int x = QUADS_X + (index % 8) * QUAD_STEP;
+	int y = QUADS_Y + (index / 8) * QUAD_STEP;
+
+	if(!texture)
+	{
+		TILE *tile = new_primitive(ctx, 1, sizeof(TILE));
+
+		setTile(tile);
+		setXY0 (tile, x, y);
+		setWH  (tile, QUAD_SIZE, QUAD_SIZE);
+		setRGB0(tile, 255, 0, 0);
+		return;
+	}
+
+	POLY_FT4 *poly = new_primitive(ctx, 1, sizeof(POLY_FT4));
+
+	setPolyFT4(poly);
+	setXY4(poly, x, y, x + QUAD_SIZE, y, x, y + QUAD_SIZE, x + QUAD_SIZE, y + QUAD_SIZE);
+	setRGB0(poly, 128, 128, 128);
+	setUVWH(poly, texture->u, texture->v, texture->width - 1, texture->height - 1);
+	poly->tpage = texture->tpage;
+	poly->clut  = texture->clut;
+}
+
+static void DrawStats(RenderContext* ctx, int xPos, int *yPos)
+{
+	char buffer[128];
+	uint32_t requests = averages.hits + averages.misses;
+
+	sprintf(buffer, "HIT RATE       %6d%%", requests ? ((averages.hits * 100) / requests) : 0);
+	drawTextList(ctx, xPos, yPos, 0, RESULT_DY, buffer);
+
+	// Counts per frame, in tenths
+	sprintf(buffer, "MISSES/FRAME   %5d.%d", (averages.misses * 10 / STATS_FRAMES) / 10,
+		(averages.misses * 10 / STATS_FRAMES) % 10);
+	drawTextList(ctx, xPos, yPos, 0, RESULT_DY, buffer);
+	sprintf(buffer, "EVICTS/FRAME   %5d.%d", (averages.evictions * 10 / STATS_FRAMES) / 10,
+		(averages.evictions * 10 / STATS_FRAMES) % 10);
+	drawTextList(ctx, xPos, yPos, 0, RESULT_DY, buffer);
+	sprintf(buffer, "FAILED/FRAME   %5d.%d", (averages.failures * 10 / STATS_FRAMES) / 10,
+		(averages.failures * 10 / STATS_FRAMES) % 10);
+	drawTextList(ctx, xPos, yPos, 0, RESULT_DY, buffer);
+
+	sprintf(buffer, "UPLOAD/FRAME   %7d BYTES", averages.upload_bytes / STATS_FRAMES);
+	drawTextList(ctx, xPos, yPos, 0, RESULT_DY, buffer);
+	sprintf(buffer, "CACHE TIME     %7d US", Timer_TicksToUs(cacheAverage));
+	drawTextList(ctx, xPos, yPos, 0, RESULT_DY, buffer);
+	sprintf(buffer, "GENERATE TIME  %7d US", Timer_TicksToUs(loadAverage));
+	drawTextList(ctx, xPos, yPos, 0, RESULT_DY, buffer);
+
+	*yPos += RESULT_DY;
+}
+
+/* Mode callbacks */
+
+static void InitVramLru(void)
+{
+	pattern = 0;
+	frame = 0;
+	error = 0;
+
+	staging = malloc(STAGING_SIZE);
+
+	if(!staging)
+		error = "OUT OF MEMORY";
+
+	Vram_Flush();
+	ResetStats();
+}
+
+static void EndVramLru(void)
+{
+	// Uploads may still be reading from the staging buffer.
+	DrawSync(0);
+	Vram_Flush();
+
+	free(staging);
+	staging = 0;
+}
+
+static void DrawVramLru(RenderContext* ctx)
+{
+	char buffer[128];
+	int xPos = 8;
+	int yPos = RESULT_START_Y;
+
+	if(error)
+	{
+		drawTextList(ctx, xPos, &yPos, 0, RESULT_DY, error);
+		return;
+	}
+
+	// The previous frame's uploads were completed when the buffers were
+	// flipped, so the staging buffer can be reused.
+	Vram_NewFrame();
+	stagingUsed = 0;
+	loadTicks = 0;
+
+	const Vram_Texture *textures[MAX_SET_SIZE];
+	int count = patterns[pattern].size;
+	Timer_Ticks start = Timer_GetTicks();
+
+	for(int i = 0; i < count; i++)
+		textures[i] = Vram_UseTexture(GetSetTexture(i), &LoadTexture, 0);
+
+	AccumulateStats(Timer_GetTicks() - start - loadTicks);
+	frame++;
+
+	for(int i = 0; i < count; i++)
+		DrawTexture(ctx, i, textures[i]);
+
+	drawTextList(ctx, xPos, &yPos, 0, RESULT_DY * 2, "VRAM TEXTURE CACHE");
+
+	sprintf(buffer, "%d TEXTURES, %d FREE BLOCKS", NUM_TEXTURES, Vram_GetFreeBlocks());
+	drawTextList(ctx, xPos, &yPos, 0, RESULT_DY * 2, buffer);
+
+	DrawStats(ctx, xPos, &yPos);
+
+	sprintf(buffer, "[SQUARE] PATTERN: %s", patterns[pattern].name);
+	drawTextList(ctx, xPos, &yPos, 0, RESULT_DY, buffer);
+}
+
+static void HandleVramLruCommands(PADTYPE* pad)
+{
+	if((lastButtons & PAD_SQUARE) && !(pad->btn & PAD_SQUARE))
+	{
+		pattern = (pattern + 1) % NUM_PATTERNS;
+		ResetStats();
+	}
+}
+
+const BenchMode bench_mode =
+{
+	.init            = &InitVramLru,
+	.end             = &EndVramLru,
+	.handle_commands = &HandleVramLruCommands,
+	.draw            = &DrawVramLru
+};
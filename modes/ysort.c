@@ -0,0 +1,273 @@
+/*
+ * ps1-benchmark Y-sorted sprite ordering test (overlay)
+ *
+ * 2D games usually draw sprites in order of their Y coordinate, so that
+ * sprites lower on the screen cover those behind them; the stress test instead
+ * links each rectangle into OT entry i + 1, i.e. in creation order. This test
+ * moves thousands of sprites up and down each frame and compares the cost of
+ * linking them into a Y-ordered chain in three ways:
+ *
+ * - OT buckets: the OT has one entry per scanline, and each sprite is linked
+ *   into the entry for its Y coordinate. This is O(n) but only orders by whole
+ *   pixels, and needs an OT as tall as the screen.
+ * - Radix sort: the 16-bit keys (Y with 8 fractional bits) are sorted with two
+ *   8-bit counting passes, then the sprites are linked into a single OT entry
+ *   in sorted order.
+ * - Insertion sort: the order from the previous frame is kept and fixed up
+ *   with an insertion sort, which is close to O(n) as sprites only move a
+ *   little each frame, then linked as above.
+ *
+ * Only the primitives' tag words are linked (the chain is never drawn), so
+ * the results are purely the ordering cost; they are given in cycles per
+ * frame, averaged over several frames of movement, for increasing numbers of
+ * sprites.
+ */
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <psxgpu.h>
+#include <psxpad.h>
+
+#include "bench.h"
+#include "timer.h"
+#include "calib.h"
+
+#define MAX_SPRITES  2048
+#define NUM_COUNTS   4
+#define NUM_FRAMES   16
+
+#define KEY_SHIFT    8
+#define KEY_MAX      ((SCREEN_YRES - 1) << KEY_SHIFT)
+#define MAX_SPEED    (2 << KEY_SHIFT)
+#define NUM_BUCKETS  SCREEN_YRES
+
+enum sortMethod
+{
+	METHOD_BUCKETS = 0,
+	METHOD_RADIX,
+	METHOD_INSERTION,
+	NUM_METHODS
+};
+
+static const int spriteCounts[NUM_COUNTS] = { 256, 512, 1024, 2048 };
+
+// Sprites
+static uint16_t keys[MAX_SPRITES];
+static int16_t  speeds[MAX_SPRITES];
+static uint32_t tags[MAX_SPRITES];
+
+// Sorted sprite indices (kept between frames for the insertion sort) and the
+// radix sort's intermediate pass
+static uint16_t order[MAX_SPRITES];
+static uint16_t temp[MAX_SPRITES];
+
+static uint32_t ot[NUM_BUCKETS];
+
+// Average cycles per frame
+static uint32_t cycles[NUM_COUNTS][NUM_METHODS];
+
+static BenchRun run;
+
+/* Sprites */
+
+static void InitSprites(int count)
+{
+	srand(1);
+
+	for(int i = 0; i < count; i++)
+	{
+		keys[i]   = rand() % KEY_MAX;
+		speeds[i] = (rand() % (MAX_SPEED * 2 + 1)) - MAX_SPEED;
+		order[i]  = i;
+	}
+}
+
+static void MoveSprites(int count)
+{
+	for(int i = 0; i < count; i++)
+	{
+		int key = keys[i] + speeds[i];
+
+		if((key < 0) || (key > KEY_MAX))
+		{
+			speeds[i] = -speeds[i];
+			key = keys[i] + speeds[i];
+		}
+
+		keys[i] = key;
+	}
+}
+
+/* Ordering */
+
+static void LinkBuckets(int count)
+{
+	ClearOTagR(ot, NUM_BUCKETS);
+
+	// The reverse-cleared OT is drawn starting from the last entry, so lower
+	// sprites go into lower entries to be drawn last.
+	for(int i = 0; i < count; i++)
+		addPrim(&ot[(NUM_BUCKETS - 1) - (keys[i] >> KEY_SHIFT)], &tags[i]);
+}
+
+// Links the sprites into a single OT entry so they are drawn in order.
+static void LinkSorted(int count)
+{
+	termPrim(&ot[0]);
+
+	for(int i = count - 1; i >= 0; i--)
+		addPrim(&ot[0], &tags[order[i]]);
+}
+
+static void RadixPass(const uint16_t *src, uint16_t *dst, int shift, int count)
+{
+	int offsets[256];
+
+	for(int i = 0; i < 256; i++)
+		offsets[i] = 0;
+
+	for(int i = 0; i < count; i++)
+		offsets[(keys[src[i]] >> shift) & 0xff]++;
+
+	for(int i = 0, total = 0; i < 256; i++)
+	{
+		int digits = offsets[i];
+
+		offsets[i] = total;
+		total     += digits;
+	}
+
+	for(int i = 0; i < count; i++)
+		dst[offsets[(keys[src[i]] >> shift) & 0xff]++] = src[i];
+}
+
+static void RadixSort(int count)
+{
+	// The passes are stable, so sorting by the low byte and then by the high
+	// byte leaves the sprites sorted by the whole key. The order array only
+	// serves as input for the first pass, so it need not be reset.
+	RadixPass(order, temp, 0, count);
+	RadixPass(temp, order, 8, count);
+}
+
+static void InsertionSort(int count)
+{
+	for(int i = 1; i < count; i++)
+	{
+		uint16_t sprite = order[i];
+		uint16_t key    = keys[sprite];
+		int j = i - 1;
+
+		for(; (j >= 0) && (keys[order[j]] > key); j--)
+			order[j + 1] = order[j];
+
+		order[j + 1] = sprite;
+	}
+}
+
+static void Order(int method, int count)
+{
+	switch(method)
+	{
+		case METHOD_BUCKETS:
+			LinkBuckets(count);
+		break;
+
+		case METHOD_RADIX:
+			RadixSort(count);
+			LinkSorted(count);
+		break;
+
+		case METHOD_INSERTION:
+			InsertionSort(count);
+			LinkSorted(count);
+		break;
+	}
+}
+
+static void RunBenchmark(void)
+{
+	for(int c = 0; c < NUM_COUNTS; c++)
+	{
+		int count = spriteCounts[c];
+
+		for(int method = 0; method < NUM_METHODS; method++)
+		{
+			Timer_Ticks total = 0;
+
+			// Start from sorted sprites, as after any previous frame; this
+			// also loads the code into the I-cache.
+			InitSprites(count);
+			RadixSort(count);
+			Order(method, count);
+
+			for(int frame = 0; frame < NUM_FRAMES; frame++)
+			{
+				MoveSprites(count);
+
+				Timer_Ticks start = Timer_GetTicks();
+				Order(method, count);
+				total += Timer_GetTicks() - start;
+			}
+
+			cycles[c][method] = Calib_TicksToStockCycles(total, CALIB_CPU) / NUM_FRAMES;
+		}
+	}
+}
+
+/* Display */
+
+static void DrawResults(RenderContext* ctx, int xPos, int *yPos)
+{
+	char buffer[128];
+
+	drawTextList(ctx, xPos, yPos, 0, RESULT_DY, "CYCLES/FRAME");
+	drawTextList(ctx, xPos, yPos, 0, RESULT_DY, "SPRITES  BUCKETS   RADIX  INSERT");
+
+	for(int c = 0; c < NUM_COUNTS; c++)
+	{
+		sprintf(buffer, "%7d %8d %7d %7d", spriteCounts[c], cycles[c][METHOD_BUCKETS],
+			cycles[c][METHOD_RADIX], cycles[c][METHOD_INSERTION]);
+		drawTextList(ctx, xPos, yPos, 0, RESULT_DY, buffer);
+	}
+
+	*yPos += RESULT_DY;
+}
+
+/* Mode callbacks */
+
+static void InitYSort(void)
+{
+	Bench_ResetRun(&run);
+}
+
+static void DrawYSort(RenderContext* ctx)
+{
+	int xPos = 8;
+	int yPos = RESULT_START_Y;
+
+	if(Bench_DrawPending(&run, ctx, xPos, &yPos))
+		return;
+	if(Bench_ShouldRun(&run))
+		RunBenchmark();
+
+	drawTextList(ctx, xPos, &yPos, 0, RESULT_DY * 2, "Y-SORTED SPRITE ORDERING");
+
+	if(run.state == BENCH_DONE)
+		DrawResults(ctx, xPos, &yPos);
+
+	drawTextList(ctx, xPos, &yPos, 0, RESULT_DY, "[X] MEASURE");
+}
+
+static void HandleYSortCommands(PADTYPE* pad)
+{
+	Bench_RequestRun(&run, pad, PAD_CROSS);
+}
+
+const BenchMode bench_mode =
+{
+	.init            = &InitYSort,
+	.handle_commands = &HandleYSortCommands,
+	.draw            = &DrawYSort
+};
@@ -0,0 +1,123 @@
+/*
+ * ps1-benchmark audio+data demuxer
+ */
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+
+#include "mux.h"
+#include "stream.h"
+
+#define SECTOR_SIZE 2048
+
+/* Private utilities */
+
+// Advances the cursor by one sector and returns whether that sector holds
+// audio. This must match the way tools/avmux lays out groups.
+static bool _next_is_audio(const Mux_Header *header, Mux_Cursor *cursor) {
+	if (!cursor->group_audio && !cursor->group_data) {
+		int audio = cursor->audio_left;
+		int data  = cursor->data_left;
+
+		// Once all data has been stored, the rest of the audio follows.
+		if (data && (audio > header->audio_sectors))
+			audio = header->audio_sectors;
+		if (data > header->data_sectors)
+			data = header->data_sectors;
+
+		cursor->group_audio = audio;
+		cursor->group_data  = data;
+	}
+
+	if (cursor->group_audio) {
+		cursor->group_audio--;
+		cursor->audio_left--;
+		return true;
+	}
+
+	cursor->group_data--;
+	cursor->data_left--;
+	return false;
+}
+
+/* Public API */
+
+bool Mux_IsValid(const void *header) {
+	return (((const Mux_Header *) header)->magic == MUX_MAGIC);
+}
+
+int Mux_GetLength(const Mux_Header *header) {
+	return header->num_audio_sectors + header->num_data_sectors;
+}
+
+void Mux_Init(
+	Mux_Context *ctx, const Mux_Header *header, Stream_Context *stream,
+	uint8_t *data
+) {
+	ctx->header = header;
+	ctx->stream = stream;
+	ctx->data   = data;
+
+	ctx->cursor.audio_left  = header->num_audio_sectors;
+	ctx->cursor.data_left   = header->num_data_sectors;
+	ctx->cursor.group_audio = 0;
+	ctx->cursor.group_data  = 0;
+
+	ctx->audio_routed = 0;
+	ctx->data_routed  = 0;
+}
+
+int Mux_GetBatchLength(const Mux_Context *ctx, int max) {
+	Mux_Cursor cursor = ctx->cursor;
+	int        room   = Stream_GetRefillLength(ctx->stream) / SECTOR_SIZE;
+	int        length = 0;
+
+	for (; (length < max) && (cursor.audio_left || cursor.data_left); length++) {
+		Mux_Cursor next = cursor;
+
+		if (_next_is_audio(ctx->header, &next)) {
+			if (!room)
+				break;
+
+			room--;
+		}
+
+		cursor = next;
+	}
+
+	return length;
+}
+
+void Mux_Demux(Mux_Context *ctx, const uint8_t *sectors, int count) {
+	for (; count > 0; count--, sectors += SECTOR_SIZE) {
+		if (_next_is_audio(ctx->header, &(ctx->cursor))) {
+			uint8_t *ptr;
+
+			// Batches are sized so there is always room for audio sectors.
+			// The ring buffer's size is a multiple of the sector size, so
+			// its contiguous free region is always at least one sector long.
+			Stream_GetFeedPtr(ctx->stream, &ptr);
+			__builtin_memcpy(ptr, sectors, SECTOR_SIZE);
+			Stream_Feed(ctx->stream, SECTOR_SIZE);
+
+			ctx->audio_routed++;
+		} else {
+			if (ctx->data)
+				__builtin_memcpy(
+					&(ctx->data[ctx->data_routed * SECTOR_SIZE]), sectors,
+					SECTOR_SIZE
+				);
+
+			ctx->data_routed++;
+		}
+	}
+}
+
+int Mux_GetPosition(const Mux_Context *ctx) {
+	return ctx->audio_routed + ctx->data_routed;
+}
+
+bool Mux_IsDataComplete(const Mux_Context *ctx) {
+	return (ctx->data_routed >= (int) ctx->header->num_data_sectors);
+}
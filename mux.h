@@ -0,0 +1,161 @@
+/*
+ * ps1-benchmark audio+data demuxer
+ */
+
+/**
+ * @file mux.h
+ * @brief Demuxer for containers interleaving audio and data sectors
+ *
+ * @details Containers (.AVM) are produced at build time by tools/avmux. The
+ * file starts with a sector holding a Mux_Header, followed by groups of
+ * audio_sectors sectors of an interleaved .VAG stream and data_sectors sectors
+ * of data (the data files listed in the header, each starting on a sector
+ * boundary). Once all data has been stored, the rest of the file holds audio.
+ *
+ * As the audio is delivered at (slightly more than) the rate it is played, the
+ * whole container can be read sequentially with no seeking: the demuxer routes
+ * each sector read to either the audio stream's ring buffer or the data
+ * buffer. The caller is responsible for reading the sectors (in any batch
+ * size), and shall use Mux_GetBatchLength() to avoid reading more audio than
+ * the ring buffer can take.
+ *
+ * All fields are little-endian.
+ */
+
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+
+#include "stream.h"
+
+#define MUX_MAGIC     0x584d5641 // "AVMX"
+#define MUX_MAX_FILES 32
+
+/* Type definitions */
+
+typedef struct {
+	uint32_t offset, size; // Offset in sectors from the start of the data
+} Mux_File;
+
+typedef struct {
+	uint32_t magic;
+	uint16_t audio_sectors, data_sectors;
+	uint32_t num_audio_sectors, num_data_sectors;
+	uint32_t interleave, sample_rate;
+	uint16_t channels, num_files;
+	uint32_t _reserved;
+	Mux_File files[MUX_MAX_FILES];
+} Mux_Header;
+
+/**
+ * @brief Position within the container's layout.
+ *
+ * @details Used internally to tell audio and data sectors apart.
+ */
+typedef struct {
+	int audio_left, data_left;
+	int group_audio, group_data;
+} Mux_Cursor;
+
+/**
+ * @brief Demuxer state.
+ *
+ * @details Initialized by Mux_Init(). The counters of audio and data sectors
+ * routed so far may be read directly; all other fields are only used
+ * internally.
+ */
+typedef struct {
+	const Mux_Header *header;
+	Stream_Context   *stream;
+	uint8_t          *data;
+
+	Mux_Cursor cursor;
+	int        audio_routed, data_routed;
+} Mux_Context;
+
+/* Public API */
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @brief Returns whether the given buffer holds a valid container header.
+ *
+ * @param header
+ * @return True if the magic number matches
+ */
+bool Mux_IsValid(const void *header);
+
+/**
+ * @brief Returns the number of sectors in the container, excluding the header.
+ *
+ * @param header
+ * @return Total number of audio and data sectors
+ */
+int Mux_GetLength(const Mux_Header *header);
+
+/**
+ * @brief Initializes a demuxer.
+ *
+ * @details The header must stay in memory while the demuxer is in use. The
+ * stream context must have been initialized with a matching configuration
+ * (interleave, sample rate and number of channels). The data buffer must be
+ * large enough to hold all data sectors; if NULL, data sectors are discarded.
+ *
+ * @param ctx
+ * @param header
+ * @param stream Stream to feed audio sectors to
+ * @param data Buffer to copy data sectors to (NULL to discard)
+ */
+void Mux_Init(
+	Mux_Context *ctx, const Mux_Header *header, Stream_Context *stream,
+	uint8_t *data
+);
+
+/**
+ * @brief Returns how many of the following sectors can be read right now.
+ *
+ * @details Counts sectors, up to the given maximum, until one is reached that
+ * holds audio the stream's ring buffer has no room for yet.
+ *
+ * @param ctx
+ * @param max Maximum number of sectors (e.g. the size of a staging buffer)
+ * @return Number of sectors that can be read and passed to Mux_Demux()
+ */
+int Mux_GetBatchLength(const Mux_Context *ctx, int max);
+
+/**
+ * @brief Routes sectors read from the container.
+ *
+ * @details The sectors must immediately follow those passed to the previous
+ * call (or be the first ones after the header) and must not exceed the length
+ * returned by Mux_GetBatchLength().
+ *
+ * @param ctx
+ * @param sectors Sector data
+ * @param count Number of sectors
+ */
+void Mux_Demux(Mux_Context *ctx, const uint8_t *sectors, int count);
+
+/**
+ * @brief Returns the number of sectors routed so far.
+ *
+ * @param ctx
+ * @return Position within the container, excluding the header
+ */
+int Mux_GetPosition(const Mux_Context *ctx);
+
+/**
+ * @brief Returns whether all data sectors have been routed.
+ *
+ * @param ctx
+ * @return True once the data buffer is complete
+ */
+bool Mux_IsDataComplete(const Mux_Context *ctx);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,181 @@
+/*
+ * ps1-benchmark overlay loader
+ */
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdio.h>
+#include <psxcd.h>
+#include <dlfcn.h>
+
+#include "overlay.h"
+#include "timer.h"
+
+#define SECTOR_SIZE 2048
+
+#define _sector_align(x) (((x) + SECTOR_SIZE - 1) & ~(SECTOR_SIZE - 1))
+
+/* Private state */
+
+static uint8_t *_arena = (void *) 0;
+
+static DLL           _dll;
+static bool          _dll_loaded = false;
+static Overlay_Stats _stats;
+static const char    *_error     = (void *) 0;
+
+// The symbol map only lists symbols actually linked into the executable, so any
+// library function that is only used by overlays would be missing from it.
+// Referencing them here forces the linker to keep them.
+static void *const _overlay_exports[] __attribute__((used)) = {
+	(void *) &rand,
+	(void *) &srand,
+	(void *) &malloc,
+	(void *) &free,
+	(void *) &memset,
+	(void *) &memcpy,
+	(void *) &sprintf
+};
+
+/* Private utilities */
+
+// Overlays are read straight from the CD rather than through the sector cache,
+// so that the read time in the load statistics is always the actual CD time.
+static bool _read_file(const CdlFILE *file, void *buffer) {
+	int sectors = _sector_align(file->size) / SECTOR_SIZE;
+
+	CdReadCallback(0);
+	CdControl(CdlSetloc, &(file->pos), 0);
+	CdRead(sectors, (uint32_t *) buffer, CdlModeSpeed);
+
+	return (CdReadSync(0, 0) >= 0);
+}
+
+/* Public API */
+
+bool Overlay_Init(const char *map_path, const char *const *paths, int count) {
+	CdlFILE file;
+
+	if (!CdSearchFile(&file, map_path)) {
+		_error = "SYMBOL MAP NOT FOUND";
+		return false;
+	}
+
+	// The map is kept in memory for the lifetime of the program, as the
+	// parsed symbol table may still point into it.
+	char *map = malloc(_sector_align(file.size));
+
+	if (!map) {
+		_error = "OUT OF MEMORY";
+		return false;
+	}
+	if (!_read_file(&file, map)) {
+		free(map);
+
+		_error = "SYMBOL MAP READ ERROR";
+		return false;
+	}
+	if (DL_ParseSymbolMap(map, file.size) < 0) {
+		free(map);
+
+		_error = dlerror();
+		return false;
+	}
+
+	_stats.map_size = _sector_align(file.size);
+
+	// Size the arena after the largest overlay. CdRead() always transfers whole
+	// sectors, so the size has to be rounded up.
+	_stats.arena_size = 0;
+	_stats.total_size = 0;
+
+	for (int i = 0; i < count; i++) {
+		if (!paths[i] || !CdSearchFile(&file, paths[i]))
+			continue;
+
+		size_t size = _sector_align(file.size);
+
+		if (size > _stats.arena_size)
+			_stats.arena_size = size;
+
+		_stats.total_size += file.size;
+	}
+
+	_arena = malloc(_stats.arena_size);
+
+	if (!_arena) {
+		_error = "OUT OF MEMORY";
+		return false;
+	}
+
+	_error = (void *) 0;
+	return true;
+}
+
+const BenchMode *Overlay_Load(const char *path) {
+	if (_dll_loaded && (_stats.path == path))
+		return DL_GetDLLSymbol(&_dll, "bench_mode");
+
+	Overlay_Unload();
+
+	Timer_Ticks start = Timer_GetTicks();
+	CdlFILE     file;
+
+	if (!CdSearchFile(&file, path)) {
+		_error = "OVERLAY NOT FOUND";
+		return (void *) 0;
+	}
+
+	if (!_arena || (_sector_align(file.size) > _stats.arena_size)) {
+		_error = "OVERLAY TOO LARGE";
+		return (void *) 0;
+	}
+	if (!_read_file(&file, _arena)) {
+		_error = "OVERLAY READ ERROR";
+		return (void *) 0;
+	}
+
+	Timer_Ticks read_end = Timer_GetTicks();
+
+	if (!DL_CreateDLL(&_dll, _arena, file.size, RTLD_NOW)) {
+		_error = dlerror();
+		return (void *) 0;
+	}
+
+	const BenchMode *mode = DL_GetDLLSymbol(&_dll, "bench_mode");
+
+	if (!mode) {
+		DL_DestroyDLL(&_dll);
+
+		_error = "BENCH_MODE SYMBOL MISSING";
+		return (void *) 0;
+	}
+
+	_dll_loaded      = true;
+	_stats.path      = path;
+	_stats.size      = file.size;
+	_stats.read_time = read_end - start;
+	_stats.link_time = Timer_GetTicks() - read_end;
+
+	_error = (void *) 0;
+	return mode;
+}
+
+void Overlay_Unload(void) {
+	if (!_dll_loaded)
+		return;
+
+	DL_DestroyDLL(&_dll);
+	_dll_loaded = false;
+}
+
+const Overlay_Stats *Overlay_GetStats(void) {
+	return &_stats;
+}
+
+const char *Overlay_GetError(void) {
+	return _error;
+}
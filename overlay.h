@@ -0,0 +1,106 @@
+/*
+ * ps1-benchmark overlay loader
+ */
+
+/**
+ * @file overlay.h
+ * @brief Loader for benchmark modes built as overlays
+ *
+ * @details Benchmark modes in modes/ are built as PSn00bSDK DLLs and loaded
+ * from the CD on demand into a single arena, allocated once at startup and
+ * sized to fit the largest overlay, so all of them run from the same address
+ * and only one is resident at a time. Overlays are linked against BENCH.EXE at
+ * load time using the executable's symbol map (BENCH.MAP).
+ *
+ * Loading an overlay replaces the previous one, so no pointers into an overlay
+ * (including the BenchMode structure it exports) shall be used after another
+ * overlay has been loaded.
+ */
+
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+
+#include "bench.h"
+#include "timer.h"
+
+/* Type definitions */
+
+/**
+ * @brief Overlay memory usage and load statistics.
+ *
+ * @details The total size is the sum of the sizes of all overlays, i.e. the
+ * amount of RAM a monolithic executable would need to hold the same code,
+ * while the arena size is what is actually allocated to hold them. The map size
+ * is the RAM taken by the symbol map, which has to stay resident alongside the
+ * arena and would not be needed without overlays. The other
+ * fields refer to the last overlay loaded: the read time covers locating the
+ * file and reading it from the CD, while the link time covers relocation and
+ * symbol resolution by the dynamic linker.
+ */
+typedef struct {
+	size_t arena_size, total_size, map_size;
+
+	const char  *path;
+	size_t      size;
+	Timer_Ticks read_time, link_time;
+} Overlay_Stats;
+
+/* Public API */
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @brief Loads the executable's symbol map and allocates the overlay arena.
+ *
+ * @details Looks up all the given overlays on the CD in order to size the arena
+ * after the largest one. Overlays missing from the CD are skipped and will
+ * fail to load later on.
+ *
+ * @param map_path Path to the symbol map on the CD (e.g. "\\BENCH.MAP;1")
+ * @param paths Array of paths to all overlays that may be loaded
+ * @param count Number of entries in the array (NULL entries are ignored)
+ * @return True if the map was parsed and the arena allocated successfully
+ */
+bool Overlay_Init(const char *map_path, const char *const *paths, int count);
+
+/**
+ * @brief Loads an overlay into the arena and returns the mode it exports.
+ *
+ * @details Any previously loaded overlay is unloaded first. Does nothing and
+ * returns the already loaded mode if the requested overlay is the current one.
+ * The CD drive must be idle (i.e. no stream reads in progress) when calling
+ * this function.
+ *
+ * @param path Path to the overlay on the CD (e.g. "\\MODES\\STRESS.DLL;1")
+ * @return Pointer to the overlay's BenchMode structure, or NULL on failure
+ */
+const BenchMode *Overlay_Load(const char *path);
+
+/**
+ * @brief Unloads the current overlay, if any.
+ */
+void Overlay_Unload(void);
+
+/**
+ * @brief Returns overlay memory usage and load statistics.
+ *
+ * @return Pointer to a statistics structure (the load fields are zero if no
+ * overlay has been loaded yet)
+ */
+const Overlay_Stats *Overlay_GetStats(void);
+
+/**
+ * @brief Returns the last error message reported by the loader.
+ *
+ * @return Error string, or NULL if no error occurred
+ */
+const char *Overlay_GetError(void);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,94 @@
+/*
+ * ps1-benchmark direct controller driver
+ */
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+#include <psxapi.h>
+
+#include "pad.h"
+#include "sio.h"
+#include "timer.h"
+
+#define PAD_ADDRESS  0x01
+#define PAD_CMD_READ 0x42
+#define PAD_ID_HIGH  0x5a
+#define TAP_READ_ALL 0x01
+
+#define TAP_SLOT_SIZE 8
+
+// Controllers acknowledge each byte within 100 us or so; waiting any longer
+// than that only slows down polling empty ports.
+#define ACK_TIMEOUT (TIMER_CLOCK / 5000) // 200 us
+
+/* Private utilities */
+
+static int _exchange(uint8_t value, bool ack) {
+	return Sio_Exchange(value, ack, ACK_TIMEOUT);
+}
+
+static int _read(uint8_t *buffer, bool tap) {
+	if (_exchange(PAD_ADDRESS, true) < 0)
+		return 0;
+
+	int id = _exchange(PAD_CMD_READ, true);
+
+	if ((id < 0) || (_exchange(tap ? TAP_READ_ALL : 0, true) != PAD_ID_HIGH))
+		return 0;
+
+	// The low nibble of the ID is the number of halfwords that follow, with
+	// zero meaning 16 (as is the case for the multitap).
+	int length = (id & 15) ? ((id & 15) * 2) : 32;
+
+	if (length > (PAD_BUFFER_SIZE - 2))
+		return 0;
+
+	buffer[1] = (uint8_t) id;
+
+	for (int i = 0; i < length; i++) {
+		int value = _exchange(0, i < (length - 1));
+
+		if (value < 0)
+			return 0;
+
+		buffer[i + 2] = (uint8_t) value;
+	}
+
+	buffer[0] = 0;
+	return length + 2;
+}
+
+// The multitap forwards each slot's reply as is (ID, 5Ah, 6 data bytes); the
+// 5Ah byte is replaced with the ID and the ID with a status byte, so every
+// slot has the same layout as the whole buffer.
+static void _convert_tap_slots(uint8_t *buffer) {
+	uint8_t *slot = &buffer[2];
+
+	for (int i = 0; i < PAD_TAP_SLOTS; i++, slot += TAP_SLOT_SIZE) {
+		uint8_t id = slot[0];
+
+		slot[0] = (id == 0xff) ? 0xff : 0;
+		slot[1] = id;
+	}
+}
+
+/* Public API */
+
+int Pad_Poll(int port, uint8_t *buffer, bool tap) {
+	buffer[0] = 0xff;
+
+	int _exit = EnterCriticalSection();
+
+	Sio_Select(port);
+	int length = _read(buffer, tap);
+	Sio_Deselect();
+
+	if (_exit)
+		ExitCriticalSection();
+
+	if (length && (buffer[1] == PAD_TAP_ID))
+		_convert_tap_slots(buffer);
+
+	return length;
+}
@@ -0,0 +1,63 @@
+/*
+ * ps1-benchmark direct controller driver
+ */
+
+/**
+ * @file pad.h
+ * @brief Polled controller and multitap reads through the SIO0 registers
+ *
+ * @details The BIOS pad driver started by StartPAD() polls both controller
+ * ports from the vblank interrupt handler, every frame, whether or not the
+ * program is going to look at the result. This driver instead reads a port
+ * only when asked to, busy-waiting on the serial port for the few hundred
+ * microseconds a transfer takes, so that controllers can be polled once at
+ * whatever point in the frame input is actually needed (typically right
+ * before it is processed, for the lowest latency). Ports with nothing plugged
+ * in time out on the first byte.
+ *
+ * Results are stored in the same layout the BIOS driver uses, so they can be
+ * read through PADTYPE: a status byte (0 if a controller responded, 0xff
+ * otherwise), the controller's ID byte and its data. When reading through a
+ * multitap, the ID byte is 0x80 and is followed by four 8-byte blocks with the
+ * same layout, one per multitap slot.
+ *
+ * The BIOS pad driver must be stopped (with StopPAD()) before using this one,
+ * as both drive the same port. Transfers are performed in a critical section.
+ *
+ * See https://problemkaputt.de/psx-spx.htm#controllersandmemorycards for the
+ * protocol.
+ */
+
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+
+/* Constants */
+
+#define PAD_BUFFER_SIZE 34 // Enough for a multitap with four controllers
+#define PAD_TAP_SLOTS   4
+#define PAD_TAP_ID      0x80
+
+/* Public API */
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @brief Reads the state of the controller (or multitap) in a port.
+ *
+ * @param port Controller port (0 or 1)
+ * @param buffer Destination buffer (PAD_BUFFER_SIZE bytes)
+ * @param tap True to read all four slots of a multitap; when no multitap is
+ *            connected, the controller in the port is read as usual
+ * @return Number of bytes stored in the buffer, including the status and ID
+ *         bytes, or 0 if nothing responded
+ */
+int Pad_Poll(int port, uint8_t *buffer, bool tap);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,149 @@
+/*
+ * ps1-benchmark sampling profiler and hot code placement
+ */
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <psxetc.h>
+#include <psxapi.h>
+#include <hwregs_c.h>
+
+#include "profile.h"
+#include "timer.h"
+
+// Root counter 2 is taken by the timer (see timer.c). Counter 1 runs off the
+// system clock as well unless set to count hblanks.
+#define PROFILE_TIMER 1
+
+#define TIMER_RESET_AT_TARGET (1 << 3)
+#define TIMER_IRQ_AT_TARGET   (1 << 4)
+#define TIMER_IRQ_REPEAT      (1 << 6)
+
+// Locations in the BIOS kernel's table of tables.
+// https://problemkaputt.de/psx-spx.htm#biosmemorymap
+#define KERNEL_PCB_PTR 0x108
+#define TCB_EPC_OFFSET 0x88
+
+#define ROM_START 0xbfc00000
+
+// Provided by hotcode.ld; both resolve to zero if the script is not used.
+extern char __hot_start[] __attribute__((weak));
+extern char __hot_end[]   __attribute__((weak));
+
+static Profile_Data *_data = (void *) 0;
+static void         (*_old_handler)(void) = (void *) 0;
+
+/* Interrupt handlers */
+
+static uint32_t _get_epc(void) {
+	const uint32_t *pcb = *((uint32_t **) KERNEL_PCB_PTR);
+	const uint32_t *tcb = (const uint32_t *) pcb[0];
+
+	return tcb[TCB_EPC_OFFSET / 4];
+}
+
+static void _profile_irq_handler(void) {
+	uint32_t pc = _get_epc();
+
+	_data->total++;
+
+	if ((pc < PROFILE_KERNEL_END) || (pc >= ROM_START)) {
+		_data->kernel++;
+		return;
+	}
+
+	// Open addressing on the bucket address, which is never zero.
+	uint32_t address = pc & ~((1 << PROFILE_BUCKET_SHIFT) - 1);
+	int      index   = (address >> PROFILE_BUCKET_SHIFT) % PROFILE_MAX_BUCKETS;
+
+	for (int i = 0; i < PROFILE_MAX_BUCKETS; i++) {
+		Profile_Bucket *bucket = &(_data->buckets[index]);
+
+		if (bucket->address == address) {
+			bucket->count++;
+			return;
+		}
+		if (!bucket->address) {
+			bucket->address = address;
+			bucket->count   = 1;
+			_data->num_buckets++;
+			return;
+		}
+
+		index = (index + 1) % PROFILE_MAX_BUCKETS;
+	}
+
+	_data->dropped++;
+}
+
+/* Public API */
+
+void Profile_Start(Profile_Data *data, int rate) {
+	__builtin_memset(data, 0, sizeof(Profile_Data));
+
+	int _exit = EnterCriticalSection();
+
+	_data        = data;
+	_old_handler = InterruptCallback(IRQ_TIMER1, &_profile_irq_handler);
+
+	TIMER_RELOAD(PROFILE_TIMER) = TIMER_CPU_CLOCK / rate;
+	TIMER_CTRL(PROFILE_TIMER)   =
+		TIMER_RESET_AT_TARGET | TIMER_IRQ_AT_TARGET | TIMER_IRQ_REPEAT;
+
+	if (_exit)
+		ExitCriticalSection();
+}
+
+Profile_Data *Profile_Stop(bool print) {
+	int _exit = EnterCriticalSection();
+
+	TIMER_CTRL(PROFILE_TIMER) = 0;
+	InterruptCallback(IRQ_TIMER1, _old_handler);
+
+	if (_exit)
+		ExitCriticalSection();
+
+	// Compact the table, then sort it by count (insertion sort is plenty for
+	// a few hundred entries).
+	Profile_Bucket *buckets = _data->buckets;
+	int            count    = 0;
+
+	for (int i = 0; i < PROFILE_MAX_BUCKETS; i++) {
+		if (buckets[i].address)
+			buckets[count++] = buckets[i];
+	}
+
+	for (int i = 1; i < count; i++) {
+		Profile_Bucket bucket = buckets[i];
+		int            j      = i;
+
+		for (; (j > 0) && (buckets[j - 1].count < bucket.count); j--)
+			buckets[j] = buckets[j - 1];
+
+		buckets[j] = bucket;
+	}
+
+	for (int i = count; i < PROFILE_MAX_BUCKETS; i++) {
+		buckets[i].address = 0;
+		buckets[i].count   = 0;
+	}
+
+	if (print) {
+		printf("profile: %d samples, %d kernel, %d dropped\n",
+			_data->total, _data->kernel, _data->dropped);
+
+		for (int i = 0; i < count; i++)
+			printf("%08x %d\n", buckets[i].address, buckets[i].count);
+	}
+
+	return _data;
+}
+
+bool Profile_GetHotRange(uint32_t *start, uint32_t *end) {
+	*start = (uint32_t) __hot_start;
+	*end   = (uint32_t) __hot_end;
+
+	return (*start != 0) && (*end > *start);
+}
@@ -0,0 +1,83 @@
+/*
+ * ps1-benchmark sampling profiler
+ */
+
+/**
+ * @file profile.h
+ * @brief PC sampling profiler
+ *
+ * @details The profiler samples the program counter interrupted by root counter
+ * 1 at a fixed rate and counts samples per 32-byte range of code. The PC is
+ * read back from the register dump the BIOS exception handler saves to the
+ * current thread's TCB before it calls interrupt handlers. Samples can also be
+ * printed to the TTY when the profiler is stopped, for offline processing. The
+ * hot code mode uses it to check which functions should be marked HOT_TEXT
+ * (see hottext.h).
+ */
+
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+
+/* Constants */
+
+#define PROFILE_MAX_BUCKETS  256
+#define PROFILE_BUCKET_SHIFT 5
+#define PROFILE_KERNEL_END   0x80010000
+
+/* Type definitions */
+
+typedef struct {
+	uint32_t address, count;
+} Profile_Bucket;
+
+/**
+ * @brief Profiler samples.
+ *
+ * @details Samples taken while the kernel (BIOS ROM, or the kernel's area of
+ * RAM below PROFILE_KERNEL_END) was running are only counted. Samples that do
+ * not fit in the bucket table once it is full are counted as dropped.
+ */
+typedef struct {
+	uint32_t       total, kernel, dropped;
+	int            num_buckets;
+	Profile_Bucket buckets[PROFILE_MAX_BUCKETS];
+} Profile_Data;
+
+/* Public API */
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @brief Clears the given sample buffer and starts sampling into it.
+ *
+ * @param data
+ * @param rate Sampling rate in Hz (at least 520)
+ */
+void Profile_Start(Profile_Data *data, int rate);
+
+/**
+ * @brief Stops sampling and sorts the buckets by sample count.
+ *
+ * @param print True to also print the buckets to the TTY, one "address
+ *              count" pair per line
+ * @return Pointer to the sample buffer passed to Profile_Start()
+ */
+Profile_Data *Profile_Stop(bool print);
+
+/**
+ * @brief Returns the address range of the hot code section.
+ *
+ * @param start Set to the address of the first hot function
+ * @param end Set to the address past the end of the last hot function
+ * @return False if the executable was built without BENCH_HOT_CODE
+ */
+bool Profile_GetHotRange(uint32_t *start, uint32_t *end);
+
+#ifdef __cplusplus
+}
+#endif
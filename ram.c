@@ -0,0 +1,172 @@
+/*
+ * ps1-benchmark RAM size detection
+ */
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <psxapi.h>
+
+#include "ram.h"
+
+// The RAM_SIZE register sets up how much of the 8 MB RAM window is mapped;
+// accessing a locked range raises a bus error, so the mirrors are only probed
+// if the BIOS has mapped the whole window, which both retail (0x0b88) and
+// development (0x0f88) BIOSes normally do.
+// https://problemkaputt.de/psx-spx.htm#memorycontrol
+#define RAM_SIZE_REG   (*((volatile uint32_t *) 0xbf801060))
+#define RAM_WINDOW(v)  (((v) >> 9) & 7)
+#define WINDOW_8MB     5
+#define WINDOW_8MB_X2  7
+
+#define KSEG0          0x80000000
+#define KSEG1          0xa0000000
+#define PHYS_MASK      0x1fffffff
+
+#define PROBE_PATTERN  0x5a3cc3a5
+
+// Configuration with 2 MB of RAM and with 8 MB. The sector caches (see
+// sectorcache.h) are kept small enough for their linear lookups to stay cheap,
+// as every stream read goes through one of them.
+#define BASE_CACHE_SECTORS  64
+#define BASE_STREAM_BUFFER  0x18000
+#define BASE_RENDER_BUFFER  8192
+#define BASE_PACKET_ARENA   8192
+#define BASE_MAX_OBJECTS    100
+
+#define EXT_CACHE_SECTORS   256
+#define EXT_STREAM_BUFFER   0x40000
+#define EXT_RENDER_BUFFER   0x10000
+#define EXT_PACKET_ARENA    0x40000
+#define EXT_MAX_OBJECTS     6400
+
+typedef struct _Ram_Block {
+	struct _Ram_Block *prev;
+	uint32_t          freed;
+} Ram_Block;
+
+static Ram_Config _config;
+
+static uint8_t    *_extra_start = (void *) 0;
+static uint8_t    *_extra_top   = (void *) 0;
+static uint8_t    *_extra_end   = (void *) 0;
+static Ram_Block  *_last        = (void *) 0;
+
+static volatile uint32_t _probe;
+
+/* Private utilities */
+
+static size_t _detect_size(void) {
+	uint32_t window = RAM_WINDOW(RAM_SIZE_REG);
+
+	if ((window != WINDOW_8MB) && (window != WINDOW_8MB_X2))
+		return RAM_BASE_SIZE;
+
+	// Go through uncached addresses so that every access actually reaches
+	// the RAM bus.
+	volatile uint32_t *base = (volatile uint32_t *)
+		((((uint32_t) &_probe) & PHYS_MASK) | KSEG1);
+	size_t size = RAM_MAX_SIZE;
+
+	int _exit = EnterCriticalSection();
+
+	for (size_t offset = RAM_BASE_SIZE; offset < RAM_MAX_SIZE; offset += RAM_BASE_SIZE) {
+		volatile uint32_t *mirror = (volatile uint32_t *)
+			(((uint32_t) base) + offset);
+
+		uint32_t saved = *mirror;
+
+		*base   = PROBE_PATTERN;
+		*mirror = ~PROBE_PATTERN;
+
+		bool aliased = (*base == ~PROBE_PATTERN);
+
+		*mirror = saved;
+
+		if (aliased) {
+			size = offset;
+			break;
+		}
+	}
+
+	if (_exit)
+		ExitCriticalSection();
+
+	return size;
+}
+
+/* Public API */
+
+void Ram_Init(void) {
+	size_t size = _detect_size();
+
+	_config.ram_size = size;
+
+	if (size > RAM_BASE_SIZE) {
+		_extra_start = (uint8_t *) (KSEG0 + RAM_BASE_SIZE);
+		_extra_top   = _extra_start;
+		_extra_end   = (uint8_t *) (KSEG0 + size);
+
+		_config.cache_sectors  = EXT_CACHE_SECTORS;
+		_config.stream_buffer  = EXT_STREAM_BUFFER;
+		_config.render_buffer  = EXT_RENDER_BUFFER;
+		_config.packet_arena   = EXT_PACKET_ARENA;
+		_config.max_objects    = EXT_MAX_OBJECTS;
+		_config.resident_audio = true;
+	} else {
+		_config.cache_sectors  = BASE_CACHE_SECTORS;
+		_config.stream_buffer  = BASE_STREAM_BUFFER;
+		_config.render_buffer  = BASE_RENDER_BUFFER;
+		_config.packet_arena   = BASE_PACKET_ARENA;
+		_config.max_objects    = BASE_MAX_OBJECTS;
+		_config.resident_audio = false;
+	}
+}
+
+const Ram_Config *Ram_GetConfig(void) {
+	return &_config;
+}
+
+void *Ram_Alloc(size_t size) {
+	if (!_extra_start)
+		return malloc(size);
+
+	size = (size + 7) & ~7;
+
+	if (((size_t) (_extra_end - _extra_top)) < (size + sizeof(Ram_Block)))
+		return (void *) 0;
+
+	Ram_Block *block = (Ram_Block *) _extra_top;
+
+	block->prev  = _last;
+	block->freed = 0;
+	_last        = block;
+	_extra_top  += sizeof(Ram_Block) + size;
+
+	return &block[1];
+}
+
+void Ram_Free(void *ptr) {
+	uint8_t *address = (uint8_t *) ptr;
+
+	if (!_extra_start || (address < _extra_start) || (address >= _extra_end)) {
+		free(ptr);
+		return;
+	}
+
+	((Ram_Block *) ptr)[-1].freed = 1;
+
+	// Blocks freed out of order are only reclaimed once all blocks allocated
+	// after them have been freed as well.
+	while (_last && _last->freed) {
+		_extra_top = (uint8_t *) _last;
+		_last      = _last->prev;
+	}
+}
+
+size_t Ram_GetExtraUsage(size_t *used) {
+	*used = _extra_top - _extra_start;
+
+	return _extra_end - _extra_start;
+}
@@ -0,0 +1,104 @@
+/*
+ * ps1-benchmark RAM size detection
+ */
+
+/**
+ * @file ram.h
+ * @brief Main RAM size detection and allocator for RAM beyond 2 MB
+ *
+ * @details Retail consoles have 2 MB of RAM, mirrored across the 8 MB window
+ * the BIOS sets up in the RAM_SIZE register, while development kits (and
+ * emulators set up to emulate them) have 8 MB. Ram_Init() tells the two apart
+ * by checking whether writes 2 MB apart alias each other, and picks a
+ * configuration for buffers whose size is a tradeoff between memory usage
+ * and performance.
+ *
+ * The heap provided by the C library always ends below the stack, at the top
+ * of the first 2 MB, so any RAM past that is managed separately by
+ * Ram_Alloc(). As its only users are large buffers allocated once, it is a
+ * simple stack allocator: Ram_Free() only reclaims memory when called on the
+ * most recent allocation, in reverse order of allocation. When there is no
+ * extra RAM, both functions fall back to malloc() and free().
+ */
+
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+
+/* Constants */
+
+#define RAM_BASE_SIZE 0x200000
+#define RAM_MAX_SIZE  0x800000
+
+/* Type definitions */
+
+/**
+ * @brief Buffer configuration picked for the detected amount of RAM.
+ *
+ * @details The sector cache, the audio stream ring buffers (stream_buffer
+ * bytes per track) and the two resident render buffers (render_buffer bytes of
+ * primitives each) are allocated with Ram_Alloc(). The packet arena size and
+ * maximum object count are meant for modes drawing large numbers of objects
+ * (the resident stress test always draws NUM_RECTANGLES objects). If
+ * resident_audio is set, the looped part of each audio test track is kept in
+ * RAM as it is streamed, as long as it fits, so that the CD is no longer read
+ * from once it has played through once.
+ */
+typedef struct {
+	size_t ram_size;
+	int    cache_sectors;
+	size_t stream_buffer, render_buffer;
+	size_t packet_arena;
+	int    max_objects;
+	bool   resident_audio;
+} Ram_Config;
+
+/* Public API */
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @brief Detects the amount of RAM and sets up the configuration.
+ *
+ * @details Must be called once at startup, before any other function in this
+ * module.
+ */
+void Ram_Init(void);
+
+/**
+ * @brief Returns the configuration for the detected amount of RAM.
+ *
+ * @return Pointer to the current configuration
+ */
+const Ram_Config *Ram_GetConfig(void);
+
+/**
+ * @brief Allocates memory, from the RAM past 2 MB if present.
+ *
+ * @param size
+ * @return Pointer to the allocated block (8-byte aligned), or NULL
+ */
+void *Ram_Alloc(size_t size);
+
+/**
+ * @brief Frees memory allocated by Ram_Alloc().
+ *
+ * @param ptr Block to free (may be NULL)
+ */
+void Ram_Free(void *ptr);
+
+/**
+ * @brief Returns the amount of RAM past 2 MB in use and in total.
+ *
+ * @param used Set to the number of bytes allocated
+ * @return Total number of bytes past 2 MB (0 on retail consoles)
+ */
+size_t Ram_GetExtraUsage(size_t *used);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,175 @@
+/*
+ * ps1-benchmark CD sector cache
+ */
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <psxcd.h>
+
+#include "sectorcache.h"
+#include "timer.h"
+#include "ram.h"
+
+#define SECTOR_SIZE 2048
+#define NO_SECTOR   -1
+
+/* Private utilities */
+
+static int _find(const SectorCache *cache, int lba) {
+	for (int i = 0; i < cache->num_sectors; i++) {
+		if (cache->lba[i] == lba)
+			return i;
+	}
+
+	return -1;
+}
+
+// Returns the slot a sector shall be stored in: the one already holding it if
+// any, otherwise a free one or the least recently used one.
+static int _find_slot(const SectorCache *cache, int lba) {
+	int      slot   = 0;
+	uint32_t oldest = 0xffffffff;
+
+	for (int i = 0; i < cache->num_sectors; i++) {
+		if ((cache->lba[i] == lba) || (cache->lba[i] == NO_SECTOR))
+			return i;
+
+		if (cache->last_used[i] < oldest) {
+			slot   = i;
+			oldest = cache->last_used[i];
+		}
+	}
+
+	return slot;
+}
+
+/* Public API */
+
+bool SectorCache_Init(SectorCache *cache, int num_sectors) {
+	cache->data        = Ram_Alloc(num_sectors * SECTOR_SIZE);
+	cache->lba         = Ram_Alloc(num_sectors * sizeof(int));
+	cache->last_used   = Ram_Alloc(num_sectors * sizeof(uint32_t));
+	cache->num_sectors = num_sectors;
+
+	if (!cache->data || !cache->lba || !cache->last_used) {
+		SectorCache_Destroy(cache);
+		return false;
+	}
+
+	SectorCache_Clear(cache);
+	return true;
+}
+
+void SectorCache_Destroy(SectorCache *cache) {
+	Ram_Free(cache->last_used);
+	Ram_Free(cache->lba);
+	Ram_Free(cache->data);
+
+	cache->data        = (void *) 0;
+	cache->lba         = (void *) 0;
+	cache->last_used   = (void *) 0;
+	cache->num_sectors = 0;
+}
+
+void SectorCache_Clear(SectorCache *cache) {
+	for (int i = 0; i < cache->num_sectors; i++) {
+		cache->lba[i]       = NO_SECTOR;
+		cache->last_used[i] = 0;
+	}
+
+	cache->clock = 0;
+	__builtin_memset(&(cache->stats), 0, sizeof(SectorCache_Stats));
+}
+
+int SectorCache_Fetch(SectorCache *cache, int lba, int count, void *buffer) {
+	uint8_t *ptr = buffer;
+	int     hits = 0;
+
+	for (; hits < count; hits++) {
+		int slot = _find(cache, lba + hits);
+
+		if (slot < 0)
+			break;
+
+		cache->last_used[slot] = ++cache->clock;
+
+		__builtin_memcpy(ptr, &(cache->data[slot * SECTOR_SIZE]), SECTOR_SIZE);
+		ptr += SECTOR_SIZE;
+	}
+
+	cache->stats.hits += hits;
+	return hits;
+}
+
+void SectorCache_Fill(
+	SectorCache *cache, int lba, int count, const void *data, Timer_Ticks time
+) {
+	const uint8_t *ptr = data;
+
+	cache->stats.misses    += count;
+	cache->stats.miss_time += time;
+
+	for (int i = 0; (i < count) && cache->num_sectors; i++) {
+		int slot = _find_slot(cache, lba + i);
+
+		cache->lba[slot]       = lba + i;
+		cache->last_used[slot] = ++cache->clock;
+
+		__builtin_memcpy(&(cache->data[slot * SECTOR_SIZE]), ptr, SECTOR_SIZE);
+		ptr += SECTOR_SIZE;
+	}
+}
+
+bool SectorCache_Read(SectorCache *cache, int lba, int count, void *buffer) {
+	uint8_t *ptr = buffer;
+
+	CdReadCallback(0);
+
+	while (count > 0) {
+		int hits = SectorCache_Fetch(cache, lba, count, ptr);
+
+		lba   += hits;
+		count -= hits;
+		ptr   += hits * SECTOR_SIZE;
+
+		if (!count)
+			break;
+
+		// Read all sectors up to the next cached one in one go.
+		int length = 1;
+
+		while ((length < count) && (_find(cache, lba + length) < 0))
+			length++;
+
+		CdlLOC      pos;
+		Timer_Ticks start = Timer_GetTicks();
+
+		CdIntToPos(lba, &pos);
+		CdControl(CdlSetloc, &pos, 0);
+		CdRead(length, (uint32_t *) ptr, CdlModeSpeed);
+
+		if (CdReadSync(0, 0) < 0)
+			return false;
+
+		SectorCache_Fill(cache, lba, length, ptr, Timer_GetTicks() - start);
+
+		lba   += length;
+		count -= length;
+		ptr   += length * SECTOR_SIZE;
+	}
+
+	return true;
+}
+
+const SectorCache_Stats *SectorCache_GetStats(const SectorCache *cache) {
+	return &(cache->stats);
+}
+
+Timer_Ticks SectorCache_GetTimeSaved(const SectorCache *cache) {
+	if (!cache->stats.misses)
+		return 0;
+
+	return (cache->stats.miss_time / cache->stats.misses) * cache->stats.hits;
+}
@@ -0,0 +1,157 @@
+/*
+ * ps1-benchmark CD sector cache
+ */
+
+/**
+ * @file sectorcache.h
+ * @brief LRU cache of CD sectors in main RAM
+ *
+ * @details Keeps copies of recently read CD sectors, keyed by their LBA, in a
+ * fixed-size pool allocated once by SectorCache_Init(). When the pool is full,
+ * the least recently used sector is evicted to make room for new ones. The pool
+ * is allocated with Ram_Alloc(), so it lives past the first 2 MB of RAM if
+ * there is any (see ram.h).
+ *
+ * The cache can be used either synchronously through SectorCache_Read(), which
+ * only reads the sectors that are not cached from the CD, or by asynchronous
+ * readers (such as the audio stream feeder) which shall call SectorCache_Fetch()
+ * before issuing a read and SectorCache_Fill() once it has completed.
+ *
+ * Lookups are linear scans of the pool, which is fine for the few hundred
+ * sectors at most the cache is meant to hold.
+ */
+
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+
+#include "timer.h"
+
+/* Type definitions */
+
+/**
+ * @brief Sector cache statistics.
+ *
+ * @details Hits and misses are counted in sectors. The miss time is the time
+ * spent reading missed sectors from the CD (including seeking), which is used
+ * to estimate how much time cache hits have saved.
+ */
+typedef struct {
+	uint32_t    hits, misses;
+	Timer_Ticks miss_time;
+} SectorCache_Stats;
+
+/**
+ * @brief Sector cache object.
+ *
+ * @details All fields are only used internally and shall not be accessed
+ * directly. A zero-filled cache (or one whose allocation failed) is valid and
+ * simply never hits.
+ */
+typedef struct {
+	uint8_t  *data;
+	int      *lba;
+	uint32_t *last_used;
+	int      num_sectors;
+	uint32_t clock;
+
+	SectorCache_Stats stats;
+} SectorCache;
+
+/* Public API */
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @brief Allocates a sector cache's pool.
+ *
+ * @param cache
+ * @param num_sectors Size of the pool in sectors (2048 bytes each)
+ * @return True if the pool was allocated successfully
+ */
+bool SectorCache_Init(SectorCache *cache, int num_sectors);
+
+/**
+ * @brief Frees a sector cache's pool.
+ *
+ * @param cache
+ */
+void SectorCache_Destroy(SectorCache *cache);
+
+/**
+ * @brief Evicts all sectors and resets the statistics.
+ *
+ * @param cache
+ */
+void SectorCache_Clear(SectorCache *cache);
+
+/**
+ * @brief Copies the longest cached run of sectors at the start of a range.
+ *
+ * @details Stops at the first sector that is not in the cache. All sectors
+ * copied are accounted as hits.
+ *
+ * @param cache
+ * @param lba First sector of the range
+ * @param count Number of sectors in the range
+ * @param buffer Destination buffer
+ * @return Number of sectors copied (0 if the first one is not cached)
+ */
+int SectorCache_Fetch(SectorCache *cache, int lba, int count, void *buffer);
+
+/**
+ * @brief Adds sectors that have just been read from the CD to the cache.
+ *
+ * @details All sectors are accounted as misses, and the given time (in timer
+ * ticks) is added to the time spent reading missed sectors.
+ *
+ * @param cache
+ * @param lba First sector read
+ * @param count Number of sectors read
+ * @param data Sector data
+ * @param time Time it took to read the sectors
+ */
+void SectorCache_Fill(
+	SectorCache *cache, int lba, int count, const void *data, Timer_Ticks time
+);
+
+/**
+ * @brief Reads sectors from the CD through the cache.
+ *
+ * @details Copies cached sectors and reads the others from the CD at double
+ * speed, blocking until done. The CD read callback is cleared.
+ *
+ * @param cache
+ * @param lba First sector to read
+ * @param count Number of sectors to read
+ * @param buffer Destination buffer
+ * @return True if all sectors were read successfully
+ */
+bool SectorCache_Read(SectorCache *cache, int lba, int count, void *buffer);
+
+/**
+ * @brief Returns the cache's statistics.
+ *
+ * @param cache
+ * @return Pointer to the statistics structure
+ */
+const SectorCache_Stats *SectorCache_GetStats(const SectorCache *cache);
+
+/**
+ * @brief Estimates how much CD time cache hits have saved.
+ *
+ * @details Based on the average time per missed sector, so that the seek
+ * every missed read required is accounted for.
+ *
+ * @param cache
+ * @return Estimated time saved in timer ticks
+ */
+Timer_Ticks SectorCache_GetTimeSaved(const SectorCache *cache);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,80 @@
+/*
+ * ps1-benchmark controller/memory card serial port access
+ */
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+#include <psxetc.h>
+#include <psxapi.h>
+#include <hwregs_c.h>
+
+#include "sio.h"
+#include "timer.h"
+
+#define SIO_STAT_TX_READY (1 << 0)
+#define SIO_STAT_RX_READY (1 << 1)
+#define SIO_STAT_IRQ      (1 << 9)
+
+#define SIO_CTRL_TX_ENABLE (1 << 0)
+#define SIO_CTRL_DTR       (1 << 1)
+#define SIO_CTRL_ACK       (1 << 4)
+#define SIO_CTRL_DSR_IRQ   (1 << 12)
+#define SIO_CTRL_PORT2     (1 << 13)
+
+// Same settings as the BIOS: 8N1 at 33.8688 MHz / 0x88 = 250 kHz.
+#define SIO_MODE_8N1 0x000d
+#define SIO_BAUD_250 0x0088
+
+#define SELECT_DELAY (TIMER_CLOCK / 50000) // 20 us
+
+/* Public API */
+
+void Sio_WaitTicks(Timer_Ticks ticks) {
+	Timer_Ticks start = Timer_GetTicks();
+
+	while ((Timer_GetTicks() - start) < ticks)
+		__asm__ volatile("");
+}
+
+void Sio_Select(int port) {
+	SIO_MODE(0) = SIO_MODE_8N1;
+	SIO_BAUD(0) = SIO_BAUD_250;
+	SIO_CTRL(0) = SIO_CTRL_TX_ENABLE | SIO_CTRL_DTR | SIO_CTRL_ACK |
+		SIO_CTRL_DSR_IRQ | (port ? SIO_CTRL_PORT2 : 0);
+
+	Sio_WaitTicks(SELECT_DELAY);
+}
+
+void Sio_Deselect(void) {
+	SIO_CTRL(0) = SIO_CTRL_ACK;
+	IRQ_STAT    = ~(1 << IRQ_SIO0);
+}
+
+int Sio_Exchange(uint8_t value, bool ack, Timer_Ticks timeout) {
+	while (!(SIO_STAT(0) & SIO_STAT_TX_READY))
+		__asm__ volatile("");
+
+	SIO_DATA(0) = value;
+
+	while (!(SIO_STAT(0) & SIO_STAT_RX_READY))
+		__asm__ volatile("");
+
+	int reply = SIO_DATA(0);
+
+	if (!ack)
+		return reply;
+
+	Timer_Ticks start = Timer_GetTicks();
+
+	while (!(SIO_STAT(0) & SIO_STAT_IRQ)) {
+		if ((Timer_GetTicks() - start) > timeout)
+			return -1;
+	}
+
+	// Clear the acknowledge flag on both the port and the interrupt
+	// controller, so the BIOS card driver does not see a stray interrupt.
+	SIO_CTRL(0) |= SIO_CTRL_ACK;
+	IRQ_STAT     = ~(1 << IRQ_SIO0);
+	return reply;
+}
@@ -0,0 +1,67 @@
+/*
+ * ps1-benchmark controller/memory card serial port access
+ */
+
+/**
+ * @file sio.h
+ * @brief Polled byte transfers through the SIO0 registers
+ *
+ * @details Low-level helpers shared by the direct controller (pad.h) and
+ * memory card (card.h) drivers. The port is set up the same way the BIOS does
+ * (8N1 at 250 kHz) every time a device is selected, and each byte is sent and
+ * received by busy-waiting on the status register; the device's acknowledge
+ * pulse is awaited for up to a timeout given by the caller, as controllers
+ * and memory cards respond within very different times.
+ *
+ * These functions do not disable interrupts; callers should select a device,
+ * perform the whole transfer and deselect it in a critical section, so the
+ * BIOS pad driver does not interleave its own traffic.
+ */
+
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+
+#include "timer.h"
+
+/* Public API */
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @brief Busy-waits for a number of timer ticks.
+ *
+ * @param ticks
+ */
+void Sio_WaitTicks(Timer_Ticks ticks);
+
+/**
+ * @brief Sets up the port and selects the device in a controller port.
+ *
+ * @param port Controller port (0 or 1)
+ */
+void Sio_Select(int port);
+
+/**
+ * @brief Deselects the current device and clears any pending acknowledge.
+ */
+void Sio_Deselect(void);
+
+/**
+ * @brief Sends a byte and returns the byte received at the same time.
+ *
+ * @param value Byte to send
+ * @param ack True to wait for the device to acknowledge the byte (the last
+ *            byte of a command is never acknowledged)
+ * @param timeout Longest time to wait for the acknowledge, in timer ticks
+ * @return Byte received, or -1 if the device did not acknowledge it
+ */
+int Sio_Exchange(uint8_t value, bool ack, Timer_Ticks timeout);
+
+#ifdef __cplusplus
+}
+#endif
@@ -15,6 +15,7 @@
 #include <hwregs_c.h>
 
 #include "stream.h"
+#include "hottext.h"
 
 // The first 4 KB of SPU RAM are reserved for capture buffers and psxspu
 // additionally uploads a dummy sample (16 bytes) at 0x1000 by default, so the
@@ -41,7 +42,11 @@ static int _get_default_timer_rate(void) {
 
 /* Interrupt handlers */
 
-static void _spu_irq_handler(void) {
+static Stream_Time _profile(volatile Stream_Context *ctx) {
+	return ctx->config.profile_function ? ctx->config.profile_function() : 0;
+}
+
+static HOT_TEXT void _spu_irq_handler(void) {
 	volatile Stream_Context *ctx = _active_ctx;
 
 	// Acknowledge the interrupt to ensure it can be triggered again. The only
@@ -52,12 +57,16 @@ static void _spu_irq_handler(void) {
 	if (!ctx)
 		return;
 
+	Stream_Time start = _profile(ctx);
+
 	// Ensure enough data is available. If not, re-enable the IRQ (to prevent
 	// the SPU from getting stuck, even though this will produce nasty noises!)
 	// and fire the underrun callback.
 	int length = (int) ctx->buffer.length - (int) ctx->chunk_size;
 
 	if (length < 0) {
+		ctx->stats.underruns++;
+
 		if (ctx->config.underrun_callback)
 			ctx->config.underrun_callback();
 
@@ -112,14 +121,32 @@ static void _spu_irq_handler(void) {
 	}
 
 	// Start uploading the next chunk to the SPU.
+	ctx->dma_started = _profile(ctx);
 	SpuWrite((const uint32_t *) ptr, ctx->chunk_size);
+
+	Stream_Time irq_time = _profile(ctx) - start;
+
+	ctx->stats.chunks++;
+	ctx->stats.irq_time     += irq_time;
+	ctx->stats.last_irq_time = irq_time;
 }
 
 static void _spu_dma_handler(void) {
+	volatile Stream_Context *ctx = _active_ctx;
+
 	// Re-enable the SPU IRQ once the new chunk has been fully uploaded.
 	SPU_CTRL |= 1 << 6;
 
-	_active_ctx->buffering = false;
+	// The callback may also be triggered by other SPU transfers while no
+	// stream is active.
+	if (!ctx)
+		return;
+
+	Stream_Time dma_time = _profile(ctx) - ctx->dma_started;
+
+	ctx->buffering           = false;
+	ctx->stats.dma_time     += dma_time;
+	ctx->stats.last_dma_time = dma_time;
 }
 
 /* Public API */
@@ -144,7 +171,13 @@ void Stream_Init(Stream_Context *ctx, const Stream_Config *config) {
 	ctx->chunk_size        = ctx->config.interleave * ctx->num_channels;
 	ctx->samples_per_chunk = ctx->config.interleave / 16 * 28;
 	ctx->new_sample_rate   = ctx->config.sample_rate;
-	ctx->buffer.data       = malloc(config->buffer_size);
+
+	if (!ctx->config.alloc_function) {
+		ctx->config.alloc_function = &malloc;
+		ctx->config.free_function  = &free;
+	}
+
+	ctx->buffer.data = ctx->config.alloc_function(config->buffer_size);
 
 	assert(ctx->buffer.data);
 
@@ -157,7 +190,7 @@ void Stream_Init(Stream_Context *ctx, const Stream_Config *config) {
 }
 
 void Stream_Destroy(Stream_Context *ctx) {
-	free(ctx->buffer.data);
+	ctx->config.free_function(ctx->buffer.data);
 
 	int _exit = EnterCriticalSection();
 	InterruptCallback(IRQ_SPU, ctx->old_irq_handler);
@@ -259,6 +292,18 @@ void Stream_ResetSamplesPlayed(Stream_Context *ctx) {
 	ctx->play_time = 0;
 }
 
+void Stream_GetStats(const Stream_Context *ctx, Stream_Stats *stats) {
+	FastEnterCriticalSection();
+	__builtin_memcpy(stats, (const void *) &(ctx->stats), sizeof(Stream_Stats));
+	FastExitCriticalSection();
+}
+
+void Stream_ResetStats(Stream_Context *ctx) {
+	FastEnterCriticalSection();
+	__builtin_memset((void *) &(ctx->stats), 0, sizeof(Stream_Stats));
+	FastExitCriticalSection();
+}
+
 size_t Stream_GetRefillLength(const Stream_Context *ctx) {
 	int unbuf_total = (int) ctx->config.buffer_size - (int) ctx->buffer.length;
 
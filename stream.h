@@ -35,6 +35,8 @@
 typedef uint32_t    Stream_Time;
 typedef void        (*Stream_Callback)(void);
 typedef Stream_Time (*Stream_TimerFunction)(void);
+typedef void        *(*Stream_AllocFunction)(size_t size);
+typedef void        (*Stream_FreeFunction)(void *ptr);
 
 /**
  * @brief Stream initialization settings structure.
@@ -56,7 +58,10 @@ typedef Stream_Time (*Stream_TimerFunction)(void);
  * handler once the FIFO's length goes below the specified threshold and once it
  * reaches zero, respectively. The timer function will be used to improve the
  * accuracy of Stream_GetSamplesPlayed(); if not provided, VSync(-1) will be
- * used by default.
+ * used by default. The profiling function is also optional and, if provided,
+ * shall return a high resolution timestamp used to fill in Stream_Stats. The
+ * FIFO is allocated using the allocation and free functions if provided, or
+ * malloc() and free() otherwise.
  */
 typedef struct {
 	uint32_t spu_address, channel_mask;
@@ -64,9 +69,27 @@ typedef struct {
 	int      sample_rate, timer_rate;
 
 	Stream_Callback      refill_callback, underrun_callback;
-	Stream_TimerFunction timer_function;
+	Stream_TimerFunction timer_function, profile_function;
+	Stream_AllocFunction alloc_function;
+	Stream_FreeFunction  free_function;
 } Stream_Config;
 
+/**
+ * @brief Stream profiling counters.
+ *
+ * @details The chunk and underrun counts are always updated. The times are
+ * only measured if a profiling timer function was provided in the stream's
+ * configuration (they stay at zero otherwise), in which case they are
+ * expressed in that timer's units. The IRQ time is the time spent in the SPU
+ * IRQ handler (i.e. CPU time taken away from the main loop), while the DMA
+ * time is the time it takes for each chunk to be uploaded to SPU RAM, which
+ * happens in the background.
+ */
+typedef struct {
+	uint32_t    chunks, underruns;
+	Stream_Time irq_time, dma_time, last_irq_time, last_dma_time;
+} Stream_Stats;
+
 typedef struct {
 	uint8_t *data;
 	size_t  head, tail, length;
@@ -91,6 +114,9 @@ typedef struct {
 	volatile uint8_t     db_active, buffering, callback_issued;
 	volatile Stream_Time last_updated, last_stopped, play_time;
 	volatile int         new_sample_rate;
+
+	volatile Stream_Stats stats;
+	volatile Stream_Time  dma_started;
 } Stream_Context;
 
 /* Public API */
@@ -192,6 +218,23 @@ uint32_t Stream_GetSamplesPlayed(const Stream_Context *ctx);
  */
 void Stream_ResetSamplesPlayed(Stream_Context *ctx);
 
+/**
+ * @brief Returns a stream's profiling counters.
+ *
+ * @param ctx
+ * @param stats Structure to copy the counters into
+ *
+ * @see Stream_Stats, Stream_ResetStats()
+ */
+void Stream_GetStats(const Stream_Context *ctx, Stream_Stats *stats);
+
+/**
+ * @brief Resets a stream's profiling counters.
+ *
+ * @param ctx
+ */
+void Stream_ResetStats(Stream_Context *ctx);
+
 /**
  * @brief Returns how many bytes in a stream's FIFO are currently empty and can
  * be filled.
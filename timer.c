@@ -0,0 +1,77 @@
+/*
+ * ps1-benchmark high resolution timer
+ */
+
+#include <stdint.h>
+#include <psxetc.h>
+#include <psxapi.h>
+#include <hwregs_c.h>
+
+#include "timer.h"
+
+// Root counter 2 is the only one that can be clocked from the system clock
+// divided by 8 (counters 0 and 1 can only use the dot clock and hblank as
+// alternate sources, which depend on the video mode).
+// https://problemkaputt.de/psx-spx.htm#timers
+#define TIMER_CHANNEL 2
+
+#define TIMER_IRQ_AT_WRAP (1 << 5)
+#define TIMER_IRQ_REPEAT  (1 << 6)
+#define TIMER_SRC_SYSCLK8 (2 << 8)
+
+/* Interrupt handlers */
+
+static volatile uint32_t _overflow_count = 0;
+
+static void _timer_irq_handler(void) {
+	_overflow_count++;
+}
+
+/* Public API */
+
+void Timer_Init(void) {
+	int _exit = EnterCriticalSection();
+
+	_overflow_count = 0;
+	InterruptCallback(IRQ_TIMER2, &_timer_irq_handler);
+
+	// Writing to the control register also resets the counter to zero.
+	TIMER_CTRL(TIMER_CHANNEL) =
+		TIMER_IRQ_AT_WRAP | TIMER_IRQ_REPEAT | TIMER_SRC_SYSCLK8;
+
+	if (_exit)
+		ExitCriticalSection();
+}
+
+Timer_Ticks Timer_GetTicks(void) {
+	// Retry until the overflow count is stable across the counter read. If the
+	// counter wrapped around but the IRQ has not been serviced yet (e.g. when
+	// called with interrupts disabled) the pending overflow has to be added
+	// manually; the dispatcher acknowledges the IRQ before invoking our handler,
+	// so a pending IRQ is never counted twice.
+	uint32_t high, low, pending;
+
+	do {
+		high    = _overflow_count;
+		low     = TIMER_VALUE(TIMER_CHANNEL) & 0xffff;
+		pending = IRQ_STAT & (1 << IRQ_TIMER2);
+	} while (high != _overflow_count);
+
+	if (pending && (low < 0x8000))
+		high++;
+
+	return (high << 16) | low;
+}
+
+uint32_t Timer_TicksToUs(Timer_Ticks ticks) {
+	// 1000000 / 4233600 = 625 / 2646. Splitting the division keeps all
+	// intermediate values well within 32 bits.
+	return (ticks / 2646) * 625 + ((ticks % 2646) * 625) / 2646;
+}
+
+uint32_t Timer_TicksToCycles(Timer_Ticks ticks) {
+	if (ticks > (0xffffffff / TIMER_CYCLES_TICK))
+		return 0xffffffff;
+
+	return ticks * TIMER_CYCLES_TICK;
+}
@@ -0,0 +1,72 @@
+/*
+ * ps1-benchmark high resolution timer
+ */
+
+/**
+ * @file timer.h
+ * @brief Free-running 32-bit timer for benchmark measurements
+ *
+ * @details VSync(-1) only has a resolution of one frame, which is too coarse to
+ * time anything shorter than a few seconds. This module sets up root counter 2
+ * to count at 1/8 of the system clock and extends it to 32 bits in software by
+ * counting overflows in an IRQ handler (which fires every ~15.5 ms). One tick
+ * thus equals 8 CPU cycles, or ~0.236 us, and the counter wraps around after
+ * roughly 17 minutes.
+ */
+
+#pragma once
+
+#include <stdint.h>
+
+/* Constants */
+
+#define TIMER_CPU_CLOCK   33868800
+#define TIMER_CLOCK       (TIMER_CPU_CLOCK / 8)
+#define TIMER_CYCLES_TICK 8
+
+typedef uint32_t Timer_Ticks;
+
+/* Public API */
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @brief Sets up root counter 2 and installs the overflow IRQ handler.
+ *
+ * @details Must be called once at startup, after ResetGraph() (which resets
+ * the interrupt dispatcher).
+ */
+void Timer_Init(void);
+
+/**
+ * @brief Returns the current value of the 32-bit timer.
+ *
+ * @details Safe to call from both the main loop and interrupt handlers. The
+ * difference between two values is valid even if the counter wrapped around in
+ * between.
+ *
+ * @return Number of ticks elapsed since Timer_Init() was called
+ */
+Timer_Ticks Timer_GetTicks(void);
+
+/**
+ * @brief Converts a tick count to microseconds without 64-bit arithmetic.
+ *
+ * @param ticks
+ * @return Duration in microseconds
+ */
+uint32_t Timer_TicksToUs(Timer_Ticks ticks);
+
+/**
+ * @brief Converts a tick count to CPU cycles.
+ *
+ * @param ticks
+ * @return Duration in CPU cycles (saturates after ~2 minutes)
+ */
+uint32_t Timer_TicksToCycles(Timer_Ticks ticks);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,182 @@
+/*
+ * ps1-benchmark audio+data muxer (host tool)
+ *
+ * Interleaves the sectors of an interleaved .VAG stream (VAGi, see vagenc) with
+ * the sectors of one or more data files into a single container (.AVM), so
+ * that the data can be loaded while the audio is playing with a single
+ * sequential read and no seeking between files. The format is read by mux.c.
+ *
+ * Usage: avmux [-a audio_sectors] [-d data_sectors] audio.vag data... output
+ *
+ * The container starts with a header sector, followed by groups made up of
+ * audio_sectors audio sectors and data_sectors data sectors each, until all
+ * data has been stored; the last group may have fewer data sectors and all
+ * sectors after it hold audio. Each data file starts on a sector boundary.
+ *
+ * By default each group holds one chunk worth of audio sectors, and the number
+ * of data sectors is chosen so that reading at double speed (150 sectors per
+ * second) delivers audio slightly faster than it is played.
+ */
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdio.h>
+
+#include "common.h"
+
+#define MUX_MAGIC     0x584d5641 // "AVMX"
+#define MUX_MAX_FILES 32
+
+#define SECTOR_SIZE     2048
+#define SECTORS_PER_SEC 150
+
+int main(int argc, char **argv) {
+	int audio_sectors = 0;
+	int data_sectors  = 0;
+	int arg           = 1;
+
+	for (; (arg < argc) && (argv[arg][0] == '-'); arg++) {
+		if (!strcmp(argv[arg], "-a") && ((arg + 1) < argc))
+			audio_sectors = atoi(argv[++arg]);
+		else if (!strcmp(argv[arg], "-d") && ((arg + 1) < argc))
+			data_sectors = atoi(argv[++arg]);
+		else
+			break;
+	}
+
+	int num_files = argc - arg - 2;
+
+	if ((num_files < 1) || (num_files > MUX_MAX_FILES) || (audio_sectors < 0) || (data_sectors < 0)) {
+		fprintf(
+			stderr,
+			"Usage: %s [-a audio_sectors] [-d data_sectors] audio.vag data... output\n"
+			"Up to %d data files can be stored.\n",
+			argv[0], MUX_MAX_FILES
+		);
+		return 1;
+	}
+
+	const char *audio_path  = argv[arg];
+	const char *output_path = argv[argc - 1];
+
+	Buffer audio;
+
+	if (!buffer_load(&audio, audio_path))
+		return 1;
+
+	if ((audio.length <= SECTOR_SIZE) || memcmp(audio.data, "VAGi", 4)) {
+		fprintf(stderr, "%s: not an interleaved .VAG file\n", audio_path);
+		return 1;
+	}
+
+	uint32_t interleave   = read_le32(&audio.data[8]);
+	uint32_t sample_rate  = read_be32(&audio.data[16]);
+	int      num_channels = read_le16(&audio.data[0x1e]);
+
+	if (!num_channels)
+		num_channels = 2;
+	if (!interleave || (interleave % SECTOR_SIZE)) {
+		fprintf(stderr, "%s: interleave must be a multiple of %d\n", audio_path, SECTOR_SIZE);
+		return 1;
+	}
+
+	int num_audio = (int) ((audio.length - SECTOR_SIZE + SECTOR_SIZE - 1) / SECTOR_SIZE);
+
+	buffer_align(&audio, SECTOR_SIZE);
+
+	// Concatenate the data files, each one starting on a sector boundary.
+	Buffer   data;
+	uint32_t offsets[MUX_MAX_FILES], sizes[MUX_MAX_FILES];
+
+	buffer_init(&data);
+
+	for (int i = 0; i < num_files; i++) {
+		Buffer file;
+
+		if (!buffer_load(&file, argv[arg + 1 + i]))
+			return 1;
+
+		offsets[i] = (uint32_t) (data.length / SECTOR_SIZE);
+		sizes[i]   = (uint32_t) file.length;
+
+		buffer_write(&data, file.data, file.length);
+		buffer_align(&data, SECTOR_SIZE);
+		buffer_free(&file);
+	}
+
+	int num_data = (int) (data.length / SECTOR_SIZE);
+
+	// Pick the group layout. Audio must arrive at least as fast as it is
+	// played, i.e. audio_sectors / (audio_sectors + data_sectors) of the
+	// drive's bandwidth must cover the stream's bitrate; one sector is taken
+	// off the data share as a margin.
+	if (!audio_sectors)
+		audio_sectors = (int) ((num_channels * interleave) / SECTOR_SIZE);
+
+	if (!data_sectors) {
+		double needed = num_channels * (sample_rate / 28.0) * 16.0 / SECTOR_SIZE;
+
+		data_sectors = (int) (audio_sectors * SECTORS_PER_SEC / needed) - audio_sectors - 1;
+
+		if (data_sectors < 1)
+			data_sectors = 1;
+	}
+
+	// Write the header, padded to a full sector.
+	Buffer output;
+
+	buffer_init(&output);
+	buffer_put_le32(&output, MUX_MAGIC);
+	buffer_put_le16(&output, (uint16_t) audio_sectors);
+	buffer_put_le16(&output, (uint16_t) data_sectors);
+	buffer_put_le32(&output, (uint32_t) num_audio);
+	buffer_put_le32(&output, (uint32_t) num_data);
+	buffer_put_le32(&output, interleave);
+	buffer_put_le32(&output, sample_rate);
+	buffer_put_le16(&output, (uint16_t) num_channels);
+	buffer_put_le16(&output, (uint16_t) num_files);
+	buffer_put_le32(&output, 0);
+
+	for (int i = 0; i < num_files; i++) {
+		buffer_put_le32(&output, offsets[i]);
+		buffer_put_le32(&output, sizes[i]);
+	}
+
+	buffer_align(&output, SECTOR_SIZE);
+
+	// Interleave the sectors.
+	const uint8_t *audio_ptr = &audio.data[SECTOR_SIZE];
+	const uint8_t *data_ptr  = data.data;
+	int audio_left = num_audio;
+	int data_left  = num_data;
+
+	while (audio_left || data_left) {
+		int a = (audio_left < audio_sectors) ? audio_left : audio_sectors;
+
+		// Once all data has been stored, the rest of the audio follows.
+		if (!data_left)
+			a = audio_left;
+
+		buffer_write(&output, audio_ptr, a * SECTOR_SIZE);
+		audio_ptr  += a * SECTOR_SIZE;
+		audio_left -= a;
+
+		int d = (data_left < data_sectors) ? data_left : data_sectors;
+
+		buffer_write(&output, data_ptr, d * SECTOR_SIZE);
+		data_ptr  += d * SECTOR_SIZE;
+		data_left -= d;
+	}
+
+	if (!buffer_save(&output, output_path))
+		return 1;
+
+	printf(
+		"%s: %d audio + %d data sectors, groups of %d + %d\n",
+		output_path, num_audio, num_data, audio_sectors, data_sectors
+	);
+	return 0;
+}
@@ -0,0 +1,162 @@
+/*
+ * ps1-benchmark host tools - shared utilities
+ */
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdio.h>
+
+#include "common.h"
+
+/* Growable byte buffer */
+
+void buffer_init(Buffer *buf) {
+	buf->data     = NULL;
+	buf->length   = 0;
+	buf->capacity = 0;
+}
+
+void buffer_free(Buffer *buf) {
+	free(buf->data);
+	buffer_init(buf);
+}
+
+void buffer_reserve(Buffer *buf, size_t length) {
+	size_t required = buf->length + length;
+
+	if (required <= buf->capacity)
+		return;
+
+	size_t capacity = buf->capacity ? buf->capacity : 4096;
+
+	while (capacity < required)
+		capacity *= 2;
+
+	buf->data = realloc(buf->data, capacity);
+
+	if (!buf->data) {
+		fprintf(stderr, "out of memory\n");
+		exit(1);
+	}
+
+	buf->capacity = capacity;
+}
+
+void buffer_write(Buffer *buf, const void *data, size_t length) {
+	buffer_reserve(buf, length);
+	memcpy(&(buf->data[buf->length]), data, length);
+
+	buf->length += length;
+}
+
+void buffer_fill(Buffer *buf, uint8_t value, size_t length) {
+	buffer_reserve(buf, length);
+	memset(&(buf->data[buf->length]), value, length);
+
+	buf->length += length;
+}
+
+void buffer_put(Buffer *buf, uint8_t value) {
+	buffer_write(buf, &value, 1);
+}
+
+void buffer_put_le16(Buffer *buf, uint16_t value) {
+	uint8_t data[2];
+
+	write_le16(data, value);
+	buffer_write(buf, data, 2);
+}
+
+void buffer_put_le32(Buffer *buf, uint32_t value) {
+	uint8_t data[4];
+
+	write_le32(data, value);
+	buffer_write(buf, data, 4);
+}
+
+void buffer_put_be32(Buffer *buf, uint32_t value) {
+	uint8_t data[4];
+
+	write_be32(data, value);
+	buffer_write(buf, data, 4);
+}
+
+void buffer_align(Buffer *buf, size_t alignment) {
+	size_t padding = (alignment - (buf->length % alignment)) % alignment;
+
+	buffer_fill(buf, 0, padding);
+}
+
+bool buffer_load(Buffer *buf, const char *path) {
+	FILE *file = fopen(path, "rb");
+
+	buffer_init(buf);
+
+	if (!file) {
+		fprintf(stderr, "%s: cannot open file\n", path);
+		return false;
+	}
+
+	uint8_t chunk[65536];
+	size_t  length;
+
+	while ((length = fread(chunk, 1, sizeof(chunk), file)))
+		buffer_write(buf, chunk, length);
+
+	fclose(file);
+	return true;
+}
+
+bool buffer_save(const Buffer *buf, const char *path) {
+	FILE *file = fopen(path, "wb");
+
+	if (!file) {
+		fprintf(stderr, "%s: cannot create file\n", path);
+		return false;
+	}
+
+	bool ok = (fwrite(buf->data, 1, buf->length, file) == buf->length);
+
+	if (fclose(file) || !ok) {
+		fprintf(stderr, "%s: write error\n", path);
+		return false;
+	}
+
+	return true;
+}
+
+/* Endianness helpers */
+
+uint16_t read_le16(const uint8_t *ptr) {
+	return ptr[0] | (ptr[1] << 8);
+}
+
+uint32_t read_le32(const uint8_t *ptr) {
+	return ptr[0] | (ptr[1] << 8) | (ptr[2] << 16) | ((uint32_t) ptr[3] << 24);
+}
+
+uint32_t read_be32(const uint8_t *ptr) {
+	return ((uint32_t) ptr[0] << 24) | (ptr[1] << 16) | (ptr[2] << 8) | ptr[3];
+}
+
+void write_le16(uint8_t *ptr, uint16_t value) {
+	ptr[0] = value & 0xff;
+	ptr[1] = value >> 8;
+}
+
+void write_le32(uint8_t *ptr, uint32_t value) {
+	ptr[0] = value & 0xff;
+	ptr[1] = (value >> 8) & 0xff;
+	ptr[2] = (value >> 16) & 0xff;
+	ptr[3] = value >> 24;
+}
+
+void write_be32(uint8_t *ptr, uint32_t value) {
+	ptr[0] = value >> 24;
+	ptr[1] = (value >> 16) & 0xff;
+	ptr[2] = (value >> 8) & 0xff;
+	ptr[3] = value & 0xff;
+}
@@ -0,0 +1,39 @@
+/*
+ * ps1-benchmark host tools - shared utilities
+ */
+
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+
+/* Growable byte buffer */
+
+typedef struct {
+	uint8_t *data;
+	size_t  length, capacity;
+} Buffer;
+
+void buffer_init(Buffer *buf);
+void buffer_free(Buffer *buf);
+void buffer_reserve(Buffer *buf, size_t length);
+void buffer_write(Buffer *buf, const void *data, size_t length);
+void buffer_fill(Buffer *buf, uint8_t value, size_t length);
+void buffer_put(Buffer *buf, uint8_t value);
+void buffer_put_le16(Buffer *buf, uint16_t value);
+void buffer_put_le32(Buffer *buf, uint32_t value);
+void buffer_put_be32(Buffer *buf, uint32_t value);
+void buffer_align(Buffer *buf, size_t alignment);
+
+bool buffer_load(Buffer *buf, const char *path);
+bool buffer_save(const Buffer *buf, const char *path);
+
+/* Endianness helpers */
+
+uint16_t read_le16(const uint8_t *ptr);
+uint32_t read_le32(const uint8_t *ptr);
+uint32_t read_be32(const uint8_t *ptr);
+void write_le16(uint8_t *ptr, uint16_t value);
+void write_le32(uint8_t *ptr, uint32_t value);
+void write_be32(uint8_t *ptr, uint32_t value);
@@ -0,0 +1,322 @@
+/*
+ * ps1-benchmark LZ4 asset packer (host tool)
+ *
+ * Compresses a file into the block-indexed LZ4 format read by lz4.c. The file
+ * is split into fixed-size blocks that can be decompressed as soon as their
+ * compressed data has been read from the CD; matches may still reference any
+ * previous block within the 64 KB LZ4 window, so splitting costs very little
+ * compression ratio.
+ *
+ * Usage: lz4pack [-b block_size] [-l limit] input output [raw_output]
+ *
+ * -l truncates the input to the given number of bytes before compressing it,
+ * and raw_output (if given) receives the same truncated data uncompressed, so
+ * that benchmarks can compare the two versions of a slice of a larger file.
+ */
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdio.h>
+
+#include "common.h"
+
+#define LZ4_MAGIC 0x42345a4c
+
+#define MIN_MATCH     4
+#define LAST_LITERALS 5  // The last 5 bytes of a block are always literals
+#define MF_LIMIT      12 // The last match must start 12 bytes before the end
+#define MAX_OFFSET    65535
+
+#define HASH_BITS   16
+#define CHAIN_DEPTH 256
+
+/* Compressor */
+
+typedef struct {
+	const uint8_t *data;
+	size_t        size;
+
+	int32_t *head, *prev;
+} Matcher;
+
+static uint32_t hash4(const uint8_t *ptr) {
+	uint32_t value = ptr[0] | (ptr[1] << 8) | (ptr[2] << 16) | (ptr[3] << 24);
+
+	return (value * 2654435761u) >> (32 - HASH_BITS);
+}
+
+static void insert(Matcher *m, size_t pos) {
+	uint32_t hash = hash4(&(m->data[pos]));
+
+	m->prev[pos]  = m->head[hash];
+	m->head[hash] = (int32_t) pos;
+}
+
+// Finds the longest match for the data at pos that ends no later than limit.
+static size_t find_match(Matcher *m, size_t pos, size_t limit, size_t *offset) {
+	size_t  best_length = 0;
+	int32_t candidate   = m->head[hash4(&(m->data[pos]))];
+
+	for (int depth = 0; (candidate >= 0) && (depth < CHAIN_DEPTH); depth++) {
+		if ((pos - candidate) > MAX_OFFSET)
+			break;
+
+		size_t length = 0;
+
+		while (
+			((pos + length) < limit) &&
+			(m->data[candidate + length] == m->data[pos + length])
+		)
+			length++;
+
+		if (length > best_length) {
+			best_length = length;
+			*offset     = pos - candidate;
+		}
+
+		candidate = m->prev[candidate];
+	}
+
+	return best_length;
+}
+
+static void put_length(Buffer *out, size_t length) {
+	for (length -= 15; length >= 255; length -= 255)
+		buffer_put(out, 255);
+
+	buffer_put(out, (uint8_t) length);
+}
+
+static void put_sequence(
+	Buffer *out, const uint8_t *literals, size_t num_literals, size_t offset,
+	size_t match_length
+) {
+	size_t lit_token   = (num_literals >= 15) ? 15 : num_literals;
+	size_t match_token = 0;
+
+	if (match_length) {
+		match_length -= MIN_MATCH;
+		match_token   = (match_length >= 15) ? 15 : match_length;
+	}
+
+	buffer_put(out, (uint8_t) ((lit_token << 4) | match_token));
+
+	if (lit_token == 15)
+		put_length(out, num_literals);
+
+	buffer_write(out, literals, num_literals);
+
+	// The last sequence of a block has no match.
+	if (!offset)
+		return;
+
+	buffer_put(out, (uint8_t) (offset & 0xff));
+	buffer_put(out, (uint8_t) (offset >> 8));
+
+	if (match_token == 15)
+		put_length(out, match_length);
+}
+
+static void compress_block(Matcher *m, Buffer *out, size_t start, size_t end) {
+	size_t anchor = start;
+	size_t pos    = start;
+
+	if ((end - start) > MF_LIMIT) {
+		size_t match_limit = end - MF_LIMIT;
+		size_t end_limit   = end - LAST_LITERALS;
+
+		while (pos < match_limit) {
+			size_t offset = 0;
+			size_t length = find_match(m, pos, end_limit, &offset);
+
+			if (length < MIN_MATCH) {
+				insert(m, pos++);
+				continue;
+			}
+
+			put_sequence(out, &(m->data[anchor]), pos - anchor, offset, length);
+
+			for (size_t i = 0; i < length; i++)
+				insert(m, pos + i);
+
+			pos   += length;
+			anchor = pos;
+		}
+	}
+
+	// Hash the tail as well, so the next block can reference it.
+	for (; pos < end; pos++) {
+		if ((pos + MIN_MATCH) <= m->size)
+			insert(m, pos);
+	}
+
+	put_sequence(out, &(m->data[anchor]), end - anchor, 0, 0);
+}
+
+/* Verification */
+
+static bool verify(const uint8_t *packed, const uint8_t *data, size_t size) {
+	uint32_t block_size = read_le16(&packed[8]);
+	uint32_t num_blocks = read_le16(&packed[10]);
+	uint8_t  *out       = malloc(size + 1);
+	size_t   op         = 0;
+	size_t   ip         = 12 + num_blocks * 4;
+
+	for (uint32_t block = 0; block < num_blocks; block++) {
+		size_t iend = read_le32(&packed[12 + block * 4]);
+		size_t oend = op + block_size;
+
+		if (oend > size)
+			oend = size;
+
+		while (ip < iend) {
+			uint32_t token  = packed[ip++];
+			size_t   length = token >> 4;
+
+			if (length == 15) {
+				uint8_t value;
+
+				do {
+					value   = packed[ip++];
+					length += value;
+				} while (value == 255);
+			}
+
+			memcpy(&out[op], &packed[ip], length);
+			ip += length;
+			op += length;
+
+			if (ip >= iend)
+				break;
+
+			size_t offset = packed[ip] | (packed[ip + 1] << 8);
+			ip += 2;
+			length = token & 15;
+
+			if (length == 15) {
+				uint8_t value;
+
+				do {
+					value   = packed[ip++];
+					length += value;
+				} while (value == 255);
+			}
+
+			length += MIN_MATCH;
+
+			if (!offset || (offset > op) || ((op + length) > oend - LAST_LITERALS)) {
+				free(out);
+				return false;
+			}
+
+			for (size_t i = 0; i < length; i++, op++)
+				out[op] = out[op - offset];
+		}
+
+		if (op != oend) {
+			free(out);
+			return false;
+		}
+	}
+
+	bool valid = (op == size) && !memcmp(out, data, size);
+
+	free(out);
+	return valid;
+}
+
+/* Main */
+
+int main(int argc, char **argv) {
+	size_t block_size = 8192;
+	size_t limit      = 0;
+	int    arg        = 1;
+
+	for (; (arg < argc) && (argv[arg][0] == '-'); arg++) {
+		if (!strcmp(argv[arg], "-b") && ((arg + 1) < argc))
+			block_size = strtoul(argv[++arg], NULL, 0);
+		else if (!strcmp(argv[arg], "-l") && ((arg + 1) < argc))
+			limit = strtoul(argv[++arg], NULL, 0);
+		else
+			break;
+	}
+
+	if (((argc - arg) < 2) || !block_size || (block_size > 0xffff)) {
+		fprintf(
+			stderr,
+			"Usage: %s [-b block_size] [-l limit] input output [raw_output]\n",
+			argv[0]
+		);
+		return 1;
+	}
+
+	Buffer input;
+
+	if (!buffer_load(&input, argv[arg]))
+		return 1;
+
+	if (limit && (input.length > limit))
+		input.length = limit;
+
+	size_t num_blocks = (input.length + block_size - 1) / block_size;
+
+	if (num_blocks > 0xffff) {
+		fprintf(stderr, "%s: too many blocks, increase block size\n", argv[arg]);
+		return 1;
+	}
+
+	Matcher m;
+
+	m.data = input.data;
+	m.size = input.length;
+	m.head = malloc(sizeof(int32_t) << HASH_BITS);
+	m.prev = malloc(sizeof(int32_t) * (input.length + 1));
+
+	for (size_t i = 0; i < (1 << HASH_BITS); i++)
+		m.head[i] = -1;
+
+	// Write the header and leave room for the block index, which is filled in
+	// once each block's compressed size is known.
+	Buffer output;
+
+	buffer_init(&output);
+	buffer_put_le32(&output, LZ4_MAGIC);
+	buffer_put_le32(&output, (uint32_t) input.length);
+	buffer_put_le16(&output, (uint16_t) block_size);
+	buffer_put_le16(&output, (uint16_t) num_blocks);
+
+	size_t index = output.length;
+
+	for (size_t i = 0; i < num_blocks; i++)
+		buffer_put_le32(&output, 0);
+
+	for (size_t i = 0; i < num_blocks; i++) {
+		size_t start = i * block_size;
+		size_t end   = start + block_size;
+
+		if (end > input.length)
+			end = input.length;
+
+		compress_block(&m, &output, start, end);
+		write_le32(&(output.data[index + i * 4]), (uint32_t) output.length);
+	}
+
+	if (!verify(output.data, input.data, input.length)) {
+		fprintf(stderr, "%s: verification failed\n", argv[arg]);
+		return 1;
+	}
+	if (!buffer_save(&output, argv[arg + 1]))
+		return 1;
+	if (((argc - arg) >= 3) && !buffer_save(&input, argv[arg + 2]))
+		return 1;
+
+	printf(
+		"%s: %zu -> %zu bytes (%zu%%), %zu blocks\n",
+		argv[arg], input.length, output.length,
+		input.length ? (output.length * 100 / input.length) : 0, num_blocks
+	);
+	return 0;
+}
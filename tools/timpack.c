@@ -0,0 +1,688 @@
+/*
+ * ps1-benchmark texture atlas packer (host tool)
+ *
+ * Packs a set of sprites into a single .TIM atlas and generates a C header
+ * holding each sprite's UV rectangle and CLUT ID, plus the atlas' texture page
+ * attribute, so that draw code can use precomputed constants instead of
+ * hardcoded texture coordinates.
+ *
+ * Usage: timpack [-b 4|8|15] [-x vram_x] [-y vram_y] [-c clut_x,clut_y]
+ *                [-n prefix] output.tim output.h input...
+ *
+ * Inputs can be uncompressed or RLE .TGA files (24 or 32 bits per pixel) or
+ * 16bpp .TIM files. Pixels with an alpha value below 128 are made transparent
+ * (color 0x0000); opaque black is stored as 0x8000 so it is still drawn. Each
+ * sprite's macros are named after the input file, e.g. textures/disc.tga with
+ * prefix TILESC becomes TILESC_DISC_U, TILESC_DISC_V and so on.
+ *
+ * The atlas always fits within a single 256x256 texture page, as a primitive
+ * can only sample from one page and the GPU's texture cache is flushed when
+ * switching pages. 4bpp atlases get a separate 16-color CLUT for each sprite,
+ * while 8bpp atlases share a single 256-color CLUT; colors are reduced by
+ * median cut if needed. The CLUT is placed below the atlas by default.
+ */
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+#include <stdio.h>
+
+#include "common.h"
+
+#define PAGE_SIZE   256
+#define MAX_SPRITES 256
+#define MAX_NAME    32
+
+#define TIM_MAGIC 0x10
+
+/* Sprites */
+
+typedef struct {
+	char     name[MAX_NAME];
+	int      width, height;
+	uint16_t *pixels;   // RGB555 with the PS1's transparency convention
+	uint8_t  *indices;  // Palette indices (4bpp and 8bpp only)
+	uint16_t palette[256];
+	int      u, v, clut_row;
+} Sprite;
+
+static Sprite sprites[MAX_SPRITES];
+static int    num_sprites = 0;
+
+static uint16_t to_rgb555(int r, int g, int b, int a) {
+	if (a < 128)
+		return 0x0000;
+
+	uint16_t color = (r >> 3) | ((g >> 3) << 5) | ((b >> 3) << 10);
+
+	return color ? color : 0x8000;
+}
+
+static void set_name(Sprite *sprite, const char *path) {
+	const char *start = path;
+
+	for (const char *ptr = path; *ptr; ptr++) {
+		if ((*ptr == '/') || (*ptr == '\\'))
+			start = ptr + 1;
+	}
+
+	int length = 0;
+
+	for (; start[length] && (start[length] != '.') && (length < (MAX_NAME - 1)); length++)
+		sprite->name[length] = isalnum((unsigned char) start[length]) ?
+			toupper((unsigned char) start[length]) : '_';
+
+	sprite->name[length] = 0;
+}
+
+/* Image loading */
+
+static bool load_tga(Sprite *sprite, const Buffer *file) {
+	const uint8_t *data = file->data;
+
+	if (file->length < 18)
+		return false;
+
+	int type   = data[2];
+	int width  = read_le16(&data[12]);
+	int height = read_le16(&data[14]);
+	int bpp    = data[16];
+	bool top   = (data[17] >> 5) & 1;
+
+	if (((type != 2) && (type != 10)) || ((bpp != 24) && (bpp != 32)))
+		return false;
+
+	size_t        stride = bpp / 8;
+	size_t        count  = (size_t) width * height;
+	const uint8_t *ptr   = &data[18 + data[0]];
+	const uint8_t *end   = &data[file->length];
+	uint8_t       *rgba  = malloc(count * 4);
+
+	// Decode everything to RGBA first, expanding RLE packets if necessary.
+	for (size_t i = 0; i < count;) {
+		size_t run  = 1;
+		bool   copy = true;
+
+		if (type == 10) {
+			if (ptr >= end)
+				break;
+
+			uint8_t header = *(ptr++);
+
+			run  = (header & 0x7f) + 1;
+			copy = !(header & 0x80);
+		}
+
+		for (size_t j = 0; (j < run) && (i < count); j++, i++) {
+			if ((ptr + stride) > end) {
+				free(rgba);
+				return false;
+			}
+
+			rgba[i * 4 + 0] = ptr[2];
+			rgba[i * 4 + 1] = ptr[1];
+			rgba[i * 4 + 2] = ptr[0];
+			rgba[i * 4 + 3] = (bpp == 32) ? ptr[3] : 255;
+
+			if (copy || (j == (run - 1)))
+				ptr += stride;
+		}
+	}
+
+	sprite->width  = width;
+	sprite->height = height;
+	sprite->pixels = malloc(count * sizeof(uint16_t));
+
+	for (int y = 0; y < height; y++) {
+		int row = top ? y : (height - 1 - y);
+
+		for (int x = 0; x < width; x++) {
+			const uint8_t *pixel = &rgba[(row * width + x) * 4];
+
+			sprite->pixels[y * width + x] =
+				to_rgb555(pixel[0], pixel[1], pixel[2], pixel[3]);
+		}
+	}
+
+	free(rgba);
+	return true;
+}
+
+static bool load_tim(Sprite *sprite, const Buffer *file) {
+	const uint8_t *data = file->data;
+
+	if ((file->length < 20) || (read_le32(data) != TIM_MAGIC))
+		return false;
+
+	// Only 16bpp images without a CLUT are supported as inputs.
+	if ((read_le32(&data[4]) & 15) != 2)
+		return false;
+
+	int width  = read_le16(&data[16]);
+	int height = read_le16(&data[18]);
+
+	if ((20 + (size_t) width * height * 2) > file->length)
+		return false;
+
+	sprite->width  = width;
+	sprite->height = height;
+	sprite->pixels = malloc((size_t) width * height * sizeof(uint16_t));
+
+	for (int i = 0; i < (width * height); i++)
+		sprite->pixels[i] = read_le16(&data[20 + i * 2]);
+
+	return true;
+}
+
+/* Color reduction */
+
+typedef struct {
+	uint16_t color;
+	uint32_t count;
+} ColorEntry;
+
+typedef struct {
+	int start, end; // Range of entries in the color list
+} ColorBox;
+
+static int sort_channel;
+
+// Channels 0-2 are red, green and blue. Channel 3 is the STP bit, scaled up so
+// that boxes mixing colors with and without it are split first.
+static int channel(uint16_t color, int index) {
+	if (index == 3)
+		return (color >> 15) ? 31 : 0;
+
+	return (color >> (index * 5)) & 31;
+}
+
+static int compare_entries(const void *a, const void *b) {
+	return
+		channel(((const ColorEntry *) a)->color, sort_channel) -
+		channel(((const ColorEntry *) b)->color, sort_channel);
+}
+
+static int box_range(const ColorEntry *entries, const ColorBox *box, int *axis) {
+	int best = -1;
+
+	*axis = 0;
+
+	for (int c = 0; c < 4; c++) {
+		int low = 31, high = 0;
+
+		for (int i = box->start; i < box->end; i++) {
+			int value = channel(entries[i].color, c);
+
+			if (value < low)
+				low = value;
+			if (value > high)
+				high = value;
+		}
+
+		if ((high - low) > best) {
+			best  = high - low;
+			*axis = c;
+		}
+	}
+
+	return best;
+}
+
+// Builds a palette of up to max_colors opaque colors for the given pixels
+// (transparent pixels always use index 0, which is reserved) and maps each
+// pixel to its closest palette entry.
+static int quantize(
+	const uint16_t *pixels, size_t count, uint16_t *palette, uint8_t *indices,
+	int max_colors
+) {
+	ColorEntry *entries    = calloc(65536, sizeof(ColorEntry));
+	int        num_entries = 0;
+
+	// Build a histogram of the opaque colors. The STP bit is kept, as it
+	// selects whether the pixel is blended by semi-transparent primitives.
+	uint32_t *histogram = calloc(65536, sizeof(uint32_t));
+
+	for (size_t i = 0; i < count; i++) {
+		if (pixels[i])
+			histogram[pixels[i]]++;
+	}
+
+	for (int color = 0; color < 65536; color++) {
+		if (histogram[color]) {
+			entries[num_entries].color   = (uint16_t) color;
+			entries[num_entries].count   = histogram[color];
+			num_entries++;
+		}
+	}
+
+	free(histogram);
+
+	// Split the box with the largest color range at its weighted median
+	// until there are enough boxes.
+	ColorBox boxes[256];
+	int      num_boxes = 0;
+
+	if (num_entries) {
+		boxes[0].start = 0;
+		boxes[0].end   = num_entries;
+		num_boxes      = 1;
+	}
+
+	while (num_boxes < max_colors) {
+		int split = -1, split_axis = 0, best_range = 0;
+
+		for (int i = 0; i < num_boxes; i++) {
+			int axis = 0;
+			int range = box_range(entries, &boxes[i], &axis);
+
+			if (((boxes[i].end - boxes[i].start) > 1) && (range > best_range)) {
+				split      = i;
+				split_axis = axis;
+				best_range = range;
+			}
+		}
+
+		if (split < 0)
+			break;
+
+		ColorBox *box = &boxes[split];
+
+		sort_channel = split_axis;
+		qsort(&entries[box->start], box->end - box->start, sizeof(ColorEntry), &compare_entries);
+
+		uint32_t total = 0, half = 0;
+		int      middle;
+
+		for (int i = box->start; i < box->end; i++)
+			total += entries[i].count;
+
+		// Both halves must get at least one color.
+		for (middle = box->start; middle < (box->end - 2); middle++) {
+			half += entries[middle].count;
+
+			if ((half * 2) >= total)
+				break;
+		}
+
+		boxes[num_boxes].start = middle + 1;
+		boxes[num_boxes].end   = box->end;
+		box->end               = middle + 1;
+		num_boxes++;
+	}
+
+	// Average each box into a palette entry. Index 0 is transparent. The STP
+	// bit is set if most of the box's pixels have it set.
+	palette[0] = 0x0000;
+
+	for (int i = 0; i < num_boxes; i++) {
+		uint32_t sum[3] = { 0, 0, 0 }, stp = 0, total = 0;
+
+		for (int j = boxes[i].start; j < boxes[i].end; j++) {
+			for (int c = 0; c < 3; c++)
+				sum[c] += channel(entries[j].color, c) * entries[j].count;
+
+			if (entries[j].color & 0x8000)
+				stp += entries[j].count;
+
+			total += entries[j].count;
+		}
+
+		uint16_t color = 0;
+
+		for (int c = 0; c < 3; c++)
+			color |= ((sum[c] + total / 2) / total) << (c * 5);
+
+		if ((stp * 2) > total)
+			color |= 0x8000;
+
+		palette[i + 1] = color ? color : 0x8000;
+	}
+
+	for (size_t i = 0; i < count; i++) {
+		if (!pixels[i]) {
+			indices[i] = 0;
+			continue;
+		}
+
+		int best = 1, best_distance = 0x7fffffff;
+
+		for (int j = 1; j <= num_boxes; j++) {
+			int distance = 0;
+
+			for (int c = 0; c < 4; c++) {
+				int delta = channel(pixels[i], c) - channel(palette[j], c);
+
+				distance += delta * delta;
+			}
+
+			if (distance < best_distance) {
+				best          = j;
+				best_distance = distance;
+			}
+		}
+
+		indices[i] = (uint8_t) best;
+	}
+
+	free(entries);
+	return num_boxes + 1;
+}
+
+/* Packing */
+
+static int compare_heights(const void *a, const void *b) {
+	const Sprite *sa = *((const Sprite *const *) a);
+	const Sprite *sb = *((const Sprite *const *) b);
+
+	if (sa->height != sb->height)
+		return sb->height - sa->height;
+
+	// Keep the input order for sprites of the same height.
+	return (int) (sa - sb);
+}
+
+// Simple shelf packer: sprites are sorted by height and placed left to right
+// in rows as tall as the first sprite in each row. Sprite widths are rounded
+// up so each sprite starts on a halfword boundary in VRAM.
+static bool pack(int max_width, int max_height, int align, int *width, int *height) {
+	Sprite *order[MAX_SPRITES];
+
+	for (int i = 0; i < num_sprites; i++)
+		order[i] = &sprites[i];
+
+	qsort(order, num_sprites, sizeof(Sprite *), &compare_heights);
+
+	int x = 0, y = 0, shelf = 0;
+
+	*width  = 0;
+	*height = 0;
+
+	for (int i = 0; i < num_sprites; i++) {
+		Sprite *sprite = order[i];
+		int    w       = (sprite->width + align - 1) / align * align;
+
+		if ((x + w) > max_width) {
+			x     = 0;
+			y    += shelf;
+			shelf = 0;
+		}
+		if (((x + w) > max_width) || ((y + sprite->height) > max_height))
+			return false;
+
+		sprite->u = x;
+		sprite->v = y;
+		x        += w;
+
+		if (sprite->height > shelf)
+			shelf = sprite->height;
+		if (x > *width)
+			*width = x;
+		if ((y + shelf) > *height)
+			*height = y + shelf;
+	}
+
+	return true;
+}
+
+/* Output */
+
+static void put_block(Buffer *out, int x, int y, int w, int h, const Buffer *data) {
+	buffer_put_le32(out, (uint32_t) (12 + data->length));
+	buffer_put_le16(out, (uint16_t) x);
+	buffer_put_le16(out, (uint16_t) y);
+	buffer_put_le16(out, (uint16_t) w);
+	buffer_put_le16(out, (uint16_t) h);
+	buffer_write(out, data->data, data->length);
+}
+
+static uint16_t get_tpage(int mode, int x, int y) {
+	return
+		((x & 0x3ff) >> 6) | ((y & 0x100) >> 4) | ((mode & 3) << 7) |
+		((y & 0x200) << 2);
+}
+
+static uint16_t get_clut(int x, int y) {
+	return (uint16_t) ((y << 6) | ((x >> 4) & 0x3f));
+}
+
+/* Main */
+
+int main(int argc, char **argv) {
+	int        bpp    = 15;
+	int        vram_x = 640, vram_y = 0;
+	int        clut_x = -1, clut_y = -1;
+	const char *prefix = NULL;
+	int        arg     = 1;
+
+	for (; (arg < argc) && (argv[arg][0] == '-'); arg++) {
+		if (!strcmp(argv[arg], "-b") && ((arg + 1) < argc))
+			bpp = atoi(argv[++arg]);
+		else if (!strcmp(argv[arg], "-x") && ((arg + 1) < argc))
+			vram_x = atoi(argv[++arg]);
+		else if (!strcmp(argv[arg], "-y") && ((arg + 1) < argc))
+			vram_y = atoi(argv[++arg]);
+		else if (!strcmp(argv[arg], "-c") && ((arg + 1) < argc))
+			sscanf(argv[++arg], "%d,%d", &clut_x, &clut_y);
+		else if (!strcmp(argv[arg], "-n") && ((arg + 1) < argc))
+			prefix = argv[++arg];
+		else
+			break;
+	}
+
+	if (((argc - arg) < 3) || ((bpp != 4) && (bpp != 8) && (bpp != 15))) {
+		fprintf(
+			stderr,
+			"Usage: %s [-b 4|8|15] [-x vram_x] [-y vram_y] [-c clut_x,clut_y] [-n prefix] output.tim output.h input...\n",
+			argv[0]
+		);
+		return 1;
+	}
+
+	const char *tim_path    = argv[arg++];
+	const char *header_path = argv[arg++];
+
+	for (; arg < argc; arg++) {
+		if (num_sprites >= MAX_SPRITES) {
+			fprintf(stderr, "too many sprites (max %d)\n", MAX_SPRITES);
+			return 1;
+		}
+
+		Sprite *sprite = &sprites[num_sprites++];
+		Buffer file;
+
+		if (!buffer_load(&file, argv[arg]))
+			return 1;
+		if (!load_tga(sprite, &file) && !load_tim(sprite, &file)) {
+			fprintf(stderr, "%s: unsupported image format\n", argv[arg]);
+			return 1;
+		}
+
+		set_name(sprite, argv[arg]);
+		buffer_free(&file);
+	}
+
+	// Work out where the atlas falls within its texture page. The page is
+	// always 256 texels wide, i.e. 64, 128 or 256 halfwords in VRAM.
+	int mode        = (bpp == 4) ? 0 : ((bpp == 8) ? 1 : 2);
+	int texels      = (bpp == 4) ? 4 : ((bpp == 8) ? 2 : 1); // Per halfword
+	int page_x      = vram_x & ~63;
+	int page_y      = vram_y & ~255;
+	int u_offset    = (vram_x - page_x) * texels;
+	int v_offset    = vram_y - page_y;
+	int width, height;
+
+	if (
+		(u_offset >= PAGE_SIZE) ||
+		!pack(PAGE_SIZE - u_offset, PAGE_SIZE - v_offset, texels, &width, &height)
+	) {
+		fprintf(stderr, "%s: sprites do not fit in a single texture page\n", tim_path);
+		return 1;
+	}
+
+	if (clut_x < 0) {
+		clut_x = vram_x;
+		clut_y = vram_y + height;
+	}
+	if (clut_x % 16) {
+		fprintf(stderr, "%s: CLUT X coordinate must be a multiple of 16\n", tim_path);
+		return 1;
+	}
+
+	// Reduce colors and assign CLUT rows.
+	int num_colors = 1 << bpp;
+	int clut_rows  = 0;
+
+	if (bpp == 8) {
+		// Quantize all sprites together to get a shared palette, by treating
+		// them as a single strip of pixels.
+		size_t   count = 0;
+		uint16_t *all;
+		uint8_t  *indices;
+
+		for (int i = 0; i < num_sprites; i++)
+			count += (size_t) sprites[i].width * sprites[i].height;
+
+		all     = malloc(count * sizeof(uint16_t));
+		indices = malloc(count);
+		count   = 0;
+
+		for (int i = 0; i < num_sprites; i++) {
+			size_t length = (size_t) sprites[i].width * sprites[i].height;
+
+			memcpy(&all[count], sprites[i].pixels, length * sizeof(uint16_t));
+			count += length;
+		}
+
+		quantize(all, count, sprites[0].palette, indices, num_colors - 1);
+		count = 0;
+
+		for (int i = 0; i < num_sprites; i++) {
+			size_t length = (size_t) sprites[i].width * sprites[i].height;
+
+			sprites[i].indices  = malloc(length);
+			sprites[i].clut_row = 0;
+
+			memcpy(sprites[i].indices, &indices[count], length);
+			count += length;
+		}
+
+		free(all);
+		free(indices);
+		clut_rows = 1;
+	} else if (bpp == 4) {
+		for (int i = 0; i < num_sprites; i++) {
+			size_t length = (size_t) sprites[i].width * sprites[i].height;
+
+			sprites[i].indices  = malloc(length);
+			sprites[i].clut_row = i;
+
+			quantize(sprites[i].pixels, length, sprites[i].palette, sprites[i].indices, num_colors - 1);
+		}
+
+		clut_rows = num_sprites;
+	}
+
+	// Render the atlas. Unused areas are left transparent.
+	int    vram_width = width / texels;
+	Buffer pixels, clut, tim;
+
+	buffer_init(&pixels);
+	buffer_fill(&pixels, 0, (size_t) vram_width * height * 2);
+
+	for (int i = 0; i < num_sprites; i++) {
+		Sprite *sprite = &sprites[i];
+
+		for (int y = 0; y < sprite->height; y++) {
+			for (int x = 0; x < sprite->width; x++) {
+				int    index  = y * sprite->width + x;
+				int    u      = sprite->u + x;
+				size_t row    = (size_t) (sprite->v + y) * vram_width * 2;
+
+				if (bpp == 15) {
+					write_le16(&pixels.data[row + u * 2], sprite->pixels[index]);
+				} else if (bpp == 8) {
+					pixels.data[row + u] = sprite->indices[index];
+				} else {
+					pixels.data[row + u / 2] |= sprite->indices[index] << ((u % 2) * 4);
+				}
+			}
+		}
+
+		sprite->u += u_offset;
+		sprite->v += v_offset;
+	}
+
+	buffer_init(&clut);
+
+	for (int row = 0; row < clut_rows; row++) {
+		for (int i = 0; i < num_colors; i++)
+			buffer_put_le16(&clut, sprites[row].palette[i]);
+	}
+
+	buffer_init(&tim);
+	buffer_put_le32(&tim, TIM_MAGIC);
+	buffer_put_le32(&tim, mode | (clut_rows ? 8 : 0));
+
+	if (clut_rows)
+		put_block(&tim, clut_x, clut_y, num_colors, clut_rows, &clut);
+
+	put_block(&tim, vram_x, vram_y, vram_width, height, &pixels);
+
+	if (!buffer_save(&tim, tim_path))
+		return 1;
+
+	// Generate the header.
+	char name[MAX_NAME];
+
+	if (!prefix) {
+		Sprite dummy;
+
+		set_name(&dummy, tim_path);
+		strcpy(name, dummy.name);
+		prefix = name;
+	}
+
+	FILE *header = fopen(header_path, "w");
+
+	if (!header) {
+		fprintf(stderr, "%s: cannot create file\n", header_path);
+		return 1;
+	}
+
+	fprintf(header, "/*\n * Generated by timpack from %d sprites, do not edit.\n */\n\n", num_sprites);
+	fprintf(header, "#pragma once\n\n");
+	fprintf(header, "#define %s_BPP        %d\n", prefix, bpp);
+	fprintf(header, "#define %s_TPAGE      0x%04x // getTPage(%d, 0, %d, %d)\n", prefix, get_tpage(mode, page_x, page_y), mode, page_x, page_y);
+	fprintf(header, "#define %s_CLUT       0x%04x // getClut(%d, %d)\n", prefix, clut_rows ? get_clut(clut_x, clut_y) : 0, clut_x, clut_y);
+	fprintf(header, "#define %s_VRAM_X     %d\n", prefix, vram_x);
+	fprintf(header, "#define %s_VRAM_Y     %d\n", prefix, vram_y);
+	fprintf(header, "#define %s_CLUT_X     %d\n", prefix, clut_x);
+	fprintf(header, "#define %s_CLUT_Y     %d\n", prefix, clut_y);
+	fprintf(header, "#define %s_NUM_SPRITES %d\n", prefix, num_sprites);
+
+	for (int i = 0; i < num_sprites; i++) {
+		const Sprite *sprite = &sprites[i];
+		uint16_t     clut_id = clut_rows ? get_clut(clut_x, clut_y + sprite->clut_row) : 0;
+
+		fprintf(header, "\n// %s\n", sprite->name);
+		fprintf(header, "#define %s_%s_U    %d\n", prefix, sprite->name, sprite->u);
+		fprintf(header, "#define %s_%s_V    %d\n", prefix, sprite->name, sprite->v);
+		fprintf(header, "#define %s_%s_W    %d\n", prefix, sprite->name, sprite->width);
+		fprintf(header, "#define %s_%s_H    %d\n", prefix, sprite->name, sprite->height);
+		fprintf(header, "#define %s_%s_CLUT 0x%04x\n", prefix, sprite->name, clut_id);
+	}
+
+	if (fclose(header)) {
+		fprintf(stderr, "%s: write error\n", header_path);
+		return 1;
+	}
+
+	printf(
+		"%s: %d sprites, %dx%d at %dbpp, %d CLUT rows\n",
+		tim_path, num_sprites, width, height, bpp, clut_rows
+	);
+	return 0;
+}
@@ -0,0 +1,555 @@
+/*
+ * ps1-benchmark VAG encoder (host tool)
+ *
+ * Converts one or more audio files into an interleaved .VAG file (VAGi) that
+ * can be played by the stream driver. Inputs can be 16-bit PCM .WAV files or
+ * existing .VAG files (mono VAGp or interleaved VAGi); the channels of all
+ * inputs are concatenated in order, so for instance two stereo files produce a
+ * 4-channel stream. If more output channels than input channels are requested,
+ * the input channels are repeated.
+ *
+ * Usage: vagenc [-i interleave] [-c channels] [-r sample_rate] [-d seconds]
+ *               [-L start[,end]] input... output
+ *
+ * The interleave (size of each channel's slice of a chunk) must be a multiple
+ * of 2048 bytes, so that chunks always start on a sector boundary and can be
+ * seeked to. The last block of each slice is flagged as a loop end, which
+ * makes the SPU jump to the loop address set by the stream driver once the
+ * slice has been played.
+ *
+ * Loop points can be given in seconds with -L; they are rounded to whole chunks
+ * (the start down, the end up) and stored as little-endian chunk indices in the
+ * otherwise unused header bytes at 0x14 (start) and 0x18 (end, or 0 to loop at
+ * the end of the file). Without -L both are 0, i.e. the whole file is looped.
+ *
+ * If all inputs are .VAG files at the output sample rate, their ADPCM data is
+ * copied as-is rather than being decoded and re-encoded, so re-interleaving an
+ * existing file is lossless.
+ */
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdio.h>
+
+#include "common.h"
+
+#define SECTOR_SIZE       2048
+#define BLOCK_SIZE        16
+#define SAMPLES_PER_BLOCK 28
+#define MAX_CHANNELS      24
+
+#define VAG_HEADER_SIZE   48
+#define FLAG_LOOP_END     0x01
+#define FLAG_LOOP_REPEAT  0x02
+
+/* Sources */
+
+typedef struct {
+	int16_t *pcm;
+	uint8_t *adpcm; // NULL for .WAV sources
+	size_t  num_samples;
+	int     sample_rate;
+} Source;
+
+static Source sources[MAX_CHANNELS];
+static int    num_sources = 0;
+
+static Source *add_source(const char *path, int sample_rate) {
+	if (num_sources >= MAX_CHANNELS) {
+		fprintf(stderr, "%s: too many input channels (max %d)\n", path, MAX_CHANNELS);
+		exit(1);
+	}
+
+	Source *source = &sources[num_sources++];
+
+	source->pcm         = NULL;
+	source->adpcm       = NULL;
+	source->num_samples = 0;
+	source->sample_rate = sample_rate;
+
+	return source;
+}
+
+/* ADPCM codec */
+
+static const int filters[5][2] = {
+	{   0,   0 },
+	{  60,   0 },
+	{ 115, -52 },
+	{  98, -55 },
+	{ 122, -60 }
+};
+
+static int16_t clamp16(int value) {
+	if (value < -32768)
+		return -32768;
+	if (value > 32767)
+		return 32767;
+
+	return (int16_t) value;
+}
+
+// Decodes a single block the same way the SPU does, updating the history.
+static void decode_block(const uint8_t *block, int16_t *output, int *s1, int *s2) {
+	int shift  = block[0] & 15;
+	int filter = (block[0] >> 4) % 5;
+
+	if (shift > 12)
+		shift = 9;
+
+	for (int i = 0; i < SAMPLES_PER_BLOCK; i++) {
+		int nibble = (block[2 + i / 2] >> ((i % 2) * 4)) & 15;
+		int sample = (int16_t) (nibble << 12) >> shift;
+
+		sample += (*s1 * filters[filter][0] + *s2 * filters[filter][1] + 32) >> 6;
+
+		output[i] = clamp16(sample);
+		*s2       = *s1;
+		*s1       = output[i];
+	}
+}
+
+// Quantizes a block with the given filter and shift and returns the squared
+// error. If block is not NULL, the encoded data is written to it and the
+// history is updated.
+static uint64_t try_block(
+	const int16_t *input, int filter, int shift, int *s1, int *s2,
+	uint8_t *block
+) {
+	uint64_t error = 0;
+	int      h1    = *s1;
+	int      h2    = *s2;
+
+	for (int i = 0; i < SAMPLES_PER_BLOCK; i++) {
+		int predicted = (h1 * filters[filter][0] + h2 * filters[filter][1] + 32) >> 6;
+		int residual  = input[i] - predicted;
+
+		// Round to the nearest step, then clamp to a signed nibble.
+		int step = 4096 >> shift;
+		int q    = (residual >= 0) ?
+			((residual + step / 2) / step) :
+			-((-residual + step / 2) / step);
+
+		if (q < -8)
+			q = -8;
+		if (q > 7)
+			q = 7;
+
+		int16_t decoded = clamp16(((q * 4096) >> shift) + predicted);
+		int     delta   = input[i] - decoded;
+
+		error += (int64_t) delta * delta;
+		h2     = h1;
+		h1     = decoded;
+
+		if (block) {
+			if (i % 2)
+				block[2 + i / 2] |= (q & 15) << 4;
+			else
+				block[2 + i / 2]  = q & 15;
+		}
+	}
+
+	if (block) {
+		block[0] = (uint8_t) (shift | (filter << 4));
+		block[1] = 0;
+		*s1      = h1;
+		*s2      = h2;
+	}
+
+	return error;
+}
+
+// Brute forces all filter and shift combinations and picks the one with the
+// lowest error. Slow, but this only runs at build time.
+static void encode_block(const int16_t *input, uint8_t *block, int *s1, int *s2) {
+	uint64_t best_error  = UINT64_MAX;
+	int      best_filter = 0, best_shift = 0;
+
+	for (int filter = 0; filter < 5; filter++) {
+		for (int shift = 0; shift <= 12; shift++) {
+			uint64_t error = try_block(input, filter, shift, s1, s2, NULL);
+
+			if (error < best_error) {
+				best_error  = error;
+				best_filter = filter;
+				best_shift  = shift;
+			}
+		}
+	}
+
+	try_block(input, best_filter, best_shift, s1, s2, block);
+}
+
+static uint8_t *encode(const int16_t *pcm, size_t num_samples) {
+	size_t  num_blocks = num_samples / SAMPLES_PER_BLOCK;
+	uint8_t *adpcm     = calloc(num_blocks, BLOCK_SIZE);
+	int     s1 = 0, s2 = 0;
+
+	for (size_t i = 0; i < num_blocks; i++)
+		encode_block(&pcm[i * SAMPLES_PER_BLOCK], &adpcm[i * BLOCK_SIZE], &s1, &s2);
+
+	return adpcm;
+}
+
+/* Input parsing */
+
+static void set_adpcm(Source *source, const uint8_t *data, size_t num_blocks) {
+	source->num_samples = num_blocks * SAMPLES_PER_BLOCK;
+	source->adpcm       = malloc(num_blocks * BLOCK_SIZE);
+	source->pcm         = malloc(source->num_samples * sizeof(int16_t));
+
+	int s1 = 0, s2 = 0;
+
+	for (size_t i = 0; i < num_blocks; i++) {
+		uint8_t *block = &(source->adpcm[i * BLOCK_SIZE]);
+
+		// Loop flags are stripped, the output's flags are set when
+		// interleaving.
+		memcpy(block, &data[i * BLOCK_SIZE], BLOCK_SIZE);
+		block[1] = 0;
+
+		decode_block(block, &(source->pcm[i * SAMPLES_PER_BLOCK]), &s1, &s2);
+	}
+}
+
+static bool load_vag(const char *path, const Buffer *file) {
+	const uint8_t *data = file->data;
+
+	if (file->length < VAG_HEADER_SIZE)
+		return false;
+
+	size_t size        = read_be32(&data[12]);
+	int    sample_rate = (int) read_be32(&data[16]);
+
+	if (!memcmp(data, "VAGp", 4)) {
+		size_t num_blocks = size / BLOCK_SIZE;
+
+		if ((VAG_HEADER_SIZE + num_blocks * BLOCK_SIZE) > file->length)
+			num_blocks = (file->length - VAG_HEADER_SIZE) / BLOCK_SIZE;
+
+		// Mono files usually start with an empty block, which is kept as it
+		// is part of the sample.
+		set_adpcm(add_source(path, sample_rate), &data[VAG_HEADER_SIZE], num_blocks);
+		return true;
+	}
+	if (memcmp(data, "VAGi", 4))
+		return false;
+
+	size_t interleave   = read_le32(&data[8]);
+	int    num_channels = read_le16(&data[0x1e]);
+
+	if (!num_channels)
+		num_channels = 2;
+	if (!interleave || (interleave % BLOCK_SIZE)) {
+		fprintf(stderr, "%s: invalid interleave\n", path);
+		exit(1);
+	}
+
+	// De-interleave each channel into a contiguous buffer first.
+	size_t  num_chunks = (size + interleave - 1) / interleave;
+	size_t  available  = (file->length - SECTOR_SIZE) / (interleave * num_channels);
+	uint8_t *channel   = malloc(num_chunks * interleave);
+
+	if (num_chunks > available)
+		num_chunks = available;
+
+	for (int ch = 0; ch < num_channels; ch++) {
+		for (size_t i = 0; i < num_chunks; i++) {
+			const uint8_t *slice = &data[
+				SECTOR_SIZE + (i * num_channels + ch) * interleave
+			];
+
+			memcpy(&channel[i * interleave], slice, interleave);
+		}
+
+		size_t length = num_chunks * interleave;
+
+		if (length > size)
+			length = size;
+
+		// The last slice is usually padded, with the actual end of the audio
+		// data marked by the first loop end flag in it.
+		if (num_chunks) {
+			for (size_t i = (num_chunks - 1) * interleave; i < length; i += BLOCK_SIZE) {
+				if (channel[i + 1] & FLAG_LOOP_END) {
+					length = i + BLOCK_SIZE;
+					break;
+				}
+			}
+		}
+
+		set_adpcm(add_source(path, sample_rate), channel, length / BLOCK_SIZE);
+	}
+
+	free(channel);
+	return true;
+}
+
+static bool load_wav(const char *path, const Buffer *file) {
+	const uint8_t *data = file->data;
+
+	if ((file->length < 12) || memcmp(data, "RIFF", 4) || memcmp(&data[8], "WAVE", 4))
+		return false;
+
+	int    num_channels = 0, sample_rate = 0, bits = 0, format = 0;
+	size_t offset       = 12;
+
+	while ((offset + 8) <= file->length) {
+		const uint8_t *chunk  = &data[offset];
+		size_t        length  = read_le32(&chunk[4]);
+		const uint8_t *body   = &chunk[8];
+
+		offset += 8 + length + (length % 2);
+
+		if (!memcmp(chunk, "fmt ", 4)) {
+			format       = read_le16(&body[0]);
+			num_channels = read_le16(&body[2]);
+			sample_rate  = (int) read_le32(&body[4]);
+			bits         = read_le16(&body[14]);
+			continue;
+		}
+		if (memcmp(chunk, "data", 4))
+			continue;
+
+		// Format 0xfffe is WAVE_FORMAT_EXTENSIBLE, which is used by some
+		// tools for plain PCM files with more than 2 channels.
+		if (((format != 1) && (format != 0xfffe)) || (bits != 16) || !num_channels) {
+			fprintf(stderr, "%s: only 16-bit PCM files are supported\n", path);
+			exit(1);
+		}
+
+		if (((size_t) (body - data) + length) > file->length)
+			length = file->length - (size_t) (body - data);
+
+		size_t num_samples = length / (num_channels * 2);
+
+		for (int ch = 0; ch < num_channels; ch++) {
+			Source *source = add_source(path, sample_rate);
+
+			source->num_samples = num_samples;
+			source->pcm         = malloc(num_samples * sizeof(int16_t) + 1);
+
+			for (size_t i = 0; i < num_samples; i++)
+				source->pcm[i] = (int16_t) read_le16(&body[(i * num_channels + ch) * 2]);
+		}
+
+		return true;
+	}
+
+	fprintf(stderr, "%s: no audio data found\n", path);
+	exit(1);
+}
+
+/* Resampling */
+
+// Linear interpolation is good enough for the test material in this project;
+// resample with a proper tool beforehand if quality matters.
+static void resample(Source *source, int sample_rate) {
+	if (source->sample_rate == sample_rate)
+		return;
+
+	size_t  num_samples = (size_t) ((uint64_t) source->num_samples * sample_rate / source->sample_rate);
+	int16_t *pcm        = malloc(num_samples * sizeof(int16_t) + 1);
+
+	for (size_t i = 0; i < num_samples; i++) {
+		double position = (double) i * source->sample_rate / sample_rate;
+		size_t index    = (size_t) position;
+		double fraction = position - index;
+
+		int a = source->pcm[index];
+		int b = ((index + 1) < source->num_samples) ? source->pcm[index + 1] : a;
+
+		pcm[i] = clamp16((int) (a + (b - a) * fraction));
+	}
+
+	free(source->pcm);
+	free(source->adpcm);
+
+	source->pcm         = pcm;
+	source->adpcm       = NULL;
+	source->num_samples = num_samples;
+	source->sample_rate = sample_rate;
+}
+
+/* Main */
+
+int main(int argc, char **argv) {
+	size_t interleave   = SECTOR_SIZE;
+	int    num_channels = 0;
+	int    sample_rate  = 0;
+	double duration     = 0.0;
+	double loop_start   = 0.0;
+	double loop_end     = 0.0;
+	int    arg          = 1;
+
+	for (; (arg < argc) && (argv[arg][0] == '-'); arg++) {
+		if (!strcmp(argv[arg], "-i") && ((arg + 1) < argc))
+			interleave = strtoul(argv[++arg], NULL, 0);
+		else if (!strcmp(argv[arg], "-c") && ((arg + 1) < argc))
+			num_channels = atoi(argv[++arg]);
+		else if (!strcmp(argv[arg], "-r") && ((arg + 1) < argc))
+			sample_rate = atoi(argv[++arg]);
+		else if (!strcmp(argv[arg], "-d") && ((arg + 1) < argc))
+			duration = atof(argv[++arg]);
+		else if (!strcmp(argv[arg], "-L") && ((arg + 1) < argc))
+			sscanf(argv[++arg], "%lf,%lf", &loop_start, &loop_end);
+		else
+			break;
+	}
+
+	if (
+		((argc - arg) < 2) || !interleave || (interleave % SECTOR_SIZE) ||
+		(num_channels < 0) || (num_channels > MAX_CHANNELS) || (sample_rate < 0) ||
+		(loop_start < 0.0) || ((loop_end > 0.0) && (loop_end <= loop_start))
+	) {
+		fprintf(
+			stderr,
+			"Usage: %s [-i interleave] [-c channels] [-r sample_rate] [-d seconds] [-L start[,end]] input... output\n"
+			"The interleave must be a multiple of %d bytes (default %d).\n",
+			argv[0], SECTOR_SIZE, SECTOR_SIZE
+		);
+		return 1;
+	}
+
+	const char *output_path = argv[argc - 1];
+
+	for (; arg < (argc - 1); arg++) {
+		Buffer file;
+
+		if (!buffer_load(&file, argv[arg]))
+			return 1;
+
+		if (!load_wav(argv[arg], &file) && !load_vag(argv[arg], &file)) {
+			fprintf(stderr, "%s: unsupported file format\n", argv[arg]);
+			return 1;
+		}
+
+		buffer_free(&file);
+	}
+
+	if (!num_channels)
+		num_channels = num_sources;
+	if (!sample_rate)
+		sample_rate = sources[0].sample_rate;
+
+	// Bring all sources to the same sample rate (dropping the ADPCM data of
+	// any .VAG file that had to be resampled) and find out the length of the
+	// longest one, which all others are padded to with silence.
+	size_t num_samples = 0;
+	bool   lossless    = true;
+
+	for (int i = 0; i < num_sources; i++) {
+		resample(&sources[i], sample_rate);
+
+		if (!sources[i].adpcm)
+			lossless = false;
+		if (sources[i].num_samples > num_samples)
+			num_samples = sources[i].num_samples;
+	}
+
+	if (duration > 0.0) {
+		size_t limit = (size_t) (duration * sample_rate);
+
+		if (num_samples > limit)
+			num_samples = limit;
+	}
+
+	// Round the length up to a whole number of chunks.
+	size_t blocks_per_slice = interleave / BLOCK_SIZE;
+	size_t num_blocks       = (num_samples + SAMPLES_PER_BLOCK - 1) / SAMPLES_PER_BLOCK;
+	size_t num_chunks       = (num_blocks + blocks_per_slice - 1) / blocks_per_slice;
+
+	size_t last_block = num_blocks - 1;
+
+	num_blocks  = num_chunks * blocks_per_slice;
+	num_samples = num_blocks * SAMPLES_PER_BLOCK;
+
+	// Convert the loop points to chunk indices. A loop end at or past the end
+	// of the file is stored as 0.
+	double   samples_per_chunk = (double) (blocks_per_slice * SAMPLES_PER_BLOCK);
+	uint32_t loop_start_chunk  = (uint32_t) (loop_start * sample_rate / samples_per_chunk);
+	uint32_t loop_end_chunk    = 0;
+
+	if (loop_end > 0.0) {
+		double chunks = loop_end * sample_rate / samples_per_chunk;
+
+		loop_end_chunk = (uint32_t) chunks;
+
+		if (loop_end_chunk < chunks)
+			loop_end_chunk++;
+
+		if (loop_end_chunk >= num_chunks)
+			loop_end_chunk = 0;
+	}
+
+	if (loop_start_chunk >= (loop_end_chunk ? loop_end_chunk : num_chunks)) {
+		fprintf(stderr, "Loop start is past the end of the stream\n");
+		return 1;
+	}
+
+	uint8_t *channels[MAX_CHANNELS];
+
+	for (int i = 0; i < num_sources; i++) {
+		Source *source = &sources[i];
+		size_t length  = source->num_samples;
+
+		if (length > num_samples)
+			length = num_samples;
+
+		if (lossless) {
+			channels[i] = calloc(num_blocks, BLOCK_SIZE);
+			memcpy(channels[i], source->adpcm, (length / SAMPLES_PER_BLOCK) * BLOCK_SIZE);
+		} else {
+			int16_t *pcm = calloc(num_samples, sizeof(int16_t));
+
+			memcpy(pcm, source->pcm, length * sizeof(int16_t));
+			channels[i] = encode(pcm, num_samples);
+			free(pcm);
+		}
+
+		// Flag the last block of each slice. The last slice is flagged right
+		// after the end of the audio data instead, skipping the padding.
+		for (size_t j = 1; j < num_chunks; j++)
+			channels[i][(j * blocks_per_slice - 1) * BLOCK_SIZE + 1] =
+				FLAG_LOOP_END | FLAG_LOOP_REPEAT;
+
+		channels[i][last_block * BLOCK_SIZE + 1] = FLAG_LOOP_END | FLAG_LOOP_REPEAT;
+	}
+
+	// Write the header, padded to a full sector so the data that follows it
+	// is sector-aligned.
+	Buffer output;
+	size_t slice_size = num_blocks * BLOCK_SIZE;
+
+	buffer_init(&output);
+	buffer_write(&output, "VAGi", 4);
+	buffer_put_be32(&output, 0x20);
+	buffer_put_le32(&output, (uint32_t) interleave);
+	buffer_put_be32(&output, (uint32_t) slice_size);
+	buffer_put_be32(&output, (uint32_t) sample_rate);
+	buffer_put_le32(&output, loop_start_chunk);
+	buffer_put_le32(&output, loop_end_chunk);
+	buffer_fill(&output, 0, 2);
+	buffer_put_le16(&output, (uint16_t) num_channels);
+	buffer_fill(&output, 0, 16);
+	buffer_align(&output, SECTOR_SIZE);
+
+	for (size_t i = 0; i < num_chunks; i++) {
+		for (int ch = 0; ch < num_channels; ch++)
+			buffer_write(&output, &channels[ch % num_sources][i * interleave], interleave);
+	}
+
+	if (!buffer_save(&output, output_path))
+		return 1;
+
+	printf(
+		"%s: %d channels, %d Hz, interleave %zu, %zu chunks (%s)\n",
+		output_path, num_channels, sample_rate, interleave, num_chunks,
+		lossless ? "copied" : "encoded"
+	);
+	return 0;
+}
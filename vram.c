@@ -0,0 +1,345 @@
+/*
+ * ps1-benchmark VRAM allocator
+ */
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+#include <psxgpu.h>
+
+#include "vram.h"
+
+#define BLOCK_COLUMNS (VRAM_WIDTH / VRAM_BLOCK_SIZE)
+#define BLOCK_ROWS    (VRAM_HEIGHT / VRAM_BLOCK_SIZE)
+#define PAGE_ROWS     (256 / VRAM_BLOCK_SIZE)
+
+// The CLUT area is the bottom right corner of VRAM, 256 colors wide.
+#define CLUT_X        (VRAM_WIDTH - 256)
+#define CLUT_Y        (VRAM_HEIGHT - VRAM_CLUT_ROWS)
+#define CLUT_SLOTS    16
+#define FULL_ROW      0xffff
+
+typedef struct {
+	Vram_Texture texture;
+	RECT         rect, clut_rect;
+	uint32_t     last_used;
+	bool         used, has_clut;
+} Vram_Entry;
+
+// One bit per block (or CLUT slot), set if used
+static uint16_t _blocks[BLOCK_ROWS];
+static uint16_t _clut_slots[VRAM_CLUT_ROWS];
+
+static Vram_Entry _entries[VRAM_MAX_TEXTURES];
+static uint32_t   _frame = 1;
+static Vram_Stats _stats;
+
+/* Private utilities */
+
+static int _to_blocks(int pixels) {
+	return (pixels + VRAM_BLOCK_SIZE - 1) / VRAM_BLOCK_SIZE;
+}
+
+static void _set_blocks(int col, int row, int width, int height, bool used) {
+	uint16_t mask = ((1 << width) - 1) << col;
+
+	for (int i = row; i < (row + height); i++) {
+		if (used)
+			_blocks[i] |= mask;
+		else
+			_blocks[i] &= ~mask;
+	}
+}
+
+static bool _blocks_free(int col, int row, int width, int height) {
+	uint16_t mask = ((1 << width) - 1) << col;
+
+	for (int i = row; i < (row + height); i++) {
+		if (_blocks[i] & mask)
+			return false;
+	}
+
+	return true;
+}
+
+static void _set_clut_slots(int row, int rows, uint16_t mask, bool used) {
+	for (int i = row; i < (row + rows); i++) {
+		if (used)
+			_clut_slots[i] |= mask;
+		else
+			_clut_slots[i] &= ~mask;
+	}
+}
+
+static bool _clut_slots_free(int row, int rows, uint16_t mask) {
+	for (int i = row; i < (row + rows); i++) {
+		if (_clut_slots[i] & mask)
+			return false;
+	}
+
+	return true;
+}
+
+static void _reset_stats(void) {
+	_stats.hits         = 0;
+	_stats.misses       = 0;
+	_stats.evictions    = 0;
+	_stats.failures     = 0;
+	_stats.upload_bytes = 0;
+}
+
+static void _evict(Vram_Entry *entry) {
+	Vram_Free(&entry->rect);
+
+	if (entry->has_clut)
+		Vram_FreeClut(&entry->clut_rect);
+
+	entry->used = false;
+}
+
+// Evicts the least recently used texture not used in the current frame.
+// Returns false if there is none.
+static bool _evict_lru(void) {
+	Vram_Entry *lru = (void *) 0;
+
+	for (int i = 0; i < VRAM_MAX_TEXTURES; i++) {
+		Vram_Entry *entry = &_entries[i];
+
+		if (!entry->used || (entry->last_used == _frame))
+			continue;
+		if (!lru || (entry->last_used < lru->last_used))
+			lru = entry;
+	}
+
+	if (!lru)
+		return false;
+
+	_evict(lru);
+	_stats.evictions++;
+	return true;
+}
+
+static Vram_Entry *_find_free_entry(void) {
+	for (int i = 0; i < VRAM_MAX_TEXTURES; i++) {
+		if (!_entries[i].used)
+			return &_entries[i];
+	}
+
+	return (void *) 0;
+}
+
+// Allocates an entry and space for its image and CLUT, all or nothing.
+static Vram_Entry *_alloc_entry(const TIM_IMAGE *info) {
+	Vram_Entry *entry = _find_free_entry();
+
+	if (!entry)
+		return (void *) 0;
+	if (!Vram_Alloc(info->mode & TIM_BPP_MASK, info->prect->w, info->prect->h, &entry->rect))
+		return (void *) 0;
+
+	entry->has_clut = (info->mode & TIM_HAS_CLUT) ? true : false;
+
+	if (
+		entry->has_clut &&
+		!Vram_AllocClut(info->crect->w, info->crect->h, &entry->clut_rect)
+	) {
+		Vram_Free(&entry->rect);
+		return (void *) 0;
+	}
+
+	entry->used = true;
+	return entry;
+}
+
+/* Public API */
+
+void Vram_Init(void) {
+	for (int i = 0; i < BLOCK_ROWS; i++)
+		_blocks[i] = 0;
+	for (int i = 0; i < VRAM_CLUT_ROWS; i++)
+		_clut_slots[i] = 0;
+	for (int i = 0; i < VRAM_MAX_TEXTURES; i++)
+		_entries[i].used = false;
+
+	RECT clut_area = { CLUT_X, CLUT_Y, 256, VRAM_CLUT_ROWS };
+	Vram_Reserve(&clut_area);
+
+	_reset_stats();
+}
+
+void Vram_Reserve(const RECT *rect) {
+	int col0 = rect->x / VRAM_BLOCK_SIZE;
+	int row0 = rect->y / VRAM_BLOCK_SIZE;
+	int col1 = (rect->x + rect->w - 1) / VRAM_BLOCK_SIZE;
+	int row1 = (rect->y + rect->h - 1) / VRAM_BLOCK_SIZE;
+
+	_set_blocks(col0, row0, col1 - col0 + 1, row1 - row0 + 1, true);
+}
+
+bool Vram_Alloc(int bpp, int width, int height, RECT *rect) {
+	// A primitive can sample up to 256 texels horizontally, and a 16-bit
+	// pixel holds 4 texels at 4bpp, 2 at 8bpp and 1 at 16bpp.
+	if ((bpp < 0) || (bpp > 2))
+		return false;
+	if ((width <= 0) || (width > (64 << bpp)) || (height <= 0) || (height > 256))
+		return false;
+
+	int cols = _to_blocks(width);
+	int rows = _to_blocks(height);
+
+	// Try each row of texture pages in turn, so textures never straddle
+	// them, and take the first free area.
+	for (int page = 0; page < BLOCK_ROWS; page += PAGE_ROWS) {
+		for (int row = page; row <= (page + PAGE_ROWS - rows); row++) {
+			for (int col = 0; col <= (BLOCK_COLUMNS - cols); col++) {
+				if (!_blocks_free(col, row, cols, rows))
+					continue;
+
+				_set_blocks(col, row, cols, rows, true);
+				setRECT(rect, col * VRAM_BLOCK_SIZE, row * VRAM_BLOCK_SIZE, width, height);
+				return true;
+			}
+		}
+	}
+
+	return false;
+}
+
+void Vram_Free(const RECT *rect) {
+	_set_blocks(
+		rect->x / VRAM_BLOCK_SIZE, rect->y / VRAM_BLOCK_SIZE,
+		_to_blocks(rect->w), _to_blocks(rect->h), false
+	);
+}
+
+bool Vram_AllocClut(int colors, int rows, RECT *rect) {
+	if ((colors <= 0) || (colors > 256) || (rows <= 0) || (rows > VRAM_CLUT_ROWS))
+		return false;
+
+	if (colors > 16) {
+		for (int row = 0; row <= (VRAM_CLUT_ROWS - rows); row++) {
+			if (!_clut_slots_free(row, rows, FULL_ROW))
+				continue;
+
+			_set_clut_slots(row, rows, FULL_ROW, true);
+			setRECT(rect, CLUT_X, CLUT_Y + row, colors, rows);
+			return true;
+		}
+
+		return false;
+	}
+
+	// Fill up partially used rows first, to keep whole rows free for
+	// 256-color CLUTs.
+	for (int pass = 0; pass < 2; pass++) {
+		for (int row = 0; row <= (VRAM_CLUT_ROWS - rows); row++) {
+			if (!pass && !_clut_slots[row])
+				continue;
+
+			for (int slot = 0; slot < CLUT_SLOTS; slot++) {
+				if (!_clut_slots_free(row, rows, 1 << slot))
+					continue;
+
+				_set_clut_slots(row, rows, 1 << slot, true);
+				setRECT(rect, CLUT_X + slot * 16, CLUT_Y + row, colors, rows);
+				return true;
+			}
+		}
+	}
+
+	return false;
+}
+
+void Vram_FreeClut(const RECT *rect) {
+	uint16_t mask = (rect->w > 16) ? FULL_ROW : (1 << ((rect->x - CLUT_X) / 16));
+
+	_set_clut_slots(rect->y - CLUT_Y, rect->h, mask, false);
+}
+
+void Vram_NewFrame(void) {
+	_frame++;
+}
+
+const Vram_Texture *Vram_UseTexture(uint32_t id, Vram_LoadFunc load, void *arg) {
+	for (int i = 0; i < VRAM_MAX_TEXTURES; i++) {
+		Vram_Entry *entry = &_entries[i];
+
+		if (!entry->used || (entry->texture.id != id))
+			continue;
+
+		entry->last_used = _frame;
+		_stats.hits++;
+		return &entry->texture;
+	}
+
+	_stats.misses++;
+
+	const uint32_t *tim = load(id, arg);
+	TIM_IMAGE      info;
+
+	if (!tim || GetTimInfo(tim, &info)) {
+		_stats.failures++;
+		return (void *) 0;
+	}
+
+	Vram_Entry *entry;
+
+	while (!(entry = _alloc_entry(&info))) {
+		if (!_evict_lru()) {
+			_stats.failures++;
+			return (void *) 0;
+		}
+	}
+
+	// Uploads are queued after any drawing already in progress.
+	LoadImage(&entry->rect, info.paddr);
+	_stats.upload_bytes += entry->rect.w * entry->rect.h * 2;
+
+	if (entry->has_clut) {
+		LoadImage(&entry->clut_rect, info.caddr);
+		_stats.upload_bytes += entry->clut_rect.w * entry->clut_rect.h * 2;
+	}
+
+	// A 16-bit pixel holds 4 texels at 4bpp, 2 at 8bpp and 1 at 16bpp.
+	int bpp   = info.mode & TIM_BPP_MASK;
+	int shift = 2 - bpp;
+
+	entry->texture.id     = id;
+	entry->texture.tpage  = getTPage(bpp, 0, entry->rect.x, entry->rect.y);
+	entry->texture.clut   = entry->has_clut ?
+		getClut(entry->clut_rect.x, entry->clut_rect.y) : 0;
+	entry->texture.u      = (entry->rect.x % VRAM_BLOCK_SIZE) << shift;
+	entry->texture.v      = entry->rect.y % 256;
+	entry->texture.width  = entry->rect.w << shift;
+	entry->texture.height = entry->rect.h;
+	entry->last_used      = _frame;
+
+	return &entry->texture;
+}
+
+void Vram_Flush(void) {
+	for (int i = 0; i < VRAM_MAX_TEXTURES; i++) {
+		if (_entries[i].used)
+			_evict(&_entries[i]);
+	}
+}
+
+void Vram_GetStats(Vram_Stats *stats, bool reset) {
+	*stats = _stats;
+
+	if (reset)
+		_reset_stats();
+}
+
+int Vram_GetFreeBlocks(void) {
+	int count = 0;
+
+	for (int row = 0; row < BLOCK_ROWS; row++) {
+		for (int col = 0; col < BLOCK_COLUMNS; col++) {
+			if (!(_blocks[row] & (1 << col)))
+				count++;
+		}
+	}
+
+	return count;
+}
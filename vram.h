@@ -0,0 +1,192 @@
+/*
+ * ps1-benchmark VRAM allocator
+ */
+
+/**
+ * @file vram.h
+ * @brief VRAM allocator and LRU texture residency cache
+ *
+ * @details VRAM (1024x512 16-bit pixels) is divided into 64x64 blocks; a
+ * texture page is 64 pixels wide (regardless of color depth, as a pixel holds
+ * four 4bpp or two 8bpp texels) and 256 pixels tall, so each page spans four
+ * blocks vertically. Textures are allocated as rectangles of whole blocks
+ * that start at the left edge of a page and never cross the boundary between
+ * the two rows of pages, so a single primitive can sample the whole texture.
+ * Areas with a fixed location (framebuffers, the debug font, the texture
+ * atlas) are marked as reserved with Vram_Reserve().
+ *
+ * CLUTs are allocated separately from a dedicated area of VRAM_CLUT_ROWS rows
+ * of 256 colors, in slots of 16 colors (as CLUT X coordinates must be
+ * multiples of 16); a CLUT of more than 16 colors takes whole rows. A .TIM
+ * file may hold several CLUTs stacked vertically, which are allocated in the
+ * same slot of consecutive rows.
+ *
+ * On top of the allocator, Vram_UseTexture() keeps a cache of textures
+ * identified by number. Textures that are not resident are loaded through a
+ * callback returning a .TIM file in RAM (e.g. read from the disc) and
+ * uploaded; when there is no room left, the least recently used textures are
+ * evicted until there is. Textures used during the current frame (since the
+ * last call to Vram_NewFrame()) are never evicted, as primitives may still
+ * refer to them. Textures used by the previous frame can safely be
+ * overwritten, as uploads are queued after the previous frame's drawing.
+ */
+
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+#include <psxgpu.h>
+
+/* Constants */
+
+#define VRAM_WIDTH        1024
+#define VRAM_HEIGHT       512
+#define VRAM_BLOCK_SIZE   64
+#define VRAM_CLUT_ROWS    64
+#define VRAM_MAX_TEXTURES 64
+
+// .TIM file flags (the second word of the header)
+#define TIM_BPP_MASK      3
+#define TIM_HAS_CLUT      8
+
+/* Type definitions */
+
+/**
+ * @brief Callback loading a texture into RAM.
+ *
+ * @param id Texture number passed to Vram_UseTexture()
+ * @param arg Argument passed to Vram_UseTexture()
+ * @return Pointer to a .TIM file in RAM, which must remain valid until it has
+ *         been uploaded (i.e. until the next DrawSync()), or NULL on failure
+ */
+typedef const uint32_t *(*Vram_LoadFunc)(uint32_t id, void *arg);
+
+/**
+ * @brief A resident texture.
+ *
+ * @details tpage and clut are ready to be stored in primitives; u and v are
+ * the texture's top left corner within its texture page, and width and height
+ * are given in texels.
+ */
+typedef struct {
+	uint32_t id;
+	uint16_t tpage, clut;
+	uint8_t  u, v;
+	uint16_t width, height;
+} Vram_Texture;
+
+/**
+ * @brief Texture cache counters, accumulated since the last reset.
+ */
+typedef struct {
+	uint32_t hits, misses, evictions, failures;
+	uint32_t upload_bytes;
+} Vram_Stats;
+
+/* Public API */
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @brief Marks the whole of VRAM as free, except for the CLUT area, and
+ * empties the texture cache.
+ */
+void Vram_Init(void);
+
+/**
+ * @brief Marks an area with a fixed location as used.
+ *
+ * @details Every block the area overlaps is reserved, even partially.
+ *
+ * @param rect
+ */
+void Vram_Reserve(const RECT *rect);
+
+/**
+ * @brief Allocates an area for a texture.
+ *
+ * @details The width is limited to the 256 texels a primitive can sample,
+ * i.e. 64 pixels at 4bpp, 128 at 8bpp and 256 at 16bpp.
+ *
+ * @param bpp Color depth, as in getTPage() (0 = 4bpp, 1 = 8bpp, 2 = 16bpp)
+ * @param width Width in 16-bit pixels
+ * @param height Height (up to 256)
+ * @param rect Allocated area, with the requested size
+ * @return True on success, false if the size is invalid or there is no room
+ *         for the texture
+ */
+bool Vram_Alloc(int bpp, int width, int height, RECT *rect);
+
+/**
+ * @brief Frees an area allocated with Vram_Alloc().
+ *
+ * @param rect
+ */
+void Vram_Free(const RECT *rect);
+
+/**
+ * @brief Allocates one or more CLUTs of the same size.
+ *
+ * @param colors Colors per CLUT (up to 256)
+ * @param rows Number of CLUTs, one per row
+ * @param rect Allocated area, colors wide and rows tall
+ * @return True on success, false if the size is invalid or there is no room
+ *         for the CLUTs
+ */
+bool Vram_AllocClut(int colors, int rows, RECT *rect);
+
+/**
+ * @brief Frees a CLUT allocated with Vram_AllocClut().
+ *
+ * @param rect
+ */
+void Vram_FreeClut(const RECT *rect);
+
+/**
+ * @brief Starts a new frame, allowing the textures used in the previous one
+ * to be evicted.
+ */
+void Vram_NewFrame(void);
+
+/**
+ * @brief Returns a texture from the cache, loading it on a miss.
+ *
+ * @details The texture is marked as used in the current frame. On a miss, the
+ * texture is loaded through the callback, space is allocated for it (evicting
+ * the least recently used textures as needed) and its image and CLUT (if any)
+ * are uploaded with LoadImage().
+ *
+ * @param id Texture number
+ * @param load Callback loading the texture
+ * @param arg Argument passed to the callback
+ * @return Pointer to the texture, valid until the next call to Vram_NewFrame(),
+ *         or NULL if the texture could not be loaded or there was no room left
+ */
+const Vram_Texture *Vram_UseTexture(uint32_t id, Vram_LoadFunc load, void *arg);
+
+/**
+ * @brief Evicts all textures from the cache.
+ */
+void Vram_Flush(void);
+
+/**
+ * @brief Returns the texture cache counters.
+ *
+ * @param stats
+ * @param reset True to reset the counters afterwards
+ */
+void Vram_GetStats(Vram_Stats *stats, bool reset);
+
+/**
+ * @brief Returns the number of free blocks for textures.
+ *
+ * @return
+ */
+int Vram_GetFreeBlocks(void);
+
+#ifdef __cplusplus
+}
+#endif